@@ -1425,6 +1425,21 @@ static __always_inline int sock_to_ring(struct filler_data *data, struct sock *s
 	return bpf_val_to_ring_len(data, 0, size);
 }
 
+/*
+ * Key of rtt_static_map and rtt_agg_map for a socket, ports in network byte order
+ */
+static __always_inline void sk_to_tuple(struct sock *sk, struct tuple *tp)
+{
+	const struct inet_sock *inet = inet_sk(sk);
+
+	bpf_probe_read(&tp->sport, sizeof(tp->sport), (void *)&inet->inet_sport);
+	bpf_probe_read(&tp->dport, sizeof(tp->dport), (void *)&inet->inet_dport);
+	bpf_probe_read(&tp->saddr, sizeof(tp->saddr), (void *)&inet->inet_saddr);
+	bpf_probe_read(&tp->daddr, sizeof(tp->daddr), (void *)&inet->inet_daddr);
+	bpf_probe_read(&tp->family, sizeof(tp->family), (void *)&sk->__sk_common.skc_family);
+	tp->pad = 1;
+}
+
 static __always_inline int tuple_to_ring(struct filler_data *data, struct tuple *tp){
 	u16 sport = 0;
 	u16 dport = 0;
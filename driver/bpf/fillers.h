@@ -4927,6 +4927,37 @@ KP_FILLER(rtt_kprobe_e)
 }
 
 
+KP_FILLER(tcp_rtt_summary_e)
+{
+	struct pt_regs *args = (struct pt_regs*)data->ctx;
+	struct sock *sk = (struct sock *)_READ(PT_REGS_PARAM1(args));
+	struct tuple tp = {0};
+	struct statistics *st;
+	int res;
+
+	sk_to_tuple(sk, &tp);
+	st = bpf_map_lookup_elem(&rtt_agg_map, &tp);
+	if (!st)
+		return PPM_FAILURE_BUG;
+
+	res = tuple_to_ring(data, &tp);
+	if (res != PPM_SUCCESS)
+		return res;
+	res = bpf_val_to_ring(data, st->samples);
+	if (res != PPM_SUCCESS)
+		return res;
+	res = bpf_val_to_ring(data, st->srtt_min);
+	if (res != PPM_SUCCESS)
+		return res;
+	res = bpf_val_to_ring(data, st->srtt_max);
+	if (res != PPM_SUCCESS)
+		return res;
+	res = bpf_val_to_ring(data, st->srtt_sum);
+	if (res != PPM_SUCCESS)
+		return res;
+	return 0;
+}
+
 KP_FILLER(tcp_retransmit_skb_kprobe_e)
 {
 	struct pt_regs *args = (struct pt_regs*)data->ctx;
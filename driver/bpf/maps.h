@@ -106,6 +106,18 @@ struct bpf_map_def __bpf_section("maps") rtt_static_map = {
         .max_entries = 65535,
 };
 
+/*
+ * srtt aggregation state of the sockets, one copy per CPU so that the
+ * segments handled at the same time on several CPUs don't race on the
+ * counters. Each CPU sends its own summaries, userspace adds them up.
+ */
+struct bpf_map_def __bpf_section("maps") rtt_agg_map = {
+        .type = BPF_MAP_TYPE_LRU_PERCPU_HASH,
+        .key_size = sizeof(struct tuple),
+        .value_size = sizeof(struct statistics),
+        .max_entries = 65535,
+};
+
 struct bpf_map_def __bpf_section("maps") stash_tuple_map = {
 	.type = BPF_MAP_TYPE_HASH,
 	.key_size = sizeof(u64),
@@ -136,41 +148,45 @@ struct info_t {
     u8 time_type[NUM];
 };
 
-struct bpf_map_def __bpf_section("maps") on_start_ts = {
-        .type = BPF_MAP_TYPE_HASH,
-        .key_size = sizeof(u32),
-        .value_size = sizeof(u64),
-        .max_entries = 65535,
-};
-
-struct bpf_map_def __bpf_section("maps") off_start_ts = {
-        .type = BPF_MAP_TYPE_HASH,
-        .key_size = sizeof(u32),
-        .value_size = sizeof(u64),
-        .max_entries = 65535,
+/*
+ * The thread each CPU switched to last, and when. At the next switch on
+ * that CPU it is the previous thread, so its on-CPU time needs no per
+ * thread lookup.
+ */
+struct cpu_oncpu {
+    u32 tid;
+    u32 pad;
+    u64 ts;
 };
 
-struct bpf_map_def __bpf_section("maps") cpu_runq = {
-        .type = BPF_MAP_TYPE_HASH,
+struct bpf_map_def __bpf_section("maps") cpu_oncpu_map = {
+        .type = BPF_MAP_TYPE_PERCPU_ARRAY,
         .key_size = sizeof(u32),
-        .value_size = sizeof(u64),
-        .max_entries = 65535,
+        .value_size = sizeof(struct cpu_oncpu),
+        .max_entries = 1,
 };
 
-struct bpf_map_def __bpf_section("maps") type_map = {
-        .type = BPF_MAP_TYPE_HASH,
+/*
+ * Off-CPU state of a thread, updated in place. One LRU map instead of
+ * one hash map per field: a single lookup per thread and context switch,
+ * no deletes, and threads that never reach sched_process_exit are
+ * evicted instead of filling the map.
+ */
+struct thread_cpu_state {
+    u64 off_ts; // 0 if not switched out
+    u64 rq_ts; // wakeup time, 0 if not runnable
+    u64 focus_ts; // last network or disk activity
+    u32 type; // enum offcpu_type of the current syscall
+    u32 pad;
+};
+
+struct bpf_map_def __bpf_section("maps") thread_cpu_state_map = {
+        .type = BPF_MAP_TYPE_LRU_HASH,
         .key_size = sizeof(u32),
-        .value_size = sizeof(enum offcpu_type),
+        .value_size = sizeof(struct thread_cpu_state),
         .max_entries = 65535,
 };
 
-struct bpf_map_def __bpf_section("maps") syscall_map = {
-        .type = BPF_MAP_TYPE_HASH,
-        .key_size = sizeof(u32),
-        .value_size = sizeof(enum offcpu_type),
-        .max_entries = 1000,
-};
-
 struct bpf_map_def __bpf_section("maps") cpu_analysis_pid_whitelist = {
         .type = BPF_MAP_TYPE_HASH,
         .key_size = sizeof(u32),
@@ -186,17 +202,10 @@ struct bpf_map_def __bpf_section("maps") cpu_analysis_pid_blacklist = {
 };
 
 struct bpf_map_def __bpf_section("maps") cpu_records = {
-        .type = BPF_MAP_TYPE_HASH,
+        .type = BPF_MAP_TYPE_LRU_HASH,
         .key_size = sizeof(u32),
         .value_size = sizeof(struct info_t),
-        .max_entries = 1000,
-};
-
-struct bpf_map_def __bpf_section("maps") cpu_focus_threads = {
-        .type = BPF_MAP_TYPE_HASH,
-        .key_size = sizeof(u32),
-        .value_size = sizeof(u64),
-        .max_entries = 65535,
+        .max_entries = 16384,
 };
 #endif // __KERNEL__
 
@@ -53,13 +53,24 @@ static __always_inline bool prepare_filler(void *ctx,
 static __always_inline int bpf_cpu_analysis(void *ctx, u32 tid);
 static __always_inline void clear_map(u32 tid)
 {
-	bpf_map_delete_elem(&type_map, &tid);
-	bpf_map_delete_elem(&on_start_ts, &tid);
-	bpf_map_delete_elem(&off_start_ts, &tid);
-	bpf_map_delete_elem(&cpu_focus_threads, &tid);
+	bpf_map_delete_elem(&thread_cpu_state_map, &tid);
 	bpf_map_delete_elem(&cpu_records, &tid);
 }
 
+static __always_inline struct thread_cpu_state *get_thread_cpu_state(u32 tid)
+{
+	struct thread_cpu_state *st;
+	st = bpf_map_lookup_elem(&thread_cpu_state_map, &tid);
+	if (st == 0) {
+		struct thread_cpu_state new_st = {0};
+		new_st.type = OTHER;
+		bpf_map_update_elem(&thread_cpu_state_map, &tid, &new_st, BPF_NOEXIST);
+		st = bpf_map_lookup_elem(&thread_cpu_state_map, &tid);
+	}
+
+	return st;
+}
+
 static __always_inline bool check_filter(u32 pid)
 {
 	return true;
@@ -74,11 +85,6 @@ static __always_inline bool check_filter(u32 pid)
 	return false;
 }
 static __always_inline enum offcpu_type get_syscall_type(int syscall_id) {
-	enum offcpu_type *typep;
-	typep = bpf_map_lookup_elem(&syscall_map, &syscall_id);
-	if (typep != 0)
-		return *typep;
-
 	enum offcpu_type type;
 	switch(syscall_id) {
 		case __NR_read :
@@ -126,7 +132,6 @@ static __always_inline enum offcpu_type get_syscall_type(int syscall_id) {
 		default:
 			type = OTHER;
 	}
-	bpf_map_update_elem(&syscall_map, &syscall_id, &type, BPF_ANY);
 	return type;
 }
 static __always_inline struct info_t* get_cpu_info(u32 pid, u32 tid, u64 real_start_ts)
@@ -147,22 +152,24 @@ static __always_inline struct info_t* get_cpu_info(u32 pid, u32 tid, u64 real_st
 	return infop;
 }
 
-static __always_inline void record_cpu_offtime(void *ctx, struct sysdig_bpf_settings *settings, u32 pid, u32 tid, u64 start_ts, u64 latency, u64 delta)
+/*
+ * A record holds at most NUM intervals, whatever switch_agg_num asks for
+ */
+static __always_inline uint16_t get_switch_agg_num(struct sysdig_bpf_settings *settings)
 {
 	uint16_t switch_agg_num = settings->switch_agg_num;
+
+	return switch_agg_num > NUM ? NUM : switch_agg_num;
+}
+
+static __always_inline void record_cpu_offtime(void *ctx, struct sysdig_bpf_settings *settings, u32 pid, u32 tid, u64 start_ts, u64 latency, u64 delta, enum offcpu_type type)
+{
+	uint16_t switch_agg_num = get_switch_agg_num(settings);
 	struct info_t *infop = get_cpu_info(pid, tid, settings->boot_time + start_ts);
 
 	if (infop != 0) {
 		if (infop->index < switch_agg_num) {
 			infop->times_specs[infop->index & (NUM - 1)] = delta;
-			// get the type of offcpu
-			enum offcpu_type *typep, type;
-			typep = bpf_map_lookup_elem(&type_map, &tid);
-			if (typep == 0) {
-				type = OTHER;
-			} else {
-				type = *typep;
-			}
 			infop->time_type[infop->index & (NUM - 1)] = (u8)type;
 			infop->rq[(infop->index / 2) & (HALF_NUM - 1)] = latency;
 			infop->index++;
@@ -172,9 +179,9 @@ static __always_inline void record_cpu_offtime(void *ctx, struct sysdig_bpf_sett
 	}
 }
 
-static __always_inline void record_cpu_ontime_and_out(void *ctx, struct sysdig_bpf_settings *settings, u32 pid, u32 tid, u64 start_ts, u64 delta)
+static __always_inline void record_cpu_ontime_and_out(void *ctx, struct sysdig_bpf_settings *settings, u32 pid, u32 tid, u64 start_ts, u64 delta, u64 focus_time)
 {
-	uint16_t switch_agg_num = settings->switch_agg_num;
+	uint16_t switch_agg_num = get_switch_agg_num(settings);
 	struct info_t *infop = get_cpu_info(pid, tid, start_ts);
 
 	if (infop != 0) {
@@ -186,11 +193,7 @@ static __always_inline void record_cpu_ontime_and_out(void *ctx, struct sysdig_b
 		infop->end_ts = settings->boot_time + bpf_ktime_get_ns();
 		int offset_ts = infop->end_ts - infop->start_ts;
 
-		u64 *focus_time = bpf_map_lookup_elem(&cpu_focus_threads, &tid);
-		bool have_focus_events = false;
-		if (focus_time) {
-		 	if (*focus_time > start_ts && *focus_time < start_ts + delta) have_focus_events = true;
-		}
+		bool have_focus_events = focus_time > start_ts && focus_time < start_ts + delta;
 
 		/* Some situations will trigger perf out:
 		   1. have focused events, e.g. net events
@@ -71,10 +71,11 @@ BPF_PROBE("raw_syscalls/", sys_enter, sys_enter_args)
 #ifdef CPU_ANALYSIS
 	enum offcpu_type type = get_syscall_type((int)id);
 	u32 tid = bpf_get_current_pid_tgid();
-	bpf_map_update_elem(&type_map, &tid, &type, BPF_ANY);
-	if(type == NET || type == DISK) {
-		u64 enter_time = bpf_ktime_get_ns();
-		bpf_map_update_elem(&cpu_focus_threads, &tid, &enter_time, BPF_ANY);
+	struct thread_cpu_state *st = get_thread_cpu_state(tid);
+	if (st) {
+		st->type = type;
+		if(type == NET || type == DISK)
+			st->focus_ts = bpf_ktime_get_ns();
 	}
 #endif
 	sc_evt = get_syscall_info(id);
@@ -125,13 +126,12 @@ BPF_PROBE("raw_syscalls/", sys_exit, sys_exit_args)
 #ifdef CPU_ANALYSIS
 	enum offcpu_type type = get_syscall_type((int)id);
 	u32 tid = bpf_get_current_pid_tgid();
-
-	bpf_map_delete_elem(&type_map, &tid);
-	if(type == NET || type == DISK) {
-		u64 exit_time = bpf_ktime_get_ns();
-		bpf_map_update_elem(&cpu_focus_threads, &tid, &exit_time, BPF_ANY);
+	struct thread_cpu_state *st = bpf_map_lookup_elem(&thread_cpu_state_map, &tid);
+	if (st) {
+		st->type = OTHER;
+		if(type == NET || type == DISK)
+			st->focus_ts = bpf_ktime_get_ns();
 	}
-	
 #endif
 	if (!settings->capture_enabled)
 		return 0;
@@ -234,60 +234,60 @@ BPF_KPROBE(finish_task_switch)
 	if (evt_type < PPM_EVENT_MAX && !settings->events_mask[evt_type])
 		return 0;
 
+	u32 cpu_key = 0;
+	struct cpu_oncpu *oncpu = bpf_map_lookup_elem(&cpu_oncpu_map, &cpu_key);
+	if (!oncpu)
+		return 0;
+
+	struct thread_cpu_state *st;
+	u64 now = bpf_ktime_get_ns();
 	u32 tid = _READ(p->pid);
 	u32 pid = _READ(p->tgid);
-	u64 ts, *tsp;
 	if (FILTER) {
 		// record previous thread offcpu start time
-		ts = bpf_ktime_get_ns();
-		bpf_map_update_elem(&off_start_ts, &tid, &ts, BPF_ANY);
+		st = get_thread_cpu_state(tid);
+		if (st) {
+			st->off_ts = now;
+			// record enqueue time
+			if (_READ(p->state) == TASK_RUNNING)
+				st->rq_ts = now;
+		}
 
-		u64 *on_ts;
-		on_ts = bpf_map_lookup_elem(&on_start_ts, &tid);
-		if (on_ts != 0) {
+		// the previous thread is the one this cpu switched to last
+		if (oncpu->tid == tid && oncpu->ts != 0) {
 			// calculate previous thread's oncpu delta time
-			u64 delta = ts - *on_ts;
+			u64 delta = now - oncpu->ts;
 			u64 delta_us = delta / 1000; // convert to us
-			bpf_map_delete_elem(&on_start_ts, &tid);
 			if ((delta_us >= MINBLOCK_US) && (delta_us <= MAXBLOCK_US)) {
 				if (check_filter(pid)) {
-					record_cpu_ontime_and_out(ctx, settings, pid, tid, *on_ts, delta);
+					record_cpu_ontime_and_out(ctx, settings, pid, tid, oncpu->ts, delta, st ? st->focus_ts : 0);
 				}
 			}
 		}
-		// record enqueue time
-		if (_READ(p->state) == TASK_RUNNING) {
-			u64 ts = bpf_ktime_get_ns();
-			bpf_map_update_elem(&cpu_runq, &tid, &ts, BPF_ANY);
-		}
 	}
 
 	tid = _READ(n->pid);
 	pid = _READ(n->tgid);
+	oncpu->tid = tid;
+	oncpu->ts = now;
 	if (!(FILTER))
 		return 0;
 
-	// record next thread's oncpu start time
-	u64 on_ts = bpf_ktime_get_ns();
-	bpf_map_update_elem(&on_start_ts, &tid, &on_ts, BPF_ANY);
-
-	tsp = bpf_map_lookup_elem(&off_start_ts, &tid);
-	if (tsp != 0) {
-		u64 off_ts = *tsp;
-		bpf_map_delete_elem(&off_start_ts, &tid);
+	st = bpf_map_lookup_elem(&thread_cpu_state_map, &tid);
+	if (st && st->off_ts != 0) {
+		u64 off_ts = st->off_ts;
+		u64 rq_ts = st->rq_ts;
+		st->off_ts = 0;
+		st->rq_ts = 0;
 		// calculate next thread's offcpu delta time
-		u64 delta = on_ts - off_ts;
+		u64 delta = now - off_ts;
 		u64 delta_us = delta / 1000;
 		if ((delta_us >= MINBLOCK_US) && (delta_us <= MAXBLOCK_US)) {
 			if (check_filter(pid)) {
-				u64 *rq_ts = bpf_map_lookup_elem(&cpu_runq, &tid);
 				u64 rq_la = 0;
-				if (rq_ts != 0) {
-					if (on_ts > *rq_ts)
-						rq_la = (on_ts - *rq_ts) / 1000;
-					bpf_map_delete_elem(&cpu_runq, &tid);
-				}
-				record_cpu_offtime(ctx, settings, pid, tid, off_ts, rq_la, delta);
+				if (rq_ts != 0 && now > rq_ts)
+					rq_la = (now - rq_ts) / 1000;
+				record_cpu_offtime(ctx, settings, pid, tid, off_ts, rq_la, delta, st->type);
 			}
 		}
 	}
@@ -306,8 +306,9 @@ static __always_inline int bpf_trace_enqueue(struct sched_process_exit_args *ctx
 
 	if (pid == 0)
 		return 0;
-	u64 ts = bpf_ktime_get_ns();
-	bpf_map_update_elem(&cpu_runq, &pid, &ts, BPF_ANY);
+	struct thread_cpu_state *st = get_thread_cpu_state(pid);
+	if (st)
+		st->rq_ts = bpf_ktime_get_ns();
 
 	return 0;
 }
@@ -485,50 +486,83 @@ BPF_KPROBE(tcp_drop)
 
 BPF_KPROBE(tcp_rcv_established)
 {
-	u16 sport = 0;
-	u16 dport = 0;
-	u32 saddr = 0;
-	u32 daddr = 0;
-	u16 family = 0;
 	struct sysdig_bpf_settings *settings;
 	enum ppm_event_type evt_type;
+	struct statistics *st;
+	struct tuple tp = {0};
+	u64 now;
+	u32 srtt;
 	settings = get_bpf_settings();
 	if (!settings)
 		return 0;
 	struct sock *sk = (struct sock *)_READ(PT_REGS_PARAM1(ctx));
 	struct tcp_sock *ts = tcp_sk(sk);
-	const struct inet_sock *inet = inet_sk(sk);
 
-	bpf_probe_read(&sport, sizeof(sport), (void *)&inet->inet_sport);
-	bpf_probe_read(&dport, sizeof(dport), (void *)&inet->inet_dport);
-	bpf_probe_read(&saddr, sizeof(saddr), (void *)&inet->inet_saddr);
-	bpf_probe_read(&daddr, sizeof(daddr), (void *)&inet->inet_daddr);
-	bpf_probe_read(&family, sizeof(family), (void *)&sk->__sk_common.skc_family);
-
-	struct tuple tp = {0};
-	tp.daddr = daddr;
-	tp.dport = dport;
-	tp.saddr = saddr;
-	tp.sport = sport;
-	tp.family = family;
-	tp.pad = 1;
-	if(ntohs(sport) == 22 || ntohs(dport) == 22 || ntohs(sport) == 0 || ntohs(dport) == 0) {
+	sk_to_tuple(sk, &tp);
+	if(ntohs(tp.sport) == 22 || ntohs(tp.dport) == 22 || ntohs(tp.sport) == 0 || ntohs(tp.dport) == 0) {
 		return 0;
 	}
 
-	struct statistics *st = bpf_map_lookup_elem(&rtt_static_map, &tp);
-	if (!st) {
-		struct statistics new_st = {0};
-		new_st.last_time = bpf_ktime_get_ns();
-		int ret = bpf_map_update_elem(&rtt_static_map, &tp, &new_st, BPF_NOEXIST);
-	} else {
-		if (bpf_ktime_get_ns() - st->last_time > 5000000000) {
-			st->last_time = bpf_ktime_get_ns();
+	now = bpf_ktime_get_ns();
+
+	if (settings->tcp_srtt_agg_interval_ns == 0) {
+		st = bpf_map_lookup_elem(&rtt_static_map, &tp);
+		if (!st) {
+			struct statistics new_st = {0};
+			new_st.last_time = now;
+			bpf_map_update_elem(&rtt_static_map, &tp, &new_st, BPF_NOEXIST);
+		} else if (now - st->last_time > 5000000000) {
+			st->last_time = now;
 			evt_type = PPME_TCP_RCV_ESTABLISHED_E;
 			if(prepare_filler(ctx, ctx, evt_type, settings, UF_NEVER_DROP)) {
 				bpf_rtt_kprobe_e(ctx);
 			}
 		}
+		return 0;
+	}
+
+	/*
+	 * Aggregation mode: fold the srtt of every segment in this CPU's copy
+	 * of the map and send one summary per interval instead of sampling
+	 * it. The summary is only sent by a segment that comes after the end
+	 * of the interval, so an idle socket reports on tcp_close.
+	 */
+	srtt = _READ(ts->srtt_us) >> 3;
+	st = bpf_map_lookup_elem(&rtt_agg_map, &tp);
+	if (!st) {
+		struct statistics new_st = {0};
+		new_st.last_time = now;
+		new_st.srtt_sum = srtt;
+		new_st.srtt_min = srtt;
+		new_st.srtt_max = srtt;
+		new_st.samples = 1;
+		bpf_map_update_elem(&rtt_agg_map, &tp, &new_st, BPF_NOEXIST);
+		return 0;
+	}
+
+	/*
+	 * First segment of the socket on this CPU, the entry was created
+	 * by another one
+	 */
+	if (st->last_time == 0)
+		st->last_time = now;
+
+	if (st->samples == 0 || srtt < st->srtt_min)
+		st->srtt_min = srtt;
+	if (srtt > st->srtt_max)
+		st->srtt_max = srtt;
+	st->srtt_sum += srtt;
+	st->samples++;
+
+	if (now - st->last_time >= settings->tcp_srtt_agg_interval_ns) {
+		if (prepare_filler(ctx, ctx, PPME_TCP_RTT_SUMMARY_E, settings, UF_NEVER_DROP)) {
+			bpf_tcp_rtt_summary_e(ctx);
+		}
+		st->last_time = now;
+		st->srtt_sum = 0;
+		st->srtt_min = 0;
+		st->srtt_max = 0;
+		st->samples = 0;
 	}
 	return 0;
 }
@@ -536,38 +570,34 @@ BPF_KPROBE(tcp_rcv_established)
 
 BPF_KPROBE(tcp_close)
 {
-	u16 sport = 0;
-	u16 dport = 0;
-	u32 saddr = 0;
-	u32 daddr = 0;
-	u16 family = 0;
 	struct sysdig_bpf_settings *settings;
 	enum ppm_event_type evt_type;
+	struct tuple tp = {0};
 	settings = get_bpf_settings();
 	if (!settings)
 		return 0;
 
 	struct sock *sk = (struct sock *)_READ(PT_REGS_PARAM1(ctx));
-	struct tcp_sock *ts = tcp_sk(sk);
-	const struct inet_sock *inet = inet_sk(sk);
-
-	bpf_probe_read(&sport, sizeof(sport), (void *)&inet->inet_sport);
-	bpf_probe_read(&dport, sizeof(dport), (void *)&inet->inet_dport);
-	bpf_probe_read(&saddr, sizeof(saddr), (void *)&inet->inet_saddr);
-	bpf_probe_read(&daddr, sizeof(daddr), (void *)&inet->inet_daddr);
-	bpf_probe_read(&family, sizeof(family), (void *)&sk->__sk_common.skc_family);
 
-	struct tuple tp = {0};
-	tp.daddr = daddr;
-	tp.dport = dport;
-	tp.saddr = saddr;
-	tp.sport = sport;
-	tp.family = family;
-	tp.pad = 1;
+	sk_to_tuple(sk, &tp);
+
+	/*
+	 * Flush what was aggregated since the last summary. Only this CPU's
+	 * copy can be read here: what the other CPUs folded since their last
+	 * summary is dropped with the entry.
+	 */
+	if (settings->tcp_srtt_agg_interval_ns != 0) {
+		struct statistics *st = bpf_map_lookup_elem(&rtt_agg_map, &tp);
+		if (st && st->samples != 0 &&
+		    prepare_filler(ctx, ctx, PPME_TCP_RTT_SUMMARY_E, settings, UF_NEVER_DROP)) {
+			bpf_tcp_rtt_summary_e(ctx);
+		}
+		bpf_map_delete_elem(&rtt_agg_map, &tp);
+	}
 
 	int res = bpf_map_delete_elem(&rtt_static_map, &tp);
 
-	if(ntohs(sport)==22||ntohs(dport)==22||ntohs(sport)==0||ntohs(dport)==0){
+	if(ntohs(tp.sport)==22||ntohs(tp.dport)==22||ntohs(tp.sport)==0||ntohs(tp.dport)==0){
 		return 0;
 	}
 	evt_type = PPME_TCP_CLOSE_E;
@@ -731,10 +761,11 @@ BPF_KPROBE(sock_recvmsg) {
 	if (!(FILTER))
 		return 0;
 	// update to NET
-	enum offcpu_type type = NET;
-	u64 enter_time = bpf_ktime_get_ns();
-	bpf_map_update_elem(&cpu_focus_threads, &tid, &enter_time, BPF_ANY);
-	bpf_map_update_elem(&type_map, &tid, &type, BPF_ANY);
+	struct thread_cpu_state *st = get_thread_cpu_state(tid);
+	if (st) {
+		st->type = NET;
+		st->focus_ts = bpf_ktime_get_ns();
+	}
 	return 0;
 }
 BPF_KPROBE(sock_sendmsg) {
@@ -743,10 +774,11 @@ BPF_KPROBE(sock_sendmsg) {
 	if (!(FILTER))
 		return 0;
 	// update to NET
-	enum offcpu_type type = NET;
-	u64 enter_time = bpf_ktime_get_ns();
-	bpf_map_update_elem(&cpu_focus_threads, &tid, &enter_time, BPF_ANY);
-	bpf_map_update_elem(&type_map, &tid, &type, BPF_ANY);
+	struct thread_cpu_state *st = get_thread_cpu_state(tid);
+	if (st) {
+		st->type = NET;
+		st->focus_ts = bpf_ktime_get_ns();
+	}
 	return 0;
 }
 #endif
@@ -220,8 +220,18 @@ struct perf_event_sample {
 
 #endif /* __KERNEL__ */
 
+/*
+ * Per socket state of tcp_rcv_established. When the srtt aggregation is
+ * on, the srtt of every segment is folded here, per CPU, and sent as a
+ * single PPME_TCP_RTT_SUMMARY_E per interval, and on tcp_close.
+ */
 struct statistics {
 	uint64_t last_time;
+	uint64_t srtt_sum;
+	uint32_t srtt_min;
+	uint32_t srtt_max;
+	uint32_t samples;
+	uint32_t pad;
 };
 
 struct tuple {
@@ -283,6 +293,7 @@ struct sysdig_bpf_settings {
 	uint16_t fullcapture_port_range_end;
 	uint16_t statsd_port;
 	uint16_t switch_agg_num;
+	uint64_t tcp_srtt_agg_interval_ns; /* 0: one tcp_rcv_established every 5s */
 	char if_name[16];
 	bool events_mask[PPM_EVENT_MAX];
 } __attribute__((packed));
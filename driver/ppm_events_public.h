@@ -1001,7 +1001,9 @@ enum ppm_event_type {
 	PPME_TCP_SEND_RESET_X = 341,
 	PPME_CPU_ANALYSIS_E = 342,
 	PPME_CPU_ANALYSIS_X = 343,
-	PPM_EVENT_MAX = 344
+	PPME_TCP_RTT_SUMMARY_E = 344,
+	PPME_TCP_RTT_SUMMARY_X = 345,
+	PPM_EVENT_MAX = 346
 };
 /*@}*/
 
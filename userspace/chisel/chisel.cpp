@@ -18,6 +18,7 @@ limitations under the License.
 #include <iostream>
 #include <fstream>
 #include <cctype>
+#include <cmath>
 #include <locale>
 #ifdef _WIN32
 #include <io.h>
@@ -140,6 +141,7 @@ const static struct luaL_Reg ll_chisel [] =
 	{"set_interval_ns", &lua_cbacks::set_interval_ns},
 	{"set_interval_s", &lua_cbacks::set_interval_s},
 	{"set_precise_interval_ns", &lua_cbacks::set_precise_interval_ns},
+	{"set_batch_size", &lua_cbacks::set_batch_size},
 	{"exec", &lua_cbacks::exec},
 	{NULL,NULL}
 };
@@ -251,11 +253,15 @@ sinsp_chisel::sinsp_chisel(sinsp* inspector, string filename)
 	m_inspector = inspector;
 	m_ls = NULL;
 	m_lua_has_handle_evt = false;
+	m_lua_has_handle_evts = false;
 	m_lua_is_first_evt = true;
 	m_lua_cinfo = NULL;
 	m_lua_last_interval_sample_time = 0;
 	m_lua_last_interval_ts = 0;
 	m_udp_socket = 0;
+	m_batch_size = 0;
+	m_batch_raw_numbers = false;
+	m_batch_nevts = 0;
 
 	load(filename);
 }
@@ -279,6 +285,9 @@ void sinsp_chisel::free_lua_chisel()
 		delete m_allocated_fltchecks[j];
 	}
 	m_allocated_fltchecks.clear();
+	m_batch_columns.clear();
+	m_batch_size = 0;
+	m_batch_nevts = 0;
 
 	if(m_lua_cinfo != NULL)
 	{
@@ -1264,6 +1273,13 @@ void sinsp_chisel::load(string cmdstr)
 		m_lua_has_handle_evt = true;
 		lua_pop(m_ls, 1);
 	}
+
+	lua_getglobal(m_ls, "on_events");
+	if(lua_isfunction(m_ls, -1))
+	{
+		m_lua_has_handle_evts = true;
+	}
+	lua_pop(m_ls, 1);
 #endif
 
 	is.close();
@@ -1580,10 +1596,24 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 		}
 	}
 
+	//
+	// In batched mode the fields are collected and on_events() is called
+	// when the batch is full. The formatter, if any, prints every event
+	// that passed the filter.
+	//
+	if(m_batch_size != 0)
+	{
+		add_to_batch(evt);
+
+		if(m_batch_nevts >= m_batch_size)
+		{
+			flush_batch();
+		}
+	}
 	//
 	// If the script has the on_event callback, call it
 	//
-	if(m_lua_has_handle_evt)
+	else if(m_lua_has_handle_evt)
 	{
 		lua_getglobal(m_ls, "on_event");
 
@@ -1655,6 +1685,8 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 				}
 			}
 
+			flush_batch();
+
 			lua_getglobal(m_ls, "on_interval");
 
 			lua_pushnumber(m_ls, (double)(ts / 1000000000));
@@ -1687,6 +1719,8 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 		{
 			uint64_t t;
 
+			flush_batch();
+
 			for(t = m_lua_last_interval_sample_time; t <= ts - interval; t += interval)
 			{
 				lua_getglobal(m_ls, "on_interval");
@@ -1717,6 +1751,8 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 void sinsp_chisel::do_end_of_sample()
 {
 #ifdef HAS_LUA_CHISELS
+	flush_batch();
+
 	lua_getglobal(m_ls, "on_end_of_sample");
 
 	if(lua_pcall(m_ls, 0, 1, 0) != 0)
@@ -1764,6 +1800,8 @@ void sinsp_chisel::on_capture_start()
 void sinsp_chisel::on_capture_end()
 {
 #ifdef HAS_LUA_CHISELS
+	flush_batch();
+
 	lua_getglobal(m_ls, "on_capture_end");
 
 	if(lua_isfunction(m_ls, -1))
@@ -1786,6 +1824,172 @@ void sinsp_chisel::on_capture_end()
 #endif // HAS_LUA_CHISELS
 }
 
+//
+// Opt-in batched mode: instead of calling on_event() for every event, the
+// values of the requested fields are accumulated in columns and passed to
+// on_events(batch) every batch_size events, and before on_interval(),
+// on_end_of_sample() and on_capture_end(). batch.n is the number of
+// events and batch[fld], fld being a handle returned by request_field(),
+// is the array of values of the field, with nil for the events that don't
+// have it. For the numeric fields, batch.raw[fld] also points to an array
+// of batch.n doubles, NaN where missing, that LuaJIT code can read with
+// ffi.cast("double*", batch.raw[fld]); with raw_numbers the lua arrays
+// aren't built for those fields at all.
+//
+void sinsp_chisel::set_batch_size(uint32_t batch_size, bool raw_numbers)
+{
+	flush_batch();
+
+	m_batch_size = batch_size;
+	m_batch_raw_numbers = raw_numbers;
+}
+
+void sinsp_chisel::add_to_batch(sinsp_evt* evt)
+{
+	//
+	// Fields can be requested at any time, the ones that are new to the
+	// batch are missing for the events that are already in it
+	//
+	while(m_batch_columns.size() < m_allocated_fltchecks.size())
+	{
+		chisel_batch_column column;
+		uint8_t probe[sizeof(double)] = {0};
+		double num;
+
+		column.m_chk = m_allocated_fltchecks[m_batch_columns.size()];
+		column.m_type = column.m_chk->get_field_info()->m_type;
+		column.m_is_number = lua_cbacks::rawval_to_number(probe, column.m_type, &num);
+		if(column.m_is_number)
+		{
+			column.m_numbers.assign(m_batch_nevts, NAN);
+		}
+		else
+		{
+			column.m_offsets.assign(m_batch_nevts, chisel_batch_column::MISSING);
+			column.m_lens.assign(m_batch_nevts, 0);
+		}
+
+		m_batch_columns.push_back(column);
+	}
+
+	for(auto& column : m_batch_columns)
+	{
+		uint32_t len;
+		uint8_t* rawval = column.m_chk->extract(evt, &len);
+
+		if(column.m_is_number)
+		{
+			double num = NAN;
+			if(rawval != NULL)
+			{
+				lua_cbacks::rawval_to_number(rawval, column.m_type, &num);
+			}
+			column.m_numbers.push_back(num);
+		}
+		else if(rawval != NULL)
+		{
+			column.m_offsets.push_back((uint32_t)column.m_data.size());
+			column.m_lens.push_back(len);
+			column.m_data.insert(column.m_data.end(), rawval, rawval + len);
+			// rawval_to_lua_stack() looks for the terminator of byte buffers
+			column.m_data.push_back(0);
+		}
+		else
+		{
+			column.m_offsets.push_back(chisel_batch_column::MISSING);
+			column.m_lens.push_back(0);
+		}
+	}
+
+	m_batch_nevts++;
+}
+
+void sinsp_chisel::flush_batch()
+{
+#ifdef HAS_LUA_CHISELS
+	if(m_batch_nevts == 0)
+	{
+		return;
+	}
+
+	uint32_t nevts = m_batch_nevts;
+	m_batch_nevts = 0;
+
+	lua_getglobal(m_ls, "on_events");
+
+	lua_createtable(m_ls, 0, (int)m_batch_columns.size() + 2);
+	lua_pushnumber(m_ls, nevts);
+	lua_setfield(m_ls, -2, "n");
+
+	lua_createtable(m_ls, 0, (int)m_batch_columns.size());
+	for(auto& column : m_batch_columns)
+	{
+		if(column.m_is_number)
+		{
+			lua_pushlightuserdata(m_ls, column.m_chk);
+			lua_pushlightuserdata(m_ls, column.m_numbers.data());
+			lua_rawset(m_ls, -3);
+		}
+	}
+	lua_setfield(m_ls, -2, "raw");
+
+	for(auto& column : m_batch_columns)
+	{
+		if(column.m_is_number && m_batch_raw_numbers)
+		{
+			continue;
+		}
+
+		lua_pushlightuserdata(m_ls, column.m_chk);
+		lua_createtable(m_ls, nevts, 0);
+
+		for(uint32_t j = 0; j < nevts; j++)
+		{
+			if(column.m_is_number)
+			{
+				if(!std::isnan(column.m_numbers[j]))
+				{
+					lua_pushnumber(m_ls, column.m_numbers[j]);
+					lua_rawseti(m_ls, -2, j + 1);
+				}
+			}
+			else if(column.m_offsets[j] != chisel_batch_column::MISSING)
+			{
+				if(lua_cbacks::rawval_to_lua_stack(m_ls,
+					&column.m_data[column.m_offsets[j]],
+					column.m_type,
+					column.m_lens[j]) == 1)
+				{
+					lua_rawseti(m_ls, -2, j + 1);
+				}
+			}
+		}
+
+		lua_rawset(m_ls, -3);
+	}
+
+	int res = lua_pcall(m_ls, 1, 0, 0);
+
+	for(auto& column : m_batch_columns)
+	{
+		column.m_numbers.clear();
+		column.m_offsets.clear();
+		column.m_lens.clear();
+		column.m_data.clear();
+	}
+
+	if(res != 0)
+	{
+		throw sinsp_exception(m_filename + " chisel error: calling on_events() failed:" + lua_tostring(m_ls, -1));
+	}
+
+	if(m_lua_cinfo->m_end_capture == true)
+	{
+		throw sinsp_capture_interrupt_exception();
+	}
+#endif // HAS_LUA_CHISELS
+}
+
 bool sinsp_chisel::get_nextrun_args(OUT string* args)
 {
 	ASSERT(m_lua_cinfo != NULL);
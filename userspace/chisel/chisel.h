@@ -107,6 +107,25 @@ private:
 	sinsp* m_inspector;
 };
 
+//
+// The values of one requested field for the events of a batch. Fields that
+// lua sees as numbers are converted to doubles, NaN when the field is
+// missing; the others are copied as they are extracted.
+//
+class chisel_batch_column
+{
+public:
+	static const uint32_t MISSING = 0xffffffff;
+
+	sinsp_filter_check* m_chk;
+	ppm_param_type m_type;
+	bool m_is_number;
+	vector<double> m_numbers;
+	vector<uint32_t> m_offsets; ///< Offset of each value in m_data, or MISSING
+	vector<uint32_t> m_lens;
+	vector<uint8_t> m_data;
+};
+
 class SINSP_PUBLIC sinsp_chisel
 {
 public:
@@ -147,6 +166,9 @@ private:
 	static bool parse_view_info(lua_State *ls, OUT chisel_desc* cd);
 	static bool init_lua_chisel(chisel_desc &cd, string const &path);
 	void first_event_inits(sinsp_evt* evt);
+	void set_batch_size(uint32_t batch_size, bool raw_numbers);
+	void add_to_batch(sinsp_evt* evt);
+	void flush_batch();
 
 	sinsp* m_inspector;
 	string m_description;
@@ -155,6 +177,7 @@ private:
 	lua_State* m_ls;
 	chisel_desc m_lua_script_info;
 	bool m_lua_has_handle_evt;
+	bool m_lua_has_handle_evts;
 	bool m_lua_is_first_evt;
 	uint64_t m_lua_last_interval_sample_time;
 	uint64_t m_lua_last_interval_ts;
@@ -165,6 +188,14 @@ private:
 	int m_udp_socket;
 	struct sockaddr_in m_serveraddr;
 
+	//
+	// Batched mode, see set_batch_size()
+	//
+	uint32_t m_batch_size;
+	bool m_batch_raw_numbers;
+	uint32_t m_batch_nevts;
+	vector<chisel_batch_column> m_batch_columns;
+
 	friend class lua_cbacks;
 };
 
@@ -61,52 +61,68 @@ void lua_stackdump(lua_State *L);
 ///////////////////////////////////////////////////////////////////////////////
 #ifdef HAS_LUA_CHISELS
 
-uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, ppm_param_type ptype, uint32_t len)
+bool lua_cbacks::rawval_to_number(uint8_t* rawval, ppm_param_type ptype, OUT double* res)
 {
-	ASSERT(rawval != NULL);
-
 	switch(ptype)
 	{
 		case PT_INT8:
-			lua_pushnumber(ls, *(int8_t*)rawval);
-			return 1;
+			*res = *(int8_t*)rawval;
+			return true;
 		case PT_INT16:
-			lua_pushnumber(ls, *(int16_t*)rawval);
-			return 1;
+			*res = *(int16_t*)rawval;
+			return true;
 		case PT_INT32:
-			lua_pushnumber(ls, *(int32_t*)rawval);
-			return 1;
+			*res = *(int32_t*)rawval;
+			return true;
 		case PT_INT64:
 		case PT_ERRNO:
 		case PT_PID:
 		case PT_FD:
-			lua_pushnumber(ls, (double)*(int64_t*)rawval);
-			return 1;
+			*res = (double)*(int64_t*)rawval;
+			return true;
 		case PT_L4PROTO: // This can be resolved in the future
 		case PT_FLAGS8:
 		case PT_UINT8:
-			lua_pushnumber(ls, *(uint8_t*)rawval);
-			return 1;
+			*res = *(uint8_t*)rawval;
+			return true;
 		case PT_PORT: // This can be resolved in the future
 		case PT_FLAGS16:
 		case PT_UINT16:
-			lua_pushnumber(ls, *(uint16_t*)rawval);
-			return 1;
+			*res = *(uint16_t*)rawval;
+			return true;
 		case PT_FLAGS32:
 		case PT_UINT32:
 		case PT_MODE:
 		case PT_UID:
 		case PT_GID:
-			lua_pushnumber(ls, *(uint32_t*)rawval);
-			return 1;
+			*res = *(uint32_t*)rawval;
+			return true;
 		case PT_UINT64:
 		case PT_RELTIME:
 		case PT_ABSTIME:
-			lua_pushnumber(ls, (double)*(uint64_t*)rawval);
-			return 1;
+			*res = (double)*(uint64_t*)rawval;
+			return true;
 		case PT_DOUBLE:
-			lua_pushnumber(ls, *(double*)rawval);
-			return 1;
+			*res = *(double*)rawval;
+			return true;
+		default:
+			return false;
+	}
+}
+
+uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, ppm_param_type ptype, uint32_t len)
+{
+	ASSERT(rawval != NULL);
+
+	double num;
+	if(rawval_to_number(rawval, ptype, &num))
+	{
+		lua_pushnumber(ls, num);
+		return 1;
+	}
+
+	switch(ptype)
+	{
 		case PT_CHARBUF:
 		case PT_FSPATH:
 		case PT_FSRELPATH:
@@ -888,7 +904,7 @@ int lua_cbacks::get_thread_table_int(lua_State *ls, bool include_fds, bool bareb
 			//
 			lua_pushstring(ls, "args");
 
-			vector<string>* args = &tinfo.m_args;
+			const vector<string>* args = &tinfo.m_args.get();
 			lua_newtable(ls);
 			for(j = 0; j < args->size(); j++)
 			{
@@ -1376,6 +1392,30 @@ int lua_cbacks::set_precise_interval_ns(lua_State *ls)
 	return 0;
 }
 
+int lua_cbacks::set_batch_size(lua_State *ls)
+{
+	lua_getglobal(ls, "sichisel");
+
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+	lua_pop(ls, 1);
+
+	ASSERT(ch);
+
+	uint32_t batch_size = (uint32_t)lua_tonumber(ls, 1);
+	bool raw_numbers = lua_toboolean(ls, 2) != 0;
+
+	if(batch_size != 0 && !ch->m_lua_has_handle_evts)
+	{
+		string err = "chisel " + ch->m_filename + " sets a batch size but has no on_events()";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	ch->set_batch_size(batch_size, raw_numbers);
+
+	return 0;
+}
+
 int lua_cbacks::exec(lua_State *ls)
 {
 	lua_getglobal(ls, "sichisel");
@@ -21,6 +21,10 @@ class lua_cbacks
 {
 public:
 	static uint32_t rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, ppm_param_type ptype, uint32_t len);
+	//
+	// Returns false if the type isn't rendered as a number in lua
+	//
+	static bool rawval_to_number(uint8_t* rawval, ppm_param_type ptype, OUT double* res);
 
 	static int get_num(lua_State *ls); 
 	static int get_ts(lua_State *ls);
@@ -57,6 +61,7 @@ public:
 	static int set_interval_ns(lua_State *ls);
 	static int set_interval_s(lua_State *ls);
 	static int set_precise_interval_ns(lua_State *ls);
+	static int set_batch_size(lua_State *ls);
 	static int exec(lua_State *ls);
 	static int log(lua_State *ls);
 	static int udp_setpeername(lua_State *ls);
@@ -141,6 +141,9 @@ struct scap
 	void* m_proc_callback_context;
 	struct ppm_proclist_info* m_driver_procinfo;
 	bool refresh_proc_table_when_saving;
+	// state base of the dump files opened next, see scap_set_dump_state_base()
+	char m_dump_state_base[SCAP_MAX_PATH_SIZE];
+	uint64_t m_dump_state_base_id;
 	uint32_t m_fd_lookup_limit;
 	uint64_t m_unexpected_block_readsize;
 	uint32_t m_ncpus;
@@ -180,6 +183,11 @@ struct scap
 	// /proc scan parameters
 	uint64_t m_proc_scan_timeout_ms;
 	uint64_t m_proc_scan_log_interval_ms;
+	bool m_fast_fd_scan;
+	uint32_t m_tcp_srtt_agg_interval_ms;
+	scap_fd_scan_stats m_fd_scan_stats;
+	// getdents64 buffer of the fast fd scan, allocated on first use
+	char* m_fd_scan_buf;
 
 	// Function which may be called to log a debug event
 	void(*m_debug_log_fn)(const char* msg);
@@ -189,6 +197,7 @@ typedef enum ppm_dumper_type
 {
 	DT_FILE = 0,
 	DT_MEM = 1,
+	DT_MANAGED_BUF = 2,
 }ppm_dumper_type;
 
 struct scap_dumper
@@ -257,8 +266,9 @@ uint32_t scap_fd_info_len(scap_fdinfo* fdi);
 int32_t scap_fd_write_to_disk(scap_t* handle, scap_fdinfo* fdi, scap_dumper_t* dumper, uint32_t len);
 // Populate the given fd by reading the info from disk
 uint32_t scap_fd_read_from_disk(scap_t* handle, OUT scap_fdinfo* fdi, OUT size_t* nbytes, uint32_t block_type, gzFile f);
-// Parse the headers of a trace file and load the tables
-int32_t scap_read_init(scap_t* handle, gzFile f);
+// Parse the headers of a trace file and load the tables. fname, if known,
+// locates the base of a delta capture given as a relative path
+int32_t scap_read_init(scap_t* handle, gzFile f, const char* fname);
 // Add the file descriptor info pointed by fdi to the fd table for process pi.
 // Note: silently skips if fdi->type is SCAP_FD_UNKNOWN.
 int32_t scap_add_fd_to_proc_table(scap_t* handle, scap_threadinfo* pi, scap_fdinfo* fdi, char *error);
@@ -270,10 +280,16 @@ int32_t scap_next_offline(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* p
 int32_t scap_fd_scan_fd_dir(scap_t* handle, char * procdir, scap_threadinfo* pi, struct scap_ns_socket_list** sockets_by_ns, uint64_t* num_fds_ret, char *error);
 // read tcp or udp sockets from the proc filesystem
 int32_t scap_fd_read_ipv4_sockets_from_proc_fs(scap_t* handle, const char * dir, int l4proto, scap_fdinfo ** sockets);
+#if defined(__linux__)
+// read tcp and udp sockets with sock_diag
+int32_t scap_fd_read_inet_sockets_from_netlink(scap_t* handle, char* procdir, struct scap_ns_socket_list* sockets);
+#endif
 // read all sockets and add them to the socket table hashed by their ino
 int32_t scap_fd_read_sockets(scap_t* handle, char* procdir, struct scap_ns_socket_list* sockets, char *error);
 // get the device major/minor number for the requested_mount_id, looking in procdir/mountinfo if needed
 uint32_t scap_get_device_by_mount_id(scap_t *handle, const char *procdir, unsigned long requested_mount_id);
+// read the open flags and the mount id of a file fd from procdir/fdinfo
+int32_t scap_fd_read_file_flags(scap_t *handle, const char *procdir, int64_t fd, uint32_t *open_flags, uint32_t *mount_id);
 // prints procs details for a give tid
 void scap_proc_print_proc_by_tid(scap_t* handle, uint64_t tid);
 // Allocate and return the list of interfaces on this system
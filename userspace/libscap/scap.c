@@ -96,7 +96,9 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   bool fast_fd_scan,
+			   uint32_t tcp_srtt_agg_interval_ms)
 {
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
 	*rc = SCAP_NOT_SUPPORTED;
@@ -112,7 +114,8 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   bool fast_fd_scan)
 {
 	snprintf(error, SCAP_LASTERR_SIZE, "udig capture not supported on %s", PLATFORM_NAME);
 	*rc = SCAP_NOT_SUPPORTED;
@@ -150,7 +153,9 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   bool fast_fd_scan,
+			   uint32_t tcp_srtt_agg_interval_ms)
 {
 	uint32_t j;
 	char filename[SCAP_MAX_PATH_SIZE];
@@ -176,6 +181,8 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	handle->m_debug_log_fn = debug_log_fn;
 	handle->m_proc_scan_timeout_ms = proc_scan_timeout_ms;
 	handle->m_proc_scan_log_interval_ms = proc_scan_log_interval_ms;
+	handle->m_fast_fd_scan = fast_fd_scan;
+	handle->m_tcp_srtt_agg_interval_ms = tcp_srtt_agg_interval_ms;
 
 	//
 	// While in theory we could always rely on the scap caller to properly
@@ -213,6 +220,18 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 		handle->m_bpf = false;
 	}
 
+	//
+	// The kernel module has no per socket store to aggregate the srtt
+	// into, it would keep sending every tcp_rcv_established
+	//
+	if(!handle->m_bpf && tcp_srtt_agg_interval_ms != 0)
+	{
+		scap_close(handle);
+		snprintf(error, SCAP_LASTERR_SIZE, "tcp_srtt_agg_interval_ms needs the BPF probe");
+		*rc = SCAP_NOT_SUPPORTED;
+		return NULL;
+	}
+
 	handle->m_ncpus = sysconf(_SC_NPROCESSORS_CONF);
 	if(handle->m_ncpus == -1)
 	{
@@ -475,7 +494,8 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   bool fast_fd_scan)
 {
 	char filename[SCAP_MAX_PATH_SIZE];
 	scap_t* handle = NULL;
@@ -499,6 +519,7 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 	handle->m_debug_log_fn = debug_log_fn;
 	handle->m_proc_scan_timeout_ms = proc_scan_timeout_ms;
 	handle->m_proc_scan_log_interval_ms = proc_scan_log_interval_ms;
+	handle->m_fast_fd_scan = fast_fd_scan;
 	handle->m_bpf = false;
 	handle->m_udig_capturing = false;
 	handle->m_ncpus = 1;
@@ -678,6 +699,7 @@ scap_t* scap_open_udig_int(char *error, int32_t *rc,
 #endif // !defined(HAS_CAPTURE) || defined(CYGWING_AGENT)
 
 scap_t* scap_open_offline_int(gzFile gzfile,
+			      const char *fname,
 			      char *error,
 			      int32_t *rc,
 			      proc_entry_callback proc_callback,
@@ -751,7 +773,7 @@ scap_t* scap_open_offline_int(gzFile gzfile,
 	//
 	// Validate the file and load the non-event blocks
 	//
-	if((*rc = scap_read_init(handle, handle->m_file)) != SCAP_SUCCESS)
+	if((*rc = scap_read_init(handle, handle->m_file, fname)) != SCAP_SUCCESS)
 	{
 		snprintf(error, SCAP_LASTERR_SIZE, "Could not initialize reader: %s", scap_getlasterr(handle));
 		scap_close(handle);
@@ -800,7 +822,7 @@ scap_t* scap_open_offline(const char* fname, char *error, int32_t* rc)
 		return NULL;
 	}
 
-	return scap_open_offline_int(gzfile, error, rc, NULL, NULL, true, 0, NULL);
+	return scap_open_offline_int(gzfile, fname, error, rc, NULL, NULL, true, 0, NULL);
 }
 
 scap_t* scap_open_offline_fd(int fd, char *error, int32_t *rc)
@@ -813,12 +835,12 @@ scap_t* scap_open_offline_fd(int fd, char *error, int32_t *rc)
 		return NULL;
 	}
 
-	return scap_open_offline_int(gzfile, error, rc, NULL, NULL, true, 0, NULL);
+	return scap_open_offline_int(gzfile, NULL, error, rc, NULL, NULL, true, 0, NULL);
 }
 
 scap_t* scap_open_live(char *error, int32_t *rc)
 {
-	return scap_open_live_int(error, rc, NULL, NULL, true, NULL, NULL, NULL, SCAP_PROC_SCAN_TIMEOUT_NONE, SCAP_PROC_SCAN_LOG_NONE);
+	return scap_open_live_int(error, rc, NULL, NULL, true, NULL, NULL, NULL, SCAP_PROC_SCAN_TIMEOUT_NONE, SCAP_PROC_SCAN_LOG_NONE, false, 0);
 }
 
 scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
@@ -827,7 +849,8 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 			       bool import_users,
 			       void(*debug_log_fn)(const char* msg),
 			       uint64_t proc_scan_timeout_ms,
-			       uint64_t proc_scan_log_interval_ms)
+			       uint64_t proc_scan_log_interval_ms,
+			       bool fast_fd_scan)
 {
 #if !defined(HAS_CAPTURE)
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
@@ -856,6 +879,7 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 	handle->m_debug_log_fn = debug_log_fn;
 	handle->m_proc_scan_timeout_ms = proc_scan_timeout_ms;
 	handle->m_proc_scan_log_interval_ms = proc_scan_log_interval_ms;
+	handle->m_fast_fd_scan = fast_fd_scan;
 
 	//
 	// Extract machine information
@@ -975,7 +999,7 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 			return NULL;
 		}
 
-		return scap_open_offline_int(gzfile, error, rc,
+		return scap_open_offline_int(gzfile, args.fd != 0 ? NULL : args.fname, error, rc,
 					     args.proc_callback, args.proc_callback_context,
 					     args.import_users, args.start_offset,
 					     args.suppressed_comms);
@@ -984,13 +1008,21 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 #ifndef CYGWING_AGENT
 		if(args.udig)
 		{
+			if(args.tcp_srtt_agg_interval_ms != 0)
+			{
+				snprintf(error, SCAP_LASTERR_SIZE, "tcp_srtt_agg_interval_ms needs the BPF probe");
+				*rc = SCAP_NOT_SUPPORTED;
+				return NULL;
+			}
+
 			return scap_open_udig_int(error, rc, args.proc_callback,
 						args.proc_callback_context,
 						args.import_users,
 						args.suppressed_comms,
 						args.debug_log_fn,
 						args.proc_scan_timeout_ms,
-						args.proc_scan_log_interval_ms);
+						args.proc_scan_log_interval_ms,
+						args.fast_fd_scan);
 		}
 		else
 		{
@@ -1001,7 +1033,9 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 						args.suppressed_comms,
 						args.debug_log_fn,
 						args.proc_scan_timeout_ms,
-						args.proc_scan_log_interval_ms);
+						args.proc_scan_log_interval_ms,
+						args.fast_fd_scan,
+						args.tcp_srtt_agg_interval_ms);
 		}
 #else
 		snprintf(error,	SCAP_LASTERR_SIZE, "scap_open: live mode currently not supported on windows. Use nodriver mode instead.");
@@ -1014,7 +1048,8 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 					      args.import_users,
 					      args.debug_log_fn,
 					      args.proc_scan_timeout_ms,
-					      args.proc_scan_log_interval_ms);
+					      args.proc_scan_log_interval_ms,
+					      args.fast_fd_scan);
 	case SCAP_MODE_NONE:
 		// error
 		break;
@@ -1127,6 +1162,11 @@ void scap_close(scap_t* handle)
 		free(handle->m_file_evt_buf);
 	}
 
+	if(handle->m_fd_scan_buf)
+	{
+		free(handle->m_fd_scan_buf);
+	}
+
 	// Free the process table
 	if(handle->m_proclist != NULL)
 	{
@@ -1735,6 +1775,11 @@ int32_t scap_get_stats(scap_t* handle, OUT scap_stats* stats)
 	return SCAP_SUCCESS;
 }
 
+void scap_get_fd_scan_stats(scap_t* handle, OUT scap_fd_scan_stats* stats)
+{
+	*stats = handle->m_fd_scan_stats;
+}
+
 //
 // Stop capturing the events
 //
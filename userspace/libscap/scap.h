@@ -113,6 +113,19 @@ typedef struct scap_stats
 	uint64_t n_tids_suppressed; ///< Number of threads currently being suppressed
 }scap_stats;
 
+/*!
+  \brief Syscalls issued to build the fd tables since the beginning of
+  the last full /proc scan
+*/
+typedef struct scap_fd_scan_stats
+{
+	uint64_t n_fds; ///< Number of fds added to the tables.
+	uint64_t n_getdents; ///< Number of getdents64 calls. Only counted by the fast scan, readdir() hides them.
+	uint64_t n_readlink; ///< Number of readlink calls on /proc/<pid>/fd entries.
+	uint64_t n_stat; ///< Number of stat calls on /proc/<pid>/fd entries.
+	uint64_t n_fdinfo; ///< Number of /proc/<pid>/fdinfo/<fd> files read.
+}scap_fd_scan_stats;
+
 /*!
   \brief Information about the parameter of an event
 */
@@ -281,6 +294,14 @@ typedef struct {
 	UT_hash_handle hh; ///< makes this structure hashable
 } scap_mountinfo;
 
+/*!
+  \brief Thread or fd that a delta capture drops from the state of its base
+*/
+typedef struct scap_removed_state {
+	uint64_t tid; ///< the thread
+	int64_t fd; ///< the fd, or -1 if the whole thread is gone
+} scap_removed_state;
+
 typedef void (*proc_entry_callback)(void* context,
 									scap_t* handle,
 									int64_t tid,
@@ -329,6 +350,12 @@ typedef struct scap_open_args
 	void(*debug_log_fn)(const char* msg); // Function which SCAP may use to log a debug message
 	uint64_t proc_scan_timeout_ms; // Timeout in msec, after which so-far-successful scan of /proc should be cut short with success return
 	uint64_t proc_scan_log_interval_ms; // Interval for logging progress messages from /proc scan
+	bool fast_fd_scan; ///< If true, the fd tables are read with getdents64, stat is skipped for sockets, pipes and anon inodes, and
+	                   // the open flags of files are not read. The caller can get them later with scap_fd_read_file_flags().
+	uint32_t tcp_srtt_agg_interval_ms; ///< If non-zero, the BPF probe folds the srtt of every tcp_rcv_established in a per socket summary,
+	                                   // sent as a tcp_rtt_summary event every interval and on tcp_close. If zero, one tcp_rcv_established
+	                                   // is sent every 5 seconds per socket. Live captures with the BPF probe only,
+	                                   // the other live captures fail to open with SCAP_NOT_SUPPORTED.
 }scap_open_args;
 
 
@@ -861,6 +888,15 @@ scap_threadinfo* scap_get_proc_table(scap_t* handle);
 */
 int32_t scap_get_stats(scap_t* handle, OUT scap_stats* stats);
 
+/*!
+  \brief Return the number of syscalls issued to build the fd tables.
+
+  \param handle Handle to the capture instance.
+  \param stats Pointer to a \ref scap_fd_scan_stats structure that will be filled
+  with the counters.
+*/
+void scap_get_fd_scan_stats(scap_t* handle, OUT scap_fd_scan_stats* stats);
+
 /*!
   \brief This function can be used to temporarily interrupt event capture.
 
@@ -1046,6 +1082,11 @@ uint32_t scap_event_get_sentinel_begin(scap_evt* e);
 // The returned pointer must be freed via scap_proc_free by the caller.
 struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_sockets);
 
+// Create a handle that can only be passed to scap_proc_get, to read /proc
+// from a thread other than the one consuming events. handle must outlive it.
+scap_t* scap_proc_reader_open(scap_t* handle, char* error);
+void scap_proc_reader_close(scap_t* reader);
+
 // Check if the given thread exists in ;proc
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm);
 
@@ -1078,6 +1119,13 @@ scap_dumper_t *scap_memory_dump_open(scap_t *handle, uint8_t* targetbuf, uint64_
 int32_t compr(uint8_t* dest, uint64_t* destlen, const uint8_t* source, uint64_t sourcelen, int level);
 #endif
 uint8_t* scap_get_memorydumper_curpos(scap_dumper_t *d);
+// Memory dumper that grows as needed, to stage blocks that are later written
+// to another dumper with scap_dump_append_buf. With write_header, it starts
+// with the same section header and tables as a file from scap_dump_open.
+scap_dumper_t *scap_managedbuf_dump_create(scap_t *handle, uint64_t initial_size, bool write_header, bool skip_proc_scan);
+// File dumper with nothing written in it, the handle is not touched
+scap_dumper_t *scap_dump_open_headerless(const char *fname, compression_mode compress, char *error);
+int32_t scap_dump_append_buf(scap_dumper_t *d, scap_dumper_t *buf, char *error);
 int32_t scap_write_proc_fds(scap_t *handle, struct scap_threadinfo *tinfo, scap_dumper_t *d);
 int32_t scap_write_proclist_header(scap_t *handle, scap_dumper_t *d, uint32_t totlen);
 int32_t scap_write_proclist_trailer(scap_t *handle, scap_dumper_t *d, uint32_t totlen);
@@ -1094,6 +1142,15 @@ int32_t scap_write_proclist_entry_bufs(scap_t *handle, scap_dumper_t *d, struct
 				       const char *cwd,
 				       const struct iovec *cgroups, int cgroupscnt,
 				       const char *root);
+// Delta captures: after scap_set_dump_state_base(), the dump files that are
+// opened start with a state base block naming base_fname, the capture whose
+// tables they start from, which was given the state id base_id with
+// scap_write_state_id(). Their proclist and fdlist blocks then only hold
+// what changed; the removed state block lists what's gone since. A NULL
+// base_fname goes back to full captures.
+int32_t scap_set_dump_state_base(scap_t *handle, const char *base_fname, uint64_t base_id);
+int32_t scap_write_state_id(scap_t *handle, scap_dumper_t *d, uint64_t id);
+int32_t scap_write_removed_state(scap_t *handle, scap_dumper_t *d, const scap_removed_state *entries, uint32_t nentries);
 
 // Turn on processing only a subset syscalls. This is only appliable when scap
 // is in LIVE mode.
@@ -1454,6 +1454,7 @@ static int32_t set_default_settings(scap_t *handle)
 	{
 		settings.switch_agg_num = 16;
 	}
+	settings.tcp_srtt_agg_interval_ns = handle->m_tcp_srtt_agg_interval_ms * 1000000ULL;
 	memset(settings.if_name, 0, 16);
 	int i = 0;
 	for (i = 0; i < PPM_EVENT_MAX; i++) {
@@ -55,12 +55,15 @@ limitations under the License.
 #endif
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
-//#include <linux/sock_diag.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
 //#include <linux/unix_diag.h>
+#include <sys/syscall.h>
 #endif
 #endif
 
 #define SOCKET_SCAN_BUFFER_SIZE 1024 * 1024
+#define SOCK_DIAG_BUFFER_SIZE 64 * 1024
 
 int32_t scap_fd_print_ipv6_socket_info(scap_t *handle, scap_fdinfo *fdi, OUT char *str, uint32_t stlen)
 {
@@ -725,21 +728,14 @@ void scap_free_device_table(scap_t* handle)
 
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 
-int32_t scap_fd_handle_pipe(scap_t *handle, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, char *error)
+//
+// Handlers that take the already resolved target of the /proc/<pid>/fd link
+//
+static int32_t scap_fd_handle_pipe_link(scap_t *handle, const char *link_name, scap_threadinfo *tinfo, scap_fdinfo *fdi, char *error)
 {
-	char link_name[SCAP_MAX_PATH_SIZE];
-	ssize_t r;
 	uint64_t ino;
 	struct stat sb;
 
-	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE);
-	if (r <= 0)
-	{
-		snprintf(error, SCAP_LASTERR_SIZE, "Could not read link %s (%s)",
-			 fname, scap_strerror(handle, errno));
-		return SCAP_FAILURE;
-	}
-	link_name[r] = '\0';
 	if(1 != sscanf(link_name, "pipe:[%"PRIi64"]", &ino))
 	{
 		// in this case we've got a named pipe
@@ -756,6 +752,24 @@ int32_t scap_fd_handle_pipe(scap_t *handle, char *fname, scap_threadinfo *tinfo,
 	return scap_add_fd_to_proc_table(handle, tinfo, fdi, error);
 }
 
+int32_t scap_fd_handle_pipe(scap_t *handle, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, char *error)
+{
+	char link_name[SCAP_MAX_PATH_SIZE];
+	ssize_t r;
+
+	handle->m_fd_scan_stats.n_readlink++;
+	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE);
+	if (r <= 0)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "Could not read link %s (%s)",
+			 fname, scap_strerror(handle, errno));
+		return SCAP_FAILURE;
+	}
+	link_name[r] = '\0';
+
+	return scap_fd_handle_pipe_link(handle, link_name, tinfo, fdi, error);
+}
+
 static inline uint32_t open_flags_to_scap(unsigned long flags)
 {
 	uint32_t res = 0;
@@ -872,20 +886,20 @@ uint32_t scap_get_device_by_mount_id(scap_t *handle, const char *procdir, unsign
 	return 0;
 }
 
-void scap_fd_flags_file(scap_t *handle, scap_fdinfo *fdi, const char *procdir)
+int32_t scap_fd_read_file_flags(scap_t *handle, const char *procdir, int64_t fd, uint32_t *open_flags, uint32_t *mount_id)
 {
 	char fd_dir_name[SCAP_MAX_PATH_SIZE];
 	char line[SCAP_MAX_PATH_SIZE];
 	FILE *finfo;
 
-	snprintf(fd_dir_name, SCAP_MAX_PATH_SIZE, "%sfdinfo/%" PRId64, procdir, fdi->fd);
+	snprintf(fd_dir_name, SCAP_MAX_PATH_SIZE, "%sfdinfo/%" PRId64, procdir, fd);
+	handle->m_fd_scan_stats.n_fdinfo++;
 	finfo = fopen(fd_dir_name, "r");
 	if(finfo == NULL)
 	{
-		return;
+		return SCAP_NOTFOUND;
 	}
-	fdi->info.regularinfo.mount_id = 0;
-	fdi->info.regularinfo.dev = 0;
+	*mount_id = 0;
 
 	while(fgets(line, sizeof(line), finfo) != NULL)
 	{
@@ -898,49 +912,66 @@ void scap_fd_flags_file(scap_t *handle, scap_fdinfo *fdi, const char *procdir)
 
 		if(!strncmp(line, "flags:\t", sizeof("flags:\t") - 1))
 		{
-			uint32_t open_flags;
 			errno = 0;
 			unsigned long flags = strtoul(line + sizeof("flags:\t") - 1, NULL, 8);
 
 			if(errno == ERANGE)
 			{
-				open_flags = PPM_O_NONE;
+				*open_flags = PPM_O_NONE;
 			}
 			else
 			{
-				open_flags = open_flags_to_scap(flags);
+				*open_flags = open_flags_to_scap(flags);
 			}
-
-			fdi->info.regularinfo.open_flags = open_flags;
 		}
 		else if(!strncmp(line, "mnt_id:\t", sizeof("mnt_id:\t") - 1))
 		{
 			errno = 0;
-			unsigned long mount_id = strtoul(line + sizeof("mnt_id:\t") - 1, NULL, 10);
+			unsigned long mnt_id = strtoul(line + sizeof("mnt_id:\t") - 1, NULL, 10);
 
 			if(errno != ERANGE)
 			{
-				fdi->info.regularinfo.mount_id = mount_id;
+				*mount_id = mnt_id;
 			}
 		}
 	}
 
 	fclose(finfo);
+	return SCAP_SUCCESS;
 }
 
-int32_t scap_fd_handle_regular_file(scap_t *handle, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, const char *procdir, char *error)
+//
+// Build dir + sep + name in a SCAP_MAX_PATH_SIZE buffer. Returns false
+// if it doesn't fit, rather than leaving a truncated path behind.
+//
+static bool scap_fd_path(char *dst, const char *dir, const char *sep, const char *name)
 {
-	char link_name[SCAP_MAX_PATH_SIZE];
-	ssize_t r;
+	int len = snprintf(dst, SCAP_MAX_PATH_SIZE, "%s%s%s", dir, sep, name);
+	return len >= 0 && len < SCAP_MAX_PATH_SIZE;
+}
 
-	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE);
-	if (r <= 0)
+//
+// Copy a path of at most SCAP_MAX_PATH_SIZE - 1 characters
+//
+static void scap_fd_copy_path(char *dst, const char *src)
+{
+	size_t len = strnlen(src, SCAP_MAX_PATH_SIZE - 1);
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+void scap_fd_flags_file(scap_t *handle, scap_fdinfo *fdi, const char *procdir)
+{
+	if(scap_fd_read_file_flags(handle, procdir, fdi->fd,
+				   &fdi->info.regularinfo.open_flags,
+				   &fdi->info.regularinfo.mount_id) == SCAP_SUCCESS)
 	{
-		return SCAP_SUCCESS;
+		fdi->info.regularinfo.dev = 0;
 	}
+}
 
-	link_name[r] = '\0';
-
+static int32_t scap_fd_handle_regular_file_link(scap_t *handle, const char *link_name, scap_threadinfo *tinfo, scap_fdinfo *fdi, const char *procdir, char *error)
+{
 	if(SCAP_FD_UNSUPPORTED == fdi->type)
 	{
 		// try to classify by link name
@@ -975,64 +1006,96 @@ int32_t scap_fd_handle_regular_file(scap_t *handle, char *fname, scap_threadinfo
 	}
 	else if(fdi->type == SCAP_FD_FILE_V2)
 	{
-		scap_fd_flags_file(handle, fdi, procdir);
-		strncpy(fdi->info.regularinfo.fname, link_name, SCAP_MAX_PATH_SIZE);
+		if(handle->m_fast_fd_scan)
+		{
+			//
+			// Left to the consumer, see scap_fd_read_file_flags()
+			//
+			fdi->info.regularinfo.open_flags = PPM_O_NONE;
+			fdi->info.regularinfo.mount_id = 0;
+			fdi->info.regularinfo.dev = 0;
+		}
+		else
+		{
+			scap_fd_flags_file(handle, fdi, procdir);
+		}
+		scap_fd_copy_path(fdi->info.regularinfo.fname, link_name);
 	}
 	else
 	{
-		strncpy(fdi->info.fname, link_name, SCAP_MAX_PATH_SIZE);
+		scap_fd_copy_path(fdi->info.fname, link_name);
 	}
 
 	return scap_add_fd_to_proc_table(handle, tinfo, fdi, error);
 }
 
-int32_t scap_fd_handle_socket(scap_t *handle, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, char* procdir, uint64_t net_ns, struct scap_ns_socket_list **sockets_by_ns, char *error)
+int32_t scap_fd_handle_regular_file(scap_t *handle, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, const char *procdir, char *error)
 {
 	char link_name[SCAP_MAX_PATH_SIZE];
 	ssize_t r;
-	scap_fdinfo *tfdi;
-	uint64_t ino;
-	struct scap_ns_socket_list* sockets = NULL;
+
+	handle->m_fd_scan_stats.n_readlink++;
+	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE - 1);
+	if (r <= 0)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	link_name[r] = '\0';
+
+	return scap_fd_handle_regular_file_link(handle, link_name, tinfo, fdi, procdir, error);
+}
+
+//
+// Return the socket table of the net_ns namespace, reading it the first time
+// it's needed. *sockets is NULL if socket tables are disabled.
+//
+static int32_t scap_fd_get_ns_sockets(scap_t *handle, char* procdir, uint64_t net_ns, struct scap_ns_socket_list **sockets_by_ns, struct scap_ns_socket_list **sockets, char *error)
+{
 	int32_t uth_status = SCAP_SUCCESS;
 
+	*sockets = NULL;
+
 	if(*sockets_by_ns == (void*)-1)
 	{
 		return SCAP_SUCCESS;
 	}
-	else
+
+	HASH_FIND_INT64(*sockets_by_ns, &net_ns, *sockets);
+	if(*sockets == NULL)
 	{
-		HASH_FIND_INT64(*sockets_by_ns, &net_ns, sockets);
-		if(sockets == NULL)
-		{
-			sockets = malloc(sizeof(struct scap_ns_socket_list));
-			sockets->net_ns = net_ns;
-			sockets->sockets = NULL;
-			char fd_error[SCAP_LASTERR_SIZE];
+		struct scap_ns_socket_list* ns_sockets;
+		char fd_error[SCAP_LASTERR_SIZE];
 
-			HASH_ADD_INT64(*sockets_by_ns, net_ns, sockets);
-			if(uth_status != SCAP_SUCCESS)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
-				free(sockets);
-				return SCAP_FAILURE;
-			}
+		ns_sockets = malloc(sizeof(struct scap_ns_socket_list));
+		ns_sockets->net_ns = net_ns;
+		ns_sockets->sockets = NULL;
 
-			if(scap_fd_read_sockets(handle, procdir, sockets, fd_error) == SCAP_FAILURE)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "Cannot read sockets (%s)", fd_error);
-				sockets->sockets = NULL;
-				return SCAP_FAILURE;
-			}
+		HASH_ADD_INT64(*sockets_by_ns, net_ns, ns_sockets);
+		if(uth_status != SCAP_SUCCESS)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "socket list allocation error");
+			free(ns_sockets);
+			return SCAP_FAILURE;
 		}
-	}
 
-	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE);
-	if(r <= 0)
-	{
-		return SCAP_SUCCESS;
+		if(scap_fd_read_sockets(handle, procdir, ns_sockets, fd_error) == SCAP_FAILURE)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "Cannot read sockets (%s)", fd_error);
+			ns_sockets->sockets = NULL;
+			return SCAP_FAILURE;
+		}
+
+		*sockets = ns_sockets;
 	}
 
-	link_name[r] = '\0';
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_fd_handle_socket_link(scap_t *handle, const char *link_name, scap_threadinfo *tinfo, scap_fdinfo *fdi, struct scap_ns_socket_list *sockets, char *error)
+{
+	scap_fdinfo *tfdi;
+	uint64_t ino;
 
 	strncpy(fdi->info.fname, link_name, SCAP_MAX_PATH_SIZE);
 
@@ -1061,6 +1124,34 @@ int32_t scap_fd_handle_socket(scap_t *handle, char *fname, scap_threadinfo *tinf
 	}
 }
 
+int32_t scap_fd_handle_socket(scap_t *handle, char *fname, scap_threadinfo *tinfo, scap_fdinfo *fdi, char* procdir, uint64_t net_ns, struct scap_ns_socket_list **sockets_by_ns, char *error)
+{
+	char link_name[SCAP_MAX_PATH_SIZE];
+	ssize_t r;
+	struct scap_ns_socket_list* sockets;
+
+	if(scap_fd_get_ns_sockets(handle, procdir, net_ns, sockets_by_ns, &sockets, error) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	if(sockets == NULL)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	handle->m_fd_scan_stats.n_readlink++;
+	r = readlink(fname, link_name, SCAP_MAX_PATH_SIZE);
+	if(r <= 0)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	link_name[r] = '\0';
+
+	return scap_fd_handle_socket_link(handle, link_name, tinfo, fdi, sockets, error);
+}
+
 int32_t scap_fd_read_unix_sockets_from_proc_fs(scap_t *handle, const char* filename, scap_fdinfo **sockets)
 {
 	FILE *f;
@@ -1732,6 +1823,291 @@ int32_t scap_fd_read_ipv6_sockets_from_proc_fs(scap_t *handle, char *dir, int l4
 	return uth_status;
 }
 
+#if defined(__linux__)
+#ifndef CLONE_NEWNET
+#define CLONE_NEWNET 0x40000000
+#endif
+
+//
+// TCP states of the sockets that sock_diag should return. Time wait and
+// request sockets have no inode, so no fd can point to them.
+//
+#define SCAP_TCP_NEW_SYN_RECV 12
+#define SCAP_SOCK_DIAG_STATES (0xffffffff & ~((1 << TCP_TIME_WAIT) | (1 << TCP_SYN_RECV) | (1 << SCAP_TCP_NEW_SYN_RECV)))
+
+//
+// Open a NETLINK_SOCK_DIAG socket in the network namespace of procdir, or
+// in ours if procdir is NULL. The socket keeps dumping the sockets of the
+// namespace it was created in, so the thread only needs to switch
+// namespace for the socket() call.
+// *sock is -1 if that's not possible, e.g. without CAP_SYS_ADMIN. Fails
+// if the thread can't go back to its own namespace.
+//
+static int32_t scap_fd_open_sock_diag(scap_t *handle, const char* procdir, int* sock)
+{
+	char filename[SCAP_MAX_PATH_SIZE];
+	struct stat cur_st;
+	struct stat target_st;
+	int cur_ns = -1;
+	int target_ns = -1;
+	bool switch_ns = false;
+	int32_t res = SCAP_SUCCESS;
+
+	*sock = -1;
+
+	if(procdir != NULL)
+	{
+		snprintf(filename, sizeof(filename), "%sns/net", procdir);
+		target_ns = open(filename, O_RDONLY | O_CLOEXEC);
+		cur_ns = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+		if(target_ns < 0 || cur_ns < 0 ||
+		   fstat(target_ns, &target_st) != 0 || fstat(cur_ns, &cur_st) != 0)
+		{
+			goto out;
+		}
+
+		switch_ns = (target_st.st_ino != cur_st.st_ino);
+		if(switch_ns && syscall(SYS_setns, target_ns, CLONE_NEWNET) != 0)
+		{
+			goto out;
+		}
+	}
+
+	*sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+
+	if(switch_ns && syscall(SYS_setns, cur_ns, CLONE_NEWNET) != 0)
+	{
+		//
+		// Should never happen. The thread would see the network of the
+		// container from now on, so stop here.
+		//
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "cannot go back to the original network namespace (%s)",
+			 scap_strerror(handle, errno));
+		ASSERT(false);
+		if(*sock >= 0)
+		{
+			close(*sock);
+			*sock = -1;
+		}
+		res = SCAP_FAILURE;
+	}
+
+out:
+	if(target_ns >= 0)
+	{
+		close(target_ns);
+	}
+
+	if(cur_ns >= 0)
+	{
+		close(cur_ns);
+	}
+
+	return res;
+}
+
+//
+// Dump the family/l4proto sockets in one of the states in the states
+// bitmask (1 << TCP_ESTABLISHED | ...) and add them to the table, in the
+// same format as scap_fd_read_ipv{4,6}_sockets_from_proc_fs
+//
+static int32_t scap_fd_read_inet_sockets_from_sock_diag(scap_t *handle, int sock, int family, int l4proto, uint32_t states, scap_fdinfo **sockets)
+{
+	struct
+	{
+		struct nlmsghdr nlh;
+		struct inet_diag_req_v2 req;
+	} request;
+	struct sockaddr_nl nladdr;
+	char* buf;
+	int32_t res = SCAP_FAILURE;
+	int32_t uth_status = SCAP_SUCCESS;
+	bool done = false;
+
+	memset(&nladdr, 0, sizeof(nladdr));
+	nladdr.nl_family = AF_NETLINK;
+
+	memset(&request, 0, sizeof(request));
+	request.nlh.nlmsg_len = sizeof(request);
+	request.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+	request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	request.req.sdiag_family = family;
+	request.req.sdiag_protocol = (l4proto == SCAP_L4_TCP) ? IPPROTO_TCP : IPPROTO_UDP;
+	request.req.idiag_states = states;
+
+	if(sendto(sock, &request, sizeof(request), 0, (struct sockaddr*)&nladdr, sizeof(nladdr)) < 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "sock_diag request failed (%s)",
+			 scap_strerror(handle, errno));
+		return SCAP_FAILURE;
+	}
+
+	buf = (char*)malloc(SOCK_DIAG_BUFFER_SIZE);
+	if(buf == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "sock_diag buffer allocation error");
+		return SCAP_FAILURE;
+	}
+
+	while(!done)
+	{
+		int len = recv(sock, buf, SOCK_DIAG_BUFFER_SIZE, 0);
+		struct nlmsghdr* h;
+
+		if(len < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "sock_diag recv failed (%s)",
+				 scap_strerror(handle, errno));
+			goto out;
+		}
+
+		if(len == 0)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "sock_diag dump truncated");
+			goto out;
+		}
+
+		for(h = (struct nlmsghdr*)buf; NLMSG_OK(h, len); h = NLMSG_NEXT(h, len))
+		{
+			struct inet_diag_msg* msg;
+			scap_fdinfo* fdinfo;
+
+			if(h->nlmsg_type == NLMSG_DONE)
+			{
+				done = true;
+				break;
+			}
+
+			if(h->nlmsg_type == NLMSG_ERROR)
+			{
+				struct nlmsgerr* err = (struct nlmsgerr*)NLMSG_DATA(h);
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "sock_diag error (%s)",
+					 scap_strerror(handle, -err->error));
+				goto out;
+			}
+
+			if(h->nlmsg_type != SOCK_DIAG_BY_FAMILY ||
+			   h->nlmsg_len < NLMSG_LENGTH(sizeof(struct inet_diag_msg)))
+			{
+				continue;
+			}
+
+			msg = (struct inet_diag_msg*)NLMSG_DATA(h);
+			if(msg->idiag_inode == 0)
+			{
+				continue;
+			}
+
+			fdinfo = malloc(sizeof(scap_fdinfo));
+			if(fdinfo == NULL)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "inet socket allocation error");
+				goto out;
+			}
+
+			fdinfo->ino = msg->idiag_inode;
+
+			//
+			// Addresses stay in network order and ports are converted to
+			// host order, like in /proc/net
+			//
+			if(family == AF_INET)
+			{
+				if(msg->id.idiag_dst[0] == 0)
+				{
+					fdinfo->type = SCAP_FD_IPV4_SERVSOCK;
+					fdinfo->info.ipv4serverinfo.l4proto = l4proto;
+					fdinfo->info.ipv4serverinfo.ip = msg->id.idiag_src[0];
+					fdinfo->info.ipv4serverinfo.port = ntohs(msg->id.idiag_sport);
+				}
+				else
+				{
+					fdinfo->type = SCAP_FD_IPV4_SOCK;
+					fdinfo->info.ipv4info.l4proto = l4proto;
+					fdinfo->info.ipv4info.sip = msg->id.idiag_src[0];
+					fdinfo->info.ipv4info.sport = ntohs(msg->id.idiag_sport);
+					fdinfo->info.ipv4info.dip = msg->id.idiag_dst[0];
+					fdinfo->info.ipv4info.dport = ntohs(msg->id.idiag_dport);
+				}
+			}
+			else
+			{
+				if(scap_fd_is_ipv6_server_socket(msg->id.idiag_dst))
+				{
+					fdinfo->type = SCAP_FD_IPV6_SERVSOCK;
+					fdinfo->info.ipv6serverinfo.l4proto = l4proto;
+					memcpy(fdinfo->info.ipv6serverinfo.ip, msg->id.idiag_src, sizeof(fdinfo->info.ipv6serverinfo.ip));
+					fdinfo->info.ipv6serverinfo.port = ntohs(msg->id.idiag_sport);
+				}
+				else
+				{
+					fdinfo->type = SCAP_FD_IPV6_SOCK;
+					fdinfo->info.ipv6info.l4proto = l4proto;
+					memcpy(fdinfo->info.ipv6info.sip, msg->id.idiag_src, sizeof(fdinfo->info.ipv6info.sip));
+					fdinfo->info.ipv6info.sport = ntohs(msg->id.idiag_sport);
+					memcpy(fdinfo->info.ipv6info.dip, msg->id.idiag_dst, sizeof(fdinfo->info.ipv6info.dip));
+					fdinfo->info.ipv6info.dport = ntohs(msg->id.idiag_dport);
+				}
+			}
+
+			HASH_ADD_INT64((*sockets), ino, fdinfo);
+			if(uth_status != SCAP_SUCCESS)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "inet socket allocation error");
+				free(fdinfo);
+				goto out;
+			}
+		}
+	}
+
+	res = SCAP_SUCCESS;
+
+out:
+	free(buf);
+	return res;
+}
+
+//
+// Read the TCP and UDP sockets, which are the vast majority on busy hosts,
+// with sock_diag. Anything going wrong, e.g. a kernel without udp_diag,
+// returns SCAP_NOT_SUPPORTED so that the caller can fall back to /proc.
+// SCAP_FAILURE means that the thread is stuck in another namespace.
+//
+int32_t scap_fd_read_inet_sockets_from_netlink(scap_t *handle, char* procdir, struct scap_ns_socket_list *sockets)
+{
+	int32_t res = SCAP_SUCCESS;
+	int sock;
+
+	if(scap_fd_open_sock_diag(handle, sockets->net_ns ? procdir : NULL, &sock) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	if(sock < 0)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "cannot open sock_diag socket (%s)",
+			 scap_strerror(handle, errno));
+		return SCAP_NOT_SUPPORTED;
+	}
+
+	if(scap_fd_read_inet_sockets_from_sock_diag(handle, sock, AF_INET, SCAP_L4_TCP, SCAP_SOCK_DIAG_STATES, &sockets->sockets) != SCAP_SUCCESS ||
+	   scap_fd_read_inet_sockets_from_sock_diag(handle, sock, AF_INET, SCAP_L4_UDP, SCAP_SOCK_DIAG_STATES, &sockets->sockets) != SCAP_SUCCESS ||
+	   scap_fd_read_inet_sockets_from_sock_diag(handle, sock, AF_INET6, SCAP_L4_TCP, SCAP_SOCK_DIAG_STATES, &sockets->sockets) != SCAP_SUCCESS ||
+	   scap_fd_read_inet_sockets_from_sock_diag(handle, sock, AF_INET6, SCAP_L4_UDP, SCAP_SOCK_DIAG_STATES, &sockets->sockets) != SCAP_SUCCESS)
+	{
+		res = SCAP_NOT_SUPPORTED;
+	}
+
+	close(sock);
+	return res;
+}
+#endif // __linux__
+
 int32_t scap_fd_read_sockets(scap_t *handle, char* procdir, struct scap_ns_socket_list *sockets, char *error)
 {
 	char filename[SCAP_MAX_PATH_SIZE];
@@ -1752,20 +2128,45 @@ int32_t scap_fd_read_sockets(scap_t *handle, char* procdir, struct scap_ns_socke
 		snprintf(netroot, sizeof(netroot), "%s/proc/net/", scap_get_host_root());
 	}
 
-	snprintf(filename, sizeof(filename), "%stcp", netroot);
-	if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets) == SCAP_FAILURE)
+	//
+	// TCP and UDP sockets come from sock_diag when possible, /proc/net is
+	// the fallback
+	//
+	bool inet_from_proc = true;
+#if defined(__linux__)
+	int32_t res = scap_fd_read_inet_sockets_from_netlink(handle, procdir, sockets);
+	if(res == SCAP_SUCCESS)
+	{
+		inet_from_proc = false;
+	}
+	else
 	{
 		scap_fd_free_table(handle, &sockets->sockets);
-		snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv4 tcp sockets (%s)", handle->m_lasterr);
-		return SCAP_FAILURE;
+		if(res == SCAP_FAILURE)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "Could not read inet sockets (%.200s)", handle->m_lasterr);
+			return SCAP_FAILURE;
+		}
 	}
+#endif
 
-	snprintf(filename, sizeof(filename), "%sudp", netroot);
-	if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_UDP, &sockets->sockets) == SCAP_FAILURE)
+	if(inet_from_proc)
 	{
-		scap_fd_free_table(handle, &sockets->sockets);
-		snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv4 udp sockets (%s)", handle->m_lasterr);
-		return SCAP_FAILURE;
+		snprintf(filename, sizeof(filename), "%stcp", netroot);
+		if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets) == SCAP_FAILURE)
+		{
+			scap_fd_free_table(handle, &sockets->sockets);
+			snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv4 tcp sockets (%s)", handle->m_lasterr);
+			return SCAP_FAILURE;
+		}
+
+		snprintf(filename, sizeof(filename), "%sudp", netroot);
+		if(scap_fd_read_ipv4_sockets_from_proc_fs(handle, filename, SCAP_L4_UDP, &sockets->sockets) == SCAP_FAILURE)
+		{
+			scap_fd_free_table(handle, &sockets->sockets);
+			snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv4 udp sockets (%s)", handle->m_lasterr);
+			return SCAP_FAILURE;
+		}
 	}
 
 	snprintf(filename, sizeof(filename), "%sraw", netroot);
@@ -1796,19 +2197,22 @@ int32_t scap_fd_read_sockets(scap_t *handle, char* procdir, struct scap_ns_socke
     /* We assume if there is /proc/net/tcp6 that ipv6 is available */
     if(access(filename, R_OK) == 0)
     {
-		if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets) == SCAP_FAILURE)
+		if(inet_from_proc)
 		{
-			scap_fd_free_table(handle, &sockets->sockets);
-			snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv6 tcp sockets (%s)", handle->m_lasterr);
-			return SCAP_FAILURE;
-		}
+			if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_TCP, &sockets->sockets) == SCAP_FAILURE)
+			{
+				scap_fd_free_table(handle, &sockets->sockets);
+				snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv6 tcp sockets (%s)", handle->m_lasterr);
+				return SCAP_FAILURE;
+			}
 
-		snprintf(filename, sizeof(filename), "%sudp6", netroot);
-		if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_UDP, &sockets->sockets) == SCAP_FAILURE)
-		{
-			scap_fd_free_table(handle, &sockets->sockets);
-			snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv6 udp sockets (%s)", handle->m_lasterr);
-			return SCAP_FAILURE;
+			snprintf(filename, sizeof(filename), "%sudp6", netroot);
+			if(scap_fd_read_ipv6_sockets_from_proc_fs(handle, filename, SCAP_L4_UDP, &sockets->sockets) == SCAP_FAILURE)
+			{
+				scap_fd_free_table(handle, &sockets->sockets);
+				snprintf(error, SCAP_LASTERR_SIZE, "Could not read ipv6 udp sockets (%s)", handle->m_lasterr);
+				return SCAP_FAILURE;
+			}
 		}
 
 		snprintf(filename, sizeof(filename), "%sraw6", netroot);
@@ -1878,6 +2282,255 @@ char * decode_st_mode(struct stat* sb)
     	break;
     }
 }
+//
+// Add a single fd to the table of tinfo. link_name is the target of fname if
+// the caller already read it, NULL otherwise.
+//
+static int32_t scap_fd_add_from_proc(scap_t *handle, char *procdir, scap_threadinfo *tinfo, uint64_t fd, char *fname, const char *link_name, mode_t mode, uint64_t ino, uint64_t net_ns, struct scap_ns_socket_list **sockets_by_ns, char *error)
+{
+	int32_t res = SCAP_SUCCESS;
+	scap_fdinfo *fdi = NULL;
+	struct scap_ns_socket_list* sockets;
+
+	switch(mode & S_IFMT)
+	{
+	case S_IFIFO:
+		res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_FIFO);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for fifo fd %" PRIu64, fd);
+			break;
+		}
+		res = link_name ? scap_fd_handle_pipe_link(handle, link_name, tinfo, fdi, error) :
+			scap_fd_handle_pipe(handle, fname, tinfo, fdi, error);
+		break;
+	case S_IFREG:
+	case S_IFBLK:
+	case S_IFCHR:
+	case S_IFLNK:
+		res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_FILE_V2);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for file fd %" PRIu64, fd);
+			break;
+		}
+		fdi->ino = ino;
+		res = link_name ? scap_fd_handle_regular_file_link(handle, link_name, tinfo, fdi, procdir, error) :
+			scap_fd_handle_regular_file(handle, fname, tinfo, fdi, procdir, error);
+		break;
+	case S_IFDIR:
+		res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_DIRECTORY);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for dir fd %" PRIu64, fd);
+			break;
+		}
+		fdi->ino = ino;
+		res = link_name ? scap_fd_handle_regular_file_link(handle, link_name, tinfo, fdi, procdir, error) :
+			scap_fd_handle_regular_file(handle, fname, tinfo, fdi, procdir, error);
+		break;
+	case S_IFSOCK:
+		res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_UNKNOWN);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for sock fd %" PRIu64, fd);
+			break;
+		}
+		if(link_name)
+		{
+			res = scap_fd_get_ns_sockets(handle, procdir, net_ns, sockets_by_ns, &sockets, error);
+			if(res == SCAP_SUCCESS && sockets != NULL)
+			{
+				res = scap_fd_handle_socket_link(handle, link_name, tinfo, fdi, sockets, error);
+			}
+		}
+		else
+		{
+			res = scap_fd_handle_socket(handle, fname, tinfo, fdi, procdir, net_ns, sockets_by_ns, error);
+		}
+		if(handle->m_proc_callback == NULL)
+		{
+			// we can land here if we've got a netlink socket
+			if(fdi->type == SCAP_FD_UNKNOWN)
+			{
+				scap_fd_free_fdinfo(&fdi);
+			}
+		}
+		break;
+	default:
+		res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_UNSUPPORTED);
+		if(SCAP_FAILURE == res)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for unsupported fd %" PRIu64, fd);
+			break;
+		}
+		fdi->ino = ino;
+		res = link_name ? scap_fd_handle_regular_file_link(handle, link_name, tinfo, fdi, procdir, error) :
+			scap_fd_handle_regular_file(handle, fname, tinfo, fdi, procdir, error);
+		break;
+	}
+
+	if(handle->m_proc_callback != NULL)
+	{
+		if(fdi)
+		{
+			scap_fd_free_fdinfo(&fdi);
+		}
+	}
+
+	return res;
+}
+
+#if defined(__linux__)
+#define SCAP_FD_SCAN_BUF_SIZE 32768
+
+struct scap_linux_dirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+//
+// Fast version of the /proc/x/fd scan: the directory is read with getdents64
+// into a buffer that is reused across processes, the fd type comes from the
+// link target when it has a well known format, so that stat() is only needed
+// for paths, and the fdinfo of files is not read.
+//
+static int32_t scap_fd_scan_fd_dir_fast(scap_t *handle, char *procdir, scap_threadinfo *tinfo, struct scap_ns_socket_list **sockets_by_ns, uint64_t net_ns, uint64_t* num_fds_ret, char *error)
+{
+	int32_t res = SCAP_SUCCESS;
+	char fd_dir_name[SCAP_MAX_PATH_SIZE];
+	char f_name[SCAP_MAX_PATH_SIZE];
+	char link_name[SCAP_MAX_PATH_SIZE];
+	struct stat sb;
+	uint64_t fd;
+	uint16_t fd_added = 0;
+	int dir_fd;
+	bool done = false;
+
+	if(handle->m_fd_scan_buf == NULL)
+	{
+		handle->m_fd_scan_buf = (char*)malloc(SCAP_FD_SCAN_BUF_SIZE);
+		if(handle->m_fd_scan_buf == NULL)
+		{
+			snprintf(error, SCAP_LASTERR_SIZE, "fd scan buffer allocation error");
+			return SCAP_FAILURE;
+		}
+	}
+
+	if(!scap_fd_path(fd_dir_name, procdir, "", "fd") ||
+	   (dir_fd = open(fd_dir_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "error opening the directory %.200sfd", procdir);
+		return SCAP_NOTFOUND;
+	}
+
+	while(!done)
+	{
+		long nread;
+		long pos;
+
+		handle->m_fd_scan_stats.n_getdents++;
+		nread = syscall(SYS_getdents64, dir_fd, handle->m_fd_scan_buf, SCAP_FD_SCAN_BUF_SIZE);
+		if(nread <= 0)
+		{
+			break;
+		}
+
+		for(pos = 0; pos < nread; )
+		{
+			struct scap_linux_dirent64 *d = (struct scap_linux_dirent64 *)(handle->m_fd_scan_buf + pos);
+			const char *p;
+			mode_t mode;
+			uint64_t ino = 0;
+			ssize_t r;
+
+			pos += d->d_reclen;
+
+			if(handle->m_fd_lookup_limit != 0 && fd_added >= handle->m_fd_lookup_limit)
+			{
+				done = true;
+				break;
+			}
+
+			if(d->d_name[0] < '0' || d->d_name[0] > '9')
+			{
+				continue;
+			}
+
+			fd = 0;
+			for(p = d->d_name; *p >= '0' && *p <= '9'; p++)
+			{
+				fd = fd * 10 + (*p - '0');
+			}
+
+			if(!scap_fd_path(f_name, fd_dir_name, "/", d->d_name))
+			{
+				continue;
+			}
+
+			handle->m_fd_scan_stats.n_readlink++;
+			r = readlink(f_name, link_name, SCAP_MAX_PATH_SIZE - 1);
+			if(r <= 0)
+			{
+				continue;
+			}
+			link_name[r] = '\0';
+
+			if(strncmp(link_name, "socket:[", sizeof("socket:[") - 1) == 0)
+			{
+				mode = S_IFSOCK;
+			}
+			else if(handle->m_mode == SCAP_MODE_NODRIVER)
+			{
+				// In no driver mode we're interested only in sockets
+				continue;
+			}
+			else if(strncmp(link_name, "pipe:[", sizeof("pipe:[") - 1) == 0)
+			{
+				mode = S_IFIFO;
+			}
+			else if(strncmp(link_name, "anon_inode:", sizeof("anon_inode:") - 1) == 0)
+			{
+				// anon inodes have no file type, and all share the same inode
+				mode = 0;
+			}
+			else
+			{
+				handle->m_fd_scan_stats.n_stat++;
+				if(-1 == stat(f_name, &sb))
+				{
+					continue;
+				}
+				mode = sb.st_mode;
+				ino = sb.st_ino;
+			}
+
+			res = scap_fd_add_from_proc(handle, procdir, tinfo, fd, f_name, link_name, mode, ino, net_ns, sockets_by_ns, error);
+			if(SCAP_SUCCESS != res)
+			{
+				done = true;
+				break;
+			}
+
+			++fd_added;
+		}
+	}
+	close(dir_fd);
+
+	handle->m_fd_scan_stats.n_fds += fd_added;
+	if (num_fds_ret != NULL)
+	{
+		*num_fds_ret = fd_added;
+	}
+
+	return res;
+}
+#endif // __linux__
+
 //
 // Scan the directory containing the fd's of a proc /proc/x/fd
 //
@@ -1891,7 +2544,6 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 	char link_name[SCAP_MAX_PATH_SIZE];
 	struct stat sb;
 	uint64_t fd;
-	scap_fdinfo *fdi = NULL;
 	uint64_t net_ns;
 	ssize_t r;
 	uint16_t fd_added = 0;
@@ -1901,14 +2553,6 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 		*num_fds_ret = 0;
 	}
 
-	snprintf(fd_dir_name, SCAP_MAX_PATH_SIZE, "%sfd", procdir);
-	dir_p = opendir(fd_dir_name);
-	if(dir_p == NULL)
-	{
-		snprintf(error, SCAP_LASTERR_SIZE, "error opening the directory %s", fd_dir_name);
-		return SCAP_NOTFOUND;
-	}
-
 	//
 	// Get the network namespace of the process
 	//
@@ -1927,12 +2571,29 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 		sscanf(link_name, "net:[%"PRIi64"]", &net_ns);
 	}
 
+#if defined(__linux__)
+	if(handle->m_fast_fd_scan)
+	{
+		return scap_fd_scan_fd_dir_fast(handle, procdir, tinfo, sockets_by_ns, net_ns, num_fds_ret, error);
+	}
+#endif
+
+	if(!scap_fd_path(fd_dir_name, procdir, "", "fd") ||
+	   (dir_p = opendir(fd_dir_name)) == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "error opening the directory %.200sfd", procdir);
+		return SCAP_NOTFOUND;
+	}
+
 	while((dir_entry_p = readdir(dir_p)) != NULL &&
 		(handle->m_fd_lookup_limit == 0 || fd_added < handle->m_fd_lookup_limit))
 	{
-		fdi = NULL;
-		snprintf(f_name, SCAP_MAX_PATH_SIZE, "%s/%s", fd_dir_name, dir_entry_p->d_name);
+		if(!scap_fd_path(f_name, fd_dir_name, "/", dir_entry_p->d_name))
+		{
+			continue;
+		}
 
+		handle->m_fd_scan_stats.n_stat++;
 		if(-1 == stat(f_name, &sb) || 1 != sscanf(dir_entry_p->d_name, "%"PRIu64, &fd))
 		{
 			continue;
@@ -1945,76 +2606,7 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 			continue;
 		}
 
-		switch(sb.st_mode & S_IFMT)
-		{
-		case S_IFIFO:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_FIFO);
-			if(SCAP_FAILURE == res)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for fifo fd %" PRIu64, fd);
-				break;
-			}
-			res = scap_fd_handle_pipe(handle, f_name, tinfo, fdi, error);
-			break;
-		case S_IFREG:
-		case S_IFBLK:
-		case S_IFCHR:
-		case S_IFLNK:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_FILE_V2);
-			if(SCAP_FAILURE == res)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for file fd %" PRIu64, fd);
-				break;
-			}
-			fdi->ino = sb.st_ino;
-			res = scap_fd_handle_regular_file(handle, f_name, tinfo, fdi, procdir, error);
-			break;
-		case S_IFDIR:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_DIRECTORY);
-			if(SCAP_FAILURE == res)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for dir fd %" PRIu64, fd);
-				break;
-			}
-			fdi->ino = sb.st_ino;
-			res = scap_fd_handle_regular_file(handle, f_name, tinfo, fdi, procdir, error);
-			break;
-		case S_IFSOCK:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_UNKNOWN);
-			if(SCAP_FAILURE == res)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for sock fd %" PRIu64, fd);
-				break;
-			}
-			res = scap_fd_handle_socket(handle, f_name, tinfo, fdi, procdir, net_ns, sockets_by_ns, error);
-			if(handle->m_proc_callback == NULL)
-			{
-				// we can land here if we've got a netlink socket
-				if(fdi->type == SCAP_FD_UNKNOWN)
-				{
-					scap_fd_free_fdinfo(&fdi);
-				}
-			}
-			break;
-		default:
-			res = scap_fd_allocate_fdinfo(handle, &fdi, fd, SCAP_FD_UNSUPPORTED);
-			if(SCAP_FAILURE == res)
-			{
-				snprintf(error, SCAP_LASTERR_SIZE, "can't allocate scap fd handle for unsupported fd %" PRIu64, fd);
-				break;
-			}
-			fdi->ino = sb.st_ino;
-			res = scap_fd_handle_regular_file(handle, f_name, tinfo, fdi, procdir, error);
-			break;
-		}
-
-		if(handle->m_proc_callback != NULL)
-		{
-			if(fdi)
-			{
-				scap_fd_free_fdinfo(&fdi);
-			}
-		}
+		res = scap_fd_add_from_proc(handle, procdir, tinfo, fd, f_name, NULL, sb.st_mode, sb.st_ino, net_ns, sockets_by_ns, error);
 
 		if(SCAP_SUCCESS != res)
 		{
@@ -2025,6 +2617,7 @@ int32_t scap_fd_scan_fd_dir(scap_t *handle, char *procdir, scap_threadinfo *tinf
 	}
 	closedir(dir_p);
 
+	handle->m_fd_scan_stats.n_fds += fd_added;
 	if (num_fds_ret != NULL)
 	{
 		*num_fds_ret = fd_added;
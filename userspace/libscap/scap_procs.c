@@ -979,6 +979,11 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 	uint64_t min_proc_time_ms = UINT64_MAX;
 	uint64_t max_proc_time_ms = 0;
 
+	if(parenttid == -1)
+	{
+		memset(&handle->m_fd_scan_stats, 0, sizeof(handle->m_fd_scan_stats));
+	}
+
 	if (do_timing)
 	{
 		start_ts_ms = scap_get_monotonic_ts_ms(&monotonic_ts_context);
@@ -1151,6 +1156,13 @@ static int32_t _scap_proc_scan_proc_dir_impl(scap_t* handle, char* procdirname,
 			               max_proc_time_ms,
 			               last_tid_processed,
 			               total_num_fds);
+			scap_debug_log(handle,
+			               "scap_proc_scan fd syscalls: %ld fds, getdents=%ld readlink=%ld stat=%ld fdinfo=%ld",
+			               handle->m_fd_scan_stats.n_fds,
+			               handle->m_fd_scan_stats.n_getdents,
+			               handle->m_fd_scan_stats.n_readlink,
+			               handle->m_fd_scan_stats.n_stat,
+			               handle->m_fd_scan_stats.n_fdinfo);
 		}
 	}
 
@@ -1306,6 +1318,51 @@ struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_soc
 #endif // HAS_CAPTURE
 }
 
+scap_t* scap_proc_reader_open(scap_t* handle, char* error)
+{
+#if !defined(HAS_CAPTURE) || defined(_WIN32)
+	snprintf(error, SCAP_LASTERR_SIZE, "/proc lookups not supported on %s", PLATFORM_NAME);
+	return NULL;
+#else
+	if(handle->m_mode == SCAP_MODE_CAPTURE)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "no /proc lookups for offline captures");
+		return NULL;
+	}
+
+	scap_t* reader = (scap_t*)calloc(1, sizeof(scap_t));
+	if(reader == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "error allocating the scap_t structure");
+		return NULL;
+	}
+
+	//
+	// The devices are only used to translate the thread ids in the pid
+	// namespace and are shared with the owner. Everything that gets
+	// written during a lookup (error buffer, mount table, fd scan buffer)
+	// is private to the reader, and the proc callback is left unset so
+	// the lookups never call back into the consumer.
+	//
+	reader->m_mode = handle->m_mode;
+	reader->m_bpf = handle->m_bpf;
+	reader->m_udig = handle->m_udig;
+	reader->m_devs = handle->m_devs;
+	reader->m_ndevs = handle->m_ndevs;
+	reader->m_fd_lookup_limit = handle->m_fd_lookup_limit;
+	reader->m_fast_fd_scan = handle->m_fast_fd_scan;
+
+	return reader;
+#endif // HAS_CAPTURE
+}
+
+void scap_proc_reader_close(scap_t* reader)
+{
+	scap_free_device_table(reader);
+	free(reader->m_fd_scan_buf);
+	free(reader);
+}
+
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm)
 {
 #if !defined(HAS_CAPTURE)
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef WIN32
 #include <unistd.h>
@@ -42,6 +43,28 @@ struct iovec {
 //
 // Write data into a dump file
 //
+static int scap_dump_grow_buf(scap_dumper_t *d, unsigned len)
+{
+	uint64_t used = d->m_targetbufcurpos - d->m_targetbuf;
+	uint64_t size = d->m_targetbufend - d->m_targetbuf;
+
+	while(used + len >= size)
+	{
+		size *= 2;
+	}
+
+	uint8_t* buf = (uint8_t*)realloc(d->m_targetbuf, size);
+	if(buf == NULL)
+	{
+		return -1;
+	}
+
+	d->m_targetbuf = buf;
+	d->m_targetbufcurpos = buf + used;
+	d->m_targetbufend = buf + size;
+	return 0;
+}
+
 int scap_dump_write(scap_dumper_t *d, void* buf, unsigned len)
 {
 	if(d->m_type == DT_FILE)
@@ -50,6 +73,13 @@ int scap_dump_write(scap_dumper_t *d, void* buf, unsigned len)
 	}
 	else
 	{
+		if(d->m_type == DT_MANAGED_BUF &&
+		   d->m_targetbufcurpos + len >= d->m_targetbufend &&
+		   scap_dump_grow_buf(d, len) != 0)
+		{
+			return -1;
+		}
+
 		if(d->m_targetbufcurpos + len < d->m_targetbufend)
 		{
 			memcpy(d->m_targetbufcurpos, buf, len);
@@ -499,6 +529,123 @@ static int32_t scap_write_proclist(scap_t *handle, scap_dumper_t *d)
 	return scap_write_proclist_trailer(handle, d, totlen);
 }
 
+//
+// Set the state base of the dump files opened next
+//
+int32_t scap_set_dump_state_base(scap_t *handle, const char *base_fname, uint64_t base_id)
+{
+	if(base_fname == NULL)
+	{
+		handle->m_dump_state_base[0] = 0;
+		return SCAP_SUCCESS;
+	}
+
+	size_t namelen = strlen(base_fname);
+	if(namelen == 0 || namelen >= SCAP_MAX_PATH_SIZE)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid state base file name");
+		return SCAP_FAILURE;
+	}
+
+	memcpy(handle->m_dump_state_base, base_fname, namelen + 1);
+	handle->m_dump_state_base_id = base_id;
+	return SCAP_SUCCESS;
+}
+
+//
+// Write the state base block
+//
+static int32_t scap_write_state_base(scap_t *handle, scap_dumper_t *d)
+{
+	block_header bh;
+	uint32_t bt;
+	uint64_t base_id = handle->m_dump_state_base_id;
+	uint16_t stlen = (uint16_t)strlen(handle->m_dump_state_base);
+
+	bh.block_type = SB_BLOCK_TYPE;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + sizeof(uint64_t) + sizeof(uint16_t) + stlen + 4);
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_dump_write(d, &base_id, sizeof(uint64_t)) != sizeof(uint64_t) ||
+	        scap_dump_write(d, &stlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+	        scap_dump_write(d, handle->m_dump_state_base, stlen) != stlen ||
+	        scap_write_padding(d, sizeof(uint64_t) + sizeof(uint16_t) + stlen) != SCAP_SUCCESS)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (SB1)");
+		return SCAP_FAILURE;
+	}
+
+	bt = bh.block_total_length;
+	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (SB2)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Write the state id block
+//
+int32_t scap_write_state_id(scap_t *handle, scap_dumper_t *d, uint64_t id)
+{
+	block_header bh;
+	uint32_t bt;
+
+	bh.block_type = SI_BLOCK_TYPE;
+	bh.block_total_length = sizeof(block_header) + sizeof(uint64_t) + 4;
+	bt = bh.block_total_length;
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_dump_write(d, &id, sizeof(uint64_t)) != sizeof(uint64_t) ||
+	        scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (SI1)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Write the removed state block
+//
+int32_t scap_write_removed_state(scap_t *handle, scap_dumper_t *d, const scap_removed_state *entries, uint32_t nentries)
+{
+	block_header bh;
+	uint32_t bt;
+	uint32_t j;
+
+	bh.block_type = RS_BLOCK_TYPE;
+	bh.block_total_length = sizeof(block_header) + nentries * (sizeof(uint64_t) + sizeof(int64_t)) + 4;
+
+	if(scap_dump_write(d, &bh, sizeof(bh)) != sizeof(bh))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (RS1)");
+		return SCAP_FAILURE;
+	}
+
+	for(j = 0; j < nentries; j++)
+	{
+		if(scap_dump_write(d, (void*)&entries[j].tid, sizeof(uint64_t)) != sizeof(uint64_t) ||
+		        scap_dump_write(d, (void*)&entries[j].fd, sizeof(int64_t)) != sizeof(int64_t))
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (RS2)");
+			return SCAP_FAILURE;
+		}
+	}
+
+	bt = bh.block_total_length;
+	if(scap_dump_write(d, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (RS3)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
 //
 // Write the machine info block
 //
@@ -797,7 +944,7 @@ int32_t scap_setup_dump(scap_t *handle, scap_dumper_t* d, const char *fname)
 	bh.block_total_length = sizeof(block_header) + sizeof(section_header_block) + 4;
 
 	sh.byte_order_magic = SHB_MAGIC;
-	sh.major_version = CURRENT_MAJOR_VERSION;
+	sh.major_version = handle->m_dump_state_base[0] != 0 ? CURRENT_MAJOR_VERSION : FULL_STATE_MAJOR_VERSION;
 	sh.minor_version = CURRENT_MINOR_VERSION;
 	sh.section_length = 0xffffffffffffffffLL;
 
@@ -811,6 +958,14 @@ int32_t scap_setup_dump(scap_t *handle, scap_dumper_t* d, const char *fname)
 		return SCAP_FAILURE;
 	}
 
+	//
+	// A delta capture names its base before any table
+	//
+	if(handle->m_dump_state_base[0] != 0 && scap_write_state_base(handle, d) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
 	//
 	// If we're dumping in live mode, refresh the process tables list
 	// so we don't lose information about processes created in the interval
@@ -889,15 +1044,9 @@ int32_t scap_setup_dump(scap_t *handle, scap_dumper_t* d, const char *fname)
 	return SCAP_SUCCESS;
 }
 
-// fname is only used for log messages in scap_setup_dump
-static scap_dumper_t *scap_dump_open_gzfile(scap_t *handle, gzFile gzfile, const char *fname, bool skip_proc_scan)
+static int32_t scap_setup_dump_skip_proc_scan(scap_t *handle, scap_dumper_t* d, const char *fname, bool skip_proc_scan)
 {
-	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
-	res->m_f = gzfile;
-	res->m_type = DT_FILE;
-	res->m_targetbuf = NULL;
-	res->m_targetbufcurpos = NULL;
-	res->m_targetbufend = NULL;
+	int32_t res;
 
 	bool tmp_refresh_proc_table_when_saving = handle->refresh_proc_table_when_saving;
 	if(skip_proc_scan)
@@ -905,10 +1054,7 @@ static scap_dumper_t *scap_dump_open_gzfile(scap_t *handle, gzFile gzfile, const
 		handle->refresh_proc_table_when_saving = false;
 	}
 
-	if(scap_setup_dump(handle, res, fname) != SCAP_SUCCESS)
-	{
-		res = NULL;
-	}
+	res = scap_setup_dump(handle, d, fname);
 
 	if(skip_proc_scan)
 	{
@@ -918,10 +1064,29 @@ static scap_dumper_t *scap_dump_open_gzfile(scap_t *handle, gzFile gzfile, const
 	return res;
 }
 
+// fname is only used for log messages in scap_setup_dump
+static scap_dumper_t *scap_dump_open_gzfile(scap_t *handle, gzFile gzfile, const char *fname, bool skip_proc_scan)
+{
+	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
+	res->m_f = gzfile;
+	res->m_type = DT_FILE;
+	res->m_targetbuf = NULL;
+	res->m_targetbufcurpos = NULL;
+	res->m_targetbufend = NULL;
+
+	if(scap_setup_dump_skip_proc_scan(handle, res, fname, skip_proc_scan) != SCAP_SUCCESS)
+	{
+		res = NULL;
+	}
+
+	return res;
+}
+
 //
-// Open a "savefile" for writing.
+// Open the file of a "savefile" for writing. fname is changed to a
+// printable name for the standard output.
 //
-scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan)
+static gzFile scap_dump_gzopen(const char **fname, compression_mode compress, char *error)
 {
 	gzFile f = NULL;
 	int fd = -1;
@@ -937,11 +1102,11 @@ scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mod
 		break;
 	default:
 		ASSERT(false);
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid compression mode");
+		snprintf(error, SCAP_LASTERR_SIZE, "invalid compression mode");
 		return NULL;
 	}
 
-	if(fname[0] == '-' && fname[1] == '\0')
+	if((*fname)[0] == '-' && (*fname)[1] == '\0')
 	{
 #ifndef	WIN32
 		fd = dup(STDOUT_FILENO);
@@ -951,12 +1116,12 @@ scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mod
 		if(fd != -1)
 		{
 			f = gzdopen(fd, mode);
-			fname = "standard output";
+			*fname = "standard output";
 		}
 	}
 	else
 	{
-		f = gzopen(fname, mode);
+		f = gzopen(*fname, mode);
 	}
 
 	if(f == NULL)
@@ -968,13 +1133,57 @@ scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mod
 		}
 #endif
 
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open %s", fname);
+		snprintf(error, SCAP_LASTERR_SIZE, "can't open %s", *fname);
+		return NULL;
+	}
+
+	return f;
+}
+
+//
+// Open a "savefile" for writing.
+//
+scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan)
+{
+	gzFile f = scap_dump_gzopen(&fname, compress, handle->m_lasterr);
+	if(f == NULL)
+	{
 		return NULL;
 	}
 
 	return scap_dump_open_gzfile(handle, f, fname, skip_proc_scan);
 }
 
+//
+// Open a "savefile" for writing without writing anything in it. The
+// headers are expected to be appended with scap_dump_append_buf. The
+// capture handle is not used, so this can be called from any thread.
+//
+scap_dumper_t *scap_dump_open_headerless(const char *fname, compression_mode compress, char *error)
+{
+	gzFile f = scap_dump_gzopen(&fname, compress, error);
+	if(f == NULL)
+	{
+		return NULL;
+	}
+
+	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
+	if(res == NULL)
+	{
+		gzclose(f);
+		snprintf(error, SCAP_LASTERR_SIZE, "scap_dump_open_headerless memory allocation failure");
+		return NULL;
+	}
+
+	res->m_f = f;
+	res->m_type = DT_FILE;
+	res->m_targetbuf = NULL;
+	res->m_targetbufcurpos = NULL;
+	res->m_targetbufend = NULL;
+
+	return res;
+}
+
 //
 // Open a savefile for writing, using the provided fd
 scap_dumper_t* scap_dump_open_fd(scap_t *handle, int fd, compression_mode compress, bool skip_proc_scan)
@@ -1044,6 +1253,68 @@ scap_dumper_t *scap_memory_dump_open(scap_t *handle, uint8_t* targetbuf, uint64_
 	return res;
 }
 
+//
+// Create a dumper that writes to a memory buffer that grows as needed, so
+// that its content can be appended to another dumper with
+// scap_dump_append_buf. With write_header it starts with the section header
+// and the tables, like a file opened with scap_dump_open, otherwise it's
+// empty.
+//
+scap_dumper_t *scap_managedbuf_dump_create(scap_t *handle, uint64_t initial_size, bool write_header, bool skip_proc_scan)
+{
+	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
+	if(res == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_managedbuf_dump_create memory allocation failure (1)");
+		return NULL;
+	}
+
+	if(initial_size == 0)
+	{
+		initial_size = 4096;
+	}
+
+	res->m_f = NULL;
+	res->m_type = DT_MANAGED_BUF;
+	res->m_targetbuf = (uint8_t*)malloc(initial_size);
+	if(res->m_targetbuf == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_managedbuf_dump_create memory allocation failure (2)");
+		free(res);
+		return NULL;
+	}
+
+	res->m_targetbufcurpos = res->m_targetbuf;
+	res->m_targetbufend = res->m_targetbuf + initial_size;
+
+	if(write_header && scap_setup_dump_skip_proc_scan(handle, res, "", skip_proc_scan) != SCAP_SUCCESS)
+	{
+		scap_dump_close(res);
+		return NULL;
+	}
+
+	return res;
+}
+
+int32_t scap_dump_append_buf(scap_dumper_t *d, scap_dumper_t *buf, char *error)
+{
+	ASSERT(buf->m_type == DT_MANAGED_BUF);
+
+	unsigned len = (unsigned)(buf->m_targetbufcurpos - buf->m_targetbuf);
+	if(len == 0)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	if(scap_dump_write(d, buf->m_targetbuf, len) != (int)len)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "error appending %u buffered bytes to the dump", len);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
 //
 // Close a "savefile" opened with scap_dump_open
 //
@@ -1053,6 +1324,10 @@ void scap_dump_close(scap_dumper_t *d)
 	{
 		gzclose(d->m_f);
 	}
+	else if(d->m_type == DT_MANAGED_BUF)
+	{
+		free(d->m_targetbuf);
+	}
 
 	free(d);
 }
@@ -1690,6 +1965,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			// All parsed. Allocate the new entry and copy the temp one into into it.
 			//
 			struct scap_threadinfo *ntinfo = (scap_threadinfo *)malloc(sizeof(scap_threadinfo));
+			struct scap_threadinfo *otinfo;
 			if(ntinfo == NULL)
 			{
 				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process table allocation error (fd1)");
@@ -1699,6 +1975,18 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			// Structure copy
 			*ntinfo = tinfo;
 
+			//
+			// In a delta capture, the thread replaces the one of the
+			// base, whose fds are updated by the fdlist blocks
+			//
+			HASH_FIND_INT64(handle->m_proclist, &ntinfo->tid, otinfo);
+			if(otinfo != NULL)
+			{
+				ntinfo->fdlist = otinfo->fdlist;
+				otinfo->fdlist = NULL;
+				scap_proc_delete(handle, otinfo);
+			}
+
 			HASH_ADD_INT64(handle->m_proclist, tid, ntinfo);
 			if(uth_status != SCAP_SUCCESS)
 			{
@@ -2391,6 +2679,7 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length,
 	struct scap_threadinfo *tinfo;
 	scap_fdinfo fdi;
 	scap_fdinfo *nfdi;
+	scap_fdinfo *ofdi;
 	//  uint16_t stlen;
 	uint64_t tid;
 	int32_t uth_status = SCAP_SUCCESS;
@@ -2449,6 +2738,14 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length,
 
 			ASSERT(tinfo != NULL);
 
+			// in a delta capture, the fd may replace one of the base
+			HASH_FIND_INT64(tinfo->fdlist, &nfdi->fd, ofdi);
+			if(ofdi != NULL)
+			{
+				HASH_DEL(tinfo->fdlist, ofdi);
+				free(ofdi);
+			}
+
 			HASH_ADD_INT64(tinfo->fdlist, fd, nfdi);
 			if(uth_status != SCAP_SUCCESS)
 			{
@@ -2482,16 +2779,255 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length,
 	return SCAP_SUCCESS;
 }
 
+//
+// Parse a removed state block, dropping its threads and fds from the tables
+//
+static int32_t scap_read_removed_state(scap_t *handle, gzFile f, uint32_t block_length)
+{
+	size_t readsize;
+	size_t totreadsize = 0;
+	scap_removed_state rs;
+	struct scap_threadinfo *tinfo;
+	scap_fdinfo *fdi;
+
+	while(block_length - totreadsize >= sizeof(uint64_t) + sizeof(int64_t))
+	{
+		readsize = gzread(f, &rs.tid, sizeof(uint64_t));
+		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
+		totreadsize += readsize;
+
+		readsize = gzread(f, &rs.fd, sizeof(int64_t));
+		CHECK_READ_SIZE(readsize, sizeof(int64_t));
+		totreadsize += readsize;
+
+		//
+		// The entries that aren't there are fine, e.g. the threads
+		// that the base couldn't fit in its table
+		//
+		HASH_FIND_INT64(handle->m_proclist, &rs.tid, tinfo);
+		if(tinfo == NULL)
+		{
+			continue;
+		}
+
+		if(rs.fd == -1)
+		{
+			scap_proc_delete(handle, tinfo);
+			continue;
+		}
+
+		HASH_FIND_INT64(tinfo->fdlist, &rs.fd, fdi);
+		if(fdi != NULL)
+		{
+			HASH_DEL(tinfo->fdlist, fdi);
+			free(fdi);
+		}
+	}
+
+	if(totreadsize != block_length)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted removed state block of size %u", block_length);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_read_headers(scap_t *handle, gzFile f, const char *fname, uint32_t depth, uint64_t *state_id);
+
+//
+// Skip the body of a block, the caller reads the trailer
+//
+static int32_t scap_skip_block(scap_t *handle, gzFile f, block_header *bh)
+{
+	size_t toread = bh->block_total_length - sizeof(block_header) - 4;
+
+	if(gzseek(f, (long)toread, SEEK_CUR) == -1)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip block of type %x and size %u.",
+		         (int)bh->block_type,
+		         (unsigned int)toread);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Parse a state id block
+//
+static int32_t scap_read_state_id(scap_t *handle, gzFile f, uint32_t block_length, uint64_t *state_id)
+{
+	size_t readsize;
+	uint64_t id;
+
+	if(block_length != sizeof(uint64_t))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted state id block of size %u", block_length);
+		return SCAP_FAILURE;
+	}
+
+	readsize = gzread(f, &id, sizeof(uint64_t));
+	CHECK_READ_SIZE(readsize, sizeof(uint64_t));
+
+	if(state_id != NULL)
+	{
+		*state_id = id;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Parse a state base block and load the tables of the capture it names
+//
+static int32_t scap_read_state_base(scap_t *handle, gzFile f, uint32_t block_length, const char *fname, uint32_t depth)
+{
+	size_t readsize;
+	size_t padding_len;
+	uint32_t padding;
+	uint64_t base_id;
+	uint64_t state_id = 0;
+	uint32_t name_length;
+	uint16_t stlen;
+	char name[SCAP_MAX_PATH_SIZE];
+	char path[SCAP_MAX_PATH_SIZE];
+	const char *slash;
+	gzFile bf;
+	int32_t res;
+
+	if(block_length < sizeof(uint64_t) + sizeof(uint16_t))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted state base block of size %u", block_length);
+		return SCAP_FAILURE;
+	}
+
+	readsize = gzread(f, &base_id, sizeof(uint64_t));
+	CHECK_READ_SIZE(readsize, sizeof(uint64_t));
+
+	readsize = gzread(f, &stlen, sizeof(uint16_t));
+	CHECK_READ_SIZE(readsize, sizeof(uint16_t));
+
+	name_length = block_length - sizeof(uint64_t) - sizeof(uint16_t);
+	if(stlen == 0 || stlen >= SCAP_MAX_PATH_SIZE || name_length < stlen ||
+	   name_length - stlen >= sizeof(padding))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted state base block of size %u", block_length);
+		return SCAP_FAILURE;
+	}
+
+	readsize = gzread(f, name, stlen);
+	CHECK_READ_SIZE(readsize, stlen);
+	name[stlen] = 0;
+
+	padding_len = name_length - stlen;
+	readsize = gzread(f, &padding, (unsigned int)padding_len);
+	CHECK_READ_SIZE(readsize, padding_len);
+
+	if(depth >= SCAP_MAX_STATE_CHAIN)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "more than %u delta captures chained, at %.200s", SCAP_MAX_STATE_CHAIN, name);
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Relative names are in the directory of the file that refers to
+	// them, or in the current one if we don't know that file's name
+	//
+	slash = (fname != NULL && name[0] != '/') ? strrchr(fname, '/') : NULL;
+	if(slash != NULL &&
+	   snprintf(path, sizeof(path), "%.*s/%s", (int)(slash - fname), fname, name) >= (int)sizeof(path))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "state base path too long for %.200s", name);
+		return SCAP_FAILURE;
+	}
+	else if(slash == NULL)
+	{
+		strcpy(path, name);
+	}
+
+	bf = gzopen(path, "rb");
+	if(bf == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open the state base %.200s", path);
+		return SCAP_FAILURE;
+	}
+
+	res = scap_read_headers(handle, bf, path, depth + 1, &state_id);
+	gzclose(bf);
+
+	//
+	// A file with the same name that isn't the base, like one that
+	// replaced it later, would give wrong tables
+	//
+	if(res == SCAP_SUCCESS && state_id != base_id)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "%.200s is not the state base of this capture", path);
+		return SCAP_FAILURE;
+	}
+
+	return res;
+}
+
+//
+// Hand the tables of a delta capture, which could only be rebuilt in
+// memory, to the callback
+//
+static void scap_replay_proc_table(scap_t *handle, proc_entry_callback callback)
+{
+	struct scap_threadinfo *tinfo;
+	struct scap_threadinfo *ttinfo;
+	scap_fdinfo *fdi;
+	scap_fdinfo *tfdi;
+
+	HASH_ITER(hh, handle->m_proclist, tinfo, ttinfo)
+	{
+		callback(handle->m_proc_callback_context, handle, tinfo->tid, tinfo, NULL);
+	}
+
+	HASH_ITER(hh, handle->m_proclist, tinfo, ttinfo)
+	{
+		HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+		{
+			callback(handle->m_proc_callback_context, handle, tinfo->tid, tinfo, fdi);
+		}
+	}
+
+	scap_proc_free_table(handle);
+}
+
 //
 // Parse the headers of a trace file and load the tables
 //
-int32_t scap_read_init(scap_t *handle, gzFile f)
+int32_t scap_read_init(scap_t *handle, gzFile f, const char *fname)
+{
+	proc_entry_callback callback = handle->m_proc_callback;
+	int32_t res;
+
+	res = scap_read_headers(handle, f, fname, 0, NULL);
+
+	if(handle->m_proc_callback != callback)
+	{
+		handle->m_proc_callback = callback;
+		if(res == SCAP_SUCCESS)
+		{
+			scap_replay_proc_table(handle, callback);
+		}
+	}
+
+	return res;
+}
+
+//
+// Parse the headers of a file, or only its tables if it's the base of a
+// delta capture (depth > 0), in which case its state id goes to state_id
+//
+static int32_t scap_read_headers(scap_t *handle, gzFile f, const char *fname, uint32_t depth, uint64_t *state_id)
 {
 	block_header bh;
 	section_header_block sh;
 	uint32_t bt;
 	size_t readsize;
-	size_t toread;
 	int fseekres;
 	int8_t found_mi = 0;
 	int8_t found_pl = 0;
@@ -2537,6 +3073,14 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 	{
 		readsize = gzread(f, &bh, sizeof(bh));
 
+		//
+		// A state base doesn't need any event
+		//
+		if(readsize == 0 && depth > 0)
+		{
+			return SCAP_SUCCESS;
+		}
+
 		//
 		// If we don't find the event block header,
 		// it means there is no event in the file.
@@ -2556,7 +3100,12 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		case MI_BLOCK_TYPE_INT:
 			found_mi = 1;
 
-			if(scap_read_machine_info(handle, f, bh.block_total_length - sizeof(block_header) - 4) != SCAP_SUCCESS)
+			//
+			// Of the state bases of a delta capture, only the
+			// thread and fd tables matter
+			//
+			if((depth > 0 ? scap_skip_block(handle, f, &bh) :
+			    scap_read_machine_info(handle, f, bh.block_total_length - sizeof(block_header) - 4)) != SCAP_SUCCESS)
 			{
 				return SCAP_FAILURE;
 			}
@@ -2590,6 +3139,30 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 				return SCAP_FAILURE;
 			}
 			break;
+		case SB_BLOCK_TYPE:
+			//
+			// The tables of the base can only be rebuilt in memory,
+			// scap_read_init() hands them to the callback at the end
+			//
+			handle->m_proc_callback = NULL;
+
+			if(scap_read_state_base(handle, f, bh.block_total_length - sizeof(block_header) - 4, fname, depth) != SCAP_SUCCESS)
+			{
+				return SCAP_FAILURE;
+			}
+			break;
+		case RS_BLOCK_TYPE:
+			if(scap_read_removed_state(handle, f, bh.block_total_length - sizeof(block_header) - 4) != SCAP_SUCCESS)
+			{
+				return SCAP_FAILURE;
+			}
+			break;
+		case SI_BLOCK_TYPE:
+			if(scap_read_state_id(handle, f, bh.block_total_length - sizeof(block_header) - 4, state_id) != SCAP_SUCCESS)
+			{
+				return SCAP_FAILURE;
+			}
+			break;
 		case EV_BLOCK_TYPE:
 		case EV_BLOCK_TYPE_INT:
 		case EV_BLOCK_TYPE_V2:
@@ -2615,7 +3188,8 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		case IL_BLOCK_TYPE_V2:
 			found_il = 1;
 
-			if(scap_read_iflist(handle, f, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
+			if((depth > 0 ? scap_skip_block(handle, f, &bh) :
+			    scap_read_iflist(handle, f, bh.block_total_length - sizeof(block_header) - 4, bh.block_type)) != SCAP_SUCCESS)
 			{
 				return SCAP_FAILURE;
 			}
@@ -2625,7 +3199,8 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		case UL_BLOCK_TYPE_V2:
 			found_ul = 1;
 
-			if(scap_read_userlist(handle, f, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
+			if((depth > 0 ? scap_skip_block(handle, f, &bh) :
+			    scap_read_userlist(handle, f, bh.block_total_length - sizeof(block_header) - 4, bh.block_type)) != SCAP_SUCCESS)
 			{
 				return SCAP_FAILURE;
 			}
@@ -2634,13 +3209,8 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 			//
 			// Unknown block type. Skip the block.
 			//
-			toread = bh.block_total_length - sizeof(block_header) - 4;
-			fseekres = (int)gzseek(f, (long)toread, SEEK_CUR);
-			if(fseekres == -1)
+			if(scap_skip_block(handle, f, &bh) != SCAP_SUCCESS)
 			{
-				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip block of type %x and size %u.",
-				         (int)bh.block_type,
-				         (unsigned int)toread);
 				return SCAP_FAILURE;
 			}
 			break;
@@ -2666,6 +3236,11 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		}
 	}
 
+	if(depth > 0)
+	{
+		return SCAP_SUCCESS;
+	}
+
 	if(!found_mi)
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't find machine info block.");
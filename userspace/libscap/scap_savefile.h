@@ -45,7 +45,10 @@ typedef struct _block_header
 // Major version of the file format supported by this library.
 // Must be increased only when if the new version of the software
 // is not able anymore to read older captures
-#define CURRENT_MAJOR_VERSION	1
+#define CURRENT_MAJOR_VERSION	2
+// Major version written in the files that the readers of version 1 can
+// still read, all but the delta captures (see SB_BLOCK_TYPE)
+#define FULL_STATE_MAJOR_VERSION	1
 // Minor version of the file format supported by this library.
 // We used to bump it every time the event table was updated, but
 // after adding {retro,forward} captures compatibility support
@@ -148,6 +151,37 @@ typedef struct _section_header_block
 
 #define EVF_BLOCK_TYPE_V2	0x217
 
+///////////////////////////////////////////////////////////////////////////////
+// STATE BASE BLOCK
+///////////////////////////////////////////////////////////////////////////////
+// The file is a delta capture: its thread and fd tables start from the ones
+// of the capture named in the block, a path relative to the directory of
+// this file unless it's absolute. The proclist and fdlist blocks that follow
+// only hold the threads and fds added or changed since that capture, the
+// removed state blocks the ones that are gone.
+// The block has the state id of that capture, a uint64_t, then the name
+// length, a uint16_t, and the name. Delta captures have CURRENT_MAJOR_VERSION
+// in the section header, so that older readers don't take them for
+// complete captures.
+#define SB_BLOCK_TYPE		0x221
+
+///////////////////////////////////////////////////////////////////////////////
+// REMOVED STATE BLOCK
+///////////////////////////////////////////////////////////////////////////////
+#define RS_BLOCK_TYPE		0x222
+
+///////////////////////////////////////////////////////////////////////////////
+// STATE ID BLOCK
+///////////////////////////////////////////////////////////////////////////////
+// A uint64_t that identifies the tables of a capture which is the state base
+// of delta captures. They fail to load a base with a different id, like a
+// file written later with the same name.
+#define SI_BLOCK_TYPE		0x223
+
+// Longest chain of delta captures the reader follows, which also stops the
+// loops
+#define SCAP_MAX_STATE_CHAIN	64
+
 #if defined __sun
 #pragma pack()
 #else
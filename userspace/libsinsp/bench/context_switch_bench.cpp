@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Measure what the driver adds to a context switch. Two threads bounce
+// a byte over a pair of pipes, pinned to the same CPU so that every round
+// trip is two context switches. The loop is timed with no capture
+// running, then again while an inspector drains a live capture, with the
+// BPF probe if one is given or the kernel module otherwise.
+//
+// Must run as root. Usage: bench-context-switch [round_trips] [bpf_probe]
+//
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "sinsp.h"
+
+using namespace std::chrono;
+
+static void pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+}
+
+//
+// Return the average time of a context switch, in ns
+//
+static double ping_pong(uint64_t round_trips)
+{
+	int ping[2];
+	int pong[2];
+	char c = 0;
+
+	if(pipe(ping) != 0 || pipe(pong) != 0)
+	{
+		throw sinsp_exception("can't create the pipes");
+	}
+
+	std::thread peer([&]()
+	{
+		char b;
+		pin_to_cpu(0);
+		for(uint64_t j = 0; j < round_trips; j++)
+		{
+			if(read(ping[0], &b, 1) != 1 || write(pong[1], &b, 1) != 1)
+			{
+				break;
+			}
+		}
+	});
+
+	pin_to_cpu(0);
+	auto start = steady_clock::now();
+	for(uint64_t j = 0; j < round_trips; j++)
+	{
+		if(write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1)
+		{
+			break;
+		}
+	}
+	double ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+	peer.join();
+	close(ping[0]);
+	close(ping[1]);
+	close(pong[0]);
+	close(pong[1]);
+
+	return ns / (round_trips * 2);
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t round_trips = argc > 1 ? strtoull(argv[1], NULL, 10) : 200000;
+	std::string bpf_probe = argc > 2 ? argv[2] : "";
+
+	try
+	{
+		// warm up, then the reference
+		ping_pong(round_trips / 10);
+		double detached = ping_pong(round_trips);
+		printf("detached: %.0f ns/switch\n", detached);
+
+		sinsp inspector;
+		if(!bpf_probe.empty())
+		{
+			inspector.set_bpf_probe(bpf_probe);
+		}
+		inspector.open();
+
+		//
+		// Drain the buffers from another CPU, so that the cost measured
+		// is the one of the probe, not of the consumer
+		//
+		std::atomic<bool> stop(false);
+		uint64_t nevts = 0;
+		std::thread consumer([&]()
+		{
+			sinsp_evt* evt;
+			if(std::thread::hardware_concurrency() > 1)
+			{
+				pin_to_cpu(1);
+			}
+			while(!stop)
+			{
+				if(inspector.next(&evt) == SCAP_SUCCESS)
+				{
+					nevts++;
+				}
+			}
+		});
+
+		ping_pong(round_trips / 10);
+		double attached = ping_pong(round_trips);
+
+		stop = true;
+		consumer.join();
+
+		scap_stats stats;
+		inspector.get_capture_stats(&stats);
+		inspector.close();
+
+		printf("attached: %.0f ns/switch, overhead %.0f ns (%.1f%%)\n",
+			attached, attached - detached, (attached - detached) * 100 / detached);
+		printf("events: %lu read, %lu received by the driver, %lu dropped\n",
+			nevts, stats.n_evts, stats.n_drops);
+	}
+	catch(const sinsp_exception& e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
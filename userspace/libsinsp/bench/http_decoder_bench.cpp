@@ -0,0 +1,236 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compare decoding HTTP transactions in process with exporting the raw
+// read and write buffers through a pipe to another thread that parses
+// them, which is what consumers without an HTTP decoder have to do.
+// The same synthetic client traffic is used for both: keep-alive
+// connections, a request write followed by a response read, with the
+// response body in a separate read.
+//
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "http_transaction.h"
+
+using namespace std::chrono;
+
+static const uint32_t NCONNS = 256;
+static const uint32_t NTRANSACTIONS = 1000000;
+static const uint32_t SNAPLEN = 256;
+
+struct buffer
+{
+	uint32_t m_conn;
+	bool m_is_read;
+	std::string m_data;
+	uint64_t m_size;
+};
+
+struct frame_hdr
+{
+	uint32_t m_conn;
+	uint32_t m_is_read;
+	uint64_t m_ts;
+	uint64_t m_size;
+	uint32_t m_len;
+};
+
+static std::vector<buffer> make_traffic()
+{
+	std::vector<buffer> res;
+	std::string body(1500, 'x');
+
+	for(uint32_t j = 0; j < NTRANSACTIONS; j++)
+	{
+		uint32_t conn = j % NCONNS;
+		std::string url = "/api/v1/objects/" + std::to_string(j % 977) + "?verbose=true";
+
+		res.push_back({conn, false,
+			"GET " + url + " HTTP/1.1\r\nHost: backend.svc.cluster.local\r\n"
+			"User-Agent: bench/1.0\r\nAccept: application/json\r\n\r\n", 0});
+		res.push_back({conn, true,
+			"HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+			"Content-Length: " + std::to_string(body.size()) + "\r\n\r\n", 0});
+		res.push_back({conn, true, body, 0});
+	}
+
+	for(auto& b : res)
+	{
+		b.m_size = b.m_data.size();
+		if(b.m_data.size() > SNAPLEN)
+		{
+			b.m_data.resize(SNAPLEN);
+		}
+	}
+
+	return res;
+}
+
+static uint64_t run_decoder(const std::vector<buffer>& traffic)
+{
+	std::vector<std::unique_ptr<sinsp_http_conn>> conns;
+	for(uint32_t j = 0; j < NCONNS; j++)
+	{
+		conns.emplace_back(new sinsp_http_conn());
+	}
+
+	sinsp_http_transaction tr;
+	uint64_t ntr = 0;
+	uint64_t ts = 0;
+
+	for(const auto& b : traffic)
+	{
+		ts += 1000;
+		if(conns[b.m_conn]->on_data(b.m_is_read, ts, b.m_data.c_str(), b.m_data.size(), b.m_size, &tr))
+		{
+			ntr++;
+		}
+	}
+
+	return ntr;
+}
+
+static uint64_t run_export(const std::vector<buffer>& traffic, uint64_t* exported_bytes)
+{
+	int fds[2];
+	if(pipe(fds) != 0)
+	{
+		perror("pipe");
+		return 0;
+	}
+
+	uint64_t ntr = 0;
+
+	//
+	// The consumer parses the stream of frames and runs the same decoder
+	// on them, as an external process would
+	//
+	std::thread consumer([&]()
+	{
+		std::vector<std::unique_ptr<sinsp_http_conn>> conns;
+		for(uint32_t j = 0; j < NCONNS; j++)
+		{
+			conns.emplace_back(new sinsp_http_conn());
+		}
+
+		sinsp_http_transaction tr;
+		std::vector<char> buf;
+		size_t pos = 0;
+		char rbuf[65536];
+
+		while(true)
+		{
+			ssize_t n = read(fds[0], rbuf, sizeof(rbuf));
+			if(n <= 0)
+			{
+				break;
+			}
+			buf.insert(buf.end(), rbuf, rbuf + n);
+
+			while(buf.size() - pos >= sizeof(frame_hdr))
+			{
+				frame_hdr hdr;
+				memcpy(&hdr, &buf[pos], sizeof(hdr));
+				if(buf.size() - pos < sizeof(hdr) + hdr.m_len)
+				{
+					break;
+				}
+
+				if(conns[hdr.m_conn]->on_data(hdr.m_is_read, hdr.m_ts, &buf[pos + sizeof(hdr)], hdr.m_len, hdr.m_size, &tr))
+				{
+					ntr++;
+				}
+				pos += sizeof(hdr) + hdr.m_len;
+			}
+
+			buf.erase(buf.begin(), buf.begin() + pos);
+			pos = 0;
+		}
+	});
+
+	std::vector<char> out;
+	uint64_t ts = 0;
+	*exported_bytes = 0;
+
+	for(const auto& b : traffic)
+	{
+		ts += 1000;
+		frame_hdr hdr = {b.m_conn, b.m_is_read, ts, b.m_size, (uint32_t)b.m_data.size()};
+		out.insert(out.end(), (char*)&hdr, (char*)&hdr + sizeof(hdr));
+		out.insert(out.end(), b.m_data.begin(), b.m_data.end());
+
+		if(out.size() >= 65536)
+		{
+			*exported_bytes += out.size();
+			if(write(fds[1], out.data(), out.size()) != (ssize_t)out.size())
+			{
+				perror("write");
+			}
+			out.clear();
+		}
+	}
+
+	*exported_bytes += out.size();
+	if(!out.empty() && write(fds[1], out.data(), out.size()) != (ssize_t)out.size())
+	{
+		perror("write");
+	}
+
+	close(fds[1]);
+	consumer.join();
+	close(fds[0]);
+
+	return ntr;
+}
+
+int main()
+{
+	std::vector<buffer> traffic = make_traffic();
+	uint64_t total_bytes = 0;
+	for(const auto& b : traffic)
+	{
+		total_bytes += b.m_data.size();
+	}
+
+	printf("%u transactions, %lu buffers, %lu captured bytes (snaplen %u)\n",
+	       NTRANSACTIONS, traffic.size(), total_bytes, SNAPLEN);
+
+	auto start = steady_clock::now();
+	uint64_t ntr = run_decoder(traffic);
+	uint64_t ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+	printf("%-9s transactions=%lu total=%lums per buffer=%luns exported=0B\n",
+	       "decoder", ntr, ns / 1000000, ns / traffic.size());
+
+	uint64_t exported = 0;
+	start = steady_clock::now();
+	ntr = run_export(traffic, &exported);
+	ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+	printf("%-9s transactions=%lu total=%lums per buffer=%luns exported=%luMB\n",
+	       "export", ntr, ns / 1000000, ns / traffic.size(), exported >> 20);
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Measure how replaying a capture file with a filter scales with the
+// number of worker threads. The file is split once, then the shards are
+// replayed with 1, 2, 4... workers up to the number of cores, and the
+// time is compared with a sequential read of the original file with the
+// same filter.
+//
+// Usage: bench-parallel-replay <file.scap> [events_per_shard] [filter]
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sinsp.h"
+#include "parallel_replay.h"
+
+using namespace std::chrono;
+
+static const char* FORMAT = "%evt.num %evt.time %proc.name (%thread.tid) %evt.dir %evt.type %evt.args";
+
+static uint64_t sequential(const std::string& fname, const std::string& filter)
+{
+	sinsp inspector;
+	sinsp_evt* evt;
+	uint64_t nmatches = 0;
+	std::string out;
+
+	inspector.open(fname);
+	sinsp_evt_formatter formatter(&inspector, FORMAT);
+	std::unique_ptr<sinsp_filter> flt;
+	if(!filter.empty())
+	{
+		sinsp_filter_compiler compiler(&inspector, filter);
+		flt.reset(compiler.compile());
+	}
+
+	while(true)
+	{
+		int32_t res = inspector.next(&evt);
+		if(res == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			break;
+		}
+
+		if(!flt || flt->run(evt))
+		{
+			formatter.tostring(evt, &out);
+			nmatches++;
+		}
+	}
+
+	inspector.close();
+	return nmatches;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: %s <file.scap> [events_per_shard] [filter]\n", argv[0]);
+		return 1;
+	}
+
+	std::string input = argv[1];
+	uint64_t events_per_shard = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000;
+	std::string filter = argc > 3 ? argv[3] : "evt.dir=< and evt.type in (open, openat, connect, accept, execve)";
+	uint32_t ncores = std::thread::hardware_concurrency();
+
+	try
+	{
+		auto start = steady_clock::now();
+		uint64_t nmatches = sequential(input, filter);
+		double seq_s = duration_cast<duration<double>>(steady_clock::now() - start).count();
+		printf("sequential: %.3fs, %lu matches\n", seq_s, nmatches);
+
+		start = steady_clock::now();
+		sinsp_parallel_replay replay(sinsp_parallel_replay::split(input, "/tmp/bench-replay", events_per_shard, false));
+		double split_s = duration_cast<duration<double>>(steady_clock::now() - start).count();
+		printf("split: %.3fs, %lu shards\n", split_s, replay.get_shards().size());
+
+		for(uint32_t nworkers = 1; ; nworkers *= 2)
+		{
+			if(nworkers > ncores)
+			{
+				nworkers = ncores;
+			}
+
+			start = steady_clock::now();
+			std::vector<sinsp_replay_match> res = replay.run(filter, FORMAT, nworkers);
+			double s = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+			printf("%2u workers: %.3fs, %lu matches, speedup %.2fx\n",
+				nworkers, s, res.size(), seq_s / s);
+
+			if(nworkers == ncores)
+			{
+				break;
+			}
+		}
+
+		for(auto& shard : replay.get_shards())
+		{
+			remove(shard.m_filename.c_str());
+		}
+	}
+	catch(const sinsp_exception& e)
+	{
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
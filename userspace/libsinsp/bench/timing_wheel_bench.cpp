@@ -0,0 +1,181 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+//
+// Compare expiring 1M tracked objects with a timing wheel against the
+// periodic full table walk the inspector used to do.
+// Objects are touched at random and expire after an hour without being
+// touched, time moves forward one second per step.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+#include "timing_wheel.h"
+
+using namespace std::chrono;
+
+static const uint64_t ONE_SECOND = 1000000000ULL;
+static const uint64_t TIMEOUT = 3600 * ONE_SECOND;
+static const uint64_t SCAN_INTERVAL = 1200 * ONE_SECOND;
+static const uint32_t STEPS = 4 * 3600;
+static const uint32_t TOUCHES_PER_STEP = 1000;
+
+struct object
+{
+	uint64_t m_lastaccess_ts;
+};
+
+static uint64_t g_seed = 42;
+
+static void print_result(const char* name, uint32_t nobjects, uint64_t removed, uint64_t total_ns, std::vector<uint64_t>& steps)
+{
+	std::sort(steps.begin(), steps.end());
+	printf("%-13s objects=%u removed=%lu total=%lums step p50=%luus p99=%luus max=%luus\n",
+	       name, nobjects, removed, total_ns / 1000000,
+	       steps[steps.size() / 2] / 1000,
+	       steps[steps.size() * 99 / 100] / 1000,
+	       steps.back() / 1000);
+}
+
+static uint64_t next_rand()
+{
+	g_seed = g_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return g_seed >> 33;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t nobjects = argc > 1 ? atoi(argv[1]) : 1000000;
+	uint64_t start = 1000000 * ONE_SECOND;
+
+	std::unordered_map<uint64_t, object> table;
+	for(uint64_t j = 0; j < nobjects; j++)
+	{
+		table[j].m_lastaccess_ts = start - (next_rand() % TIMEOUT);
+	}
+	std::unordered_map<uint64_t, object> table_copy = table;
+
+	//
+	// Full table walk every SCAN_INTERVAL
+	//
+	std::vector<uint64_t> steps;
+	uint64_t last_scan = start;
+	uint64_t removed = 0;
+	auto begin = steady_clock::now();
+	for(uint32_t s = 0; s < STEPS; s++)
+	{
+		uint64_t now = start + s * ONE_SECOND;
+		for(uint32_t t = 0; t < TOUCHES_PER_STEP; t++)
+		{
+			auto it = table.find(next_rand() % nobjects);
+			if(it != table.end())
+			{
+				it->second.m_lastaccess_ts = now;
+			}
+		}
+
+		auto step_begin = steady_clock::now();
+		if(now > last_scan + SCAN_INTERVAL)
+		{
+			last_scan = now;
+			for(auto it = table.begin(); it != table.end();)
+			{
+				if(now > it->second.m_lastaccess_ts + TIMEOUT)
+				{
+					it = table.erase(it);
+					removed++;
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+		steps.push_back(duration_cast<nanoseconds>(steady_clock::now() - step_begin).count());
+	}
+	uint64_t total_ns = duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+	print_result("full scan:", nobjects, removed, total_ns, steps);
+
+	//
+	// Timing wheel, expiring at most 1024 objects per step
+	//
+	table = table_copy;
+	g_seed = 42;
+	libsinsp::timing_wheel<uint64_t> wheel(ONE_SECOND);
+	std::vector<uint64_t> expired;
+
+	// start the wheel clock
+	wheel.pop_expired(start, 0, expired);
+
+	begin = steady_clock::now();
+	for(auto& it : table)
+	{
+		wheel.schedule(it.first, it.second.m_lastaccess_ts + TIMEOUT);
+	}
+	uint64_t schedule_ns = duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+
+	steps.clear();
+	removed = 0;
+	begin = steady_clock::now();
+	for(uint32_t s = 0; s < STEPS; s++)
+	{
+		uint64_t now = start + s * ONE_SECOND;
+		for(uint32_t t = 0; t < TOUCHES_PER_STEP; t++)
+		{
+			auto it = table.find(next_rand() % nobjects);
+			if(it != table.end())
+			{
+				it->second.m_lastaccess_ts = now;
+			}
+		}
+
+		auto step_begin = steady_clock::now();
+		expired.clear();
+		if(wheel.pop_expired(now, 1024, expired) != 0)
+		{
+			for(auto id : expired)
+			{
+				auto it = table.find(id);
+				if(it == table.end())
+				{
+					continue;
+				}
+
+				if(now > it->second.m_lastaccess_ts + TIMEOUT)
+				{
+					table.erase(it);
+					removed++;
+				}
+				else
+				{
+					wheel.schedule(id, it->second.m_lastaccess_ts + TIMEOUT);
+				}
+			}
+		}
+		steps.push_back(duration_cast<nanoseconds>(steady_clock::now() - step_begin).count());
+	}
+	total_ns = duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+	print_result("timing wheel:", nobjects, removed, total_ns, steps);
+	printf("initial schedule of %u objects: %lums\n", nobjects, schedule_ns / 1000000);
+
+	return 0;
+}
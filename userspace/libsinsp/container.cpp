@@ -16,6 +16,7 @@ limitations under the License.
 */
 
 #include <algorithm>
+#include <chrono>
 
 #ifdef HAS_CAPTURE
 #include "container_engine/cri.h"
@@ -42,12 +43,17 @@ using namespace libsinsp;
 
 sinsp_container_manager::sinsp_container_manager(sinsp* inspector, bool static_container, const std::string static_id, const std::string static_name, const std::string static_image) :
 	m_inspector(inspector),
-	m_last_flush_time_ns(0),
+	m_expiry_wheel(ONE_SECOND_IN_NS),
 	m_static_container(static_container),
 	m_static_id(static_id),
 	m_static_name(static_name),
 	m_static_image(static_image)
 {
+	sinsp_metrics_registry& metrics = sinsp_metrics_registry::get();
+	m_metric_added = &metrics.counter("sinsp_containers_added", "Containers added to the container table");
+	m_metric_removed = &metrics.counter("sinsp_containers_removed", "Inactive containers removed from the container table");
+	m_metric_containers = &metrics.gauge("sinsp_containers", "Containers in the container table");
+	m_metric_resolve_ns = &metrics.histogram("sinsp_container_resolve_ns", "Time to match a thread with the container engines, in ns");
 }
 
 sinsp_container_manager::~sinsp_container_manager()
@@ -58,52 +64,85 @@ bool sinsp_container_manager::remove_inactive_containers()
 {
 	bool res = false;
 
-	if(m_last_flush_time_ns == 0)
+	m_expired_containers.clear();
+	if(m_expiry_wheel.pop_expired(m_inspector->m_lastevent_ts, m_inspector->m_thread_purge_batch_size, m_expired_containers) == 0)
 	{
-		m_last_flush_time_ns = m_inspector->m_lastevent_ts - m_inspector->m_inactive_container_scan_time_ns + 30 * ONE_SECOND_IN_NS;
+		return res;
 	}
 
-	if(m_inspector->m_lastevent_ts >
-		m_last_flush_time_ns + m_inspector->m_inactive_container_scan_time_ns)
+	auto containers = m_containers.lock();
+	for(const auto& container_id : m_expired_containers)
 	{
+		//
+		// Some thread joined the container during the grace period
+		//
+		auto refs = m_thread_refs.find(container_id);
+		if(refs != m_thread_refs.end() && refs->second != 0)
+		{
+			continue;
+		}
+
+		auto it = containers->find(container_id);
+		if(it == containers->end())
+		{
+			continue;
+		}
+
+		g_logger.format(sinsp_logger::SEV_DEBUG, "Removing inactive container %s", container_id.c_str());
+
+		sinsp_container_info::ptr_t container = it->second;
+		for(const auto &remove_cb : m_remove_callbacks)
+		{
+			remove_cb(*container);
+		}
+		containers->erase(it);
+		m_metric_removed->add();
 		res = true;
+	}
 
-		m_last_flush_time_ns = m_inspector->m_lastevent_ts;
+	m_metric_containers->set(containers->size());
 
-		g_logger.format(sinsp_logger::SEV_INFO, "Flushing container table");
+	return res;
+}
 
-		set<string> containers_in_use;
+void sinsp_container_manager::add_thread_ref(const std::string& container_id)
+{
+	if(!container_id.empty())
+	{
+		m_thread_refs[container_id]++;
+	}
+}
 
-		threadinfo_map_t* threadtable = m_inspector->m_thread_manager->get_threads();
+void sinsp_container_manager::remove_thread_ref(const std::string& container_id)
+{
+	if(container_id.empty())
+	{
+		return;
+	}
 
-		threadtable->loop([&] (const sinsp_threadinfo& tinfo) {
-			if(!tinfo.m_container_id.empty())
-			{
-				containers_in_use.insert(tinfo.m_container_id);
-			}
-			return true;
-		});
+	auto it = m_thread_refs.find(container_id);
+	if(it == m_thread_refs.end())
+	{
+		ASSERT(false);
+		return;
+	}
 
-		auto containers = m_containers.lock();
-		for(auto it = containers->begin(); it != containers->end();)
-		{
-			if(containers_in_use.find(it->first) == containers_in_use.end())
-			{
-				sinsp_container_info::ptr_t container = it->second;
-				for(const auto &remove_cb : m_remove_callbacks)
-				{
-					remove_cb(*container);
-				}
-				containers->erase(it++);
-			}
-			else
-			{
-				++it;
-			}
-		}
+	if(--it->second == 0)
+	{
+		m_thread_refs.erase(it);
+		m_expiry_wheel.schedule(container_id, m_inspector->m_lastevent_ts + m_inspector->m_inactive_container_scan_time_ns);
 	}
+}
 
-	return res;
+void sinsp_container_manager::clear_thread_refs()
+{
+	m_thread_refs.clear();
+}
+
+uint32_t sinsp_container_manager::get_thread_refs(const std::string& container_id) const
+{
+	auto it = m_thread_refs.find(container_id);
+	return it != m_thread_refs.end() ? it->second : 0;
 }
 
 sinsp_container_info::ptr_t sinsp_container_manager::get_container(const string& container_id) const
@@ -122,6 +161,18 @@ bool sinsp_container_manager::resolve_container(sinsp_threadinfo* tinfo, bool qu
 {
 	ASSERT(tinfo);
 	bool matches = false;
+	auto start = std::chrono::steady_clock::now();
+
+	//
+	// Threads that are already in the thread table might move to a
+	// different container (e.g. on execve), keep the refcounts right
+	//
+	bool in_table = m_inspector->m_thread_manager->get_threads()->get(tinfo->m_tid) == tinfo;
+	std::string old_container_id;
+	if(in_table)
+	{
+		old_container_id = tinfo->m_container_id;
+	}
 
 	tinfo->m_container_id = "";
 	if (m_inspector->m_parser->m_fd_listener)
@@ -149,6 +200,15 @@ bool sinsp_container_manager::resolve_container(sinsp_threadinfo* tinfo, bool qu
 	// Also possibly set the category for the threadinfo
 	identify_category(tinfo);
 
+	if(in_table && old_container_id != tinfo->m_container_id)
+	{
+		add_thread_ref(tinfo->m_container_id);
+		remove_thread_ref(old_container_id);
+	}
+
+	m_metric_resolve_ns->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count());
+
 	return matches;
 }
 
@@ -302,6 +362,17 @@ void sinsp_container_manager::add_container(const sinsp_container_info::ptr_t& c
 	{
 		auto containers = m_containers.lock();
 		(*containers)[container_info->m_id] = container_info;
+		m_metric_containers->set(containers->size());
+	}
+	m_metric_added->add();
+
+	//
+	// Containers learnt before any of their threads (e.g. from the
+	// capture) go away if no thread shows up
+	//
+	if(m_thread_refs.find(container_info->m_id) == m_thread_refs.end())
+	{
+		m_expiry_wheel.schedule(container_info->m_id, m_inspector->m_lastevent_ts + m_inspector->m_inactive_container_scan_time_ns);
 	}
 
 	for(const auto &new_cb : m_new_callbacks)
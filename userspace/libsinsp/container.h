@@ -35,7 +35,9 @@ limitations under the License.
 #include "container_engine/container_cache_interface.h"
 #include "container_engine/container_engine_base.h"
 #include "container_engine/sinsp_container_type.h"
+#include "metrics.h"
 #include "mutex.h"
+#include "timing_wheel.h"
 
 class sinsp_container_manager :
 	public libsinsp::container_engine::container_cache_interface
@@ -63,8 +65,28 @@ public:
 	 * @return the map of container_id -> shared_ptr<container_info>
 	 */
 	map_ptr_t get_containers() const;
+
+	/**
+	 * @brief Remove the containers that have had no threads for
+	 * m_inactive_container_scan_time_ns
+	 *
+	 * Only the containers whose last thread went away are checked, so
+	 * this doesn't depend on the size of the thread table
+	 *
+	 * @return true if some container was removed
+	 */
 	bool remove_inactive_containers();
 
+	/**
+	 * @brief Keep track of the threads in the thread table that belong to
+	 * a container. Called by the thread manager when threads are added to
+	 * and removed from the table, or change container.
+	 */
+	void add_thread_ref(const std::string& container_id);
+	void remove_thread_ref(const std::string& container_id);
+	void clear_thread_refs();
+	uint32_t get_thread_refs(const std::string& container_id) const;
+
 	/**
 	 * @brief Add/update a container in the manager map, executing on_new_container callbacks
 	 *
@@ -204,10 +226,19 @@ private:
 	sinsp* m_inspector;
 	libsinsp::Mutex<std::unordered_map<std::string, std::shared_ptr<const sinsp_container_info>>> m_containers;
 	std::unordered_map<std::string, std::unordered_map<sinsp_container_type, sinsp_container_lookup_state>> m_lookups;
-	uint64_t m_last_flush_time_ns;
+	// number of threads in the thread table for each container
+	std::unordered_map<std::string, uint32_t> m_thread_refs;
+	// containers left with no threads, checked when their grace period expires
+	libsinsp::timing_wheel<std::string> m_expiry_wheel;
+	std::vector<std::string> m_expired_containers;
 	std::list<new_container_cb> m_new_callbacks;
 	std::list<remove_container_cb> m_remove_callbacks;
 
+	sinsp_metric_counter* m_metric_added;
+	sinsp_metric_counter* m_metric_removed;
+	sinsp_metric_gauge* m_metric_containers;
+	sinsp_metric_histogram* m_metric_resolve_ns;
+
 	// indicates whether we should use only the static container engine, or the other engines.
 	// if true, we expect to have the subsequent bits of metadata as well. If this bool is false,
 	// then the values of those metadata are undefined
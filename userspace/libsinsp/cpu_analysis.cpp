@@ -0,0 +1,242 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string.h>
+
+#include "cpu_analysis.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+sinsp_cpu_analysis_record::sinsp_cpu_analysis_record():
+	m_start_ts(0),
+	m_end_ts(0),
+	m_nintervals(0),
+	m_time_specs(NULL),
+	m_runq(NULL),
+	m_nrunq(0),
+	m_time_types(NULL)
+{
+}
+
+bool sinsp_cpu_analysis_record::init(sinsp_evt* evt)
+{
+	m_nintervals = 0;
+
+	if(evt->get_type() != PPME_CPU_ANALYSIS_E || evt->get_num_params() < 6)
+	{
+		return false;
+	}
+
+	sinsp_evt_param* start_ts = evt->get_param(0);
+	sinsp_evt_param* end_ts = evt->get_param(1);
+	sinsp_evt_param* cnt = evt->get_param(2);
+	sinsp_evt_param* time_specs = evt->get_param(3);
+	sinsp_evt_param* runq = evt->get_param(4);
+	sinsp_evt_param* time_types = evt->get_param(5);
+
+	if(start_ts->m_len != sizeof(uint64_t) ||
+	   end_ts->m_len != sizeof(uint64_t) ||
+	   cnt->m_len != sizeof(uint32_t))
+	{
+		return false;
+	}
+
+	uint32_t nintervals = *(uint32_t*)cnt->m_val;
+	if(time_specs->m_len / sizeof(uint64_t) < nintervals ||
+	   time_types->m_len < nintervals ||
+	   runq->m_len / sizeof(uint64_t) < nintervals / 2)
+	{
+		return false;
+	}
+
+	m_start_ts = *(uint64_t*)start_ts->m_val;
+	m_end_ts = *(uint64_t*)end_ts->m_val;
+	m_time_specs = time_specs->m_val;
+	m_runq = runq->m_val;
+	m_nrunq = runq->m_len / sizeof(uint64_t);
+	m_time_types = (const uint8_t*)time_types->m_val;
+	m_nintervals = nintervals;
+	return true;
+}
+
+sinsp_cpu_interval sinsp_cpu_analysis_record::get(uint32_t j) const
+{
+	sinsp_cpu_interval res;
+
+	ASSERT(j < m_nintervals);
+
+	//
+	// The buffers come straight from the ring, don't assume alignment
+	//
+	memcpy(&res.m_duration_ns, m_time_specs + j * sizeof(uint64_t), sizeof(uint64_t));
+	res.m_runq_ns = 0;
+
+	uint8_t type = m_time_types[j];
+	if(type == CPU_TIME_ON)
+	{
+		res.m_type = CPU_TIME_ON;
+		return res;
+	}
+
+	res.m_type = type < CPU_TIME_RUNQ ? (sinsp_cpu_time_type)type : CPU_TIME_OTHER;
+
+	if(j / 2 < m_nrunq)
+	{
+		uint64_t runq_us;
+		memcpy(&runq_us, m_runq + (j / 2) * sizeof(uint64_t), sizeof(uint64_t));
+		res.m_runq_ns = runq_us * 1000;
+		if(res.m_runq_ns > res.m_duration_ns)
+		{
+			res.m_runq_ns = res.m_duration_ns;
+		}
+	}
+
+	return res;
+}
+
+void sinsp_cpu_time_breakdown::add(const sinsp_cpu_interval& interval)
+{
+	if(interval.m_type == CPU_TIME_ON)
+	{
+		m_time_ns[CPU_TIME_ON] += interval.m_duration_ns;
+	}
+	else
+	{
+		m_time_ns[CPU_TIME_RUNQ] += interval.m_runq_ns;
+		m_time_ns[interval.m_type] += interval.m_duration_ns - interval.m_runq_ns;
+	}
+
+	m_nintervals++;
+}
+
+uint64_t sinsp_cpu_time_breakdown::offcpu_ns() const
+{
+	uint64_t res = 0;
+
+	for(uint32_t j = CPU_TIME_ON + 1; j < CPU_TIME_MAX; j++)
+	{
+		res += m_time_ns[j];
+	}
+
+	return res;
+}
+
+sinsp_cpu_analysis_table::sinsp_cpu_analysis_table(uint64_t max_threads, uint64_t idle_timeout_ns):
+	m_max_threads(max_threads),
+	m_idle_timeout_ns(idle_timeout_ns),
+	m_next_purge_ts(0)
+{
+}
+
+bool sinsp_cpu_analysis_table::process_event(sinsp_evt* evt, const std::string& container_id)
+{
+	sinsp_cpu_analysis_record record;
+
+	if(!record.init(evt))
+	{
+		return false;
+	}
+
+	sinsp_cpu_time_breakdown* thread = NULL;
+	int64_t tid = evt->get_tid();
+	auto it = m_threads.find(tid);
+
+	if(it != m_threads.end())
+	{
+		thread = &it->second;
+	}
+	else if(m_threads.size() < m_max_threads)
+	{
+		thread = &m_threads[tid];
+		memset(thread, 0, sizeof(*thread));
+	}
+
+	auto cit = m_containers.find(container_id);
+	if(cit == m_containers.end())
+	{
+		cit = m_containers.emplace(container_id, sinsp_cpu_time_breakdown()).first;
+		memset(&cit->second, 0, sizeof(cit->second));
+	}
+	sinsp_cpu_time_breakdown* container = &cit->second;
+
+	for(uint32_t j = 0; j < record.size(); j++)
+	{
+		sinsp_cpu_interval interval = record.get(j);
+
+		if(thread != NULL)
+		{
+			thread->add(interval);
+		}
+		container->add(interval);
+	}
+
+	if(thread != NULL)
+	{
+		thread->m_last_ts = evt->get_ts();
+	}
+	container->m_last_ts = evt->get_ts();
+
+	return true;
+}
+
+const sinsp_cpu_time_breakdown* sinsp_cpu_analysis_table::find_thread(int64_t tid) const
+{
+	auto it = m_threads.find(tid);
+
+	if(it == m_threads.end())
+	{
+		return NULL;
+	}
+
+	return &it->second;
+}
+
+const sinsp_cpu_time_breakdown* sinsp_cpu_analysis_table::find_container(const std::string& container_id) const
+{
+	auto it = m_containers.find(container_id);
+
+	if(it == m_containers.end())
+	{
+		return NULL;
+	}
+
+	return &it->second;
+}
+
+void sinsp_cpu_analysis_table::purge(uint64_t ts)
+{
+	bool first = m_next_purge_ts == 0;
+
+	m_next_purge_ts = ts + m_idle_timeout_ns;
+
+	if(first)
+	{
+		return;
+	}
+
+	for(auto it = m_threads.begin(); it != m_threads.end();)
+	{
+		if(it->second.m_last_ts + m_idle_timeout_ns < ts)
+		{
+			it = m_threads.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
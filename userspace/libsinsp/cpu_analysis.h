@@ -0,0 +1,180 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "sinsp_public.h"
+
+class sinsp_evt;
+
+/*!
+  \brief Where a thread spent an interval. The values up to
+  CPU_TIME_EPOLL are the ones of enum offcpu_type in the BPF probe,
+  CPU_TIME_RUNQ is the part of an off-CPU interval spent waiting for a
+  CPU after the wakeup.
+*/
+enum sinsp_cpu_time_type
+{
+	CPU_TIME_ON = 0,
+	CPU_TIME_DISK = 1,
+	CPU_TIME_NET = 2,
+	CPU_TIME_LOCK = 3,
+	CPU_TIME_IDLE = 4,
+	CPU_TIME_OTHER = 5,
+	CPU_TIME_EPOLL = 6,
+	CPU_TIME_RUNQ = 7,
+	CPU_TIME_MAX = 8,
+};
+
+/*!
+  \brief One on-CPU or off-CPU interval of a cpu_analysis event
+*/
+struct sinsp_cpu_interval
+{
+	sinsp_cpu_time_type m_type;
+	uint64_t m_duration_ns;
+	uint64_t m_runq_ns; ///< Off-CPU only, included in m_duration_ns
+};
+
+/*!
+  \brief Decoder of the PPME_CPU_ANALYSIS_E buffers.
+
+  The event carries the struct info_t arrays of the BPF cpu_records map:
+  time_specs has the duration of every interval in ns, time_type its
+  type (CPU_TIME_ON for on-CPU intervals) and runq_latency the run queue
+  latency in us of the off-CPU interval at index j, in slot j / 2.
+
+  The record is a view: it points into the event buffer and decodes an
+  interval when asked for it, so it is valid only as long as the event.
+*/
+class SINSP_PUBLIC sinsp_cpu_analysis_record
+{
+public:
+	sinsp_cpu_analysis_record();
+
+	/*!
+	  \return false if evt isn't a cpu_analysis event or its buffers are
+	  too short for its interval count.
+	*/
+	bool init(sinsp_evt* evt);
+
+	inline uint64_t get_start_ts() const
+	{
+		return m_start_ts;
+	}
+
+	inline uint64_t get_end_ts() const
+	{
+		return m_end_ts;
+	}
+
+	inline uint32_t size() const
+	{
+		return m_nintervals;
+	}
+
+	sinsp_cpu_interval get(uint32_t j) const;
+
+private:
+	uint64_t m_start_ts;
+	uint64_t m_end_ts;
+	uint32_t m_nintervals;
+	const char* m_time_specs;
+	const char* m_runq;
+	uint32_t m_nrunq;
+	const uint8_t* m_time_types;
+};
+
+/*!
+  \brief Time spent by a thread, or by all the threads of a container,
+  per sinsp_cpu_time_type
+*/
+struct sinsp_cpu_time_breakdown
+{
+	uint64_t m_time_ns[CPU_TIME_MAX];
+	uint64_t m_nintervals;
+	uint64_t m_last_ts;
+
+	void add(const sinsp_cpu_interval& interval);
+
+	inline uint64_t oncpu_ns() const
+	{
+		return m_time_ns[CPU_TIME_ON];
+	}
+
+	uint64_t offcpu_ns() const;
+};
+
+/*!
+  \brief Folds the cpu_analysis events into per thread and per container
+  breakdowns. The host threads are under the "" container.
+
+  Threads with no events for the idle timeout are removed, checked once
+  every timeout of event time. Containers are kept.
+*/
+class SINSP_PUBLIC sinsp_cpu_analysis_table
+{
+public:
+	typedef std::unordered_map<int64_t, sinsp_cpu_time_breakdown> thread_map_t;
+	typedef std::unordered_map<std::string, sinsp_cpu_time_breakdown> container_map_t;
+
+	/*!
+	  \param max_threads beyond this, new threads aren't tracked until
+	  the next purge, they still count in their container.
+	*/
+	sinsp_cpu_analysis_table(uint64_t max_threads = 64 * 1024,
+		uint64_t idle_timeout_ns = 60ULL * 1000000000);
+
+	/*!
+	  \return false if evt isn't a valid cpu_analysis event.
+	*/
+	bool process_event(sinsp_evt* evt, const std::string& container_id);
+
+	inline void on_ts(uint64_t ts)
+	{
+		if(ts >= m_next_purge_ts)
+		{
+			purge(ts);
+		}
+	}
+
+	const sinsp_cpu_time_breakdown* find_thread(int64_t tid) const;
+	const sinsp_cpu_time_breakdown* find_container(const std::string& container_id) const;
+
+	inline const thread_map_t& get_threads() const
+	{
+		return m_threads;
+	}
+
+	inline const container_map_t& get_containers() const
+	{
+		return m_containers;
+	}
+
+private:
+	void purge(uint64_t ts);
+
+	thread_map_t m_threads;
+	container_map_t m_containers;
+	uint64_t m_max_threads;
+	uint64_t m_idle_timeout_ns;
+	uint64_t m_next_purge_ts;
+};
@@ -0,0 +1,474 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "db_transaction.h"
+
+static const char* s_protocol_names[SINSP_DB_MAX_PROTOCOL] =
+{
+	"mysql",
+	"pgsql",
+	"redis",
+	"kafka",
+};
+
+static const char* s_mysql_commands[] =
+{
+	"COM_SLEEP", "COM_QUIT", "COM_INIT_DB", "COM_QUERY", "COM_FIELD_LIST",
+	"COM_CREATE_DB", "COM_DROP_DB", "COM_REFRESH", "COM_SHUTDOWN", "COM_STATISTICS",
+	"COM_PROCESS_INFO", "COM_CONNECT", "COM_PROCESS_KILL", "COM_DEBUG", "COM_PING",
+	"COM_TIME", "COM_DELAYED_INSERT", "COM_CHANGE_USER", "COM_BINLOG_DUMP", "COM_TABLE_DUMP",
+	"COM_CONNECT_OUT", "COM_REGISTER_SLAVE", "COM_STMT_PREPARE", "COM_STMT_EXECUTE", "COM_STMT_SEND_LONG_DATA",
+	"COM_STMT_CLOSE", "COM_STMT_RESET", "COM_SET_OPTION", "COM_STMT_FETCH", "COM_DAEMON",
+	"COM_BINLOG_DUMP_GTID", "COM_RESET_CONNECTION",
+};
+
+#define MYSQL_COM_QUIT 0x01
+#define MYSQL_COM_STMT_SEND_LONG_DATA 0x18
+#define MYSQL_COM_STMT_CLOSE 0x19
+
+static const char* s_kafka_apis[] =
+{
+	"Produce", "Fetch", "ListOffsets", "Metadata", "LeaderAndIsr",
+	"StopReplica", "UpdateMetadata", "ControlledShutdown", "OffsetCommit", "OffsetFetch",
+	"FindCoordinator", "JoinGroup", "Heartbeat", "LeaveGroup", "SyncGroup",
+	"DescribeGroups", "ListGroups", "SaslHandshake", "ApiVersions", "CreateTopics",
+	"DeleteTopics", "DeleteRecords", "InitProducerId", "OffsetForLeaderEpoch", "AddPartitionsToTxn",
+	"AddOffsetsToTxn", "EndTxn", "WriteTxnMarkers", "TxnOffsetCommit", "DescribeAcls",
+	"CreateAcls", "DeleteAcls", "DescribeConfigs", "AlterConfigs",
+};
+
+#define KAFKA_MAX_API_KEY 100
+#define KAFKA_MAX_API_VERSION 32
+
+static inline uint32_t read_be32(const char* p)
+{
+	const uint8_t* b = (const uint8_t*)p;
+	return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+static inline uint16_t read_be16(const char* p)
+{
+	const uint8_t* b = (const uint8_t*)p;
+	return (uint16_t)((b[0] << 8) | b[1]);
+}
+
+static inline void set_op(char* dst, const char* src, uint32_t len)
+{
+	if(len >= sinsp_db_transaction::MAX_OP_LEN)
+	{
+		len = sinsp_db_transaction::MAX_OP_LEN - 1;
+	}
+	memcpy(dst, src, len);
+	dst[len] = 0;
+}
+
+sinsp_db_conn::sinsp_db_conn(sinsp_db_protocol protocol, bool is_server):
+	m_protocol(protocol),
+	m_is_server(is_server),
+	m_head(0),
+	m_ninflight(0)
+{
+}
+
+const char* sinsp_db_conn::protocol_name(sinsp_db_protocol protocol)
+{
+	return protocol < SINSP_DB_MAX_PROTOCOL ? s_protocol_names[protocol] : "<NA>";
+}
+
+bool sinsp_db_conn::on_data(bool is_read, uint64_t ts, const char* data, uint32_t datalen, uint64_t size, sinsp_db_transaction* tr)
+{
+	if(is_read == m_is_server)
+	{
+		//
+		// A PostgreSQL extended query is made of several messages (Parse,
+		// Bind, Execute, Sync...) that may be sent with separate writes
+		// before the server answers: they are all the same request
+		//
+		request req;
+		bool coalesce = (m_protocol == SINSP_DB_PGSQL && m_ninflight != 0);
+
+		if(!coalesce && parse_request(data, datalen, &req))
+		{
+			if(m_ninflight == MAX_INFLIGHT)
+			{
+				// the oldest request lost its response
+				m_head = (m_head + 1) % MAX_INFLIGHT;
+				m_ninflight--;
+			}
+
+			req.m_ts = ts;
+			req.m_size = size;
+			inflight(m_ninflight++) = req;
+		}
+		else if(m_ninflight != 0)
+		{
+			inflight(m_ninflight - 1).m_size += size;
+		}
+
+		return false;
+	}
+
+	if(m_ninflight == 0)
+	{
+		return false;
+	}
+
+	response resp;
+	if(!parse_response(data, datalen, &resp))
+	{
+		return false;
+	}
+
+	//
+	// Responses come in order, so when they carry an id the requests
+	// before the matching one won't get an answer
+	//
+	uint32_t idx = 0;
+	if(resp.m_has_id)
+	{
+		while(idx < m_ninflight && inflight(idx).m_id != resp.m_id)
+		{
+			idx++;
+		}
+
+		if(idx == m_ninflight)
+		{
+			return false;
+		}
+	}
+
+	request& req = inflight(idx);
+	memcpy(tr->m_op, req.m_op, sizeof(tr->m_op));
+	tr->m_req_ts = req.m_ts;
+	tr->m_latency_ns = ts > req.m_ts ? ts - req.m_ts : 0;
+	tr->m_req_size = req.m_size;
+	tr->m_is_error = resp.m_is_error;
+	tr->m_error_code = resp.m_error_code;
+	tr->m_is_server = m_is_server;
+
+	m_head = (m_head + idx + 1) % MAX_INFLIGHT;
+	m_ninflight -= idx + 1;
+
+	return true;
+}
+
+bool sinsp_db_conn::parse_request(const char* data, uint32_t len, request* req)
+{
+	req->m_id = 0;
+
+	switch(m_protocol)
+	{
+	case SINSP_DB_MYSQL:
+		return parse_mysql_request(data, len, req);
+	case SINSP_DB_PGSQL:
+		return parse_pgsql_request(data, len, req);
+	case SINSP_DB_REDIS:
+		return parse_redis_request(data, len, req);
+	case SINSP_DB_KAFKA:
+		return parse_kafka_request(data, len, req);
+	default:
+		return false;
+	}
+}
+
+bool sinsp_db_conn::parse_response(const char* data, uint32_t len, response* resp)
+{
+	resp->m_id = 0;
+	resp->m_has_id = false;
+	resp->m_is_error = false;
+	resp->m_error_code = 0;
+
+	switch(m_protocol)
+	{
+	case SINSP_DB_MYSQL:
+		return parse_mysql_response(data, len, resp);
+	case SINSP_DB_PGSQL:
+		return parse_pgsql_response(data, len, resp);
+	case SINSP_DB_REDIS:
+		return parse_redis_response(data, len, resp);
+	case SINSP_DB_KAFKA:
+		return parse_kafka_response(data, len, resp);
+	default:
+		return false;
+	}
+}
+
+//
+// MySQL packets: 3 bytes of little endian length, 1 byte of sequence id.
+// Commands are the first packet (sequence 0) of the client, responses start
+// at sequence 1 with an OK (0x00), ERR (0xff) or a result set header.
+//
+bool sinsp_db_conn::parse_mysql_request(const char* data, uint32_t len, request* req)
+{
+	if(len < 5)
+	{
+		return false;
+	}
+
+	const uint8_t* b = (const uint8_t*)data;
+	uint32_t plen = b[0] | (b[1] << 8) | (b[2] << 16);
+	uint8_t cmd = b[4];
+
+	if(b[3] != 0 || plen == 0 || cmd >= sizeof(s_mysql_commands) / sizeof(s_mysql_commands[0]))
+	{
+		return false;
+	}
+
+	// these never get a response
+	if(cmd == MYSQL_COM_QUIT || cmd == MYSQL_COM_STMT_SEND_LONG_DATA || cmd == MYSQL_COM_STMT_CLOSE)
+	{
+		return false;
+	}
+
+	set_op(req->m_op, s_mysql_commands[cmd], strlen(s_mysql_commands[cmd]));
+	return true;
+}
+
+bool sinsp_db_conn::parse_mysql_response(const char* data, uint32_t len, response* resp)
+{
+	if(len < 5)
+	{
+		return false;
+	}
+
+	const uint8_t* b = (const uint8_t*)data;
+	uint32_t plen = b[0] | (b[1] << 8) | (b[2] << 16);
+
+	if(b[3] == 0 || plen == 0)
+	{
+		return false;
+	}
+
+	if(b[4] == 0xff)
+	{
+		resp->m_is_error = true;
+		if(len >= 7)
+		{
+			resp->m_error_code = b[5] | (b[6] << 8);
+		}
+	}
+
+	return true;
+}
+
+//
+// PostgreSQL messages: 1 byte of type and 4 bytes of big endian length
+// (that counts itself). The startup message has no type and is ignored.
+//
+bool sinsp_db_conn::parse_pgsql_request(const char* data, uint32_t len, request* req)
+{
+	if(len < 5 || read_be32(data + 1) < 4)
+	{
+		return false;
+	}
+
+	const char* op;
+	switch(data[0])
+	{
+	case 'Q': op = "Query"; break;
+	case 'P': op = "Parse"; break;
+	case 'B': op = "Bind"; break;
+	case 'E': op = "Execute"; break;
+	case 'D': op = "Describe"; break;
+	case 'C': op = "Close"; break;
+	case 'F': op = "FunctionCall"; break;
+	case 'S': op = "Sync"; break;
+	default:
+		return false;
+	}
+
+	set_op(req->m_op, op, strlen(op));
+	return true;
+}
+
+bool sinsp_db_conn::parse_pgsql_response(const char* data, uint32_t len, response* resp)
+{
+	if(len < 5 || read_be32(data + 1) < 4)
+	{
+		return false;
+	}
+
+	//
+	// Notices, notifications and parameter status messages can be sent
+	// at any time and don't answer anything
+	//
+	if(strchr("123CDEGHITVWZcdnst", data[0]) == NULL || data[0] == 0)
+	{
+		return false;
+	}
+
+	// look for an ErrorResponse among the messages in the buffer
+	uint32_t pos = 0;
+	while(pos + 5 <= len)
+	{
+		uint32_t mlen = read_be32(data + pos + 1);
+		if(data[pos] == 'E')
+		{
+			resp->m_is_error = true;
+			break;
+		}
+
+		//
+		// The length comes from the payload: stop at a bogus one or at a
+		// message that continues past the end of the buffer
+		//
+		if(mlen < 4 || (uint64_t)mlen > (uint64_t)len - pos - 1)
+		{
+			break;
+		}
+		pos += 1 + mlen;
+	}
+
+	return true;
+}
+
+//
+// Redis RESP: commands are arrays of bulk strings ("*2\r\n$3\r\nGET\r\n...")
+// or inline commands, replies start with a type byte.
+//
+bool sinsp_db_conn::parse_redis_request(const char* data, uint32_t len, request* req)
+{
+	if(len < 2)
+	{
+		return false;
+	}
+
+	if(data[0] == '*')
+	{
+		uint32_t pos = 1;
+		while(pos < len && data[pos] >= '0' && data[pos] <= '9')
+		{
+			pos++;
+		}
+
+		if(pos == 1 || pos + 3 > len || data[pos] != '\r' || data[pos + 1] != '\n' || data[pos + 2] != '$')
+		{
+			return false;
+		}
+
+		pos += 3;
+		uint32_t namelen = 0;
+		while(pos < len && data[pos] >= '0' && data[pos] <= '9')
+		{
+			namelen = namelen * 10 + (data[pos] - '0');
+			pos++;
+		}
+
+		if(pos + 2 > len || data[pos] != '\r' || data[pos + 1] != '\n')
+		{
+			return false;
+		}
+		pos += 2;
+
+		if(namelen > len - pos)
+		{
+			// truncated by the snaplen
+			namelen = len - pos;
+		}
+
+		set_op(req->m_op, data + pos, namelen);
+	}
+	else
+	{
+		uint32_t namelen = 0;
+		while(namelen < len && namelen < sinsp_db_transaction::MAX_OP_LEN &&
+		      ((data[namelen] >= 'a' && data[namelen] <= 'z') || (data[namelen] >= 'A' && data[namelen] <= 'Z')))
+		{
+			namelen++;
+		}
+
+		if(namelen == 0 || namelen == len || (data[namelen] != ' ' && data[namelen] != '\r'))
+		{
+			return false;
+		}
+
+		set_op(req->m_op, data, namelen);
+	}
+
+	for(char* p = req->m_op; *p != 0; p++)
+	{
+		if(*p >= 'a' && *p <= 'z')
+		{
+			*p -= 'a' - 'A';
+		}
+	}
+
+	return true;
+}
+
+bool sinsp_db_conn::parse_redis_response(const char* data, uint32_t len, response* resp)
+{
+	// '>' are RESP3 out of band pushes
+	if(len < 1 || data[0] == 0 || strchr("+-:$*_,#!=(%~|", data[0]) == NULL)
+	{
+		return false;
+	}
+
+	resp->m_is_error = (data[0] == '-' || data[0] == '!');
+	return true;
+}
+
+//
+// Kafka: 4 bytes of big endian size, then api key, api version and
+// correlation id for requests, the correlation id for responses.
+//
+bool sinsp_db_conn::parse_kafka_request(const char* data, uint32_t len, request* req)
+{
+	if(len < 12 || read_be32(data) < 8)
+	{
+		return false;
+	}
+
+	uint16_t api_key = read_be16(data + 4);
+	uint16_t api_version = read_be16(data + 6);
+	if(api_key >= KAFKA_MAX_API_KEY || api_version >= KAFKA_MAX_API_VERSION)
+	{
+		return false;
+	}
+
+	//
+	// Produce requests with acks=0 get no response, they'll be dropped
+	// when the next response arrives
+	//
+	if(api_key < sizeof(s_kafka_apis) / sizeof(s_kafka_apis[0]))
+	{
+		set_op(req->m_op, s_kafka_apis[api_key], strlen(s_kafka_apis[api_key]));
+	}
+	else
+	{
+		char op[sinsp_db_transaction::MAX_OP_LEN];
+		int n = snprintf(op, sizeof(op), "api%u", api_key);
+		set_op(req->m_op, op, n);
+	}
+
+	req->m_id = read_be32(data + 8);
+	return true;
+}
+
+bool sinsp_db_conn::parse_kafka_response(const char* data, uint32_t len, response* resp)
+{
+	if(len < 8 || read_be32(data) < 4)
+	{
+		return false;
+	}
+
+	resp->m_id = read_be32(data + 4);
+	resp->m_has_id = true;
+	return true;
+}
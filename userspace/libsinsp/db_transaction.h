@@ -0,0 +1,129 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+//
+// Wire protocols understood by sinsp_db_conn
+//
+enum sinsp_db_protocol
+{
+	SINSP_DB_MYSQL = 0,
+	SINSP_DB_PGSQL,
+	SINSP_DB_REDIS,
+	SINSP_DB_KAFKA,
+	SINSP_DB_MAX_PROTOCOL
+};
+
+/*!
+  \brief A request paired with the first buffer of its response.
+*/
+struct sinsp_db_transaction
+{
+	static const uint32_t MAX_OP_LEN = 24;
+
+	char m_op[MAX_OP_LEN]; ///< Command, e.g. COM_QUERY, Parse, GET, Produce
+	uint64_t m_req_ts; ///< Timestamp of the first request buffer
+	uint64_t m_latency_ns; ///< From the request to the first response buffer
+	uint64_t m_req_size; ///< Bytes sent for the request
+	bool m_is_error; ///< The response reports an error (not available for kafka)
+	int32_t m_error_code; ///< Protocol error code if any (MySQL errno), 0 otherwise
+	bool m_is_server; ///< True if the requests were read from the fd
+};
+
+/*!
+  \brief Streaming request/response tracker for the binary database and
+  messaging protocols.
+
+  Like sinsp_http_conn it's fed one read or write at a time and only looks
+  at the headers found at the beginning of the buffers, in place: nothing
+  from the payload is kept except a short command name. Requests waiting
+  for a response are kept in a small fixed ring.
+
+  Known approximations: several pipelined commands in the same buffer
+  count as one, and responses that don't start at the beginning of a
+  buffer are not seen.
+*/
+class sinsp_db_conn
+{
+public:
+	static const uint32_t MAX_INFLIGHT = 8;
+
+	sinsp_db_conn(sinsp_db_protocol protocol, bool is_server);
+
+	/*!
+	  \brief Process a buffer.
+
+	  \param is_read true if the data was read from the fd.
+	  \param ts event timestamp.
+	  \param data captured data, possibly truncated.
+	  \param datalen length of data.
+	  \param size bytes actually transferred by the syscall.
+	  \param tr filled when this buffer starts a response.
+
+	  \return true if tr has been filled.
+	*/
+	bool on_data(bool is_read, uint64_t ts, const char* data, uint32_t datalen, uint64_t size, sinsp_db_transaction* tr);
+
+	static const char* protocol_name(sinsp_db_protocol protocol);
+
+private:
+	struct request
+	{
+		char m_op[sinsp_db_transaction::MAX_OP_LEN];
+		uint32_t m_id;
+		uint64_t m_ts;
+		uint64_t m_size;
+	};
+
+	struct response
+	{
+		uint32_t m_id;
+		bool m_has_id;
+		bool m_is_error;
+		int32_t m_error_code;
+	};
+
+	//
+	// Protocol specific header parsing. parse_request returns false if
+	// the buffer doesn't start a request that gets a response.
+	//
+	bool parse_request(const char* data, uint32_t len, request* req);
+	bool parse_response(const char* data, uint32_t len, response* resp);
+
+	static bool parse_mysql_request(const char* data, uint32_t len, request* req);
+	static bool parse_mysql_response(const char* data, uint32_t len, response* resp);
+	static bool parse_pgsql_request(const char* data, uint32_t len, request* req);
+	static bool parse_pgsql_response(const char* data, uint32_t len, response* resp);
+	static bool parse_redis_request(const char* data, uint32_t len, request* req);
+	static bool parse_redis_response(const char* data, uint32_t len, response* resp);
+	static bool parse_kafka_request(const char* data, uint32_t len, request* req);
+	static bool parse_kafka_response(const char* data, uint32_t len, response* resp);
+
+	inline request& inflight(uint32_t j)
+	{
+		return m_inflight[(m_head + j) % MAX_INFLIGHT];
+	}
+
+	sinsp_db_protocol m_protocol;
+	bool m_is_server;
+	request m_inflight[MAX_INFLIGHT];
+	uint32_t m_head;
+	uint32_t m_ninflight;
+};
@@ -17,28 +17,57 @@ limitations under the License.
 
 #include "dns_manager.h"
 
+#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+static sinsp_metric_counter& s_metric_resolutions =
+	sinsp_metrics_registry::get().counter("sinsp_dns_resolutions", "Names resolved for the fd.*name filters");
+static sinsp_metric_counter& s_metric_failures =
+	sinsp_metrics_registry::get().counter("sinsp_dns_resolution_failures", "Names that failed to resolve");
+static sinsp_metric_histogram& s_metric_resolve_ns =
+	sinsp_metrics_registry::get().histogram("sinsp_dns_resolve_ns", "Time to resolve a name, in ns");
+static sinsp_metric_gauge& s_metric_names =
+	sinsp_metrics_registry::get().gauge("sinsp_dns_names", "Names in the DNS cache");
+#endif
+
 void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_timeout, uint64_t max_refresh_timeout, std::future<void> f_exit)
 {
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
 	sinsp_dns_manager &manager = sinsp_dns_manager::get();
+	std::vector<std::string> expired;
+	std::vector<std::pair<std::string, uint64_t>> to_schedule;
 	while(true)
 	{
-		if(!manager.m_cache.empty())
+		uint64_t ts = sinsp_utils::get_current_time_ns();
+
+		//
+		// Only look at the names that are due for a refresh or could
+		// have been unused for erase_timeout, not at the whole cache
+		//
+		expired.clear();
+		manager.m_erase_mutex.lock();
+		manager.m_expiry_wheel.pop_expired(ts, UINT32_MAX, expired);
+		manager.m_erase_mutex.unlock();
+
+		if(!expired.empty())
 		{
 			std::list<std::string> to_delete;
+			to_schedule.clear();
 
-			uint64_t ts = sinsp_utils::get_current_time_ns();
-
-			for(auto &it: manager.m_cache)
+			for(const auto &name : expired)
 			{
-				const std::string &name = it.first;
-				sinsp_dns_manager::dns_info &info = it.second;
+				auto it = manager.m_cache.find(name);
+				if(it == manager.m_cache.end())
+				{
+					continue;
+				}
+
+				sinsp_dns_manager::dns_info &info = it->second;
 
 				if((ts > info.m_last_used_ts) &&
 				   (ts - info.m_last_used_ts) > erase_timeout)
 				{
 					// remove the entry if it's hasn't been used for a whole hour
 					to_delete.push_back(name);
+					continue;
 				}
 				else if(ts > (info.m_last_resolve_ts + info.m_timeout))
 				{
@@ -59,16 +88,22 @@ void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_t
 						info.m_timeout <<= 1;
 					}
 				}
+
+				to_schedule.emplace_back(name, std::min(info.m_last_resolve_ts + info.m_timeout,
+									 info.m_last_used_ts + erase_timeout + 1));
 			}
-			if(!to_delete.empty())
+
+			manager.m_erase_mutex.lock();
+			for(const auto &name : to_delete)
 			{
-				manager.m_erase_mutex.lock();
-				for(const auto &name : to_delete)
-				{
-					manager.m_cache.unsafe_erase(name);
-				}
-				manager.m_erase_mutex.unlock();
+				manager.m_cache.unsafe_erase(name);
+			}
+			s_metric_names.set(manager.m_cache.size());
+			for(auto &it : to_schedule)
+			{
+				manager.m_expiry_wheel.schedule(std::move(it.first), it.second);
 			}
+			manager.m_erase_mutex.unlock();
 		}
 
 		if(f_exit.wait_for(std::chrono::nanoseconds(base_refresh_timeout)) == std::future_status::ready)
@@ -90,7 +125,12 @@ inline sinsp_dns_manager::dns_info sinsp_dns_manager::resolve(const std::string
 	// Allow IPv4 or IPv6, all socket types, all protocols
 	hints.ai_family = AF_UNSPEC;
 
+	auto start = std::chrono::steady_clock::now();
 	int s = getaddrinfo(name.c_str(), NULL, &hints, &result);
+	s_metric_resolve_ns.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count());
+	s_metric_resolutions.add();
+
 	if (!s && result)
 	{
 		for (rp = result; rp != NULL; rp = rp->ai_next)
@@ -108,6 +148,10 @@ inline sinsp_dns_manager::dns_info sinsp_dns_manager::resolve(const std::string
 		}
 		freeaddrinfo(result);
 	}
+	else
+	{
+		s_metric_failures.add();
+	}
 	return dinfo;
 }
 #endif
@@ -130,6 +174,8 @@ bool sinsp_dns_manager::match(const char *name, int af, void *addr, uint64_t ts)
 		dinfo.m_timeout = m_base_refresh_timeout;
 		dinfo.m_last_resolve_ts = ts;
 		m_cache[sname] = dinfo;
+		m_expiry_wheel.schedule(sname, ts + m_base_refresh_timeout);
+		s_metric_names.set(m_cache.size());
 	}
 
 	m_cache[sname].m_last_used_ts = ts;
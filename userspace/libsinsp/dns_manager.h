@@ -31,6 +31,7 @@ limitations under the License.
 #include "tbb/concurrent_unordered_map.h"
 #endif
 #include "sinsp.h"
+#include "timing_wheel.h"
 
 
 struct sinsp_dns_resolver
@@ -108,6 +109,9 @@ private:
 
 	typedef tbb::concurrent_unordered_map<std::string, dns_info> c_dns_table;
 	c_dns_table m_cache;
+
+	// names due for a refresh or an erase, protected by m_erase_mutex
+	libsinsp::timing_wheel<std::string> m_expiry_wheel{ONE_SECOND_IN_NS};
 #endif
 
 	// tbb concurrent unordered map is not thread-safe for deletions,
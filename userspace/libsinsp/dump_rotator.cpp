@@ -0,0 +1,161 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "dump_rotator.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+sinsp_dump_rotator::sinsp_dump_rotator():
+	m_in_progress(false),
+	m_n_rotations(0),
+	m_has_job(false),
+	m_done(false),
+	m_terminate(false),
+	m_result(NULL)
+{
+}
+
+sinsp_dump_rotator::~sinsp_dump_rotator()
+{
+	if(m_in_progress)
+	{
+		try
+		{
+			scap_dump_close(finish());
+		}
+		catch(const sinsp_exception& e)
+		{
+			g_logger.format(sinsp_logger::SEV_ERROR, "dump_rotator: %s", e.what());
+		}
+	}
+
+	if(m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_terminate = true;
+		}
+		m_cv.notify_all();
+		m_thread.join();
+	}
+}
+
+void sinsp_dump_rotator::start(scap_dumper_t* old_dumper, const std::string& fname, bool compress, scap_dumper_t* header)
+{
+	ASSERT(!m_in_progress);
+
+	if(!m_thread.joinable())
+	{
+		m_thread = std::thread(&sinsp_dump_rotator::run, this);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_job.m_old_dumper = old_dumper;
+		m_job.m_fname = fname;
+		m_job.m_compress = compress;
+		m_job.m_header = header;
+		m_has_job = true;
+		m_done = false;
+	}
+
+	m_cv.notify_all();
+	m_in_progress = true;
+}
+
+scap_dumper_t* sinsp_dump_rotator::try_finish()
+{
+	std::unique_lock<std::mutex> lock(m_mtx);
+
+	if(!m_done)
+	{
+		return NULL;
+	}
+
+	return complete(lock);
+}
+
+scap_dumper_t* sinsp_dump_rotator::finish()
+{
+	std::unique_lock<std::mutex> lock(m_mtx);
+
+	m_cv.wait(lock, [this] { return m_done; });
+
+	return complete(lock);
+}
+
+scap_dumper_t* sinsp_dump_rotator::complete(std::unique_lock<std::mutex>& lock)
+{
+	scap_dumper_t* res = m_result;
+	std::string error = m_error;
+
+	m_result = NULL;
+	m_done = false;
+	m_in_progress = false;
+	lock.unlock();
+
+	if(res == NULL)
+	{
+		throw sinsp_exception("cannot rotate the capture file: " + error);
+	}
+
+	m_n_rotations++;
+	return res;
+}
+
+void sinsp_dump_rotator::run()
+{
+	std::unique_lock<std::mutex> lock(m_mtx);
+
+	while(true)
+	{
+		m_cv.wait(lock, [this] { return m_has_job || m_terminate; });
+
+		if(m_terminate)
+		{
+			return;
+		}
+
+		job j = m_job;
+		m_has_job = false;
+		lock.unlock();
+
+		scap_dump_close(j.m_old_dumper);
+
+		//
+		// The header already has everything that goes before the
+		// events, so the capture handle is not needed here
+		//
+		char error[SCAP_LASTERR_SIZE] = "";
+		scap_dumper_t* res = scap_dump_open_headerless(j.m_fname.c_str(),
+			j.m_compress ? SCAP_COMPRESSION_GZIP : SCAP_COMPRESSION_NONE, error);
+
+		if(res != NULL && scap_dump_append_buf(res, j.m_header, error) != SCAP_SUCCESS)
+		{
+			scap_dump_close(res);
+			res = NULL;
+		}
+
+		scap_dump_close(j.m_header);
+
+		lock.lock();
+		m_result = res;
+		m_error = error;
+		m_done = true;
+		m_cv.notify_all();
+	}
+}
@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "scap.h"
+
+/*!
+  \brief Moves the slow parts of a capture file rotation to a helper thread.
+
+  start() hands over the file being written together with the header of
+  the next file, section header and tables, already serialized in memory
+  by the event thread. The helper thread closes the old file, which
+  flushes the compressor, then creates the new one and writes the header
+  in it. It never uses the capture handle. Meanwhile the event thread
+  keeps dumping into a memory buffer, which gets appended to the new file
+  once try_finish() returns it.
+*/
+class sinsp_dump_rotator
+{
+public:
+	sinsp_dump_rotator();
+	~sinsp_dump_rotator();
+
+	/*!
+	  \brief Start a rotation. Takes ownership of old_dumper and header,
+	  a managed buffer dumper with the beginning of the new file.
+	*/
+	void start(scap_dumper_t* old_dumper, const std::string& fname, bool compress, scap_dumper_t* header);
+
+	/*!
+	  \brief True from start() until the new file has been returned by
+	  try_finish() or finish(). Only for the event thread.
+	*/
+	inline bool in_progress() const
+	{
+		return m_in_progress;
+	}
+
+	/*!
+	  \brief Return the new file if it's ready, NULL otherwise.
+
+	  \note throws a sinsp_exception if the new file couldn't be created.
+	*/
+	scap_dumper_t* try_finish();
+
+	/*!
+	  \brief Wait for the new file and return it.
+
+	  \note throws a sinsp_exception if the new file couldn't be created.
+	*/
+	scap_dumper_t* finish();
+
+	/*!
+	  \brief Number of rotations completed so far
+	*/
+	uint64_t get_rotations() const
+	{
+		return m_n_rotations;
+	}
+
+private:
+	struct job
+	{
+		scap_dumper_t* m_old_dumper;
+		std::string m_fname;
+		bool m_compress;
+		scap_dumper_t* m_header;
+	};
+
+	void run();
+	scap_dumper_t* complete(std::unique_lock<std::mutex>& lock);
+
+	bool m_in_progress;
+	uint64_t m_n_rotations;
+
+	//
+	// Shared with the helper thread, protected by m_mtx
+	//
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_has_job;
+	bool m_done;
+	bool m_terminate;
+	job m_job;
+	scap_dumper_t* m_result;
+	std::string m_error;
+
+	std::thread m_thread;
+};
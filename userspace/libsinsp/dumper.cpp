@@ -142,6 +142,9 @@ void sinsp_dumper::dump(sinsp_evt* evt)
 
 	scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
 
+	sinsp_perf_monitor& perf = m_inspector->m_perf_monitor;
+	uint64_t start = perf.enabled() ? sinsp_perf_monitor::ticks() : 0;
+
 	int32_t res = scap_dump(m_inspector->m_h,
 		m_dumper, pdevt, evt->m_cpuid, 0);
 
@@ -150,6 +153,11 @@ void sinsp_dumper::dump(sinsp_evt* evt)
 		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
 	}
 
+	if(perf.enabled())
+	{
+		perf.add(SINSP_PERF_DUMPER, sinsp_perf_monitor::ticks() - start);
+	}
+
 	m_nevts++;
 }
 
@@ -529,6 +529,7 @@ VISIBILITY_PRIVATE
 	friend class sinsp_memory_dumper;
 	friend class sinsp_memory_dumper_job;
 	friend class protocol_manager;
+	friend class sinsp_sampling_profiler;
 	friend class test_helpers::event_builder;
 	friend class test_helpers::sinsp_mock;
 };
@@ -202,6 +202,20 @@ bool sinsp_evt_formatter::resolve_tokens(sinsp_evt *evt, map<string,string>& val
 
 
 bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
+{
+	sinsp_perf_monitor& perf = m_inspector->m_perf_monitor;
+	if(perf.enabled())
+	{
+		uint64_t start = sinsp_perf_monitor::ticks();
+		bool retval = tostring_int(evt, res);
+		perf.add(SINSP_PERF_FORMATTER, sinsp_perf_monitor::ticks() - start);
+		return retval;
+	}
+
+	return tostring_int(evt, res);
+}
+
+bool sinsp_evt_formatter::tostring_int(sinsp_evt* evt, OUT string* res)
 {
 	bool retval = true;
 	const filtercheck_field_info* fi;
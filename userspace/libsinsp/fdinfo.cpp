@@ -31,22 +31,20 @@ template<> sinsp_fdinfo_t::sinsp_fdinfo()
 {
 	m_type = SCAP_FD_UNINITIALIZED;
 	m_flags = FLAGS_NONE;
-	m_callbacks = NULL;
-	m_usrstate = NULL;
+	m_rare = NULL;
 }
 
 template<> void sinsp_fdinfo_t::reset()
 {
 	m_type = SCAP_FD_UNINITIALIZED;
 	m_flags = FLAGS_NONE;
-	delete(m_callbacks);
-	m_callbacks = NULL;
-	m_usrstate = NULL;
+	delete(m_rare);
+	m_rare = NULL;
 }
 
-template<> string* sinsp_fdinfo_t::tostring()
+template<> const string* sinsp_fdinfo_t::tostring()
 {
-	return &m_name;
+	return &m_name.str();
 }
 
 template<> char sinsp_fdinfo_t::get_typechar()
@@ -136,9 +134,67 @@ template<> string sinsp_fdinfo_t::tostring_clean()
 	return m_tstr;
 }
 
+template<> size_t sinsp_fdinfo_t::state_hash()
+{
+	//
+	// The ids of the interned names, unlike their pointers, are never
+	// reused. The fields are the ones of sinsp_threadinfo::fd_to_scap()
+	//
+	size_t h = std::hash<uint64_t>()(m_name.id());
+	auto add = [&h](uint64_t v) { hash_combine(h, v); };
+
+	add(m_type);
+	add(m_ino);
+	add(m_openflags);
+	add(m_dev);
+	add(m_mount_id);
+
+	switch(m_type)
+	{
+	case SCAP_FD_IPV4_SOCK:
+		add(m_sockinfo.m_ipv4info.m_fields.m_sip);
+		add(m_sockinfo.m_ipv4info.m_fields.m_dip);
+		add(m_sockinfo.m_ipv4info.m_fields.m_sport);
+		add(m_sockinfo.m_ipv4info.m_fields.m_dport);
+		add(m_sockinfo.m_ipv4info.m_fields.m_l4proto);
+		break;
+	case SCAP_FD_IPV4_SERVSOCK:
+		add(m_sockinfo.m_ipv4serverinfo.m_ip);
+		add(m_sockinfo.m_ipv4serverinfo.m_port);
+		add(m_sockinfo.m_ipv4serverinfo.m_l4proto);
+		break;
+	case SCAP_FD_IPV6_SOCK:
+		for(uint32_t j = 0; j < 4; j++)
+		{
+			add(m_sockinfo.m_ipv6info.m_fields.m_sip.m_b[j]);
+			add(m_sockinfo.m_ipv6info.m_fields.m_dip.m_b[j]);
+		}
+		add(m_sockinfo.m_ipv6info.m_fields.m_sport);
+		add(m_sockinfo.m_ipv6info.m_fields.m_dport);
+		add(m_sockinfo.m_ipv6info.m_fields.m_l4proto);
+		break;
+	case SCAP_FD_IPV6_SERVSOCK:
+		for(uint32_t j = 0; j < 4; j++)
+		{
+			add(m_sockinfo.m_ipv6serverinfo.m_ip.m_b[j]);
+		}
+		add(m_sockinfo.m_ipv6serverinfo.m_port);
+		add(m_sockinfo.m_ipv6serverinfo.m_l4proto);
+		break;
+	case SCAP_FD_UNIX_SOCK:
+		add(m_sockinfo.m_unixinfo.m_fields.m_source);
+		add(m_sockinfo.m_unixinfo.m_fields.m_dest);
+		break;
+	default:
+		break;
+	}
+
+	return h;
+}
+
 template<> void sinsp_fdinfo_t::add_filename(const char* fullpath)
 {
-	m_name = fullpath;
+	set_name(fullpath);
 }
 
 template<> bool sinsp_fdinfo_t::set_net_role_by_guessing(sinsp* inspector,
@@ -232,18 +288,26 @@ template<> scap_l4_proto sinsp_fdinfo_t::get_l4proto()
 
 template<> void sinsp_fdinfo_t::register_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec)
 {
-	if(this->m_callbacks == NULL)
-	{
-		m_callbacks = new fd_callbacks_info();
-	}
+	fd_callbacks_info* callbacks = create_callbacks();
 
+	//
+	// Registering twice would call the decoder twice for the same data
+	//
 	switch(etype)
 	{
 	case CT_READ:
-		m_callbacks->m_read_callbacks.push_back(dec);
+		if(std::find(callbacks->m_read_callbacks.begin(), callbacks->m_read_callbacks.end(), dec) ==
+		   callbacks->m_read_callbacks.end())
+		{
+			callbacks->m_read_callbacks.push_back(dec);
+		}
 		break;
 	case CT_WRITE:
-		m_callbacks->m_write_callbacks.push_back(dec);
+		if(std::find(callbacks->m_write_callbacks.begin(), callbacks->m_write_callbacks.end(), dec) ==
+		   callbacks->m_write_callbacks.end())
+		{
+			callbacks->m_write_callbacks.push_back(dec);
+		}
 		break;
 	default:
 		ASSERT(false);
@@ -256,8 +320,9 @@ template<> void sinsp_fdinfo_t::register_event_callback(sinsp_pd_callback_type e
 template<> void sinsp_fdinfo_t::unregister_event_callback(sinsp_pd_callback_type etype, sinsp_protodecoder* dec)
 {
 	vector<sinsp_protodecoder*>::iterator it;
+	fd_callbacks_info* callbacks = get_callbacks();
 
-	if(m_callbacks == NULL)
+	if(callbacks == NULL)
 	{
 		ASSERT(false);
 		return;
@@ -266,22 +331,22 @@ template<> void sinsp_fdinfo_t::unregister_event_callback(sinsp_pd_callback_type
 	switch(etype)
 	{
 	case CT_READ:
-		for(it = m_callbacks->m_read_callbacks.begin(); it != m_callbacks->m_read_callbacks.end(); ++it)
+		for(it = callbacks->m_read_callbacks.begin(); it != callbacks->m_read_callbacks.end(); ++it)
 		{
 			if(*it == dec)
 			{
-				m_callbacks->m_read_callbacks.erase(it);
+				callbacks->m_read_callbacks.erase(it);
 				return;
 			}
 		}
 
 		break;
 	case CT_WRITE:
-		for(it = m_callbacks->m_write_callbacks.begin(); it != m_callbacks->m_write_callbacks.end(); ++it)
+		for(it = callbacks->m_write_callbacks.begin(); it != callbacks->m_write_callbacks.end(); ++it)
 		{
 			if(*it == dec)
 			{
-				m_callbacks->m_write_callbacks.erase(it);
+				callbacks->m_write_callbacks.erase(it);
 				return;
 			}
 		}
@@ -298,6 +363,17 @@ template<> void sinsp_fdinfo_t::unregister_event_callback(sinsp_pd_callback_type
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_fdtable implementation
 ///////////////////////////////////////////////////////////////////////////////
+
+//
+// There's a table per process, so they all share the same metrics
+//
+static sinsp_metric_counter& s_metric_fds_added =
+	sinsp_metrics_registry::get().counter("sinsp_fds_added", "File descriptors added to the fd tables");
+static sinsp_metric_counter& s_metric_fds_removed =
+	sinsp_metrics_registry::get().counter("sinsp_fds_removed", "File descriptors removed from the fd tables");
+static sinsp_metric_counter& s_metric_fds_dropped =
+	sinsp_metrics_registry::get().counter("sinsp_fds_dropped", "File descriptors not added because their fd table was full");
+
 sinsp_fdtable::sinsp_fdtable(sinsp* inspector)
 {
 	m_inspector = inspector;
@@ -327,11 +403,13 @@ sinsp_fdinfo_t* sinsp_fdtable::add(int64_t fd, sinsp_fdinfo_t* fdinfo)
 #ifdef GATHER_INTERNAL_STATS
 			m_inspector->m_stats.m_n_added_fds++;
 #endif
+			s_metric_fds_added.add();
 			pair<unordered_map<int64_t, sinsp_fdinfo_t>::iterator, bool> insert_res = m_table.emplace(fd, *fdinfo);
 			return &(insert_res.first->second);
 		}
 		else
 		{
+			s_metric_fds_dropped.add();
 			return nullptr;
 		}
 	}
@@ -401,6 +479,7 @@ void sinsp_fdtable::erase(int64_t fd)
 	else
 	{
 		m_table.erase(fdit);
+		s_metric_fds_removed.add();
 #ifdef GATHER_INTERNAL_STATS
 		m_inspector->m_stats.m_n_noncached_fd_lookups++;
 		m_inspector->m_stats.m_n_removed_fds++;
@@ -418,6 +497,16 @@ size_t sinsp_fdtable::size()
 	return m_table.size();
 }
 
+size_t sinsp_fdtable::memory_usage()
+{
+	//
+	// The nodes of the map, each with its next pointer, and the buckets.
+	// The names are shared between the tables and accounted by their pool.
+	//
+	return m_table.size() * (sizeof(std::pair<const int64_t, sinsp_fdinfo_t>) + sizeof(void*)) +
+		m_table.bucket_count() * sizeof(void*);
+}
+
 void sinsp_fdtable::reset_cache()
 {
 	m_last_accessed_fd = -1;
@@ -432,6 +521,14 @@ void sinsp_fdtable::lookup_device(sinsp_fdinfo_t* fdi, uint64_t fd)
 		return;
 	}
 
+	if(fdi->m_flags & sinsp_fdinfo_t::FLAGS_FILE_FLAGS_PENDING)
+	{
+		char procdir[SCAP_MAX_PATH_SIZE];
+		snprintf(procdir, sizeof(procdir), "%s/proc/%ld/", scap_get_host_root(), m_tid);
+		fdi->m_flags &= ~sinsp_fdinfo_t::FLAGS_FILE_FLAGS_PENDING;
+		scap_fd_read_file_flags(m_inspector->m_h, procdir, fd, &fdi->m_openflags, &fdi->m_mount_id);
+	}
+
 	if(fdi->is_file() && fdi->m_dev == 0 && fdi->m_mount_id != 0)
 	{
 		char procdir[SCAP_MAX_PATH_SIZE];
@@ -17,6 +17,7 @@ limitations under the License.
 
 #pragma once
 #include "sinsp_pd_callback_type.h"
+#include "interned_string.h"
 #include <unordered_map>
 #include <vector>
 
@@ -60,11 +61,47 @@ typedef union _sinsp_sockinfo
 	unix_tuple m_unixinfo; ///< The tuple if this a unix socket.
 }sinsp_sockinfo;
 
+//
+// Per-connection state of a protocol decoder, owned by the fd
+//
+class sinsp_protodecoder_state
+{
+public:
+	virtual ~sinsp_protodecoder_state()
+	{
+	}
+};
+
 class fd_callbacks_info
 {
 public:
+	fd_callbacks_info()
+	{
+	}
+
+	//
+	// The decoder states belong to the connection as it was seen so far,
+	// copies of the fd (e.g. after a fork) start from scratch
+	//
+	fd_callbacks_info(const fd_callbacks_info& other):
+		m_write_callbacks(other.m_write_callbacks),
+		m_read_callbacks(other.m_read_callbacks)
+	{
+	}
+
+	fd_callbacks_info& operator=(const fd_callbacks_info& other) = delete;
+
+	~fd_callbacks_info()
+	{
+		for(auto& it : m_decoder_states)
+		{
+			delete it.second;
+		}
+	}
+
 	std::vector<sinsp_protodecoder*> m_write_callbacks;
 	std::vector<sinsp_protodecoder*> m_read_callbacks;
+	std::vector<std::pair<sinsp_protodecoder*, sinsp_protodecoder_state*>> m_decoder_states;
 };
 
 /*!
@@ -87,14 +124,9 @@ public:
 
 	~sinsp_fdinfo()
 	{
-		if(m_callbacks != NULL)
-		{
-			delete m_callbacks;
-		}
-
-		if(m_usrstate != NULL)
+		if(m_rare != NULL)
 		{
-			delete m_usrstate;
+			delete m_rare;
 		}
 	}
 
@@ -105,7 +137,7 @@ public:
 	}
 
 	void reset();
-	std::string* tostring();
+	const std::string* tostring();
 
 	inline void copy(const sinsp_fdinfo &other, bool free_state)
 	{
@@ -113,42 +145,23 @@ public:
 		m_openflags = other.m_openflags;	
 		m_sockinfo = other.m_sockinfo;
 		m_name = other.m_name;
-		m_oldname = other.m_oldname;
 		m_flags = other.m_flags;
 		m_dev = other.m_dev;
 		m_mount_id = other.m_mount_id;
 		m_ino = other.m_ino;
 		
-		if(free_state)
+		if(free_state && m_rare != NULL)
 		{
-			if(m_callbacks != NULL)
-			{
-				delete m_callbacks;
-			}
-
-			if(m_usrstate != NULL)
-			{
-				delete m_usrstate;
-			}
+			delete m_rare;
 		}
 
-		if(other.m_callbacks != NULL)
+		if(other.m_rare != NULL)
 		{
-			m_callbacks = new fd_callbacks_info();
-			*m_callbacks = *other.m_callbacks;
+			m_rare = new rare_state(*other.m_rare);
 		}
 		else
 		{
-			m_callbacks = NULL;
-		}
-
-		if(other.m_usrstate != NULL)
-		{
-			m_usrstate = new T(*other.m_usrstate);
-		}
-		else
-		{
-			m_usrstate = NULL;
+			m_rare = NULL;
 		}
 	}
 
@@ -171,6 +184,12 @@ public:
 	*/
 	std::string tostring_clean();
 
+	/*!
+	  \brief Hash of what a capture file stores about the fd, which tells
+	   if it changed since the file was written.
+	*/
+	size_t state_hash();
+
 	/*!
 	  \brief Returns true if this is a unix socket.
 	*/
@@ -327,23 +346,53 @@ public:
 		return (m_flags & FLAGS_IS_CLONED) == FLAGS_IS_CLONED;
 	}
 
-	scap_fd_type m_type; ///< The fd type, e.g. file, directory, IPv4 socket...
-	uint32_t m_openflags; ///< If this FD is a file, the flags that were used when opening it. See the PPM_O_* definitions in driver/ppm_events_public.h.
-	
+	//
+	// The fds are the most numerous objects of the inspector, the fields
+	// are ordered to leave no padding. Keep sizeof(sinsp_fdinfo_t) in
+	// mind when adding one.
+	//
+
+	/*!
+	  \brief Human readable rendering of this FD. For files, this is the
+	  full file name. For sockets, this is the tuple. And so on. The string
+	  is shared with the other fds that have the same name. Change it with
+	  set_name().
+	*/
+	libsinsp::interned_string m_name;
+
 	/*!
 	  \brief Socket-specific state.
 	  This is uninitialized for non-socket FDs.
 	*/
 	sinsp_sockinfo m_sockinfo;
 
-	std::string m_name; ///< Human readable rendering of this FD. For files, this is the full file name. For sockets, this is the tuple. And so on.
-	std::string m_oldname; // The name of this fd at the beginning of event parsing. Used to detect name changes that result from parsing an event.
+	uint32_t m_openflags; ///< If this FD is a file, the flags that were used when opening it. See the PPM_O_* definitions in driver/ppm_events_public.h.
+
+	/*!
+	  \brief Set the name of the fd, and remember that it changed while
+	  parsing the current event if it did.
+	*/
+	template<typename S>
+	inline void set_name(S&& name)
+	{
+		if(m_name.assign(std::forward<S>(name)))
+		{
+			m_flags |= FLAGS_NAME_CHANGED;
+		}
+	}
 
 	inline bool has_decoder_callbacks()
 	{
-		return (m_callbacks != NULL);
+		return (m_rare != NULL);
+	}
+
+	inline fd_callbacks_info* get_callbacks()
+	{
+		return m_rare != NULL ? &m_rare->m_callbacks : NULL;
 	}
 
+	scap_fd_type m_type : 8; ///< The fd type, e.g. file, directory, IPv4 socket... Shares a word with the flags below.
+
 VISIBILITY_PRIVATE
 
 // Doxygen doesn't understand VISIBILITY_PRIVATE
@@ -374,19 +423,23 @@ private:
 		FLAGS_IS_CLONED = (1 << 14),
 		FLAGS_CONNECTION_PENDING = (1 << 15),
 		FLAGS_CONNECTION_FAILED = (1 << 16),
+		FLAGS_FILE_FLAGS_PENDING = (1 << 17), ///< m_openflags and m_mount_id not read from /proc yet
+		FLAGS_NAME_CHANGED = (1 << 18), ///< set_name() changed the name since the fd was looked up for the current event
 	};
 
+	uint32_t m_flags : 24;
+
 	void add_filename(const char* fullpath);
 
 public:
 	inline bool is_transaction() const
 	{
-		return (m_usrstate != NULL); 
+		return (m_rare != NULL && m_rare->m_usrstate != NULL); 
 	}
 
 	T* get_usrstate()
 	{
-		return m_usrstate;
+		return m_rare != NULL ? m_rare->m_usrstate : NULL;
 	}
 
 
@@ -488,13 +541,57 @@ private:
 		m_flags |= FLAGS_IS_CLONED;
 	}
 
-	T* m_usrstate;
-	uint32_t m_flags;
+	inline bool is_name_changed()
+	{
+		return (m_flags & FLAGS_NAME_CHANGED) == FLAGS_NAME_CHANGED;
+	}
+
+	inline void reset_name_changed()
+	{
+		m_flags &= ~FLAGS_NAME_CHANGED;
+	}
+
+	inline fd_callbacks_info* create_callbacks()
+	{
+		if(m_rare == NULL)
+		{
+			m_rare = new rare_state();
+		}
+
+		return &m_rare->m_callbacks;
+	}
+
+	//
+	// What only a few fds have, out of line
+	//
+	struct rare_state
+	{
+		rare_state():
+			m_usrstate(NULL)
+		{
+		}
+
+		rare_state(const rare_state& other):
+			m_callbacks(other.m_callbacks),
+			m_usrstate(other.m_usrstate != NULL ? new T(*other.m_usrstate) : NULL)
+		{
+		}
+
+		rare_state& operator=(const rare_state& other) = delete;
+
+		~rare_state()
+		{
+			delete m_usrstate;
+		}
+
+		fd_callbacks_info m_callbacks;
+		T* m_usrstate;
+	};
+
+	rare_state* m_rare;
+	uint64_t m_ino;
 	uint32_t m_dev;
 	uint32_t m_mount_id;
-	uint64_t m_ino;
-
-	fd_callbacks_info* m_callbacks;
 
 	friend class sinsp;
 	friend class sinsp_parser;
@@ -507,6 +604,7 @@ private:
 	friend class lua_cbacks;
 	friend class sinsp_baseliner;
 	friend class protocol_manager;
+	friend class sinsp_protodecoder;
 };
 
 /*@}*/
@@ -566,6 +664,17 @@ public:
 	size_t size();
 	void reset_cache();
 
+	//
+	// Approximate heap used by the table, in bytes
+	//
+	size_t memory_usage();
+
+	//
+	// Read the information that the /proc scan left to be fetched on
+	// demand. Called by find(), and before saving the fd.
+	//
+	void lookup_device(sinsp_fdinfo_t* fdi, uint64_t fd);
+
 	sinsp* m_inspector;
 	std::unordered_map<int64_t, sinsp_fdinfo_t> m_table;
 
@@ -575,7 +684,4 @@ public:
 	int64_t m_last_accessed_fd;
 	sinsp_fdinfo_t *m_last_accessed_fdinfo;
 	uint64_t m_tid;
-
-private:
-	void lookup_device(sinsp_fdinfo_t* fdi, uint64_t fd);
 };
@@ -75,6 +75,11 @@ sinsp_filter_check_list::sinsp_filter_check_list()
 	add_filter_check(new sinsp_filter_check_user());
 	add_filter_check(new sinsp_filter_check_group());
 	add_filter_check(new sinsp_filter_check_syslog());
+	add_filter_check(new sinsp_filter_check_http());
+	add_filter_check(new sinsp_filter_check_db(SINSP_DB_MYSQL));
+	add_filter_check(new sinsp_filter_check_db(SINSP_DB_PGSQL));
+	add_filter_check(new sinsp_filter_check_db(SINSP_DB_REDIS));
+	add_filter_check(new sinsp_filter_check_db(SINSP_DB_KAFKA));
 	add_filter_check(new sinsp_filter_check_container());
 	add_filter_check(new sinsp_filter_check_utils());
 	add_filter_check(new sinsp_filter_check_fdlist());
@@ -410,15 +415,15 @@ bool flt_compare_ipv6addr(cmpop op, ipv6addr *operand1, ipv6addr *operand2)
 	}
 }
 
-bool flt_compare_ipv6net(cmpop op, ipv6addr *operand1, ipv6addr *operand2)
+bool flt_compare_ipv6net(cmpop op, ipv6addr *operand1, ipv6net *operand2)
 {
 	switch(op)
 	{
 	case CO_EQ:
 	case CO_IN:
-		return operand1->in_subnet(*operand2);
+		return operand1->in_subnet(operand2->m_ip, operand2->m_prefix_len);
 	case CO_NE:
-		return !operand1->in_subnet(*operand2);
+		return !operand1->in_subnet(operand2->m_ip, operand2->m_prefix_len);
 	case CO_CONTAINS:
 		throw sinsp_exception("'contains' not supported for ipv6 networks");
 		return false;
@@ -480,7 +485,7 @@ bool flt_compare(cmpop op, ppm_param_type type, void* operand1, void* operand2,
 	case PT_IPV6ADDR:
 		return flt_compare_ipv6addr(op, (ipv6addr *)operand1, (ipv6addr *)operand2);
 	case PT_IPV6NET:
-		return flt_compare_ipv6net(op, (ipv6addr *)operand1, (ipv6addr*)operand2);
+		return flt_compare_ipv6net(op, (ipv6addr *)operand1, (ipv6net*)operand2);
 	case PT_IPADDR:
 		if(op1_len == sizeof(struct in_addr))
 		{
@@ -1231,6 +1236,21 @@ void sinsp_filter_check::add_filter_value(const char* str, uint32_t len, uint32_
 	{
 		m_val_storages_paths.add_search_path(item);
 	}
+
+	// If the operator is CO_IN on a network field, also add the value
+	// to the networks trie.
+	if((m_cmpop == CO_IN || m_cmpop == CO_INTERSECTS) &&
+	   (m_field->m_type == PT_IPNET || m_field->m_type == PT_IPV4NET || m_field->m_type == PT_IPV6NET))
+	{
+		if(parsed_len == sizeof(ipv4net))
+		{
+			m_val_storages_nets.add_ipv4_net(*(ipv4net*)filter_value_p(i), true);
+		}
+		else
+		{
+			m_val_storages_nets.add_ipv6_net(*(ipv6net*)filter_value_p(i), true);
+		}
+	}
 }
 
 size_t sinsp_filter_check::parse_filter_value(const char* str, uint32_t len, uint8_t *storage, uint32_t storage_len)
@@ -1264,7 +1284,20 @@ const filtercheck_field_info* sinsp_filter_check::get_field_info()
 
 bool sinsp_filter_check::flt_compare(cmpop op, ppm_param_type type, void* operand1, uint32_t op1_len, uint32_t op2_len)
 {
-	if (op == CO_IN || op == CO_PMATCH || op == CO_INTERSECTS)
+	if((op == CO_IN || op == CO_INTERSECTS) &&
+	   (type == PT_IPNET || type == PT_IPV4NET || type == PT_IPV6NET))
+	{
+		// Longest prefix match, whatever the number of networks
+		if(type == PT_IPV4NET || (type == PT_IPNET && op1_len == sizeof(struct in_addr)))
+		{
+			return m_val_storages_nets.match_ipv4(*(uint32_t*)operand1);
+		}
+		else
+		{
+			return m_val_storages_nets.match_ipv6(*(ipv6addr*)operand1);
+		}
+	}
+	else if (op == CO_IN || op == CO_PMATCH || op == CO_INTERSECTS)
 	{
 		// Certain filterchecks can't be done as a set
 		// membership test/group match. For these, just loop over the
@@ -135,6 +135,18 @@ const filtercheck_field_info sinsp_filter_check_fd_fields[] =
 	{PT_INT32, EPF_NONE, PF_HEX, "fd.dev", "device number (major/minor) containing the referenced file"},
 	{PT_INT32, EPF_NONE, PF_DEC, "fd.dev.major", "major device number containing the referenced file"},
 	{PT_INT32, EPF_NONE, PF_DEC, "fd.dev.minor", "minor device number containing the referenced file"},
+	{PT_CHARBUF, EPF_NONE, PF_NA, "fd.net.tag", "tag of the most specific network, among the ones configured with sinsp::add_net_tag(), containing the server IP address of the fd or, if there is none, its client IP address."},
+	{PT_CHARBUF, EPF_NONE, PF_NA, "fd.cnet.tag", "tag of the most specific configured network containing the client IP address."},
+	{PT_CHARBUF, EPF_NONE, PF_NA, "fd.snet.tag", "tag of the most specific configured network containing the server IP address."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "fd.tcp.srtt_min", "for TCP connections, the minimum smoothed round trip time seen, in microseconds. Requires sinsp::start_tcp_stats()."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "fd.tcp.srtt_avg", "for TCP connections, the average smoothed round trip time, in microseconds."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "fd.tcp.srtt_max", "for TCP connections, the maximum smoothed round trip time seen, in microseconds."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "fd.tcp.retransmits", "for TCP connections, the number of retransmitted segments."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "fd.tcp.drops", "for TCP connections, the number of packets dropped by the kernel."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "fd.tcp.resets_sent", "for TCP connections, the number of resets sent."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "fd.tcp.resets_received", "for TCP connections, the number of resets received."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "fd.tcp.reset_state", "for TCP connections, the TCP state of the connection at the last reset, as in include/net/tcp_states.h."},
+	{PT_INT32, EPF_NONE, PF_DEC, "fd.tcp.state", "for TCP connections, the last TCP state seen, as in include/net/tcp_states.h."},
 };
 
 sinsp_filter_check_fd::sinsp_filter_check_fd()
@@ -452,6 +464,11 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 			}
 		}
 
+		if(m_field_id == TYPE_FDNAME && !sanitize_strings)
+		{
+			RETURN_EXTRACT_STRING(m_fdinfo->m_name);
+		}
+
 		if(m_field_id == TYPE_CONTAINERNAME)
 		{
 			ASSERT(m_tinfo != NULL);
@@ -491,6 +508,32 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 				return NULL;
 			}
 
+			//
+			// Use the position of the last slash found when the name
+			// was set, the name can be returned as is if it's a directory
+			// or if it ends with a slash
+			//
+			if(m_field_id == TYPE_DIRECTORY && !sanitize_strings)
+			{
+				const string& name = m_fdinfo->m_name;
+				uint32_t pos = m_fdinfo->m_name.last_slash();
+
+				if(m_fdinfo->is_directory() || (pos != 0 && pos + 1 == name.size()))
+				{
+					RETURN_EXTRACT_STRING(name);
+				}
+				else if(pos == 0 || pos >= name.size())
+				{
+					m_tstr = "/";
+				}
+				else
+				{
+					m_tstr.assign(name, 0, pos);
+				}
+
+				RETURN_EXTRACT_STRING(m_tstr);
+			}
+
 			m_tstr = m_fdinfo->m_name;
 			if(sanitize_strings)
 			{
@@ -532,6 +575,25 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 				return NULL;
 			}
 
+			if(!sanitize_strings)
+			{
+				const string& name = m_fdinfo->m_name;
+				uint32_t pos = m_fdinfo->m_name.last_slash();
+
+				if(pos >= name.size())
+				{
+					m_tstr = "/";
+					RETURN_EXTRACT_STRING(m_tstr);
+				}
+				else if(pos + 1 == name.size())
+				{
+					RETURN_EXTRACT_STRING(name);
+				}
+
+				*len = name.size() - pos - 1;
+				return (uint8_t*)name.c_str() + pos + 1;
+			}
+
 			m_tstr = m_fdinfo->m_name;
 			if(sanitize_strings)
 			{
@@ -1308,6 +1370,143 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 			RETURN_EXTRACT_VAR(m_tbool);
 		}
 		break;
+	case TYPE_NET_TAG:
+	case TYPE_CNET_TAG:
+	case TYPE_SNET_TAG:
+		{
+			if(m_fdinfo == NULL)
+			{
+				return NULL;
+			}
+
+			if(m_fdinfo->is_role_none())
+			{
+				return NULL;
+			}
+
+			const string* tag = NULL;
+			bool server = (m_field_id != TYPE_CNET_TAG);
+			bool client = (m_field_id != TYPE_SNET_TAG);
+
+			switch(m_fdinfo->m_type)
+			{
+			case SCAP_FD_IPV4_SOCK:
+				if(server)
+				{
+					tag = net_tag_ipv4(m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip);
+				}
+				if(tag == NULL && client)
+				{
+					tag = net_tag_ipv4(m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip);
+				}
+				break;
+			case SCAP_FD_IPV4_SERVSOCK:
+				if(server)
+				{
+					tag = net_tag_ipv4(m_fdinfo->m_sockinfo.m_ipv4serverinfo.m_ip);
+				}
+				break;
+			case SCAP_FD_IPV6_SOCK:
+				if(server)
+				{
+					tag = net_tag_ipv6(m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip);
+				}
+				if(tag == NULL && client)
+				{
+					tag = net_tag_ipv6(m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip);
+				}
+				break;
+			case SCAP_FD_IPV6_SERVSOCK:
+				if(server)
+				{
+					tag = net_tag_ipv6(m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip);
+				}
+				break;
+			default:
+				break;
+			}
+
+			if(tag != NULL)
+			{
+				RETURN_EXTRACT_STRING(*tag);
+			}
+		}
+		break;
+	case TYPE_TCP_SRTT_MIN:
+	case TYPE_TCP_SRTT_AVG:
+	case TYPE_TCP_SRTT_MAX:
+	case TYPE_TCP_RETRANSMITS:
+	case TYPE_TCP_DROPS:
+	case TYPE_TCP_RESETS_SENT:
+	case TYPE_TCP_RESETS_RECEIVED:
+	case TYPE_TCP_RESET_STATE:
+	case TYPE_TCP_STATE:
+		{
+			if(m_fdinfo == NULL || m_inspector->get_tcp_stats() == NULL)
+			{
+				return NULL;
+			}
+
+			const sinsp_tcp_stats* st = m_inspector->get_tcp_stats()->find(m_fdinfo);
+			if(st == NULL)
+			{
+				return NULL;
+			}
+
+			switch(m_field_id)
+			{
+			case TYPE_TCP_SRTT_MIN:
+				if(st->m_srtt_samples == 0)
+				{
+					return NULL;
+				}
+				m_tbool = st->m_srtt_min;
+				RETURN_EXTRACT_VAR(m_tbool);
+			case TYPE_TCP_SRTT_AVG:
+				if(st->m_srtt_samples == 0)
+				{
+					return NULL;
+				}
+				m_tbool = st->srtt_avg();
+				RETURN_EXTRACT_VAR(m_tbool);
+			case TYPE_TCP_SRTT_MAX:
+				if(st->m_srtt_samples == 0)
+				{
+					return NULL;
+				}
+				m_tbool = st->m_srtt_max;
+				RETURN_EXTRACT_VAR(m_tbool);
+			case TYPE_TCP_RETRANSMITS:
+				m_tu64 = st->m_retransmits;
+				RETURN_EXTRACT_VAR(m_tu64);
+			case TYPE_TCP_DROPS:
+				m_tu64 = st->m_drops;
+				RETURN_EXTRACT_VAR(m_tu64);
+			case TYPE_TCP_RESETS_SENT:
+				m_tu64 = st->m_resets_sent;
+				RETURN_EXTRACT_VAR(m_tu64);
+			case TYPE_TCP_RESETS_RECEIVED:
+				m_tu64 = st->m_resets_received;
+				RETURN_EXTRACT_VAR(m_tu64);
+			case TYPE_TCP_RESET_STATE:
+				if(st->m_resets_sent + st->m_resets_received == 0)
+				{
+					return NULL;
+				}
+				m_tbool = st->m_reset_state;
+				RETURN_EXTRACT_VAR(m_tbool);
+			case TYPE_TCP_STATE:
+				if(st->m_state < 0)
+				{
+					return NULL;
+				}
+				m_tbool = (uint32_t)st->m_state;
+				RETURN_EXTRACT_VAR(m_tbool);
+			default:
+				ASSERT(false);
+			}
+		}
+		break;
 	default:
 		ASSERT(false);
 	}
@@ -1315,6 +1514,16 @@ uint8_t* sinsp_filter_check_fd::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 	return NULL;
 }
 
+const string* sinsp_filter_check_fd::net_tag_ipv4(uint32_t addr)
+{
+	return m_inspector->get_net_tags().match_ipv4(addr);
+}
+
+const string* sinsp_filter_check_fd::net_tag_ipv6(const ipv6addr& addr)
+{
+	return m_inspector->get_net_tags().match_ipv6(addr);
+}
+
 bool sinsp_filter_check_fd::compare_ip(sinsp_evt *evt)
 {
 	if(!extract_fd(evt))
@@ -1406,6 +1615,25 @@ bool sinsp_filter_check_fd::compare_net(sinsp_evt *evt)
 		return false;
 	}
 
+	if(m_fdinfo != NULL && (m_cmpop == CO_IN || m_cmpop == CO_INTERSECTS))
+	{
+		switch(m_fdinfo->m_type)
+		{
+		case SCAP_FD_IPV4_SOCK:
+			return m_val_storages_nets.match_ipv4(m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_sip) ||
+				m_val_storages_nets.match_ipv4(m_fdinfo->m_sockinfo.m_ipv4info.m_fields.m_dip);
+		case SCAP_FD_IPV4_SERVSOCK:
+			return m_val_storages_nets.match_ipv4(m_fdinfo->m_sockinfo.m_ipv4serverinfo.m_ip);
+		case SCAP_FD_IPV6_SOCK:
+			return m_val_storages_nets.match_ipv6(m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip) ||
+				m_val_storages_nets.match_ipv6(m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip);
+		case SCAP_FD_IPV6_SERVSOCK:
+			return m_val_storages_nets.match_ipv6(m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip);
+		default:
+			return false;
+		}
+	}
+
 	if(m_fdinfo != NULL)
 	{
 		scap_fd_type evt_type = m_fdinfo->m_type;
@@ -1445,16 +1673,16 @@ bool sinsp_filter_check_fd::compare_net(sinsp_evt *evt)
 		{
 			if(m_cmpop == CO_EQ || m_cmpop == CO_IN)
 			{
-				if(flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip, (ipv6addr*)filter_value_p()) ||
-				   flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip, (ipv6addr*)filter_value_p()))
+				if(flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip, (ipv6net*)filter_value_p()) ||
+				   flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip, (ipv6net*)filter_value_p()))
 				{
 					return true;
 				}
 			}
 			else if(m_cmpop == CO_NE)
 			{
-				if(flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip, (ipv6addr*)filter_value_p()) &&
-				   flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip, (ipv6addr*)filter_value_p()))
+				if(flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_sip, (ipv6net*)filter_value_p()) &&
+				   flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6info.m_fields.m_dip, (ipv6net*)filter_value_p()))
 				{
 					return true;
 				}
@@ -1466,7 +1694,7 @@ bool sinsp_filter_check_fd::compare_net(sinsp_evt *evt)
 		}
 		else if(evt_type == SCAP_FD_IPV6_SERVSOCK)
 		{
-			if(flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip, (ipv6addr*)filter_value_p()))
+			if(flt_compare_ipv6net(m_cmpop, &m_fdinfo->m_sockinfo.m_ipv6serverinfo.m_ip, (ipv6net*)filter_value_p()))
 			{
 				return true;
 			}
@@ -1770,7 +1998,57 @@ bool sinsp_filter_check_fd::compare(sinsp_evt *evt)
 	{
 		return compare_net(evt);
 	}
+	else if(m_field_id == TYPE_FDNAME ||
+		m_field_id == TYPE_DIRECTORY ||
+		m_field_id == TYPE_FILENAME)
+	{
+		return compare_name(evt);
+	}
+
+	return compare_extracted(evt);
+}
 
+bool sinsp_filter_check_fd::compare_name(sinsp_evt *evt)
+{
+	if(!extract_fd(evt))
+	{
+		return false;
+	}
+
+	//
+	// Sockets are named after tuples that change with every connection,
+	// not worth remembering
+	//
+	if(m_fdinfo == NULL ||
+	   m_fdinfo->m_name.id() == 0 ||
+	   !(m_fdinfo->is_file() || m_fdinfo->is_directory()))
+	{
+		return compare_extracted(evt);
+	}
+
+	if(!m_name_memo)
+	{
+		m_name_memo.reset(new name_memo_entry[NAME_MEMO_SIZE]());
+	}
+
+	name_memo_entry& e = m_name_memo[m_fdinfo->m_name.id() % NAME_MEMO_SIZE];
+	if(e.m_name_id == m_fdinfo->m_name.id() && e.m_type == m_fdinfo->m_type)
+	{
+		return e.m_res;
+	}
+
+	// the extraction can look up the fd again, copy what identifies it first
+	uint64_t name_id = m_fdinfo->m_name.id();
+	scap_fd_type type = m_fdinfo->m_type;
+
+	e.m_res = compare_extracted(evt);
+	e.m_name_id = name_id;
+	e.m_type = type;
+	return e.m_res;
+}
+
+bool sinsp_filter_check_fd::compare_extracted(sinsp_evt *evt)
+{
 	//
 	// Standard extract-based fields
 	//
@@ -1854,6 +2132,15 @@ const filtercheck_field_info sinsp_filter_check_thread_fields[] =
 	{PT_BOOL, EPF_NONE, PF_NA, "proc.is_container_healthcheck", "true if this process is running as a part of the container's health check."},
 	{PT_BOOL, EPF_NONE, PF_NA, "proc.is_container_liveness_probe", "true if this process is running as a part of the container's liveness probe."},
 	{PT_BOOL, EPF_NONE, PF_NA, "proc.is_container_readiness_probe", "true if this process is running as a part of the container's readiness probe."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.oncpu_ns", "the time the thread spent on CPU, in nanoseconds, from the cpu_analysis events. Requires sinsp::start_cpu_analysis()."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.offcpu_ns", "the time the thread spent off CPU, in nanoseconds. This is the sum of the thread.cpu.*_ns fields below."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.net_ns", "the time the thread spent off CPU waiting for the network, in nanoseconds."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.disk_ns", "the time the thread spent off CPU waiting for the disk, in nanoseconds."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.lock_ns", "the time the thread spent off CPU waiting for a lock, in nanoseconds."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.runq_ns", "the time the thread spent runnable, waiting for a CPU, in nanoseconds."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.idle_ns", "the time the thread spent off CPU sleeping, in nanoseconds."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.epoll_ns", "the time the thread spent off CPU in epoll, in nanoseconds."},
+	{PT_UINT64, EPF_NONE, PF_DEC, "thread.cpu.other_ns", "the time the thread spent off CPU for any other reason, in nanoseconds."},
 };
 
 sinsp_filter_check_thread::sinsp_filter_check_thread()
@@ -2651,6 +2938,60 @@ uint8_t* sinsp_filter_check_thread::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	case TYPE_IS_CONTAINER_READINESS_PROBE:
 		m_tbool = (tinfo->m_category == sinsp_threadinfo::CAT_READINESS_PROBE);
 		RETURN_EXTRACT_VAR(m_tbool);
+	case TYPE_THREAD_ONCPU_NS:
+	case TYPE_THREAD_OFFCPU_NS:
+	case TYPE_THREAD_NET_NS:
+	case TYPE_THREAD_DISK_NS:
+	case TYPE_THREAD_LOCK_NS:
+	case TYPE_THREAD_RUNQ_NS:
+	case TYPE_THREAD_IDLE_NS:
+	case TYPE_THREAD_EPOLL_NS:
+	case TYPE_THREAD_OTHER_NS:
+		{
+			if(m_inspector->get_cpu_analysis() == NULL)
+			{
+				return NULL;
+			}
+
+			const sinsp_cpu_time_breakdown* bd = m_inspector->get_cpu_analysis()->find_thread(tinfo->m_tid);
+			if(bd == NULL)
+			{
+				return NULL;
+			}
+
+			switch(m_field_id)
+			{
+			case TYPE_THREAD_ONCPU_NS:
+				m_u64val = bd->oncpu_ns();
+				break;
+			case TYPE_THREAD_OFFCPU_NS:
+				m_u64val = bd->offcpu_ns();
+				break;
+			case TYPE_THREAD_NET_NS:
+				m_u64val = bd->m_time_ns[CPU_TIME_NET];
+				break;
+			case TYPE_THREAD_DISK_NS:
+				m_u64val = bd->m_time_ns[CPU_TIME_DISK];
+				break;
+			case TYPE_THREAD_LOCK_NS:
+				m_u64val = bd->m_time_ns[CPU_TIME_LOCK];
+				break;
+			case TYPE_THREAD_RUNQ_NS:
+				m_u64val = bd->m_time_ns[CPU_TIME_RUNQ];
+				break;
+			case TYPE_THREAD_IDLE_NS:
+				m_u64val = bd->m_time_ns[CPU_TIME_IDLE];
+				break;
+			case TYPE_THREAD_EPOLL_NS:
+				m_u64val = bd->m_time_ns[CPU_TIME_EPOLL];
+				break;
+			default:
+				m_u64val = bd->m_time_ns[CPU_TIME_OTHER];
+				break;
+			}
+
+			RETURN_EXTRACT_VAR(m_u64val);
+		}
 	default:
 		ASSERT(false);
 		return NULL;
@@ -3839,10 +4180,10 @@ uint8_t* sinsp_filter_check_event::extract(sinsp_evt *evt, OUT uint32_t* len, bo
 		{
 			sinsp_fdinfo_t* fdinfo = evt->m_fdinfo;
 
-			if(fdinfo != NULL && fdinfo->m_callbacks != NULL)
+			if(fdinfo != NULL && fdinfo->has_decoder_callbacks())
 			{
 				char* il;
-				vector<sinsp_protodecoder*>* cbacks = &(fdinfo->m_callbacks->m_write_callbacks);
+				vector<sinsp_protodecoder*>* cbacks = &(fdinfo->get_callbacks()->m_write_callbacks);
 
 				for(auto it = cbacks->begin(); it != cbacks->end(); ++it)
 				{
@@ -5988,6 +6329,157 @@ uint8_t* sinsp_filter_check_syslog::extract(sinsp_evt *evt, OUT uint32_t* len, b
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_check_http implementation
+///////////////////////////////////////////////////////////////////////////////
+const filtercheck_field_info sinsp_filter_check_http_fields[] =
+{
+	{PT_CHARBUF, EPF_NONE, PF_NA, "http.method", "HTTP method of the request (GET, POST...). Like all the http fields, it's set on the read or write that completes the headers of the response."},
+	{PT_CHARBUF, EPF_NONE, PF_NA, "http.url", "URL of the request, as it appears in the request line."},
+	{PT_UINT32, EPF_NONE, PF_DEC, "http.status", "status code of the response."},
+	{PT_RELTIME, EPF_NONE, PF_DEC, "http.latency", "nanoseconds between the beginning of the request and the beginning of the response."},
+	{PT_INT64, EPF_NONE, PF_DEC, "http.req.size", "size of the request in bytes, headers included."},
+	{PT_INT64, EPF_NONE, PF_DEC, "http.resp.size", "size of the response in bytes, headers included. -1 when it can't be known from the headers, e.g. for chunked responses."},
+	{PT_BOOL, EPF_NONE, PF_NA, "http.is_server", "'true' if the process served the request, 'false' if it sent it."},
+};
+
+sinsp_filter_check_http::sinsp_filter_check_http()
+{
+	m_info.m_name = "http";
+	m_info.m_fields = sinsp_filter_check_http_fields;
+	m_info.m_nfields = sizeof(sinsp_filter_check_http_fields) / sizeof(sinsp_filter_check_http_fields[0]);
+	m_decoder = NULL;
+}
+
+sinsp_filter_check* sinsp_filter_check_http::allocate_new()
+{
+	return (sinsp_filter_check*) new sinsp_filter_check_http();
+}
+
+int32_t sinsp_filter_check_http::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
+{
+	int32_t res = sinsp_filter_check::parse_field_name(str, alloc_state, needed_for_filtering);
+	if(res != -1)
+	{
+		m_decoder = (sinsp_decoder_http*)m_inspector->require_protodecoder("http");
+	}
+
+	return res;
+}
+
+uint8_t* sinsp_filter_check_http::extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings)
+{
+	*len = 0;
+	ASSERT(m_decoder != NULL);
+	if(!m_decoder->is_data_valid())
+	{
+		return NULL;
+	}
+
+	sinsp_http_transaction& tr = m_decoder->m_transaction;
+
+	switch(m_field_id)
+	{
+	case TYPE_METHOD:
+		RETURN_EXTRACT_STRING(tr.m_method);
+	case TYPE_URL:
+		RETURN_EXTRACT_STRING(tr.m_url);
+	case TYPE_STATUS:
+		RETURN_EXTRACT_VAR(tr.m_status);
+	case TYPE_LATENCY:
+		RETURN_EXTRACT_VAR(tr.m_latency_ns);
+	case TYPE_REQ_SIZE:
+		RETURN_EXTRACT_VAR(tr.m_req_size);
+	case TYPE_RESP_SIZE:
+		RETURN_EXTRACT_VAR(tr.m_resp_size);
+	case TYPE_IS_SERVER:
+		m_u32val = tr.m_is_server ? 1 : 0;
+		RETURN_EXTRACT_VAR(m_u32val);
+	default:
+		ASSERT(false);
+		return NULL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_check_db implementation
+///////////////////////////////////////////////////////////////////////////////
+#define DB_FIELDS(proto, desc) \
+{ \
+	{PT_CHARBUF, EPF_NONE, PF_NA, proto ".op", "the " desc " command of the request. Like all the " proto " fields, it's set on the read or write that starts the response."}, \
+	{PT_RELTIME, EPF_NONE, PF_DEC, proto ".latency", "nanoseconds between the beginning of the request and the beginning of the response."}, \
+	{PT_UINT64, EPF_NONE, PF_DEC, proto ".req.size", "size of the request in bytes."}, \
+	{PT_BOOL, EPF_NONE, PF_NA, proto ".is_error", "'true' if the response reports an error."}, \
+	{PT_INT32, EPF_NONE, PF_DEC, proto ".error.code", "protocol error code of the response if it has one, 0 otherwise."}, \
+	{PT_BOOL, EPF_NONE, PF_NA, proto ".is_server", "'true' if the process served the request, 'false' if it sent it."}, \
+}
+
+static const filtercheck_field_info sinsp_filter_check_db_fields[SINSP_DB_MAX_PROTOCOL][6] =
+{
+	DB_FIELDS("mysql", "MySQL"),
+	DB_FIELDS("pgsql", "PostgreSQL"),
+	DB_FIELDS("redis", "Redis"),
+	DB_FIELDS("kafka", "Kafka"),
+};
+
+sinsp_filter_check_db::sinsp_filter_check_db(sinsp_db_protocol protocol)
+{
+	m_protocol = protocol;
+	m_info.m_name = sinsp_db_conn::protocol_name(protocol);
+	m_info.m_fields = sinsp_filter_check_db_fields[protocol];
+	m_info.m_nfields = sizeof(sinsp_filter_check_db_fields[protocol]) / sizeof(sinsp_filter_check_db_fields[protocol][0]);
+	m_decoder = NULL;
+}
+
+sinsp_filter_check* sinsp_filter_check_db::allocate_new()
+{
+	return (sinsp_filter_check*) new sinsp_filter_check_db(m_protocol);
+}
+
+int32_t sinsp_filter_check_db::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
+{
+	int32_t res = sinsp_filter_check::parse_field_name(str, alloc_state, needed_for_filtering);
+	if(res != -1)
+	{
+		m_decoder = (sinsp_decoder_db*)m_inspector->require_protodecoder(m_info.m_name);
+	}
+
+	return res;
+}
+
+uint8_t* sinsp_filter_check_db::extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings)
+{
+	*len = 0;
+	ASSERT(m_decoder != NULL);
+	if(!m_decoder->is_data_valid())
+	{
+		return NULL;
+	}
+
+	sinsp_db_transaction& tr = m_decoder->m_transaction;
+
+	switch(m_field_id)
+	{
+	case TYPE_OP:
+		RETURN_EXTRACT_CSTR(tr.m_op);
+	case TYPE_LATENCY:
+		RETURN_EXTRACT_VAR(tr.m_latency_ns);
+	case TYPE_REQ_SIZE:
+		RETURN_EXTRACT_VAR(tr.m_req_size);
+	case TYPE_IS_ERROR:
+		m_u32val = tr.m_is_error ? 1 : 0;
+		RETURN_EXTRACT_VAR(m_u32val);
+	case TYPE_ERROR_CODE:
+		RETURN_EXTRACT_VAR(tr.m_error_code);
+	case TYPE_IS_SERVER:
+		m_u32val = tr.m_is_server ? 1 : 0;
+		RETURN_EXTRACT_VAR(m_u32val);
+	default:
+		ASSERT(false);
+		return NULL;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_container implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -17,9 +17,12 @@ limitations under the License.
 
 #pragma once
 #include <unordered_set>
+#include <memory>
 #include <json/json.h>
 #include "filter_value.h"
 #include "prefix_search.h"
+#include "ip_prefix_search.h"
+#include "db_transaction.h"
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 #include "k8s.h"
 #include "mesos.h"
@@ -33,7 +36,7 @@ class sinsp_filter_check_reference;
 bool flt_compare(cmpop op, ppm_param_type type, void* operand1, void* operand2, uint32_t op1_len = 0, uint32_t op2_len = 0);
 bool flt_compare_avg(cmpop op, ppm_param_type type, void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len, uint32_t cnt1, uint32_t cnt2);
 bool flt_compare_ipv4net(cmpop op, uint64_t operand1, ipv4net* operand2);
-bool flt_compare_ipv6net(cmpop op, ipv6addr *operand1, ipv6addr* operand2);
+bool flt_compare_ipv6net(cmpop op, ipv6addr *operand1, ipv6net* operand2);
 
 char* flt_to_string(uint8_t* rawval, filtercheck_field_info* finfo);
 int32_t gmt2local(time_t t);
@@ -181,6 +184,9 @@ protected:
 
 	path_prefix_search m_val_storages_paths;
 
+	// Networks of an 'in' comparison on a network field
+	ip_prefix_search m_val_storages_nets;
+
 	uint32_t m_val_storages_min_size;
 	uint32_t m_val_storages_max_size;
 
@@ -269,6 +275,18 @@ public:
 		TYPE_DEV = 38,
 		TYPE_DEV_MAJOR = 39,
 		TYPE_DEV_MINOR = 40,
+		TYPE_NET_TAG = 41,
+		TYPE_CNET_TAG = 42,
+		TYPE_SNET_TAG = 43,
+		TYPE_TCP_SRTT_MIN = 44,
+		TYPE_TCP_SRTT_AVG = 45,
+		TYPE_TCP_SRTT_MAX = 46,
+		TYPE_TCP_RETRANSMITS = 47,
+		TYPE_TCP_DROPS = 48,
+		TYPE_TCP_RESETS_SENT = 49,
+		TYPE_TCP_RESETS_RECEIVED = 50,
+		TYPE_TCP_RESET_STATE = 51,
+		TYPE_TCP_STATE = 52,
 	};
 
 	enum fd_type
@@ -294,6 +312,7 @@ public:
 	bool compare_net(sinsp_evt *evt);
 	bool compare_port(sinsp_evt *evt);
 	bool compare_domain(sinsp_evt *evt);
+	bool compare_name(sinsp_evt *evt);
 	bool compare(sinsp_evt *evt);
 
 	sinsp_threadinfo* m_tinfo;
@@ -302,11 +321,29 @@ public:
 	string m_tstr;
 	uint8_t m_tcstr[2];
 	uint32_t m_tbool;
+	uint64_t m_tu64;
 
 private:
 	uint8_t* extract_from_null_fd(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings);
 	bool extract_fdname_from_creator(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings);
 	bool extract_fd(sinsp_evt *evt);
+	const string* net_tag_ipv4(uint32_t addr);
+	const string* net_tag_ipv6(const ipv6addr& addr);
+	bool compare_extracted(sinsp_evt *evt);
+
+	//
+	// Results of the comparison of the file names, by name id. The same
+	// files are opened and read over and over, so a small direct-mapped
+	// table is enough to skip most of the string matching.
+	//
+	struct name_memo_entry
+	{
+		uint64_t m_name_id;
+		scap_fd_type m_type;
+		bool m_res;
+	};
+	static const uint32_t NAME_MEMO_SIZE = 64;
+	std::unique_ptr<name_memo_entry[]> m_name_memo;
 };
 
 //
@@ -366,6 +403,15 @@ public:
 		TYPE_IS_CONTAINER_HEALTHCHECK = 46,
 		TYPE_IS_CONTAINER_LIVENESS_PROBE = 47,
 		TYPE_IS_CONTAINER_READINESS_PROBE = 48,
+		TYPE_THREAD_ONCPU_NS = 49,
+		TYPE_THREAD_OFFCPU_NS = 50,
+		TYPE_THREAD_NET_NS = 51,
+		TYPE_THREAD_DISK_NS = 52,
+		TYPE_THREAD_LOCK_NS = 53,
+		TYPE_THREAD_RUNQ_NS = 54,
+		TYPE_THREAD_IDLE_NS = 55,
+		TYPE_THREAD_EPOLL_NS = 56,
+		TYPE_THREAD_OTHER_NS = 57,
 	};
 
 	sinsp_filter_check_thread();
@@ -731,6 +777,63 @@ public:
 	string m_name;
 };
 
+//
+// http checks
+//
+class sinsp_decoder_http;
+
+class sinsp_filter_check_http : public sinsp_filter_check
+{
+public:
+	enum check_type
+	{
+		TYPE_METHOD = 0,
+		TYPE_URL,
+		TYPE_STATUS,
+		TYPE_LATENCY,
+		TYPE_REQ_SIZE,
+		TYPE_RESP_SIZE,
+		TYPE_IS_SERVER,
+	};
+
+	sinsp_filter_check_http();
+	sinsp_filter_check* allocate_new();
+	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
+	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
+
+	sinsp_decoder_http* m_decoder;
+	uint32_t m_u32val;
+};
+
+class sinsp_decoder_db;
+
+//
+// The same set of fields for each of the protocols decoded by
+// sinsp_decoder_db, under the protocol name (mysql.*, pgsql.*, ...)
+//
+class sinsp_filter_check_db : public sinsp_filter_check
+{
+public:
+	enum check_type
+	{
+		TYPE_OP = 0,
+		TYPE_LATENCY,
+		TYPE_REQ_SIZE,
+		TYPE_IS_ERROR,
+		TYPE_ERROR_CODE,
+		TYPE_IS_SERVER,
+	};
+
+	sinsp_filter_check_db(sinsp_db_protocol protocol);
+	sinsp_filter_check* allocate_new();
+	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
+	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len, bool sanitize_strings = true);
+
+	sinsp_db_protocol m_protocol;
+	sinsp_decoder_db* m_decoder;
+	uint32_t m_u32val;
+};
+
 class sinsp_filter_check_container : public sinsp_filter_check
 {
 public:
@@ -0,0 +1,153 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <string.h>
+
+#include "flight_recorder.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+sinsp_flight_recorder::sinsp_flight_recorder(uint64_t max_bytes, uint64_t max_duration_ns):
+	m_max_duration_ns(max_duration_ns),
+	m_n_evicted(0),
+	m_n_added(0)
+{
+	if(max_bytes < 4096)
+	{
+		throw sinsp_exception("flight recorder buffer too small");
+	}
+
+	// keep every record 8 bytes aligned
+	m_buf.resize(max_bytes & ~7ULL);
+	clear();
+}
+
+void sinsp_flight_recorder::clear()
+{
+	m_head = 0;
+	m_tail = 0;
+	m_wrap_end = 0;
+	m_wrapped = false;
+	m_nevts = 0;
+	m_used = 0;
+}
+
+void sinsp_flight_recorder::evict_oldest()
+{
+	uint32_t len = record_at(m_tail)->m_len;
+
+	m_tail += len;
+	m_used -= len;
+	m_nevts--;
+	m_n_evicted++;
+
+	if(m_nevts == 0)
+	{
+		clear();
+	}
+	else if(m_wrapped && m_tail == m_wrap_end)
+	{
+		m_tail = 0;
+		m_wrapped = false;
+	}
+}
+
+bool sinsp_flight_recorder::add(const scap_evt* e, uint16_t cpuid, uint32_t flags)
+{
+	uint64_t len = (sizeof(record_header) + e->len + 7) & ~7ULL;
+
+	if(len > m_buf.size())
+	{
+		return false;
+	}
+
+	//
+	// Find room for the record, dropping the oldest ones until it fits
+	//
+	uint64_t off;
+	while(true)
+	{
+		if(m_nevts == 0)
+		{
+			off = 0;
+			break;
+		}
+
+		if(!m_wrapped)
+		{
+			if(m_head + len <= m_buf.size())
+			{
+				off = m_head;
+				break;
+			}
+
+			if(len <= m_tail)
+			{
+				m_wrap_end = m_head;
+				m_wrapped = true;
+				off = 0;
+				break;
+			}
+		}
+		else if(m_head + len <= m_tail)
+		{
+			off = m_head;
+			break;
+		}
+
+		evict_oldest();
+	}
+
+	record_header* hdr = record_at(off);
+	hdr->m_ts = e->ts;
+	hdr->m_len = (uint32_t)len;
+	hdr->m_cpuid = cpuid;
+	hdr->m_flags = (uint16_t)flags;
+	memcpy(hdr + 1, e, e->len);
+
+	m_head = off + len;
+	m_used += len;
+	m_nevts++;
+	m_n_added++;
+
+	if(m_max_duration_ns != 0)
+	{
+		while(m_nevts > 1 && record_at(m_tail)->m_ts + m_max_duration_ns < e->ts)
+		{
+			evict_oldest();
+		}
+	}
+
+	return true;
+}
+
+void sinsp_flight_recorder::loop(const callback_t& cb) const
+{
+	uint64_t off = m_tail;
+
+	for(uint64_t j = 0; j < m_nevts; j++)
+	{
+		if(m_wrapped && off == m_wrap_end)
+		{
+			off = 0;
+		}
+
+		const record_header* hdr = record_at(off);
+		cb((const scap_evt*)(hdr + 1), hdr->m_cpuid, hdr->m_flags);
+		off += hdr->m_len;
+	}
+}
@@ -0,0 +1,124 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "scap.h"
+#include "sinsp_public.h"
+
+/*!
+  \brief Circular buffer with the most recent raw events.
+
+  Events are copied as they are, with a small header, into a buffer
+  allocated once. When a new event doesn't fit, or the oldest one is
+  older than the configured duration, the oldest events are dropped by
+  moving the tail, so adding an event never allocates and evicting is
+  O(1) per event.
+*/
+class SINSP_PUBLIC sinsp_flight_recorder
+{
+public:
+	typedef std::function<void(const scap_evt* e, uint16_t cpuid, uint32_t flags)> callback_t;
+
+	/*!
+	  \param max_bytes size of the buffer.
+	  \param max_duration_ns if not 0, events older than this, compared to
+	  the last event added, are dropped.
+	*/
+	sinsp_flight_recorder(uint64_t max_bytes, uint64_t max_duration_ns);
+
+	/*!
+	  \return false if the event is larger than the whole buffer.
+	*/
+	bool add(const scap_evt* e, uint16_t cpuid, uint32_t flags);
+
+	/*!
+	  \brief Call cb on every event in the buffer, oldest first.
+	*/
+	void loop(const callback_t& cb) const;
+
+	void clear();
+
+	inline uint64_t get_nevts() const
+	{
+		return m_nevts;
+	}
+
+	/*!
+	  \brief Bytes used in the buffer, headers included
+	*/
+	inline uint64_t get_used_bytes() const
+	{
+		return m_used;
+	}
+
+	inline uint64_t get_evicted() const
+	{
+		return m_n_evicted;
+	}
+
+	/*!
+	  \brief Number of events added since the recorder was created
+	*/
+	inline uint64_t get_added() const
+	{
+		return m_n_added;
+	}
+
+private:
+	struct record_header
+	{
+		uint64_t m_ts;
+		uint32_t m_len; ///< Whole record, header and padding included
+		uint16_t m_cpuid;
+		uint16_t m_flags;
+	};
+
+	inline record_header* record_at(uint64_t off)
+	{
+		return (record_header*)&m_buf[off];
+	}
+
+	inline const record_header* record_at(uint64_t off) const
+	{
+		return (const record_header*)&m_buf[off];
+	}
+
+	void evict_oldest();
+
+	std::vector<uint8_t> m_buf;
+	uint64_t m_max_duration_ns;
+
+	//
+	// The records go from m_tail to m_head. When m_wrapped is set they
+	// go from m_tail to m_wrap_end, then from the beginning of the buffer
+	// to m_head.
+	//
+	uint64_t m_head;
+	uint64_t m_tail;
+	uint64_t m_wrap_end;
+	bool m_wrapped;
+
+	uint64_t m_nevts;
+	uint64_t m_used;
+	uint64_t m_n_evicted;
+	uint64_t m_n_added;
+};
@@ -0,0 +1,277 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+#include "http_transaction.h"
+
+static const char* s_http_methods[] =
+{
+	"GET ", "POST ", "PUT ", "DELETE ", "HEAD ", "OPTIONS ", "PATCH ", "CONNECT ", "TRACE "
+};
+
+http_parser_settings sinsp_http_conn::s_settings =
+{
+	NULL, // on_message_begin
+	sinsp_http_conn::on_url,
+	NULL, // on_status
+	NULL, // on_header_field
+	NULL, // on_header_value
+	sinsp_http_conn::on_headers_complete,
+	NULL, // on_body
+	NULL, // on_message_complete
+	NULL, // on_chunk_header
+	NULL, // on_chunk_complete
+};
+
+sinsp_http_conn::sinsp_http_conn():
+	m_req_dir(DIR_UNKNOWN),
+	m_not_http(false),
+	m_resp_ts(0)
+{
+	m_req.m_in_headers = false;
+	m_req.m_complete = false;
+	m_req.m_header_len = 0;
+	m_req.m_req = NULL;
+	m_resp.m_in_headers = false;
+	m_resp.m_complete = false;
+	m_resp.m_header_len = 0;
+	m_resp.m_req = NULL;
+}
+
+bool sinsp_http_conn::is_request_start(const char* data, uint32_t len)
+{
+	for(const char* method : s_http_methods)
+	{
+		size_t mlen = strlen(method);
+		if(len >= mlen && memcmp(data, method, mlen) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool sinsp_http_conn::is_response_start(const char* data, uint32_t len)
+{
+	return len >= 7 && memcmp(data, "HTTP/1.", 7) == 0;
+}
+
+bool sinsp_http_conn::on_data(bool is_read, uint64_t ts, const char* data, uint32_t datalen, uint64_t size, sinsp_http_transaction* tr)
+{
+	direction dir = is_read ? DIR_READ : DIR_WRITE;
+
+	//
+	// The first buffer tells which side sends the requests. Captures can
+	// start in the middle of a connection, so a response is fine too.
+	//
+	if(m_req_dir == DIR_UNKNOWN)
+	{
+		if(is_request_start(data, datalen))
+		{
+			m_req_dir = dir;
+		}
+		else if(is_response_start(data, datalen))
+		{
+			m_req_dir = is_read ? DIR_WRITE : DIR_READ;
+		}
+		else
+		{
+			m_not_http = true;
+			return false;
+		}
+	}
+
+	if(dir == m_req_dir)
+	{
+		if(!m_req.m_in_headers && is_request_start(data, datalen))
+		{
+			if(m_pending.size() >= MAX_PENDING_REQUESTS)
+			{
+				// responses went missing, start over
+				m_pending.clear();
+			}
+
+			m_pending.push_back(pending_request());
+			pending_request& req = m_pending.back();
+			req.m_ts = ts;
+			req.m_size = 0;
+			req.m_expected_size = -1;
+			start_message(m_req, HTTP_REQUEST, &req);
+		}
+
+		if(m_pending.empty())
+		{
+			return false;
+		}
+
+		m_pending.back().m_size += size;
+
+		if(m_req.m_in_headers)
+		{
+			parse_headers(m_req, data, datalen, size);
+			if(!m_req.m_in_headers)
+			{
+				m_pending.back().m_expected_size = message_size(m_req);
+			}
+		}
+
+		return false;
+	}
+
+	//
+	// Response direction
+	//
+	if(!m_resp.m_in_headers)
+	{
+		if(!is_response_start(data, datalen) || m_pending.empty())
+		{
+			// body, or a response to a request we haven't seen
+			return false;
+		}
+
+		m_resp_ts = ts;
+		start_message(m_resp, HTTP_RESPONSE, NULL);
+	}
+
+	parse_headers(m_resp, data, datalen, size);
+	if(m_resp.m_in_headers)
+	{
+		return false;
+	}
+
+	fill_transaction(tr);
+	return true;
+}
+
+void sinsp_http_conn::start_message(message_parser& mp, http_parser_type type, pending_request* req)
+{
+	http_parser_init(&mp.m_parser, type);
+	mp.m_parser.data = &mp;
+	mp.m_in_headers = true;
+	mp.m_complete = false;
+	mp.m_header_len = 0;
+	mp.m_req = req;
+}
+
+void sinsp_http_conn::parse_headers(message_parser& mp, const char* data, uint32_t datalen, uint64_t size)
+{
+	size_t nparsed = http_parser_execute(&mp.m_parser, &s_settings, data, datalen);
+	enum http_errno err = HTTP_PARSER_ERRNO(&mp.m_parser);
+
+	if(err == HPE_PAUSED)
+	{
+		// on_headers_complete() stops before the last LF
+		mp.m_header_len += nparsed + 1;
+	}
+	else if(err != HPE_OK || datalen < size)
+	{
+		//
+		// Either not HTTP after all, or the rest of the headers didn't
+		// make it into the capture buffer
+		//
+		mp.m_in_headers = false;
+	}
+	else
+	{
+		mp.m_header_len += nparsed;
+	}
+}
+
+int64_t sinsp_http_conn::message_size(const message_parser& mp)
+{
+	if(!mp.m_complete)
+	{
+		return -1;
+	}
+
+	const http_parser& p = mp.m_parser;
+	if(p.type == HTTP_RESPONSE && (p.status_code == 204 || p.status_code == 304 || p.status_code / 100 == 1))
+	{
+		return mp.m_header_len;
+	}
+
+	if(p.flags & F_CHUNKED)
+	{
+		return -1;
+	}
+
+	if(p.content_length == ULLONG_MAX)
+	{
+		// no Content-Length: requests have no body, responses go on until close
+		return p.type == HTTP_REQUEST ? mp.m_header_len : -1;
+	}
+
+	return mp.m_header_len + p.content_length;
+}
+
+void sinsp_http_conn::fill_transaction(sinsp_http_transaction* tr)
+{
+	pending_request& req = m_pending.front();
+
+	tr->m_method.swap(req.m_method);
+	tr->m_url.swap(req.m_url);
+	tr->m_status = m_resp.m_parser.status_code;
+	tr->m_req_ts = req.m_ts;
+	tr->m_latency_ns = m_resp_ts > req.m_ts ? m_resp_ts - req.m_ts : 0;
+	tr->m_req_size = req.m_expected_size >= 0 ? req.m_expected_size : (int64_t)req.m_size;
+	tr->m_resp_size = message_size(m_resp);
+	tr->m_is_server = (m_req_dir == DIR_READ);
+
+	if(m_req.m_req == &req)
+	{
+		m_req.m_req = NULL;
+	}
+	m_pending.pop_front();
+}
+
+int sinsp_http_conn::on_url(http_parser* parser, const char* at, size_t length)
+{
+	message_parser* mp = (message_parser*)parser->data;
+	pending_request* req = mp->m_req;
+
+	if(req == NULL)
+	{
+		return 0;
+	}
+
+	if(req->m_method.empty())
+	{
+		req->m_method = http_method_str((enum http_method)parser->method);
+	}
+
+	if(req->m_url.size() < MAX_URL_LEN)
+	{
+		req->m_url.append(at, std::min(length, MAX_URL_LEN - req->m_url.size()));
+	}
+
+	return 0;
+}
+
+int sinsp_http_conn::on_headers_complete(http_parser* parser)
+{
+	message_parser* mp = (message_parser*)parser->data;
+
+	mp->m_in_headers = false;
+	mp->m_complete = true;
+
+	// bodies are not parsed, stop here
+	http_parser_pause(parser, 1);
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+#include "http_parser.h"
+
+/*!
+  \brief A request paired with the beginning of its response.
+*/
+struct sinsp_http_transaction
+{
+	std::string m_method;
+	std::string m_url;
+	uint32_t m_status;
+	uint64_t m_req_ts; ///< Timestamp of the first request buffer
+	uint64_t m_latency_ns; ///< From the request to the first response buffer
+	int64_t m_req_size; ///< Request size, -1 if unknown
+	int64_t m_resp_size; ///< Response size, -1 if unknown (e.g. chunked)
+	bool m_is_server; ///< True if the requests were read from the fd
+};
+
+/*!
+  \brief Incremental HTTP/1.x state of a single connection.
+
+  Data is fed one read or write at a time, exactly as the syscalls returned
+  it. Only the request and status lines and the headers are parsed; bodies
+  are skipped by counting bytes, so truncated capture buffers (snaplen) are
+  fine as long as the headers are there.
+
+  Requests are matched in order with the responses that follow them, which
+  also covers pipelining.
+*/
+class sinsp_http_conn
+{
+public:
+	static const uint32_t MAX_URL_LEN = 1024;
+	static const uint32_t MAX_PENDING_REQUESTS = 16;
+
+	sinsp_http_conn();
+	sinsp_http_conn(const sinsp_http_conn&) = delete;
+	sinsp_http_conn& operator=(const sinsp_http_conn&) = delete;
+
+	/*!
+	  \brief Process a buffer.
+
+	  \param is_read true if the data was read from the fd.
+	  \param ts event timestamp.
+	  \param data captured data, possibly truncated.
+	  \param datalen length of data.
+	  \param size bytes actually transferred by the syscall.
+	  \param tr filled when this buffer completes the headers of a response.
+
+	  \return true if tr has been filled.
+	*/
+	bool on_data(bool is_read, uint64_t ts, const char* data, uint32_t datalen, uint64_t size, sinsp_http_transaction* tr);
+
+	/*!
+	  \brief True if no HTTP message has been seen on the connection
+	  after the first buffer, which makes it pointless to look further.
+	*/
+	inline bool is_not_http() const
+	{
+		return m_not_http;
+	}
+
+	static bool is_request_start(const char* data, uint32_t len);
+	static bool is_response_start(const char* data, uint32_t len);
+
+private:
+	enum direction
+	{
+		DIR_UNKNOWN = 0,
+		DIR_READ,
+		DIR_WRITE,
+	};
+
+	struct pending_request
+	{
+		std::string m_method;
+		std::string m_url;
+		uint64_t m_ts;
+		uint64_t m_size;
+		int64_t m_expected_size;
+	};
+
+	//
+	// Header parser, one for requests and one for responses
+	//
+	struct message_parser
+	{
+		http_parser m_parser;
+		bool m_in_headers;
+		bool m_complete; ///< The headers have been fully parsed
+		uint32_t m_header_len;
+		pending_request* m_req; ///< Request being parsed, NULL for responses
+	};
+
+	void start_message(message_parser& mp, http_parser_type type, pending_request* req);
+	void parse_headers(message_parser& mp, const char* data, uint32_t datalen, uint64_t size);
+	static int64_t message_size(const message_parser& mp);
+	static int on_url(http_parser* parser, const char* at, size_t length);
+	static int on_headers_complete(http_parser* parser);
+	void fill_transaction(sinsp_http_transaction* tr);
+
+	static http_parser_settings s_settings;
+
+	direction m_req_dir;
+	bool m_not_http;
+	message_parser m_req;
+	message_parser m_resp;
+	std::deque<pending_request> m_pending;
+	uint64_t m_resp_ts;
+};
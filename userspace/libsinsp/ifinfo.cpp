@@ -19,7 +19,8 @@ limitations under the License.
 #include "sinsp_int.h"
 
 sinsp_network_interfaces::sinsp_network_interfaces(sinsp* inspector)
-	: m_inspector(inspector)
+	: m_inspector(inspector),
+	  m_ipv4_subnets_nifs(0)
 {
 	if(inet_pton(AF_INET6, "::1", m_ipv6_loopback_addr.m_b) != 1)
 	{
@@ -213,15 +214,18 @@ bool sinsp_network_interfaces::is_ipv4addr_in_subnet(uint32_t addr)
 	}
 
 	// try to find an interface for the same subnet
-	for(it = m_ipv4_interfaces.begin(); it != m_ipv4_interfaces.end(); it++)
+	if(m_ipv4_subnets_nifs != m_ipv4_interfaces.size())
 	{
-		if((it->m_addr & it->m_netmask) == (addr & it->m_netmask))
+		m_ipv4_subnets.clear();
+		for(it = m_ipv4_interfaces.begin(); it != m_ipv4_interfaces.end(); it++)
 		{
-			return true;
+			ipv4net net = {it->m_addr, it->m_netmask};
+			m_ipv4_subnets.add_ipv4_net(net, true);
 		}
+		m_ipv4_subnets_nifs = m_ipv4_interfaces.size();
 	}
 
-	return false;
+	return m_ipv4_subnets.match_ipv4(addr);
 }
 
 bool sinsp_network_interfaces::is_ipv4addr_in_local_machine(uint32_t addr, sinsp_threadinfo* tinfo)
@@ -18,6 +18,7 @@ limitations under the License.
 #pragma once
 
 #include "tuples.h"
+#include "ip_prefix_search.h"
 
 #ifndef VISIBILITY_PRIVATE
 #define VISIBILITY_PRIVATE private:
@@ -83,10 +84,19 @@ VISIBILITY_PRIVATE
 	vector<sinsp_ipv4_ifinfo> m_ipv4_interfaces;
 	vector<sinsp_ipv6_ifinfo> m_ipv6_interfaces;
 	sinsp* m_inspector;
+
+	//
+	// Networks of m_ipv4_interfaces, rebuilt when the number of
+	// interfaces changes
+	//
+	ip_prefix_search m_ipv4_subnets;
+	size_t m_ipv4_subnets_nifs;
 };
 
 void sinsp_network_interfaces::clear()
 {
 	m_ipv4_interfaces.clear();
 	m_ipv6_interfaces.clear();
+	m_ipv4_subnets.clear();
+	m_ipv4_subnets_nifs = 0;
 }
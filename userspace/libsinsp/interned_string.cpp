@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "interned_string.h"
+
+using namespace libsinsp;
+
+const uint32_t interned_string::NO_SLASH;
+
+//
+// Heap used by an entry: the node of the map, with its next pointer and
+// cached hash, and the buffer of the string if it doesn't fit inline
+//
+static size_t entry_size(const std::string& val)
+{
+	size_t size = sizeof(std::pair<const std::string, interned_string_entry>) + 2 * sizeof(void*);
+
+	const char* buf = val.data();
+	if(buf < (const char*)&val || buf >= (const char*)(&val + 1))
+	{
+		size += val.capacity() + 1;
+	}
+
+	return size;
+}
+
+template<typename S>
+interned_string_entry* string_pool::intern_locked(S&& val)
+{
+	m_stats.m_n_interned++;
+
+	auto it = m_strings.find(val);
+	if(it != m_strings.end())
+	{
+		m_stats.m_n_hits++;
+		it->second.m_refs.fetch_add(1, std::memory_order_relaxed);
+		return &it->second;
+	}
+
+	it = m_strings.emplace(std::piecewise_construct,
+			       std::forward_as_tuple(std::forward<S>(val)),
+			       std::forward_as_tuple()).first;
+
+	interned_string_entry* entry = &it->second;
+	size_t pos = it->first.rfind('/');
+
+	entry->m_refs.store(1, std::memory_order_relaxed);
+	entry->m_slash = pos == std::string::npos || pos >= interned_string::NO_SLASH ?
+		interned_string::NO_SLASH : (uint32_t)pos;
+	entry->m_id = m_next_id++;
+	entry->m_str = &it->first;
+
+	m_stats.m_n_blocks++;
+	m_stats.m_bytes += entry_size(it->first);
+
+	return entry;
+}
+
+interned_string_entry* string_pool::intern(const std::string& val)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return intern_locked(val);
+}
+
+interned_string_entry* string_pool::intern(std::string&& val)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+	return intern_locked(std::move(val));
+}
+
+void string_pool::release_last(interned_string_entry* entry)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	//
+	// intern() may have handed out the entry again since the caller
+	// saw the last reference, in which case it stays
+	//
+	if(entry->m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+	{
+		return;
+	}
+
+	m_stats.m_n_blocks--;
+	m_stats.m_bytes -= entry_size(*entry->m_str);
+	m_strings.erase(m_strings.find(*entry->m_str));
+}
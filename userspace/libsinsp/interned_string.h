@@ -0,0 +1,384 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "interned_vector.h"
+
+namespace libsinsp
+{
+
+/**
+ * A string stored in a string_pool, with what the users of the string
+ * want to know about it computed once.
+ */
+struct interned_string_entry
+{
+	interned_string_entry():
+		m_refs(0),
+		m_slash(0),
+		m_id(0),
+		m_str(nullptr)
+	{
+	}
+
+	std::atomic<uint32_t> m_refs;
+	uint32_t m_slash; ///< Position of the last '/', UINT32_MAX if there's none
+	uint64_t m_id; ///< Unique across the strings that ever were in the pool
+	const std::string* m_str; ///< The key of the entry in the pool
+};
+
+/**
+ * Store of refcounted strings. Like the shared_block_pool, interning
+ * only happens when some state changes, so a mutex is enough; copies and
+ * releases that don't drop the last reference don't take it.
+ */
+class string_pool
+{
+public:
+	string_pool():
+		m_next_id(1),
+		m_stats()
+	{
+	}
+
+	/**
+	 * @return the entry of val, with a reference taken for the caller.
+	 */
+	interned_string_entry* intern(const std::string& val);
+	interned_string_entry* intern(std::string&& val);
+
+	inline void acquire(interned_string_entry* entry)
+	{
+		entry->m_refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void release(interned_string_entry* entry)
+	{
+		uint32_t refs = entry->m_refs.load(std::memory_order_relaxed);
+
+		while(refs > 1)
+		{
+			if(entry->m_refs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel))
+			{
+				return;
+			}
+		}
+
+		release_last(entry);
+	}
+
+	shared_block_pool_stats get_stats()
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return m_stats;
+	}
+
+private:
+	template<typename S>
+	interned_string_entry* intern_locked(S&& val);
+	void release_last(interned_string_entry* entry);
+
+	std::mutex m_mtx;
+	std::unordered_map<std::string, interned_string_entry> m_strings;
+	uint64_t m_next_id;
+	shared_block_pool_stats m_stats;
+};
+
+/**
+ * Read-only string stored once in a process-wide string_pool, for the
+ * names of the fds: all the fds of the processes that opened the same
+ * file point to a single copy of its path. It takes a pointer in the
+ * objects that hold it, copies are a refcount increment and two
+ * interned strings are equal only if they are the same pointer.
+ *
+ * Every distinct string gets an id, which can key the caches of
+ * results that depend only on the string.
+ */
+class interned_string
+{
+public:
+	static const uint32_t NO_SLASH = UINT32_MAX;
+
+	interned_string():
+		m_entry(nullptr)
+	{
+	}
+
+	interned_string(const std::string& val):
+		m_entry(nullptr)
+	{
+		assign(val);
+	}
+
+	interned_string(const interned_string& other):
+		m_entry(other.m_entry)
+	{
+		if(m_entry != nullptr)
+		{
+			pool().acquire(m_entry);
+		}
+	}
+
+	interned_string(interned_string&& other):
+		m_entry(other.m_entry)
+	{
+		other.m_entry = nullptr;
+	}
+
+	~interned_string()
+	{
+		if(m_entry != nullptr)
+		{
+			pool().release(m_entry);
+		}
+	}
+
+	interned_string& operator=(const interned_string& other)
+	{
+		if(other.m_entry != nullptr)
+		{
+			pool().acquire(other.m_entry);
+		}
+		reset(other.m_entry);
+		return *this;
+	}
+
+	interned_string& operator=(interned_string&& other)
+	{
+		if(this != &other)
+		{
+			reset(other.m_entry);
+			other.m_entry = nullptr;
+		}
+		return *this;
+	}
+
+	interned_string& operator=(const std::string& val)
+	{
+		assign(val);
+		return *this;
+	}
+
+	interned_string& operator=(std::string&& val)
+	{
+		assign(std::move(val));
+		return *this;
+	}
+
+	interned_string& operator=(const char* val)
+	{
+		assign(std::string(val));
+		return *this;
+	}
+
+	/**
+	 * @return false if the string already had this value.
+	 */
+	bool assign(const std::string& val)
+	{
+		if(val == str())
+		{
+			return false;
+		}
+		reset(val.empty() ? nullptr : pool().intern(val));
+		return true;
+	}
+
+	bool assign(std::string&& val)
+	{
+		if(val == str())
+		{
+			return false;
+		}
+		reset(val.empty() ? nullptr : pool().intern(std::move(val)));
+		return true;
+	}
+
+	bool assign(const char* val)
+	{
+		return assign(std::string(val));
+	}
+
+	inline const std::string& str() const
+	{
+		return m_entry != nullptr ? *m_entry->m_str : empty_string();
+	}
+
+	inline operator const std::string&() const
+	{
+		return str();
+	}
+
+	inline const char* c_str() const
+	{
+		return str().c_str();
+	}
+
+	inline size_t size() const
+	{
+		return str().size();
+	}
+
+	inline size_t length() const
+	{
+		return str().size();
+	}
+
+	inline bool empty() const
+	{
+		return m_entry == nullptr;
+	}
+
+	inline char operator[](size_t idx) const
+	{
+		return str()[idx];
+	}
+
+	template<typename... Args>
+	inline size_t find(Args&&... args) const
+	{
+		return str().find(std::forward<Args>(args)...);
+	}
+
+	template<typename... Args>
+	inline size_t rfind(Args&&... args) const
+	{
+		return str().rfind(std::forward<Args>(args)...);
+	}
+
+	inline std::string substr(size_t pos = 0, size_t len = std::string::npos) const
+	{
+		return str().substr(pos, len);
+	}
+
+	/**
+	 * @return the id of the string, 0 for the empty string.
+	 */
+	inline uint64_t id() const
+	{
+		return m_entry != nullptr ? m_entry->m_id : 0;
+	}
+
+	/**
+	 * @return the position of the last '/' in the string, NO_SLASH if
+	 * there's none.
+	 */
+	inline uint32_t last_slash() const
+	{
+		return m_entry != nullptr ? m_entry->m_slash : NO_SLASH;
+	}
+
+	inline bool operator==(const interned_string& other) const
+	{
+		return m_entry == other.m_entry;
+	}
+
+	inline bool operator!=(const interned_string& other) const
+	{
+		return m_entry != other.m_entry;
+	}
+
+	static string_pool& pool()
+	{
+		// never destroyed, strings may outlive static destructors
+		static string_pool* s_pool = new string_pool();
+		return *s_pool;
+	}
+
+private:
+	inline void reset(interned_string_entry* entry)
+	{
+		if(m_entry != nullptr)
+		{
+			pool().release(m_entry);
+		}
+		m_entry = entry;
+	}
+
+	static const std::string& empty_string()
+	{
+		static const std::string s_empty;
+		return s_empty;
+	}
+
+	interned_string_entry* m_entry;
+};
+
+inline bool operator==(const interned_string& lhs, const std::string& rhs)
+{
+	return lhs.str() == rhs;
+}
+
+inline bool operator==(const std::string& lhs, const interned_string& rhs)
+{
+	return lhs == rhs.str();
+}
+
+inline bool operator==(const interned_string& lhs, const char* rhs)
+{
+	return lhs.str() == rhs;
+}
+
+inline bool operator==(const char* lhs, const interned_string& rhs)
+{
+	return lhs == rhs.str();
+}
+
+inline bool operator!=(const interned_string& lhs, const std::string& rhs)
+{
+	return lhs.str() != rhs;
+}
+
+inline bool operator!=(const std::string& lhs, const interned_string& rhs)
+{
+	return lhs != rhs.str();
+}
+
+inline bool operator!=(const interned_string& lhs, const char* rhs)
+{
+	return lhs.str() != rhs;
+}
+
+inline std::string operator+(const interned_string& lhs, const std::string& rhs)
+{
+	return lhs.str() + rhs;
+}
+
+inline std::string operator+(const std::string& lhs, const interned_string& rhs)
+{
+	return lhs + rhs.str();
+}
+
+inline std::string operator+(const interned_string& lhs, const char* rhs)
+{
+	return lhs.str() + rhs;
+}
+
+inline std::string operator+(const interned_string& lhs, char rhs)
+{
+	return lhs.str() + rhs;
+}
+
+}
@@ -0,0 +1,285 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace libsinsp
+{
+
+/**
+ * Memory usage of the blocks stored in a shared_block_pool.
+ */
+struct shared_block_pool_stats
+{
+	uint64_t m_n_blocks; ///< Number of unique blocks currently stored
+	uint64_t m_bytes; ///< Approximate heap memory used by the unique blocks
+	uint64_t m_n_interned; ///< Number of blocks passed to intern()
+	uint64_t m_n_hits; ///< Number of intern() calls that found an identical block
+};
+
+inline size_t shared_block_hash(const std::string& val)
+{
+	return std::hash<std::string>()(val);
+}
+
+inline size_t shared_block_hash(const std::pair<std::string, std::string>& val)
+{
+	return std::hash<std::string>()(val.first) * 31 + std::hash<std::string>()(val.second);
+}
+
+inline size_t shared_block_size(const std::string& val)
+{
+	return sizeof(val) + val.capacity();
+}
+
+inline size_t shared_block_size(const std::pair<std::string, std::string>& val)
+{
+	return shared_block_size(val.first) + shared_block_size(val.second);
+}
+
+/**
+ * Store of immutable, refcounted vectors. Identical vectors passed to
+ * intern() are stored once and shared by all their users; a block is
+ * dropped from the pool when its last reference goes away.
+ *
+ * Interning happens when the state of a thread changes (clone, execve,
+ * /proc scan), not for each event, so a mutex is enough to make the pool
+ * usable from several inspectors.
+ */
+template<typename T>
+class shared_block_pool
+{
+public:
+	typedef std::vector<T> block_t;
+	typedef std::shared_ptr<const block_t> ref_t;
+
+	shared_block_pool():
+		m_stats()
+	{
+	}
+
+	ref_t intern(block_t&& block)
+	{
+		size_t hash = 0;
+		for(const auto& it : block)
+		{
+			hash = hash * 1099511628211ULL ^ shared_block_hash(it);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mtx);
+
+		m_stats.m_n_interned++;
+
+		auto range = m_blocks.equal_range(hash);
+		for(auto it = range.first; it != range.second; ++it)
+		{
+			ref_t ref = it->second.lock();
+			if(ref && *ref == block)
+			{
+				m_stats.m_n_hits++;
+				return ref;
+			}
+		}
+
+		size_t size = sizeof(block_t) + sizeof(T) * (block.capacity() - block.size());
+		for(const auto& it : block)
+		{
+			size += shared_block_size(it);
+		}
+
+		ref_t ref(new block_t(std::move(block)), deleter(this, hash, size));
+		m_blocks.insert(std::make_pair(hash, std::weak_ptr<const block_t>(ref)));
+		m_stats.m_n_blocks++;
+		m_stats.m_bytes += size;
+
+		return ref;
+	}
+
+	shared_block_pool_stats get_stats()
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return m_stats;
+	}
+
+private:
+	struct deleter
+	{
+		deleter(shared_block_pool* pool, size_t hash, size_t size):
+			m_pool(pool),
+			m_hash(hash),
+			m_size(size)
+		{
+		}
+
+		void operator()(const block_t* block)
+		{
+			m_pool->release(block, m_hash, m_size);
+		}
+
+		shared_block_pool* m_pool;
+		size_t m_hash;
+		size_t m_size;
+	};
+
+	void release(const block_t* block, size_t hash, size_t size)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+
+			//
+			// The weak pointer of a released block has already expired,
+			// which is also true for any other expired block with the same
+			// hash, so removing the first expired one keeps the count right
+			//
+			auto range = m_blocks.equal_range(hash);
+			for(auto it = range.first; it != range.second; ++it)
+			{
+				if(it->second.expired())
+				{
+					m_blocks.erase(it);
+					break;
+				}
+			}
+
+			m_stats.m_n_blocks--;
+			m_stats.m_bytes -= size;
+		}
+
+		delete block;
+	}
+
+	std::mutex m_mtx;
+	std::unordered_multimap<size_t, std::weak_ptr<const block_t>> m_blocks;
+	shared_block_pool_stats m_stats;
+};
+
+/**
+ * Read-only vector whose content is stored in a process-wide
+ * shared_block_pool. Copies are cheap (a refcount increment) and identical
+ * contents are stored only once, which is what happens with the args, env
+ * and cgroups of the threads of a process and of forked workers.
+ */
+template<typename T>
+class interned_vector
+{
+public:
+	typedef typename shared_block_pool<T>::block_t block_t;
+	typedef typename block_t::const_iterator const_iterator;
+
+	interned_vector() = default;
+
+	interned_vector(block_t&& block)
+	{
+		assign(std::move(block));
+	}
+
+	void assign(block_t&& block)
+	{
+		if(block.empty())
+		{
+			m_block.reset();
+		}
+		else
+		{
+			m_block = pool().intern(std::move(block));
+		}
+	}
+
+	void clear()
+	{
+		m_block.reset();
+	}
+
+	inline const block_t& get() const
+	{
+		return m_block ? *m_block : empty_block();
+	}
+
+	inline operator const block_t&() const
+	{
+		return get();
+	}
+
+	inline const_iterator begin() const
+	{
+		return get().begin();
+	}
+
+	inline const_iterator end() const
+	{
+		return get().end();
+	}
+
+	inline size_t size() const
+	{
+		return m_block ? m_block->size() : 0;
+	}
+
+	inline bool empty() const
+	{
+		return size() == 0;
+	}
+
+	inline const T& operator[](size_t idx) const
+	{
+		return (*m_block)[idx];
+	}
+
+	inline bool operator==(const interned_vector& other) const
+	{
+		// interned blocks are unique, so comparing pointers is enough
+		return m_block == other.m_block;
+	}
+
+	inline bool operator!=(const interned_vector& other) const
+	{
+		return m_block != other.m_block;
+	}
+
+	static shared_block_pool<T>& pool()
+	{
+		// never destroyed, blocks may outlive static destructors
+		static shared_block_pool<T>* s_pool = new shared_block_pool<T>();
+		return *s_pool;
+	}
+
+private:
+	static const block_t& empty_block()
+	{
+		static const block_t s_empty;
+		return s_empty;
+	}
+
+	std::shared_ptr<const block_t> m_block;
+};
+
+template<typename T>
+inline bool operator==(const std::vector<T>& lhs, const interned_vector<T>& rhs)
+{
+	return lhs == rhs.get();
+}
+
+}
@@ -0,0 +1,328 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <string.h>
+
+#include <memory>
+
+#include "tuples.h"
+
+//
+// Bit counting for the trie, with the compiler builtins where available
+//
+static inline uint32_t ip_prefix_leading_zeros(uint8_t v)
+{
+#ifdef __GNUC__
+	return __builtin_clz((uint32_t)v) - 24;
+#else
+	uint32_t n = 0;
+
+	while(n < 8 && (v & 0x80) == 0)
+	{
+		v <<= 1;
+		n++;
+	}
+
+	return n;
+#endif
+}
+
+static inline uint32_t ip_prefix_popcount(uint32_t v)
+{
+#ifdef __GNUC__
+	return __builtin_popcount(v);
+#else
+	v = v - ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	return (((v + (v >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+#endif
+}
+
+//
+// Longest prefix match of IP addresses against a set of networks.
+//
+// IPv4 and IPv6 networks are kept in two path compressed binary tries:
+// every node holds the bits its subtree has in common, so a lookup
+// follows at most one node per bit of the address (33 for IPv4, 129 for
+// IPv6) no matter how many networks were added, and usually far fewer
+// since single child chains are collapsed into one node.
+//
+// Addresses are in network byte order, as they are stored in the fd
+// table and in the filter values.
+//
+template<class Value>
+class ip_prefix_map
+{
+public:
+	ip_prefix_map();
+
+	// Adding a network that is already there replaces its value
+	void add_ipv4_net(const ipv4net &net, const Value &v);
+	void add_ipv6_net(const ipv6net &net, const Value &v);
+
+	// Return the value of the most specific network containing the
+	// address, or NULL. The pointer is valid until the map changes.
+	const Value *match_ipv4(uint32_t addr) const;
+	const Value *match_ipv6(const ipv6addr &addr) const;
+
+	inline size_t size() const
+	{
+		return m_size;
+	}
+
+	inline bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	void clear();
+
+private:
+	struct node
+	{
+		uint8_t m_key[16];
+		uint32_t m_len;
+		bool m_has_value;
+		Value m_value;
+		std::unique_ptr<node> m_child[2];
+	};
+
+	static inline uint32_t bit(const uint8_t *key, uint32_t pos)
+	{
+		return (key[pos >> 3] >> (7 - (pos & 7))) & 1;
+	}
+
+	// Number of leading bits a and b have in common, up to maxlen
+	static uint32_t common_len(const uint8_t *a, const uint8_t *b, uint32_t maxlen);
+
+	// Copy the first len bits of key, zeroing the others
+	static void set_key(node *n, const uint8_t *key, uint32_t len);
+
+	void add(node &root, const uint8_t *key, uint32_t len, const Value &v);
+	const Value *match(const node &root, const uint8_t *addr, uint32_t addr_len) const;
+
+	node m_ipv4_root;
+	node m_ipv6_root;
+	size_t m_size;
+};
+
+template<class Value>
+ip_prefix_map<Value>::ip_prefix_map()
+{
+	clear();
+}
+
+template<class Value>
+void ip_prefix_map<Value>::clear()
+{
+	node *roots[] = {&m_ipv4_root, &m_ipv6_root};
+
+	for(node *root : roots)
+	{
+		memset(root->m_key, 0, sizeof(root->m_key));
+		root->m_len = 0;
+		root->m_has_value = false;
+		root->m_value = Value();
+		root->m_child[0].reset();
+		root->m_child[1].reset();
+	}
+
+	m_size = 0;
+}
+
+template<class Value>
+uint32_t ip_prefix_map<Value>::common_len(const uint8_t *a, const uint8_t *b, uint32_t maxlen)
+{
+	uint32_t len = 0;
+
+	while(len < maxlen)
+	{
+		uint8_t diff = a[len >> 3] ^ b[len >> 3];
+
+		if(diff != 0)
+		{
+			len += ip_prefix_leading_zeros(diff);
+			break;
+		}
+
+		len += 8;
+	}
+
+	return len < maxlen ? len : maxlen;
+}
+
+template<class Value>
+void ip_prefix_map<Value>::set_key(node *n, const uint8_t *key, uint32_t len)
+{
+	uint32_t nbytes = len >> 3;
+
+	memset(n->m_key, 0, sizeof(n->m_key));
+	memcpy(n->m_key, key, nbytes);
+	if(len & 7)
+	{
+		n->m_key[nbytes] = key[nbytes] & (uint8_t)(0xff << (8 - (len & 7)));
+	}
+	n->m_len = len;
+}
+
+template<class Value>
+void ip_prefix_map<Value>::add(node &root, const uint8_t *key, uint32_t len, const Value &v)
+{
+	node *cur = &root;
+
+	//
+	// cur is always a prefix of key
+	//
+	while(true)
+	{
+		if(cur->m_len == len)
+		{
+			if(!cur->m_has_value)
+			{
+				m_size++;
+			}
+			cur->m_has_value = true;
+			cur->m_value = v;
+			return;
+		}
+
+		std::unique_ptr<node> &slot = cur->m_child[bit(key, cur->m_len)];
+
+		if(!slot)
+		{
+			slot.reset(new node());
+			set_key(slot.get(), key, len);
+			slot->m_has_value = true;
+			slot->m_value = v;
+			m_size++;
+			return;
+		}
+
+		uint32_t common = common_len(key, slot->m_key, len < slot->m_len ? len : slot->m_len);
+
+		if(common == slot->m_len)
+		{
+			cur = slot.get();
+			continue;
+		}
+
+		//
+		// key and the child diverge, or key is a prefix of the child:
+		// insert a node with the common part between them
+		//
+		std::unique_ptr<node> mid(new node());
+		set_key(mid.get(), key, common);
+		mid->m_has_value = false;
+		mid->m_child[bit(slot->m_key, common)] = std::move(slot);
+
+		if(common == len)
+		{
+			mid->m_has_value = true;
+			mid->m_value = v;
+		}
+		else
+		{
+			node *leaf = new node();
+			set_key(leaf, key, len);
+			leaf->m_has_value = true;
+			leaf->m_value = v;
+			mid->m_child[bit(key, common)].reset(leaf);
+		}
+
+		slot = std::move(mid);
+		m_size++;
+		return;
+	}
+}
+
+template<class Value>
+const Value *ip_prefix_map<Value>::match(const node &root, const uint8_t *addr, uint32_t addr_len) const
+{
+	const node *cur = &root;
+	const Value *best = NULL;
+
+	while(true)
+	{
+		if(cur->m_has_value)
+		{
+			best = &cur->m_value;
+		}
+
+		if(cur->m_len == addr_len)
+		{
+			break;
+		}
+
+		const node *child = cur->m_child[bit(addr, cur->m_len)].get();
+
+		if(child == NULL ||
+		   common_len(addr, child->m_key, child->m_len) != child->m_len)
+		{
+			break;
+		}
+
+		cur = child;
+	}
+
+	return best;
+}
+
+template<class Value>
+void ip_prefix_map<Value>::add_ipv4_net(const ipv4net &net, const Value &v)
+{
+	uint32_t len = ip_prefix_popcount(net.m_netmask);
+	uint32_t ip = net.m_ip & net.m_netmask;
+
+	add(m_ipv4_root, (const uint8_t *)&ip, len, v);
+}
+
+template<class Value>
+void ip_prefix_map<Value>::add_ipv6_net(const ipv6net &net, const Value &v)
+{
+	add(m_ipv6_root, (const uint8_t *)net.m_ip.m_b, net.m_prefix_len, v);
+}
+
+template<class Value>
+const Value *ip_prefix_map<Value>::match_ipv4(uint32_t addr) const
+{
+	return match(m_ipv4_root, (const uint8_t *)&addr, 32);
+}
+
+template<class Value>
+const Value *ip_prefix_map<Value>::match_ipv6(const ipv6addr &addr) const
+{
+	return match(m_ipv6_root, (const uint8_t *)addr.m_b, 128);
+}
+
+//
+// Set of networks, for the filters and the interface checks
+//
+class ip_prefix_search : public ip_prefix_map<bool>
+{
+public:
+	inline bool match_ipv4(uint32_t addr) const
+	{
+		return ip_prefix_map<bool>::match_ipv4(addr) != NULL;
+	}
+
+	inline bool match_ipv6(const ipv6addr &addr) const
+	{
+		return ip_prefix_map<bool>::match_ipv6(addr) != NULL;
+	}
+};
@@ -15,8 +15,10 @@ limitations under the License.
 
 */
 #include "logger.h"
+#include "mpsc_ring.h"
 #include "sinsp.h"
 #include "sinsp_int.h"
+#include "token_bucket.h"
 
 #ifndef _WIN32
 #include <sys/time.h>
@@ -24,16 +26,146 @@ limitations under the License.
 #include <time.h>
 #endif
 #include <stdarg.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace
 {
 
 thread_local char s_tbuf[16384];
 
+//
+// Rate limit buckets of the format() call sites used by this thread. The
+// format strings of the logging macros are literals, so their address
+// identifies the call site. Others could be anything, hence the cap.
+//
+thread_local std::unordered_map<const char*, token_bucket> s_callsite_buckets;
+
+const size_t MAX_CALLSITE_BUCKETS = 4096;
+
 const size_t ENCODE_LEN = sizeof(uint64_t);
 
 } // end namespace
 
+//
+// The async mode of sinsp_logger: the logging threads push the records
+// into a lock-free ring and a flusher thread writes them to the sink.
+//
+class sinsp_async_log
+{
+public:
+	struct record
+	{
+		struct timeval m_ts;
+		bool m_has_ts;
+		sinsp_logger::severity m_sev;
+		std::string m_msg;
+	};
+
+	sinsp_async_log(sinsp_logger* logger, size_t ring_size, uint64_t flush_interval_ms):
+		m_logger(logger),
+		m_ring(ring_size),
+		m_flush_interval(flush_interval_ms),
+		m_stop(false),
+		m_n_reported_drops(logger->m_n_dropped)
+	{
+		m_flusher = std::thread(&sinsp_async_log::run, this);
+	}
+
+	~sinsp_async_log()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_stop = true;
+		}
+		m_cv.notify_one();
+		m_flusher.join();
+	}
+
+	bool push(record&& r)
+	{
+		bool urgent = r.m_sev <= sinsp_logger::SEV_ERROR;
+
+		if(!m_ring.push(std::move(r)))
+		{
+			return false;
+		}
+
+		if(urgent)
+		{
+			m_cv.notify_one();
+		}
+
+		return true;
+	}
+
+private:
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(m_mtx);
+
+		while(true)
+		{
+			lock.unlock();
+			drain();
+			lock.lock();
+
+			if(m_stop)
+			{
+				break;
+			}
+
+			m_cv.wait_for(lock, m_flush_interval);
+		}
+
+		// the producers are gone, pick up what they left
+		lock.unlock();
+		drain();
+	}
+
+	void drain()
+	{
+		record r;
+		bool written = false;
+
+		while(m_ring.pop(r))
+		{
+			m_logger->write(std::move(r.m_msg), r.m_sev, r.m_has_ts ? &r.m_ts : nullptr, false);
+			written = true;
+		}
+
+		uint64_t n_dropped = m_logger->m_n_dropped;
+		if(n_dropped != m_n_reported_drops)
+		{
+			struct timeval ts = {};
+			gettimeofday(&ts, nullptr);
+			m_logger->write(std::to_string(n_dropped - m_n_reported_drops) + " log messages dropped",
+					sinsp_logger::SEV_WARNING,
+					(m_logger->m_flags & sinsp_logger::OT_NOTS) ? nullptr : &ts,
+					false);
+			m_n_reported_drops = n_dropped;
+			written = true;
+		}
+
+		if(written)
+		{
+			m_logger->write_flush();
+		}
+	}
+
+	sinsp_logger* m_logger;
+	libsinsp::mpsc_ring<record> m_ring;
+	std::chrono::milliseconds m_flush_interval;
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_stop;
+	uint64_t m_n_reported_drops;
+	std::thread m_flusher;
+};
+
 const uint32_t sinsp_logger::OT_NONE       = 0;
 const uint32_t sinsp_logger::OT_STDOUT     = 1;
 const uint32_t sinsp_logger::OT_STDERR     = (OT_STDOUT   << 1);
@@ -46,11 +178,18 @@ sinsp_logger::sinsp_logger():
 	m_file(nullptr),
 	m_callback(nullptr),
 	m_flags(OT_NONE),
-	m_sev(SEV_INFO)
+	m_sev(SEV_INFO),
+	m_async(nullptr),
+	m_async_users(0),
+	m_rate_limit(0),
+	m_rate_burst(0),
+	m_n_dropped(0)
 { }
 
 sinsp_logger::~sinsp_logger()
 {
+	disable_async();
+
 	if(m_file)
 	{
 		ASSERT(m_flags & sinsp_logger::OT_FILE);
@@ -135,85 +274,219 @@ sinsp_logger::severity sinsp_logger::get_severity() const
 	return m_sev;
 }
 
-void sinsp_logger::log(std::string msg, const severity sev)
+void sinsp_logger::enable_async(const size_t ring_size, const uint64_t flush_interval_ms)
 {
-	sinsp_logger_callback cb = nullptr;
+	if(m_async != nullptr)
+	{
+		return;
+	}
 
-	if(sev > m_sev)
+	sinsp_async_log* async = new sinsp_async_log(this, ring_size, flush_interval_ms);
+	sinsp_async_log* expected = nullptr;
+
+	if(!m_async.compare_exchange_strong(expected, async))
+	{
+		// enabled by another thread meanwhile
+		delete async;
+	}
+}
+
+void sinsp_logger::disable_async()
+{
+	sinsp_async_log* async = m_async.exchange(nullptr);
+
+	if(async == nullptr)
 	{
 		return;
 	}
 
-	if((m_flags & sinsp_logger::OT_NOTS) == 0)
+	//
+	// The threads that loaded the pointer before the exchange may still
+	// be pushing into the ring, the new ones see nullptr
+	//
+	while(m_async_users != 0)
+	{
+		std::this_thread::yield();
+	}
+
+	delete async;
+}
+
+bool sinsp_logger::is_async() const
+{
+	return m_async != nullptr;
+}
+
+void sinsp_logger::set_rate_limit(const double rate, const double max_burst)
+{
+	m_rate_limit = rate;
+	m_rate_burst = max_burst;
+}
+
+uint64_t sinsp_logger::get_n_dropped() const
+{
+	return m_n_dropped;
+}
+
+bool sinsp_logger::claim_callsite(const char* const fmt)
+{
+	const double rate = m_rate_limit;
+
+	if(rate <= 0)
+	{
+		return true;
+	}
+
+	auto it = s_callsite_buckets.find(fmt);
+	if(it == s_callsite_buckets.end())
+	{
+		if(s_callsite_buckets.size() >= MAX_CALLSITE_BUCKETS)
+		{
+			s_callsite_buckets.clear();
+		}
+
+		it = s_callsite_buckets.emplace(fmt, token_bucket()).first;
+		it->second.init(rate, m_rate_burst);
+	}
+
+	if(!it->second.claim())
+	{
+		m_n_dropped++;
+		return false;
+	}
+
+	return true;
+}
+
+void sinsp_logger::log(std::string msg, const severity sev)
+{
+	if(sev > m_sev)
 	{
-		struct timeval ts = {};
+		return;
+	}
 
-		if(gettimeofday(&ts, nullptr) == 0)
+	struct timeval ts = {};
+	const bool has_ts = (m_flags & sinsp_logger::OT_NOTS) == 0 &&
+			    gettimeofday(&ts, nullptr) == 0;
+
+	if(m_async != nullptr)
+	{
+		m_async_users++;
+		sinsp_async_log* async = m_async;
+		if(async != nullptr)
 		{
-			const std::string::size_type ts_length = sizeof("31-12 23:59:59.999999 ");
-			char ts_buf[ts_length];
-			struct tm* ti;
-			struct tm time_info = {};
+			if(!async->push({ts, has_ts, sev, std::move(msg)}))
+			{
+				m_n_dropped++;
+			}
+			m_async_users--;
+			return;
+		}
+		m_async_users--;
+	}
+
+	write(std::move(msg), sev, has_ts ? &ts : nullptr, true);
+}
+
+void sinsp_logger::write(std::string&& msg, const severity sev, const struct timeval* const ts, const bool flush)
+{
+	sinsp_logger_callback cb = nullptr;
+	char prefix[ENCODE_LEN + sizeof("31-12 23:59:59.999999 ")];
+	size_t prefix_len = 0;
+
+	if(m_flags & sinsp_logger::OT_ENCODE_SEV)
+	{
+		memcpy(prefix, encode_severity(sev), ENCODE_LEN);
+		prefix_len = ENCODE_LEN;
+	}
+
+	if(ts != nullptr)
+	{
+		struct tm* ti;
+		struct tm time_info = {};
 
 #ifdef _WIN32
-			ti = _gmtime32((__time32_t*)&ts.tv_sec);
+		ti = _gmtime32((__time32_t*)&ts->tv_sec);
 #else
-			gmtime_r(&ts.tv_sec, &time_info);
-			ti = &time_info;
+		gmtime_r(&ts->tv_sec, &time_info);
+		ti = &time_info;
 #endif
 
-			snprintf(ts_buf,
-				 sizeof(ts_buf),
-				 "%.2d-%.2d %.2d:%.2d:%.2d.%.6d ",
-				 ti->tm_mon + 1,
-				 ti->tm_mday,
-				 ti->tm_hour,
-				 ti->tm_min,
-				 ti->tm_sec,
-				 (int)ts.tv_usec);
-
-			ts_buf[sizeof(ts_buf) - 1] = '\0';
-			msg.insert(0, ts_buf);
+		int len = snprintf(prefix + prefix_len,
+				   sizeof(prefix) - prefix_len,
+				   "%.2d-%.2d %.2d:%.2d:%.2d.%.6d ",
+				   ti->tm_mon + 1,
+				   ti->tm_mday,
+				   ti->tm_hour,
+				   ti->tm_min,
+				   ti->tm_sec,
+				   (int)ts->tv_usec);
+
+		if(len > 0)
+		{
+			prefix_len = std::min(prefix_len + len, sizeof(prefix) - 1);
 		}
 	}
 
-	if(m_flags & sinsp_logger::OT_ENCODE_SEV)
-	{
-		char sev_buf[ENCODE_LEN + 1];
-		strncpy(sev_buf, encode_severity(sev), sizeof(sev_buf));
-		sev_buf[sizeof(sev_buf) - 1] = 0;
-		msg.insert(0, sev_buf);
-	}
+	prefix[prefix_len] = '\0';
 
 	if(is_callback())
 	{
 		cb = m_callback;
 	}
 
+	//
+	// Only the callback needs the whole line in a string, the streams
+	// take the prefix as it is
+	//
 	if(cb != nullptr)
 	{
+		msg.insert(0, prefix, prefix_len);
 		cb(std::move(msg), sev);
 	}
 	else if((m_flags & sinsp_logger::OT_FILE) && m_file)
 	{
-		fprintf(m_file, "%s\n", msg.c_str());
+		fprintf(m_file, "%s%s\n", prefix, msg.c_str());
+	}
+	else if(m_flags & sinsp_logger::OT_STDOUT)
+	{
+		fprintf(stdout, "%s%s\n", prefix, msg.c_str());
+	}
+	else if(m_flags & sinsp_logger::OT_STDERR)
+	{
+		fprintf(stderr, "%s%s\n", prefix, msg.c_str());
+	}
+
+	if(flush)
+	{
+		write_flush();
+	}
+}
+
+void sinsp_logger::write_flush()
+{
+	if(is_callback() && m_callback != nullptr)
+	{
+		return;
+	}
+
+	if((m_flags & sinsp_logger::OT_FILE) && m_file)
+	{
 		fflush(m_file);
 	}
 	else if(m_flags & sinsp_logger::OT_STDOUT)
 	{
-		fprintf(stdout, "%s\n", msg.c_str());
 		fflush(stdout);
 	}
 	else if(m_flags & sinsp_logger::OT_STDERR)
 	{
-		fprintf(stderr, "%s\n", msg.c_str());
 		fflush(stderr);
 	}
 }
 
 void sinsp_logger::format(const severity sev, const char* const fmt, ...)
 {
-	if(sev > m_sev)
+	if(sev > m_sev || !claim_callsite(fmt))
 	{
 		return;
 	}
@@ -229,6 +502,11 @@ void sinsp_logger::format(const severity sev, const char* const fmt, ...)
 
 void sinsp_logger::format(const char* const fmt, ...)
 {
+	if(SEV_INFO > m_sev || !claim_callsite(fmt))
+	{
+		return;
+	}
+
 	va_list ap;
 
 	va_start(ap, fmt);
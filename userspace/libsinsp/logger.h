@@ -22,6 +22,8 @@ limitations under the License.
 #include <atomic>
 #include <string>
 
+class sinsp_async_log;
+
 /**
  * Component logging API.  This API exposes the ability to log to a
  * variety of log sinks.  sinsp_logger will use only one enabled log* sink;
@@ -146,6 +148,39 @@ public:
 	 */
 	void format(const char* fmt, ...);
 
+	/**
+	 * Hand the messages over to a background thread that writes them
+	 * to the sink, so that logging never waits for the I/O. The messages
+	 * are queued, already formatted, in a ring of ring_size entries;
+	 * when the ring is full they are dropped and counted. The flusher
+	 * writes them every flush_interval_ms, or as soon as one of
+	 * SEV_ERROR or worse is queued.
+	 *
+	 * Note: the callback, if any, is called from the flusher thread.
+	 */
+	void enable_async(size_t ring_size = 4096, uint64_t flush_interval_ms = 100);
+
+	/**
+	 * Write the queued messages and go back to synchronous logging.
+	 * Waits for the threads that are queueing a message.
+	 */
+	void disable_async();
+
+	bool is_async() const;
+
+	/**
+	 * Allow each format() call site, identified by its format string,
+	 * rate messages per second with bursts of up to max_burst messages.
+	 * The budget is per thread. A rate of 0 (the default) means no limit.
+	 */
+	void set_rate_limit(double rate, double max_burst);
+
+	/**
+	 * Returns the number of messages dropped so far, because of the rate
+	 * limit or because the async ring was full.
+	 */
+	uint64_t get_n_dropped() const;
+
 	/** Sets `sev` to the decoded severity or SEV_MAX+1 for errors.
 	 *  Returns the length of the severity string on success
 	 *  and 0 in case of errors
@@ -153,9 +188,22 @@ public:
 	static size_t decode_severity(const std::string &s, severity& sev);
 
 private:
+	friend class sinsp_async_log;
+
 	/** Returns true if the callback log sync is enabled, false otherwise. */
 	bool is_callback() const;
 
+	/** Returns false if the rate limit of the call site is exceeded. */
+	bool claim_callsite(const char* fmt);
+
+	/**
+	 * Prefix msg with the encoded severity and the timestamp, if they're
+	 * enabled, and send it to the sink.
+	 */
+	void write(std::string&& msg, severity sev, const struct timeval* ts, bool flush);
+
+	/** Flush the stream sink in use, if any. */
+	void write_flush();
 
 	/** Returns a string containing encoded severity, for OT_ENCODE_SEV. */
 	static const char* encode_severity(severity sev);
@@ -163,6 +211,12 @@ private:
 	std::atomic<callback_t> m_callback;
 	std::atomic<uint32_t> m_flags;
 	std::atomic<severity> m_sev;
+	std::atomic<sinsp_async_log*> m_async;
+	// threads that may be using m_async, which is freed only at 0
+	std::atomic<uint32_t> m_async_users;
+	std::atomic<double> m_rate_limit;
+	std::atomic<double> m_rate_burst;
+	std::atomic<uint64_t> m_n_dropped;
 };
 
 using sinsp_logger_callback = sinsp_logger::callback_t;
@@ -0,0 +1,322 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <json/json.h>
+
+#include "metrics.h"
+#include "sinsp_exception.h"
+
+uint32_t sinsp_metric_new_shard()
+{
+	static std::atomic<uint32_t> s_next(0);
+
+	uint32_t shard = s_next.fetch_add(1, std::memory_order_relaxed);
+	return shard < SINSP_METRIC_SHARED_SHARD ? shard : SINSP_METRIC_SHARED_SHARD;
+}
+
+sinsp_metric_counter::sinsp_metric_counter(const std::string& name, const std::string& description):
+	sinsp_metric(COUNTER, name, description)
+{
+	for(uint32_t j = 0; j < SINSP_METRIC_SHARDS; j++)
+	{
+		m_shards[j].m_value = 0;
+	}
+}
+
+uint64_t sinsp_metric_counter::get() const
+{
+	uint64_t res = 0;
+
+	for(uint32_t j = 0; j < SINSP_METRIC_SHARDS; j++)
+	{
+		res += m_shards[j].m_value.load(std::memory_order_relaxed);
+	}
+
+	return res;
+}
+
+uint64_t sinsp_metric_histogram_snapshot::percentile(double pct) const
+{
+	if(m_count == 0)
+	{
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)(m_count * pct / 100);
+	if(rank == 0)
+	{
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for(uint32_t j = 0; j < m_buckets.size(); j++)
+	{
+		seen += m_buckets[j];
+		if(seen >= rank)
+		{
+			uint64_t res = sinsp_metric_histogram::bucket_highest(j);
+			return res < m_min ? m_min : (res > m_max ? m_max : res);
+		}
+	}
+
+	return m_max;
+}
+
+const uint32_t sinsp_metric_histogram::SUB_BITS;
+const uint32_t sinsp_metric_histogram::SUB_BUCKETS;
+const uint32_t sinsp_metric_histogram::NBUCKETS;
+
+sinsp_metric_histogram::shard::shard():
+	m_count(0),
+	m_sum(0),
+	m_min(UINT64_MAX),
+	m_max(0)
+{
+	for(uint32_t j = 0; j < NBUCKETS; j++)
+	{
+		m_buckets[j] = 0;
+	}
+}
+
+sinsp_metric_histogram::sinsp_metric_histogram(const std::string& name, const std::string& description):
+	sinsp_metric(HISTOGRAM, name, description)
+{
+	for(uint32_t j = 0; j < SINSP_METRIC_SHARED_SHARD; j++)
+	{
+		m_shards[j] = nullptr;
+	}
+	m_shards[SINSP_METRIC_SHARED_SHARD] = new shard();
+}
+
+sinsp_metric_histogram::~sinsp_metric_histogram()
+{
+	for(uint32_t j = 0; j < SINSP_METRIC_SHARDS; j++)
+	{
+		delete m_shards[j].load();
+	}
+}
+
+sinsp_metric_histogram_snapshot sinsp_metric_histogram::get() const
+{
+	sinsp_metric_histogram_snapshot res;
+
+	res.m_count = 0;
+	res.m_sum = 0;
+	res.m_min = UINT64_MAX;
+	res.m_max = 0;
+	res.m_buckets.resize(NBUCKETS, 0);
+
+	//
+	// The shards are read while they're updated, so the totals can be
+	// a few records off from the buckets; they're recomputed from the
+	// buckets to stay consistent for the percentiles
+	//
+	for(uint32_t j = 0; j < SINSP_METRIC_SHARDS; j++)
+	{
+		const shard* sh = m_shards[j].load(std::memory_order_acquire);
+		if(sh == nullptr)
+		{
+			continue;
+		}
+
+		for(uint32_t b = 0; b < NBUCKETS; b++)
+		{
+			uint64_t n = sh->m_buckets[b].load(std::memory_order_relaxed);
+			res.m_buckets[b] += n;
+			res.m_count += n;
+		}
+
+		res.m_sum += sh->m_sum.load(std::memory_order_relaxed);
+
+		uint64_t min = sh->m_min.load(std::memory_order_relaxed);
+		uint64_t max = sh->m_max.load(std::memory_order_relaxed);
+		res.m_min = min < res.m_min ? min : res.m_min;
+		res.m_max = max > res.m_max ? max : res.m_max;
+	}
+
+	if(res.m_count == 0)
+	{
+		res.m_min = 0;
+	}
+
+	return res;
+}
+
+uint64_t sinsp_metric_histogram::bucket_lowest(uint32_t idx)
+{
+	if(idx < SUB_BUCKETS)
+	{
+		return idx;
+	}
+
+	uint32_t e = idx / SUB_BUCKETS;
+	return (uint64_t)(idx % SUB_BUCKETS + SUB_BUCKETS) << (e - 1);
+}
+
+uint64_t sinsp_metric_histogram::bucket_highest(uint32_t idx)
+{
+	if(idx < SUB_BUCKETS)
+	{
+		return idx;
+	}
+
+	uint32_t e = idx / SUB_BUCKETS;
+	return bucket_lowest(idx) + ((1ULL << (e - 1)) - 1);
+}
+
+template<typename T>
+T& sinsp_metrics_registry::find_or_create(sinsp_metric::type t, const std::string& name, const std::string& description)
+{
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	auto it = m_metrics.find(name);
+	if(it == m_metrics.end())
+	{
+		it = m_metrics.emplace(name, std::unique_ptr<sinsp_metric>(new T(name, description))).first;
+	}
+	else if(it->second->get_type() != t)
+	{
+		throw sinsp_exception("metric " + name + " already registered with another type");
+	}
+
+	return *static_cast<T*>(it->second.get());
+}
+
+sinsp_metric_counter& sinsp_metrics_registry::counter(const std::string& name, const std::string& description)
+{
+	return find_or_create<sinsp_metric_counter>(sinsp_metric::COUNTER, name, description);
+}
+
+sinsp_metric_gauge& sinsp_metrics_registry::gauge(const std::string& name, const std::string& description)
+{
+	return find_or_create<sinsp_metric_gauge>(sinsp_metric::GAUGE, name, description);
+}
+
+sinsp_metric_histogram& sinsp_metrics_registry::histogram(const std::string& name, const std::string& description)
+{
+	return find_or_create<sinsp_metric_histogram>(sinsp_metric::HISTOGRAM, name, description);
+}
+
+std::vector<sinsp_metric_value> sinsp_metrics_registry::snapshot() const
+{
+	std::vector<sinsp_metric_value> res;
+	std::lock_guard<std::mutex> lock(m_mtx);
+
+	res.reserve(m_metrics.size());
+	for(const auto& it : m_metrics)
+	{
+		const sinsp_metric* m = it.second.get();
+		sinsp_metric_value v = {m->get_name(), m->get_description(), m->get_type(), 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+		switch(m->get_type())
+		{
+		case sinsp_metric::COUNTER:
+			v.m_count = static_cast<const sinsp_metric_counter*>(m)->get();
+			break;
+		case sinsp_metric::GAUGE:
+			v.m_value = static_cast<const sinsp_metric_gauge*>(m)->get();
+			break;
+		case sinsp_metric::HISTOGRAM:
+		{
+			sinsp_metric_histogram_snapshot h = static_cast<const sinsp_metric_histogram*>(m)->get();
+			v.m_count = h.m_count;
+			v.m_sum = h.m_sum;
+			v.m_min = h.m_min;
+			v.m_max = h.m_max;
+			v.m_p50 = h.percentile(50);
+			v.m_p90 = h.percentile(90);
+			v.m_p99 = h.percentile(99);
+			v.m_p999 = h.percentile(99.9);
+			break;
+		}
+		}
+
+		res.push_back(std::move(v));
+	}
+
+	return res;
+}
+
+std::string sinsp_metrics_registry::to_text() const
+{
+	std::string res;
+
+	for(const auto& v : snapshot())
+	{
+		res += "# HELP " + v.m_name + " " + v.m_description + "\n";
+
+		switch(v.m_type)
+		{
+		case sinsp_metric::COUNTER:
+			res += "# TYPE " + v.m_name + " counter\n";
+			res += v.m_name + " " + std::to_string(v.m_count) + "\n";
+			break;
+		case sinsp_metric::GAUGE:
+			res += "# TYPE " + v.m_name + " gauge\n";
+			res += v.m_name + " " + std::to_string(v.m_value) + "\n";
+			break;
+		case sinsp_metric::HISTOGRAM:
+			res += "# TYPE " + v.m_name + " summary\n";
+			res += v.m_name + "{quantile=\"0.5\"} " + std::to_string(v.m_p50) + "\n";
+			res += v.m_name + "{quantile=\"0.9\"} " + std::to_string(v.m_p90) + "\n";
+			res += v.m_name + "{quantile=\"0.99\"} " + std::to_string(v.m_p99) + "\n";
+			res += v.m_name + "{quantile=\"0.999\"} " + std::to_string(v.m_p999) + "\n";
+			res += v.m_name + "_sum " + std::to_string(v.m_sum) + "\n";
+			res += v.m_name + "_count " + std::to_string(v.m_count) + "\n";
+			break;
+		}
+	}
+
+	return res;
+}
+
+std::string sinsp_metrics_registry::to_json() const
+{
+	Json::Value root(Json::objectValue);
+
+	for(const auto& v : snapshot())
+	{
+		Json::Value& m = root[v.m_name];
+
+		switch(v.m_type)
+		{
+		case sinsp_metric::COUNTER:
+			m["type"] = "counter";
+			m["value"] = (Json::UInt64)v.m_count;
+			break;
+		case sinsp_metric::GAUGE:
+			m["type"] = "gauge";
+			m["value"] = (Json::Int64)v.m_value;
+			break;
+		case sinsp_metric::HISTOGRAM:
+			m["type"] = "histogram";
+			m["count"] = (Json::UInt64)v.m_count;
+			m["sum"] = (Json::UInt64)v.m_sum;
+			m["min"] = (Json::UInt64)v.m_min;
+			m["max"] = (Json::UInt64)v.m_max;
+			m["p50"] = (Json::UInt64)v.m_p50;
+			m["p90"] = (Json::UInt64)v.m_p90;
+			m["p99"] = (Json::UInt64)v.m_p99;
+			m["p999"] = (Json::UInt64)v.m_p999;
+			break;
+		}
+
+		m["description"] = v.m_description;
+	}
+
+	return Json::FastWriter().write(root);
+}
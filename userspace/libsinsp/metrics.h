@@ -0,0 +1,360 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+
+#include "sinsp_public.h"
+
+//
+// Always-on metrics of the inspector components, readable from any thread
+// while the capture runs.
+//
+// Writers update a shard of the metric that belongs to their thread, so
+// that an update is a plain load and store with no lock prefix and no
+// cache line bouncing; readers add the shards up. The first
+// SINSP_METRIC_SHARDS - 1 threads that update a metric get a shard of
+// their own, the ones after them share the last one with atomic adds.
+//
+
+const uint32_t SINSP_METRIC_SHARDS = 16;
+const uint32_t SINSP_METRIC_SHARED_SHARD = SINSP_METRIC_SHARDS - 1;
+
+SINSP_PUBLIC uint32_t sinsp_metric_new_shard();
+
+/*!
+  \brief Shard of the calling thread
+*/
+inline uint32_t sinsp_metric_shard()
+{
+	static thread_local uint32_t s_shard = sinsp_metric_new_shard();
+	return s_shard;
+}
+
+/*!
+  \brief Add n to a value of the shard s
+*/
+inline void sinsp_metric_add(std::atomic<uint64_t>& v, uint64_t n, uint32_t s)
+{
+	if(s == SINSP_METRIC_SHARED_SHARD)
+	{
+		v.fetch_add(n, std::memory_order_relaxed);
+	}
+	else
+	{
+		v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+}
+
+class SINSP_PUBLIC sinsp_metric
+{
+public:
+	enum type
+	{
+		COUNTER,
+		GAUGE,
+		HISTOGRAM,
+	};
+
+	sinsp_metric(type t, const std::string& name, const std::string& description):
+		m_type(t),
+		m_name(name),
+		m_description(description)
+	{
+	}
+
+	virtual ~sinsp_metric()
+	{
+	}
+
+	inline type get_type() const
+	{
+		return m_type;
+	}
+
+	inline const std::string& get_name() const
+	{
+		return m_name;
+	}
+
+	inline const std::string& get_description() const
+	{
+		return m_description;
+	}
+
+private:
+	type m_type;
+	std::string m_name;
+	std::string m_description;
+};
+
+/*!
+  \brief Monotonic count of something that happened
+*/
+class SINSP_PUBLIC sinsp_metric_counter : public sinsp_metric
+{
+public:
+	sinsp_metric_counter(const std::string& name, const std::string& description);
+
+	inline void add(uint64_t n = 1)
+	{
+		uint32_t s = sinsp_metric_shard();
+		sinsp_metric_add(m_shards[s].m_value, n, s);
+	}
+
+	uint64_t get() const;
+
+private:
+	// one per cache line
+	struct shard
+	{
+		std::atomic<uint64_t> m_value;
+		char m_pad[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	shard m_shards[SINSP_METRIC_SHARDS];
+};
+
+/*!
+  \brief Current level of something, e.g. the size of a table. Gauges
+  are set by a single owner most of the time, so they aren't sharded.
+*/
+class SINSP_PUBLIC sinsp_metric_gauge : public sinsp_metric
+{
+public:
+	sinsp_metric_gauge(const std::string& name, const std::string& description):
+		sinsp_metric(GAUGE, name, description),
+		m_value(0)
+	{
+	}
+
+	inline void set(int64_t v)
+	{
+		m_value.store(v, std::memory_order_relaxed);
+	}
+
+	inline void add(int64_t n)
+	{
+		m_value.fetch_add(n, std::memory_order_relaxed);
+	}
+
+	inline int64_t get() const
+	{
+		return m_value.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<int64_t> m_value;
+};
+
+/*!
+  \brief Merged view of the shards of a histogram
+*/
+struct SINSP_PUBLIC sinsp_metric_histogram_snapshot
+{
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_min;
+	uint64_t m_max;
+	std::vector<uint64_t> m_buckets;
+
+	/*!
+	  \brief Highest value of the bucket holding the given percentile
+	  (0-100), which is within 1/16 of the recorded values
+	*/
+	uint64_t percentile(double pct) const;
+};
+
+/*!
+  \brief Distribution of values, e.g. latencies, with HDR buckets: 16
+  linear sub-buckets per power of two, so the error on any value, from 0
+  to 2^64 - 1, is below 6.25%.
+
+  The shards, 7.6KB each, are allocated by the threads when they record
+  their first value.
+*/
+class SINSP_PUBLIC sinsp_metric_histogram : public sinsp_metric
+{
+public:
+	static const uint32_t SUB_BITS = 4;
+	static const uint32_t SUB_BUCKETS = 1 << SUB_BITS;
+	static const uint32_t NBUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+	sinsp_metric_histogram(const std::string& name, const std::string& description);
+	~sinsp_metric_histogram();
+
+	inline void record(uint64_t v)
+	{
+		uint32_t s = sinsp_metric_shard();
+		shard* sh = m_shards[s].load(std::memory_order_acquire);
+
+		if(sh == nullptr)
+		{
+			// only the owner thread gets here, the shared shard always exists
+			sh = new shard();
+			m_shards[s].store(sh, std::memory_order_release);
+		}
+
+		sinsp_metric_add(sh->m_buckets[bucket(v)], 1, s);
+		sinsp_metric_add(sh->m_count, 1, s);
+		sinsp_metric_add(sh->m_sum, v, s);
+		update_min(sh->m_min, v);
+		update_max(sh->m_max, v);
+	}
+
+	sinsp_metric_histogram_snapshot get() const;
+
+	static inline uint32_t bucket(uint64_t v)
+	{
+		if(v < SUB_BUCKETS)
+		{
+			return (uint32_t)v;
+		}
+
+#ifdef _WIN32
+		unsigned long msb;
+		_BitScanReverse64(&msb, v);
+		uint32_t e = msb + 1 - SUB_BITS;
+#else
+		uint32_t e = 64 - __builtin_clzll(v) - SUB_BITS;
+#endif
+		return (e - 1) * SUB_BUCKETS + (uint32_t)(v >> (e - 1));
+	}
+
+	static uint64_t bucket_lowest(uint32_t idx);
+	static uint64_t bucket_highest(uint32_t idx);
+
+private:
+	struct shard
+	{
+		shard();
+
+		std::atomic<uint64_t> m_count;
+		std::atomic<uint64_t> m_sum;
+		std::atomic<uint64_t> m_min;
+		std::atomic<uint64_t> m_max;
+		std::atomic<uint64_t> m_buckets[NBUCKETS];
+	};
+
+	//
+	// A CAS loop is needed only for the shared shard, but it costs
+	// the owner thread nothing as the first attempt always succeeds
+	//
+	static inline void update_min(std::atomic<uint64_t>& m, uint64_t v)
+	{
+		uint64_t cur = m.load(std::memory_order_relaxed);
+		while(v < cur && !m.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	static inline void update_max(std::atomic<uint64_t>& m, uint64_t v)
+	{
+		uint64_t cur = m.load(std::memory_order_relaxed);
+		while(v > cur && !m.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	std::atomic<shard*> m_shards[SINSP_METRIC_SHARDS];
+};
+
+/*!
+  \brief Value of a metric at the time of a snapshot
+*/
+struct SINSP_PUBLIC sinsp_metric_value
+{
+	std::string m_name;
+	std::string m_description;
+	sinsp_metric::type m_type;
+	uint64_t m_count; ///< Counters and histograms
+	int64_t m_value; ///< Gauges
+	uint64_t m_sum; ///< Histograms only, like the fields below
+	uint64_t m_min;
+	uint64_t m_max;
+	uint64_t m_p50;
+	uint64_t m_p90;
+	uint64_t m_p99;
+	uint64_t m_p999;
+};
+
+/*!
+  \brief The process-wide set of metrics.
+
+  Metrics are registered by name and live as long as the process, so the
+  components can keep pointers to them; registering a name again returns
+  the same metric, which is then shared by all the inspectors. Snapshots
+  only take the registration lock, never a lock of the capture loop, so
+  they can be exported from any thread at any time.
+*/
+class SINSP_PUBLIC sinsp_metrics_registry
+{
+public:
+	static sinsp_metrics_registry& get()
+	{
+		// never destroyed, threads may still record during the exit
+		static sinsp_metrics_registry* instance = new sinsp_metrics_registry();
+		return *instance;
+	}
+
+	/*!
+	  \throws sinsp_exception if the name is taken by a metric of another type
+	*/
+	sinsp_metric_counter& counter(const std::string& name, const std::string& description);
+	sinsp_metric_gauge& gauge(const std::string& name, const std::string& description);
+	sinsp_metric_histogram& histogram(const std::string& name, const std::string& description);
+
+	/*!
+	  \brief Current values of all the metrics, sorted by name
+	*/
+	std::vector<sinsp_metric_value> snapshot() const;
+
+	/*!
+	  \brief Snapshot in the Prometheus text format, histograms as summaries
+	*/
+	std::string to_text() const;
+
+	/*!
+	  \brief Snapshot as a JSON object keyed by metric name
+	*/
+	std::string to_json() const;
+
+private:
+	sinsp_metrics_registry()
+	{
+	}
+
+	sinsp_metrics_registry(const sinsp_metrics_registry&) = delete;
+	void operator=(const sinsp_metrics_registry&) = delete;
+
+	template<typename T>
+	T& find_or_create(sinsp_metric::type t, const std::string& name, const std::string& description);
+
+	mutable std::mutex m_mtx;
+	std::map<std::string, std::unique_ptr<sinsp_metric>> m_metrics;
+};
@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace libsinsp
+{
+
+/**
+ * Bounded lock-free queue with many producers and a single consumer.
+ *
+ * Every cell carries a sequence number telling whose turn it is: a
+ * producer claims a position with a CAS on the head and publishes the
+ * value by bumping the sequence of the cell, the consumer frees the cell
+ * for the next lap by bumping it again. Producers never wait on the
+ * consumer: when the ring is full, push() fails and the caller decides
+ * what to drop.
+ *
+ * The cells are allocated once, T should be cheap to move into (e.g. a
+ * std::string, whose buffer is handed over rather than copied).
+ */
+template<typename T>
+class mpsc_ring
+{
+public:
+	/**
+	 * @param size capacity, rounded up to a power of 2.
+	 */
+	explicit mpsc_ring(size_t size):
+		m_head(0),
+		m_tail(0)
+	{
+		size_t capacity = 2;
+		while(capacity < size)
+		{
+			capacity <<= 1;
+		}
+
+		m_mask = capacity - 1;
+		m_cells.reset(new cell[capacity]);
+		for(size_t j = 0; j < capacity; j++)
+		{
+			m_cells[j].m_seq.store(j, std::memory_order_relaxed);
+		}
+	}
+
+	mpsc_ring(const mpsc_ring&) = delete;
+	mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+	/**
+	 * Can be called from any thread.
+	 *
+	 * @return false if the ring is full, value is left untouched.
+	 */
+	bool push(T&& value)
+	{
+		size_t pos = m_head.load(std::memory_order_relaxed);
+		cell* c;
+
+		while(true)
+		{
+			c = &m_cells[pos & m_mask];
+			size_t seq = c->m_seq.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+			if(diff == 0)
+			{
+				if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if(diff < 0)
+			{
+				// the consumer didn't free this cell yet
+				return false;
+			}
+			else
+			{
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+		}
+
+		c->m_value = std::move(value);
+		c->m_seq.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Only one thread at a time can pop.
+	 *
+	 * @return false if there's nothing published to read.
+	 */
+	bool pop(T& value)
+	{
+		cell* c = &m_cells[m_tail & m_mask];
+
+		if(c->m_seq.load(std::memory_order_acquire) != m_tail + 1)
+		{
+			return false;
+		}
+
+		value = std::move(c->m_value);
+		c->m_seq.store(m_tail + m_mask + 1, std::memory_order_release);
+		m_tail++;
+		return true;
+	}
+
+	size_t capacity() const
+	{
+		return m_mask + 1;
+	}
+
+private:
+	struct cell
+	{
+		std::atomic<size_t> m_seq;
+		T m_value;
+	};
+
+	std::unique_ptr<cell[]> m_cells;
+	size_t m_mask;
+	// keep the producers' and the consumer's cursors on different lines
+	char m_pad0[64];
+	std::atomic<size_t> m_head;
+	char m_pad1[64];
+	size_t m_tail;
+};
+
+}
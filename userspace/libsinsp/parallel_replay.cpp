@@ -0,0 +1,250 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <stdio.h>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+#include "parallel_replay.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "dumper.h"
+
+sinsp_parallel_replay::sinsp_parallel_replay(const std::vector<sinsp_replay_shard>& shards):
+	m_shards(shards)
+{
+}
+
+std::vector<sinsp_replay_shard> sinsp_parallel_replay::split(const std::string& input,
+	const std::string& output_prefix,
+	uint64_t events_per_shard,
+	bool compress)
+{
+	if(events_per_shard == 0)
+	{
+		throw sinsp_exception("shards need at least one event");
+	}
+
+	std::vector<sinsp_replay_shard> shards;
+	std::unique_ptr<sinsp_dumper> dumper;
+	sinsp inspector;
+	sinsp_evt* evt;
+
+	inspector.open(input);
+
+	//
+	// The next shard is opened as soon as the previous one is full, so
+	// that the tables written at its beginning reflect the state after
+	// the last event of the previous shard and before its first event
+	//
+	auto open_shard = [&]()
+	{
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), "_%04u.scap", (uint32_t)shards.size());
+
+		sinsp_replay_shard shard;
+		shard.m_filename = output_prefix + suffix;
+		shard.m_first_ts = 0;
+		shard.m_last_ts = 0;
+		shard.m_nevts = 0;
+
+		dumper.reset(new sinsp_dumper(&inspector));
+		dumper->open(shard.m_filename, compress, true);
+		shards.push_back(shard);
+	};
+
+	open_shard();
+
+	while(true)
+	{
+		int32_t res = inspector.next(&evt);
+
+		if(res == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		else if(res == SCAP_EOF)
+		{
+			break;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(inspector.getlasterr());
+		}
+
+		sinsp_replay_shard& shard = shards.back();
+
+		dumper->dump(evt);
+
+		if(shard.m_nevts == 0)
+		{
+			shard.m_first_ts = evt->get_ts();
+		}
+		shard.m_last_ts = evt->get_ts();
+		shard.m_nevts++;
+
+		if(shard.m_nevts == events_per_shard)
+		{
+			dumper->close();
+
+			//
+			// The thread or fd that the last event closed is only
+			// removed when the next one is read: do it now, or the
+			// tables of the next shard would still have it
+			//
+			if(inspector.m_automatic_threadtable_purging)
+			{
+				inspector.remove_delayed_thread();
+			}
+			inspector.remove_delayed_fds();
+
+			open_shard();
+		}
+	}
+
+	dumper->close();
+	inspector.close();
+
+	if(shards.back().m_nevts == 0 && shards.size() > 1)
+	{
+		remove(shards.back().m_filename.c_str());
+		shards.pop_back();
+	}
+
+	return shards;
+}
+
+void sinsp_parallel_replay::for_each_shard(const shard_callback_t& cb, uint32_t nworkers)
+{
+	std::atomic<uint32_t> next_shard(0);
+	std::vector<std::exception_ptr> errors(m_shards.size());
+	std::vector<std::thread> workers;
+
+	if(nworkers == 0)
+	{
+		nworkers = 1;
+	}
+	if(nworkers > m_shards.size())
+	{
+		nworkers = (uint32_t)m_shards.size();
+	}
+
+	auto worker = [&]()
+	{
+		uint32_t idx;
+
+		while((idx = next_shard++) < m_shards.size())
+		{
+			try
+			{
+				sinsp inspector;
+				inspector.open(m_shards[idx].m_filename);
+				cb(idx, &inspector);
+				inspector.close();
+			}
+			catch(...)
+			{
+				errors[idx] = std::current_exception();
+			}
+		}
+	};
+
+	for(uint32_t j = 0; j < nworkers; j++)
+	{
+		workers.emplace_back(worker);
+	}
+
+	for(auto& t : workers)
+	{
+		t.join();
+	}
+
+	for(auto& e : errors)
+	{
+		if(e)
+		{
+			std::rethrow_exception(e);
+		}
+	}
+}
+
+#ifdef HAS_FILTERING
+std::vector<sinsp_replay_match> sinsp_parallel_replay::run(const std::string& filter,
+	const std::string& format,
+	uint32_t nworkers)
+{
+	std::vector<std::vector<sinsp_replay_match>> shard_matches(m_shards.size());
+
+	for_each_shard([&](uint32_t idx, sinsp* inspector)
+	{
+		std::unique_ptr<sinsp_filter> flt;
+		sinsp_evt_formatter formatter(inspector, format);
+		std::vector<sinsp_replay_match>& matches = shard_matches[idx];
+		sinsp_evt* evt;
+
+		if(!filter.empty())
+		{
+			sinsp_filter_compiler compiler(inspector, filter);
+			flt.reset(compiler.compile());
+		}
+
+		while(true)
+		{
+			int32_t res = inspector->next(&evt);
+
+			if(res == SCAP_TIMEOUT)
+			{
+				continue;
+			}
+			else if(res == SCAP_EOF)
+			{
+				break;
+			}
+			else if(res != SCAP_SUCCESS)
+			{
+				throw sinsp_exception(inspector->getlasterr());
+			}
+
+			if(flt && !flt->run(evt))
+			{
+				continue;
+			}
+
+			sinsp_replay_match m;
+			m.m_shard = idx;
+			m.m_ts = evt->get_ts();
+			formatter.tostring(evt, &m.m_output);
+			matches.push_back(std::move(m));
+		}
+	}, nworkers);
+
+	//
+	// The shards don't overlap, so concatenating them keeps the order
+	//
+	std::vector<sinsp_replay_match> res;
+	for(auto& matches : shard_matches)
+	{
+		res.insert(res.end(),
+			std::make_move_iterator(matches.begin()),
+			std::make_move_iterator(matches.end()));
+	}
+
+	return res;
+}
+#endif
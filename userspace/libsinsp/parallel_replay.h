@@ -0,0 +1,111 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "settings.h"
+#include "sinsp_public.h"
+
+class sinsp;
+
+/*!
+  \brief A piece of a capture file produced by sinsp_parallel_replay::split()
+*/
+struct sinsp_replay_shard
+{
+	std::string m_filename;
+	uint64_t m_first_ts;
+	uint64_t m_last_ts;
+	uint64_t m_nevts;
+};
+
+/*!
+  \brief A filter match found while replaying the shards
+*/
+struct sinsp_replay_match
+{
+	uint32_t m_shard;
+	uint64_t m_ts;
+	std::string m_output;
+};
+
+/*!
+  \brief Replay a capture file on several threads.
+
+  split() reads the capture once and writes it back as a sequence of
+  smaller files with consecutive, non overlapping time ranges. Each of
+  them starts with the process, fd and container tables as they were
+  right before its first event, written as the usual proclist/fdlist
+  blocks, so it can be opened on its own and parsed with the same state
+  the sequential read would have at that point.
+
+  The shards are then read by a pool of workers, each one with its own
+  inspector, and the results are put back together in shard order, which
+  is also timestamp order.
+*/
+class SINSP_PUBLIC sinsp_parallel_replay
+{
+public:
+	typedef std::function<void(uint32_t shard_idx, sinsp* inspector)> shard_callback_t;
+
+	sinsp_parallel_replay(const std::vector<sinsp_replay_shard>& shards);
+
+	/*!
+	  \brief Split a capture file in shards of events_per_shard events,
+	  named <output_prefix>_<n>.scap.
+
+	  \note throws a sinsp_exception if the input can't be read or the
+	  shards can't be written.
+	*/
+	static std::vector<sinsp_replay_shard> split(const std::string& input,
+		const std::string& output_prefix,
+		uint64_t events_per_shard,
+		bool compress);
+
+	/*!
+	  \brief Open every shard in an inspector of its own and call cb on
+	  it, from up to nworkers threads at the same time. cb is expected to
+	  read the events. Returns when all the shards have been processed.
+
+	  \note if cb throws, the exception of the first shard that failed is
+	  rethrown once the workers have stopped.
+	*/
+	void for_each_shard(const shard_callback_t& cb, uint32_t nworkers);
+
+#ifdef HAS_FILTERING
+	/*!
+	  \brief Return the events matching filter, formatted with format,
+	  in timestamp order.
+	*/
+	std::vector<sinsp_replay_match> run(const std::string& filter,
+		const std::string& format,
+		uint32_t nworkers);
+#endif
+
+	inline const std::vector<sinsp_replay_shard>& get_shards() const
+	{
+		return m_shards;
+	}
+
+private:
+	std::vector<sinsp_replay_shard> m_shards;
+};
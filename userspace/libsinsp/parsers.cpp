@@ -146,6 +146,24 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	}
 #endif
 
+	//
+	// The tcp_* events aren't parsed, but they are aggregated before any
+	// filtering, so that the stats don't depend on the filter
+	//
+	if(m_inspector->m_tcp_stats != NULL &&
+	   m_inspector->m_tcp_stats->process_event(evt) &&
+	   m_inspector->suppress_tcp_events())
+	{
+		evt->m_filtered_out = true;
+		return;
+	}
+
+	if(m_inspector->m_cpu_analysis != NULL && etype == PPME_CPU_ANALYSIS_E)
+	{
+		m_inspector->m_cpu_analysis->process_event(evt,
+			evt->m_tinfo != NULL ? evt->m_tinfo->m_container_id : "");
+	}
+
 	if(m_drop_event_flags)
 	{
 		enum ppm_event_flags flags;
@@ -499,11 +517,10 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	}
 
 	// Check to see if the name changed as a side-effect of
-	// parsing this event. Try to avoid the overhead of a string
-	// compare for every event.
+	// parsing this event
 	if(evt->m_fdinfo)
 	{
-		evt->set_fdinfo_name_changed(evt->m_fdinfo->m_name != evt->m_fdinfo->m_oldname);
+		evt->set_fdinfo_name_changed(evt->m_fdinfo->is_name_changed());
 	}
 }
 
@@ -896,6 +913,9 @@ void sinsp_parser::register_event_callback(sinsp_pd_callback_type etype, sinsp_p
 	case CT_CONNECT:
 		m_connect_callbacks.push_back(dec);
 		break;
+	case CT_ACCEPT:
+		m_accept_callbacks.push_back(dec);
+		break;
 	default:
 		ASSERT(false);
 		break;
@@ -2514,7 +2534,7 @@ void sinsp_parser::parse_bind_exit(sinsp_evt *evt)
 	//
 	// Update the name of this socket
 	//
-	evt->m_fdinfo->m_name = evt->get_param_as_str(1, &parstr, sinsp_evt::PF_SIMPLE);
+	evt->m_fdinfo->set_name(evt->get_param_as_str(1, &parstr, sinsp_evt::PF_SIMPLE));
 
 	//
 	// If there's a listener callback, invoke it
@@ -2628,11 +2648,11 @@ inline void sinsp_parser::fill_client_socket_info(sinsp_evt *evt, uint8_t *packe
                                          (uint32_t)evt->m_paramstr_storage.size(),
                                          m_inspector->m_hostname_and_port_resolution_enabled);
 
-            evt->m_fdinfo->m_name = &evt->m_paramstr_storage[0];
+            evt->m_fdinfo->set_name(&evt->m_paramstr_storage[0]);
         }
         else
         {
-            evt->m_fdinfo->m_name = evt->get_param_as_str(1, &parstr, sinsp_evt::PF_SIMPLE);
+            evt->m_fdinfo->set_name(evt->get_param_as_str(1, &parstr, sinsp_evt::PF_SIMPLE));
         }
     }
     else
@@ -2650,7 +2670,7 @@ inline void sinsp_parser::fill_client_socket_info(sinsp_evt *evt, uint8_t *packe
         //
         // Add the friendly name to the fd info
         //
-        evt->m_fdinfo->m_name = evt->get_param_as_str(1, &parstr, sinsp_evt::PF_SIMPLE);
+        evt->m_fdinfo->set_name(evt->get_param_as_str(1, &parstr, sinsp_evt::PF_SIMPLE));
 
 #ifndef HAS_ANALYZER
         //
@@ -2840,7 +2860,7 @@ void sinsp_parser::parse_accept_exit(sinsp_evt *evt)
 		return;
 	}
 
-	fdi.m_name = evt->get_param_as_str(1, &parstr, sinsp_evt::PF_SIMPLE);
+	fdi.set_name(evt->get_param_as_str(1, &parstr, sinsp_evt::PF_SIMPLE));
 	fdi.m_flags = 0;
 
 	if(m_fd_listener)
@@ -2862,6 +2882,18 @@ void sinsp_parser::parse_accept_exit(sinsp_evt *evt)
 	// Add the entry to the table
 	//
 	evt->m_fdinfo = evt->m_tinfo->add_fd(fd, &fdi);
+
+	//
+	// Call the protocol decoder callbacks associated to this event
+	//
+	if(evt->m_fdinfo != NULL)
+	{
+		vector<sinsp_protodecoder*>::iterator it;
+		for(it = m_accept_callbacks.begin(); it != m_accept_callbacks.end(); ++it)
+		{
+			(*it)->on_event(evt, CT_ACCEPT);
+		}
+	}
 }
 
 void sinsp_parser::parse_close_enter(sinsp_evt *evt)
@@ -3005,7 +3037,7 @@ void sinsp_parser::add_pipe(sinsp_evt *evt, int64_t tid, int64_t fd, uint64_t in
 	// Populate the new fdi
 	//
 	fdi.m_type = SCAP_FD_FIFO;
-	fdi.m_name = "";
+	fdi.set_name("");
 	fdi.m_ino = ino;
 
 	//
@@ -3287,7 +3319,7 @@ bool sinsp_parser::update_fd(sinsp_evt *evt, sinsp_evt_param *parinfo)
 			return false;
 		}
 
-		evt->m_fdinfo->m_name = ((char*)packed_data) + 17;
+		evt->m_fdinfo->set_name(((char*)packed_data) + 17);
 
 		//
 		// Call the protocol decoder callbacks to notify the decoders that this FD
@@ -3638,11 +3670,11 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 							(uint32_t)evt->m_paramstr_storage.size(),
 							m_inspector->m_hostname_and_port_resolution_enabled);
 
-						evt->m_fdinfo->m_name = &evt->m_paramstr_storage[0];
+						evt->m_fdinfo->set_name(&evt->m_paramstr_storage[0]);
 					}
 					else
 					{
-						evt->m_fdinfo->m_name = evt->get_param_as_str(tupleparam, &parstr, sinsp_evt::PF_SIMPLE);
+						evt->m_fdinfo->set_name(evt->get_param_as_str(tupleparam, &parstr, sinsp_evt::PF_SIMPLE));
 					}
 				}
 			}
@@ -3674,9 +3706,9 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 			//
 			// Call the protocol decoder callbacks associated to this event
 			//
-			if(evt->m_fdinfo->m_callbacks)
+			if(evt->m_fdinfo->has_decoder_callbacks())
 			{
-				vector<sinsp_protodecoder*>* cbacks = &(evt->m_fdinfo->m_callbacks->m_read_callbacks);
+				vector<sinsp_protodecoder*>* cbacks = &(evt->m_fdinfo->get_callbacks()->m_read_callbacks);
 
 				for(auto it = cbacks->begin(); it != cbacks->end(); ++it)
 				{
@@ -3734,11 +3766,11 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 							(uint32_t)evt->m_paramstr_storage.size(),
 							m_inspector->m_hostname_and_port_resolution_enabled);
 
-						evt->m_fdinfo->m_name = &evt->m_paramstr_storage[0];
+						evt->m_fdinfo->set_name(&evt->m_paramstr_storage[0]);
 					}
 					else
 					{
-						evt->m_fdinfo->m_name = enter_evt->get_param_as_str(tupleparam, &parstr, sinsp_evt::PF_SIMPLE);
+						evt->m_fdinfo->set_name(enter_evt->get_param_as_str(tupleparam, &parstr, sinsp_evt::PF_SIMPLE));
 					}
 				}
 			}
@@ -3762,9 +3794,9 @@ void sinsp_parser::parse_rw_exit(sinsp_evt *evt)
 			//
 			// Call the protocol decoder callbacks associated to this event
 			//
-			if(evt->m_fdinfo->m_callbacks)
+			if(evt->m_fdinfo->has_decoder_callbacks())
 			{
-				vector<sinsp_protodecoder*>* cbacks = &(evt->m_fdinfo->m_callbacks->m_write_callbacks);
+				vector<sinsp_protodecoder*>* cbacks = &(evt->m_fdinfo->get_callbacks()->m_write_callbacks);
 
 				for(auto it = cbacks->begin(); it != cbacks->end(); ++it)
 				{
@@ -3862,7 +3894,7 @@ void sinsp_parser::parse_eventfd_exit(sinsp_evt *evt)
 	// Populate the new fdi
 	//
 	fdi.m_type = SCAP_FD_EVENT;
-	fdi.m_name = "";
+	fdi.set_name("");
 
 	//
 	// Add the fd to the table.
@@ -4121,7 +4153,7 @@ void sinsp_parser::parse_signalfd_exit(sinsp_evt *evt)
 		// Populate the new fdi
 		//
 		fdi.m_type = SCAP_FD_SIGNALFD;
-		fdi.m_name = "";
+		fdi.set_name("");
 
 		//
 		// Add the fd to the table.
@@ -4158,7 +4190,7 @@ void sinsp_parser::parse_timerfd_create_exit(sinsp_evt *evt)
 		// Populate the new fdi
 		//
 		fdi.m_type = SCAP_FD_TIMERFD;
-		fdi.m_name = "";
+		fdi.set_name("");
 
 		//
 		// Add the fd to the table.
@@ -4195,7 +4227,7 @@ void sinsp_parser::parse_inotify_init_exit(sinsp_evt *evt)
 		// Populate the new fdi
 		//
 		fdi.m_type = SCAP_FD_INOTIFY;
-		fdi.m_name = "";
+		fdi.set_name("");
 
 		//
 		// Add the fd to the table.
@@ -71,6 +71,7 @@ public:
 	//
 	vector<sinsp_protodecoder*> m_open_callbacks;
 	vector<sinsp_protodecoder*> m_connect_callbacks;
+	vector<sinsp_protodecoder*> m_accept_callbacks;
 
 	ppm_event_flags m_drop_event_flags;
 
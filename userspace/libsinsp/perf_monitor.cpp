@@ -0,0 +1,205 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "perf_monitor.h"
+
+static const char* s_stage_names[SINSP_PERF_MAX_STAGE] =
+{
+	"scap_next",
+	"parser",
+	"filter",
+	"formatter",
+	"dumper",
+	"external_processor",
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_perf_histogram implementation
+///////////////////////////////////////////////////////////////////////////////
+void sinsp_perf_histogram::clear()
+{
+	m_count = 0;
+	m_sum = 0;
+	m_max = 0;
+	memset(m_buckets, 0, sizeof(m_buckets));
+}
+
+uint64_t sinsp_perf_histogram::percentile(double pct) const
+{
+	if(m_count == 0)
+	{
+		return 0;
+	}
+
+	uint64_t target = (uint64_t)(m_count * pct / 100);
+	uint64_t seen = 0;
+
+	for(uint32_t j = 0; j <= NBUCKETS; j++)
+	{
+		seen += m_buckets[j];
+		if(seen > target)
+		{
+			if(j == 0 || j == NBUCKETS)
+			{
+				return j == 0 ? 0 : m_max;
+			}
+			return std::min(m_max, (uint64_t)((1ULL << j) - 1));
+		}
+	}
+
+	return m_max;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_perf_report implementation
+///////////////////////////////////////////////////////////////////////////////
+std::string sinsp_perf_report::to_string(uint32_t top_n) const
+{
+	std::string res;
+	char line[256];
+
+	snprintf(line, sizeof(line), "%-20s %12s %12s %10s %10s %10s %10s\n",
+		 "stage", "count", "total(ms)", "avg(ns)", "p50(ns)", "p99(ns)", "max(ns)");
+	res += line;
+
+	for(uint32_t j = 0; j < SINSP_PERF_MAX_STAGE; j++)
+	{
+		const sinsp_perf_histogram& h = m_stages[j];
+		snprintf(line, sizeof(line), "%-20s %12" PRIu64 " %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+			 s_stage_names[j],
+			 h.m_count,
+			 ticks_to_ns(h.m_sum) / 1000000,
+			 h.m_count ? ticks_to_ns(h.m_sum / h.m_count) : 0,
+			 ticks_to_ns(h.percentile(50)),
+			 ticks_to_ns(h.percentile(99)),
+			 ticks_to_ns(h.m_max));
+		res += line;
+	}
+
+	//
+	// Most expensive event types, parser and filters together
+	//
+	std::vector<std::pair<uint64_t, uint16_t>> by_cost;
+	for(uint32_t j = 0; j < m_parser_by_evt.size(); j++)
+	{
+		uint64_t sum = m_parser_by_evt[j].m_sum + m_filter_by_evt[j].m_sum;
+		if(sum != 0)
+		{
+			by_cost.push_back(std::make_pair(sum, (uint16_t)j));
+		}
+	}
+	std::sort(by_cost.rbegin(), by_cost.rend());
+
+	snprintf(line, sizeof(line), "\n%-20s %12s %12s %12s %10s %10s\n",
+		 "event", "count", "parser(ms)", "filter(ms)", "avg(ns)", "max(ns)");
+	res += line;
+
+	const struct ppm_event_info* etable = g_infotables.m_event_info;
+	for(uint32_t j = 0; j < by_cost.size() && j < top_n; j++)
+	{
+		uint16_t etype = by_cost[j].second;
+		const sinsp_perf_evt_stats& p = m_parser_by_evt[etype];
+		const sinsp_perf_evt_stats& f = m_filter_by_evt[etype];
+
+		snprintf(line, sizeof(line), "%-18s%c %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+			 etable[etype].name,
+			 PPME_IS_ENTER(etype) ? '>' : '<',
+			 p.m_count,
+			 ticks_to_ns(p.m_sum) / 1000000,
+			 ticks_to_ns(f.m_sum) / 1000000,
+			 p.m_count ? ticks_to_ns((p.m_sum + f.m_sum) / p.m_count) : 0,
+			 ticks_to_ns(std::max(p.m_max, f.m_max)));
+		res += line;
+	}
+
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_perf_monitor implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_perf_monitor::sinsp_perf_monitor():
+	m_enabled(false),
+	m_start_ns(0),
+	m_evt_filter_ticks(0)
+{
+	m_report.m_ns_per_tick = 1;
+	m_report.m_duration_ns = 0;
+}
+
+void sinsp_perf_monitor::set_enabled(bool enabled)
+{
+	if(enabled && !m_enabled)
+	{
+		//
+		// The per-event tables are only allocated when needed
+		//
+		m_report.m_parser_by_evt.resize(PPM_EVENT_MAX);
+		m_report.m_filter_by_evt.resize(PPM_EVENT_MAX);
+		m_report.m_ns_per_tick = calibrate();
+		reset();
+	}
+
+	m_enabled = enabled;
+}
+
+sinsp_perf_report sinsp_perf_monitor::get_report() const
+{
+	sinsp_perf_report report = m_report;
+	report.m_duration_ns = m_start_ns ? sinsp_utils::get_current_time_ns() - m_start_ns : 0;
+	return report;
+}
+
+void sinsp_perf_monitor::reset()
+{
+	for(uint32_t j = 0; j < SINSP_PERF_MAX_STAGE; j++)
+	{
+		m_report.m_stages[j].clear();
+	}
+
+	std::fill(m_report.m_parser_by_evt.begin(), m_report.m_parser_by_evt.end(), sinsp_perf_evt_stats());
+	std::fill(m_report.m_filter_by_evt.begin(), m_report.m_filter_by_evt.end(), sinsp_perf_evt_stats());
+	m_evt_filter_ticks = 0;
+	m_start_ns = sinsp_utils::get_current_time_ns();
+}
+
+//
+// Measure the tick frequency against the monotonic clock
+//
+double sinsp_perf_monitor::calibrate()
+{
+#if defined(_WIN32) || defined(__x86_64__) || defined(__i386__)
+	auto start = std::chrono::steady_clock::now();
+	uint64_t start_ticks = ticks();
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	uint64_t elapsed_ticks = ticks() - start_ticks;
+	uint64_t elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+
+	return elapsed_ticks ? (double)elapsed_ns / elapsed_ticks : 1;
+#else
+	return 1;
+#endif
+}
@@ -0,0 +1,213 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+#include "sinsp_public.h"
+
+//
+// Stages of the event loop that can be timed
+//
+enum sinsp_perf_stage
+{
+	SINSP_PERF_SCAP_NEXT = 0, ///< waiting for scap_next()
+	SINSP_PERF_PARSER, ///< sinsp_parser::process_event(), filters excluded
+	SINSP_PERF_FILTER, ///< filter evaluation
+	SINSP_PERF_FORMATTER, ///< sinsp_evt_formatter::tostring()
+	SINSP_PERF_DUMPER, ///< writing events to capture files
+	SINSP_PERF_EXTERNAL_PROCESSOR, ///< the registered event_processor
+	SINSP_PERF_MAX_STAGE
+};
+
+/*!
+  \brief Latency histogram with power of two buckets.
+  Bucket N counts the samples with a duration in [2^(N-1), 2^N) ticks.
+*/
+class SINSP_PUBLIC sinsp_perf_histogram
+{
+public:
+	static const uint32_t NBUCKETS = 64;
+
+	sinsp_perf_histogram()
+	{
+		clear();
+	}
+
+	inline void add(uint64_t ticks)
+	{
+		m_buckets[bucket(ticks)]++;
+		m_count++;
+		m_sum += ticks;
+		if(ticks > m_max)
+		{
+			m_max = ticks;
+		}
+	}
+
+	void clear();
+
+	/*!
+	  \brief Upper bound of the given percentile (0-100), in ticks
+	*/
+	uint64_t percentile(double pct) const;
+
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_max;
+	uint64_t m_buckets[NBUCKETS + 1];
+
+private:
+	static inline uint32_t bucket(uint64_t ticks)
+	{
+		if(ticks == 0)
+		{
+			return 0;
+		}
+#ifdef _WIN32
+		unsigned long idx;
+		_BitScanReverse64(&idx, ticks);
+		return idx + 1;
+#else
+		return 64 - __builtin_clzll(ticks);
+#endif
+	}
+};
+
+/*!
+  \brief Totals for a single event type
+*/
+struct sinsp_perf_evt_stats
+{
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_max;
+};
+
+/*!
+  \brief Snapshot of the event loop timings returned by sinsp::get_perf_report().
+  Durations are in ticks, convert them with ticks_to_ns().
+*/
+class SINSP_PUBLIC sinsp_perf_report
+{
+public:
+	inline uint64_t ticks_to_ns(uint64_t ticks) const
+	{
+		return (uint64_t)(ticks * m_ns_per_tick);
+	}
+
+	/*!
+	  \brief Human readable report, with the top_n most expensive event types
+	*/
+	std::string to_string(uint32_t top_n = 20) const;
+
+	double m_ns_per_tick;
+	uint64_t m_duration_ns; ///< Wall time covered by the report
+	sinsp_perf_histogram m_stages[SINSP_PERF_MAX_STAGE];
+	std::vector<sinsp_perf_evt_stats> m_parser_by_evt; ///< Indexed by event type
+	std::vector<sinsp_perf_evt_stats> m_filter_by_evt; ///< Indexed by event type
+};
+
+/*!
+  \brief Runtime-toggleable instrumentation of the event loop.
+  Timestamps come from the TSC where available, so that timing a stage costs
+  a few nanoseconds. When disabled, the cost is a predictable branch.
+*/
+class SINSP_PUBLIC sinsp_perf_monitor
+{
+public:
+	sinsp_perf_monitor();
+
+	void set_enabled(bool enabled);
+
+	inline bool enabled() const
+	{
+		return m_enabled;
+	}
+
+	static inline uint64_t ticks()
+	{
+#if defined(_WIN32) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	inline void add(sinsp_perf_stage stage, uint64_t ticks)
+	{
+		m_report.m_stages[stage].add(ticks);
+	}
+
+	inline void add_parser(uint16_t etype, uint64_t ticks)
+	{
+		// the time spent in filters is accounted separately
+		ticks = ticks > m_evt_filter_ticks ? ticks - m_evt_filter_ticks : 0;
+		m_report.m_stages[SINSP_PERF_PARSER].add(ticks);
+		add_evt(m_report.m_parser_by_evt, etype, ticks);
+		m_evt_filter_ticks = 0;
+	}
+
+	inline void add_filter(uint16_t etype, uint64_t ticks)
+	{
+		m_report.m_stages[SINSP_PERF_FILTER].add(ticks);
+		add_evt(m_report.m_filter_by_evt, etype, ticks);
+		m_evt_filter_ticks += ticks;
+	}
+
+	/*!
+	  \brief Return the timings collected since the instrumentation was
+	  enabled or since the last reset
+	*/
+	sinsp_perf_report get_report() const;
+
+	void reset();
+
+private:
+	static inline void add_evt(std::vector<sinsp_perf_evt_stats>& stats, uint16_t etype, uint64_t ticks)
+	{
+		if(etype < stats.size())
+		{
+			sinsp_perf_evt_stats& s = stats[etype];
+			s.m_count++;
+			s.m_sum += ticks;
+			if(ticks > s.m_max)
+			{
+				s.m_max = ticks;
+			}
+		}
+	}
+
+	static double calibrate();
+
+	bool m_enabled;
+	uint64_t m_start_ns;
+	uint64_t m_evt_filter_ticks;
+	sinsp_perf_report m_report;
+};
@@ -0,0 +1,76 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "proc_async_source.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+sinsp_proc_async_source::sinsp_proc_async_source(scap_t* reader, uint64_t ttl_ms):
+	async_key_value_source(NO_WAIT_LOOKUP, ttl_ms),
+	m_reader(reader, scap_proc_reader_close),
+	m_n_ready(0)
+{
+}
+
+sinsp_proc_async_source::~sinsp_proc_async_source()
+{
+	this->stop();
+}
+
+void sinsp_proc_async_source::queue(int64_t tid, bool scan_sockets)
+{
+	std::shared_ptr<scap_threadinfo> res;
+	lookup(sinsp_proc_lookup_request(tid, scan_sockets), res);
+}
+
+sinsp_proc_async_source::results_t sinsp_proc_async_source::get_results()
+{
+	m_n_ready.store(0, std::memory_order_relaxed);
+	return get_complete_results();
+}
+
+void sinsp_proc_async_source::run_impl()
+{
+	sinsp_proc_lookup_request request;
+
+	while(dequeue_next_key(request))
+	{
+		std::shared_ptr<scap_threadinfo> res;
+		scap_threadinfo* pi = scap_proc_get(m_reader.get(), request.m_tid, request.m_scan_sockets);
+
+		if(pi != NULL)
+		{
+			//
+			// The fd list is freed through the reader that filled it
+			//
+			std::shared_ptr<scap_t> reader = m_reader;
+			res.reset(pi, [reader](scap_threadinfo* p)
+			{
+				scap_proc_free(reader.get(), p);
+			});
+		}
+		else
+		{
+			g_logger.format(sinsp_logger::SEV_DEBUG,
+					"proc_async (%" PRId64 "): lookup failed: %s",
+					request.m_tid, scap_getlasterr(m_reader.get()));
+		}
+
+		store_value(request, res);
+		m_n_ready.store(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+#include "async_key_value_source.h"
+#include "scap.h"
+
+/*!
+  \brief A /proc lookup for a thread that was first seen in an event
+*/
+struct sinsp_proc_lookup_request
+{
+	sinsp_proc_lookup_request():
+		m_tid(0),
+		m_scan_sockets(false)
+	{
+	}
+
+	sinsp_proc_lookup_request(int64_t tid, bool scan_sockets):
+		m_tid(tid),
+		m_scan_sockets(scan_sockets)
+	{
+	}
+
+	bool operator<(const sinsp_proc_lookup_request& rhs) const
+	{
+		if(m_tid != rhs.m_tid)
+		{
+			return m_tid < rhs.m_tid;
+		}
+
+		return m_scan_sockets < rhs.m_scan_sockets;
+	}
+
+	bool operator==(const sinsp_proc_lookup_request& rhs) const
+	{
+		return m_tid == rhs.m_tid && m_scan_sockets == rhs.m_scan_sockets;
+	}
+
+	int64_t m_tid;
+	bool m_scan_sockets;
+};
+
+namespace std {
+/**
+ * \brief Specialization of std::hash for sinsp_proc_lookup_request
+ *
+ * It allows `sinsp_proc_lookup_request` instances to be used as `unordered_map` keys
+ */
+template<> struct hash<sinsp_proc_lookup_request> {
+	std::size_t operator()(const sinsp_proc_lookup_request& h) const {
+		return ::std::hash<int64_t>{}(h.m_tid) ^ (size_t)h.m_scan_sockets;
+	}
+};
+}
+
+/*!
+  \brief Reads /proc in a background thread for the thread manager.
+
+  The lookups go through a reader handle obtained from
+  scap_proc_reader_open(), so they never touch the state of the capture
+  handle. Each result owns a reference to the reader, which is closed
+  when both the source and all the results are gone. A NULL result means
+  that the thread could not be read, most likely because it's gone.
+*/
+class sinsp_proc_async_source : public sysdig::async_key_value_source<sinsp_proc_lookup_request, std::shared_ptr<scap_threadinfo>>
+{
+public:
+	typedef std::unordered_map<sinsp_proc_lookup_request, std::shared_ptr<scap_threadinfo>> results_t;
+
+	//
+	// Takes ownership of reader
+	//
+	sinsp_proc_async_source(scap_t* reader, uint64_t ttl_ms);
+	virtual ~sinsp_proc_async_source();
+
+	void queue(int64_t tid, bool scan_sockets);
+
+	/*!
+	  \brief Cheap check that can be done on every event
+	*/
+	inline bool has_results() const
+	{
+		return m_n_ready.load(std::memory_order_relaxed) != 0;
+	}
+
+	results_t get_results();
+
+	void quiesce()
+	{
+		async_key_value_source::stop();
+	}
+
+protected:
+	void run_impl() override;
+
+private:
+	std::shared_ptr<scap_t> m_reader;
+	std::atomic<uint32_t> m_n_ready;
+};
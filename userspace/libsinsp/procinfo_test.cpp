@@ -53,9 +53,9 @@ TEST(procinfo_single_thread,add_existing_fd)
 {
 	sinsp_procinfo procinfo = make_procinfo(0);
 	sinsp_fdinfo fdinfo1;
-	fdinfo1.m_name = "a";
+	fdinfo1.set_name("a");
 	sinsp_fdinfo fdinfo2;
-	fdinfo2.m_name = "b";
+	fdinfo2.set_name("b");
 	procinfo.add_fd(0, &fdinfo1);
 	procinfo.add_fd(0, &fdinfo2);
 	EXPECT_EQ("b", procinfo.m_fdtable[0].m_name);
@@ -65,7 +65,7 @@ TEST(procinfo_single_thread,get_existing_fd)
 {
 	sinsp_procinfo procinfo = make_procinfo(0);
 	sinsp_fdinfo fdinfo;
-	fdinfo.m_name = "a";
+	fdinfo.set_name("a");
 	procinfo.add_fd(0, &fdinfo);
 	EXPECT_EQ("a", procinfo.get_fd(0)->m_name);
 }
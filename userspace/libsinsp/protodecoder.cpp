@@ -87,6 +87,58 @@ void sinsp_protodecoder::unregister_write_callback(sinsp_fdinfo_t* fdinfo)
 	fdinfo->unregister_event_callback(CT_WRITE, this);
 }
 
+sinsp_protodecoder_state* sinsp_protodecoder::get_fd_state(sinsp_fdinfo_t* fdinfo)
+{
+	fd_callbacks_info* callbacks = fdinfo->get_callbacks();
+
+	if(callbacks == NULL)
+	{
+		return NULL;
+	}
+
+	for(auto& it : callbacks->m_decoder_states)
+	{
+		if(it.first == this)
+		{
+			return it.second;
+		}
+	}
+
+	return NULL;
+}
+
+void sinsp_protodecoder::set_fd_state(sinsp_fdinfo_t* fdinfo, sinsp_protodecoder_state* state)
+{
+	if(fdinfo->get_callbacks() == NULL && state == NULL)
+	{
+		return;
+	}
+
+	auto& states = fdinfo->create_callbacks()->m_decoder_states;
+	for(auto it = states.begin(); it != states.end(); ++it)
+	{
+		if(it->first == this)
+		{
+			delete it->second;
+
+			if(state != NULL)
+			{
+				it->second = state;
+			}
+			else
+			{
+				states.erase(it);
+			}
+			return;
+		}
+	}
+
+	if(state != NULL)
+	{
+		states.push_back(std::make_pair(this, state));
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_protodecoder_list implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -96,6 +148,11 @@ sinsp_protodecoder_list::sinsp_protodecoder_list()
 	// ADD NEW DECODER CLASSES HERE
 	//////////////////////////////////////////////////////////////////////////////
 	add_protodecoder(new sinsp_decoder_syslog());
+	add_protodecoder(new sinsp_decoder_http());
+	add_protodecoder(new sinsp_decoder_db(SINSP_DB_MYSQL));
+	add_protodecoder(new sinsp_decoder_db(SINSP_DB_PGSQL));
+	add_protodecoder(new sinsp_decoder_db(SINSP_DB_REDIS));
+	add_protodecoder(new sinsp_decoder_db(SINSP_DB_KAFKA));
 }
 
 sinsp_protodecoder_list::~sinsp_protodecoder_list()
@@ -327,3 +384,315 @@ bool sinsp_decoder_syslog::get_info_line(char** res)
 	*res = (char*)m_infostr.c_str();
 	return (m_priority != -1);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_decoder_http implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_decoder_http::sinsp_decoder_http()
+{
+	m_name = "http";
+	m_valid = false;
+}
+
+sinsp_protodecoder* sinsp_decoder_http::allocate_new()
+{
+	return (sinsp_protodecoder*) new sinsp_decoder_http();
+}
+
+void sinsp_decoder_http::init()
+{
+	// CT_OPEN is needed to receive the sockets found in /proc
+	register_event_callback(CT_OPEN);
+	register_event_callback(CT_CONNECT);
+	register_event_callback(CT_ACCEPT);
+}
+
+void sinsp_decoder_http::track(sinsp_fdinfo_t* fdinfo)
+{
+	if(fdinfo->m_type == SCAP_FD_IPV4_SOCK || fdinfo->m_type == SCAP_FD_IPV6_SOCK)
+	{
+		scap_l4_proto l4proto = fdinfo->get_l4proto();
+		if(l4proto == SCAP_L4_UDP || l4proto == SCAP_L4_ICMP || l4proto == SCAP_L4_RAW)
+		{
+			return;
+		}
+	}
+	else if(fdinfo->m_type != SCAP_FD_UNIX_SOCK)
+	{
+		return;
+	}
+
+	register_read_callback(fdinfo);
+	register_write_callback(fdinfo);
+}
+
+void sinsp_decoder_http::on_fd_from_proc(sinsp_fdinfo_t* fdinfo)
+{
+	if(fdinfo == NULL)
+	{
+		ASSERT(false);
+		return;
+	}
+
+	track(fdinfo);
+}
+
+void sinsp_decoder_http::on_event(sinsp_evt* evt, sinsp_pd_callback_type etype)
+{
+	if(etype != CT_CONNECT && etype != CT_ACCEPT)
+	{
+		return;
+	}
+
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	if(fdinfo == NULL)
+	{
+		return;
+	}
+
+	//
+	// A new connection on a reused fd number, drop what we knew about
+	// the previous one
+	//
+	set_fd_state(fdinfo, NULL);
+
+	track(fdinfo);
+}
+
+void sinsp_decoder_http::on_read(sinsp_evt* evt, char *data, uint32_t len)
+{
+	on_data(evt, true, data, len);
+}
+
+void sinsp_decoder_http::on_write(sinsp_evt* evt, char *data, uint32_t len)
+{
+	on_data(evt, false, data, len);
+}
+
+void sinsp_decoder_http::on_data(sinsp_evt* evt, bool is_read, char *data, uint32_t len)
+{
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	sinsp_evt_param* parinfo = evt->get_param(0);
+	ASSERT(parinfo->m_len == sizeof(int64_t));
+	int64_t retval = *(int64_t*)parinfo->m_val;
+
+	if(fdinfo == NULL || retval <= 0)
+	{
+		return;
+	}
+
+	conn_state* state = (conn_state*)get_fd_state(fdinfo);
+	if(state == NULL)
+	{
+		state = new conn_state();
+		set_fd_state(fdinfo, state);
+	}
+
+	if(state->m_conn.on_data(is_read, evt->get_ts(), data, len, retval, &m_transaction))
+	{
+		m_valid = true;
+		m_inspector->protodecoder_register_reset(this);
+
+		if(m_transaction_cb)
+		{
+			m_transaction_cb(evt, m_transaction);
+		}
+	}
+	else if(state->m_conn.is_not_http())
+	{
+		//
+		// The callbacks can't be removed while the engine is looping
+		// through them, do it when the next event starts
+		//
+		m_untrack_list.push_back(fdinfo);
+		m_inspector->protodecoder_register_reset(this);
+	}
+}
+
+void sinsp_decoder_http::on_reset(sinsp_evt* evt)
+{
+	m_valid = false;
+
+	for(sinsp_fdinfo_t* fdinfo : m_untrack_list)
+	{
+		if(fdinfo->has_decoder_callbacks())
+		{
+			unregister_read_callback(fdinfo);
+			unregister_write_callback(fdinfo);
+			set_fd_state(fdinfo, NULL);
+		}
+	}
+	m_untrack_list.clear();
+}
+
+void sinsp_decoder_http::set_transaction_callback(transaction_cb cb)
+{
+	m_transaction_cb = cb;
+}
+
+bool sinsp_decoder_http::get_info_line(char** res)
+{
+	if(!m_valid)
+	{
+		return false;
+	}
+
+	m_infostr = "http " + m_transaction.m_method + " " + m_transaction.m_url +
+		" " + to_string(m_transaction.m_status) +
+		" latency=" + to_string(m_transaction.m_latency_ns / 1000) + "us";
+
+	*res = (char*)m_infostr.c_str();
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_decoder_db implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_decoder_db::sinsp_decoder_db(sinsp_db_protocol protocol)
+{
+	m_protocol = protocol;
+	m_port = default_port(protocol);
+	m_name = sinsp_db_conn::protocol_name(protocol);
+	m_valid = false;
+}
+
+sinsp_protodecoder* sinsp_decoder_db::allocate_new()
+{
+	return (sinsp_protodecoder*) new sinsp_decoder_db(m_protocol);
+}
+
+uint16_t sinsp_decoder_db::default_port(sinsp_db_protocol protocol)
+{
+	switch(protocol)
+	{
+	case SINSP_DB_MYSQL:
+		return 3306;
+	case SINSP_DB_PGSQL:
+		return 5432;
+	case SINSP_DB_REDIS:
+		return 6379;
+	case SINSP_DB_KAFKA:
+		return 9092;
+	default:
+		ASSERT(false);
+		return 0;
+	}
+}
+
+void sinsp_decoder_db::init()
+{
+	// CT_OPEN is needed to receive the sockets found in /proc
+	register_event_callback(CT_OPEN);
+	register_event_callback(CT_CONNECT);
+	register_event_callback(CT_ACCEPT);
+}
+
+void sinsp_decoder_db::track(sinsp_fdinfo_t* fdinfo)
+{
+	if(fdinfo->get_serverport() != m_port || fdinfo->get_l4proto() != SCAP_L4_TCP)
+	{
+		return;
+	}
+
+	register_read_callback(fdinfo);
+	register_write_callback(fdinfo);
+}
+
+void sinsp_decoder_db::on_fd_from_proc(sinsp_fdinfo_t* fdinfo)
+{
+	if(fdinfo == NULL)
+	{
+		ASSERT(false);
+		return;
+	}
+
+	track(fdinfo);
+}
+
+void sinsp_decoder_db::on_event(sinsp_evt* evt, sinsp_pd_callback_type etype)
+{
+	if(etype != CT_CONNECT && etype != CT_ACCEPT)
+	{
+		return;
+	}
+
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	if(fdinfo == NULL)
+	{
+		return;
+	}
+
+	set_fd_state(fdinfo, NULL);
+
+	track(fdinfo);
+}
+
+void sinsp_decoder_db::on_read(sinsp_evt* evt, char *data, uint32_t len)
+{
+	on_data(evt, true, data, len);
+}
+
+void sinsp_decoder_db::on_write(sinsp_evt* evt, char *data, uint32_t len)
+{
+	on_data(evt, false, data, len);
+}
+
+void sinsp_decoder_db::on_data(sinsp_evt* evt, bool is_read, char *data, uint32_t len)
+{
+	sinsp_fdinfo_t* fdinfo = evt->get_fd_info();
+	sinsp_evt_param* parinfo = evt->get_param(0);
+	ASSERT(parinfo->m_len == sizeof(int64_t));
+	int64_t retval = *(int64_t*)parinfo->m_val;
+
+	if(fdinfo == NULL || retval <= 0)
+	{
+		return;
+	}
+
+	//
+	// The role is known for the connections seen being established, the
+	// ones found in /proc without a role are taken as clients
+	//
+	conn_state* state = (conn_state*)get_fd_state(fdinfo);
+	if(state == NULL)
+	{
+		state = new conn_state(m_protocol, fdinfo->is_role_server());
+		set_fd_state(fdinfo, state);
+	}
+
+	if(state->m_conn.on_data(is_read, evt->get_ts(), data, len, retval, &m_transaction))
+	{
+		m_valid = true;
+		m_inspector->protodecoder_register_reset(this);
+
+		if(m_transaction_cb)
+		{
+			m_transaction_cb(evt, m_transaction);
+		}
+	}
+}
+
+void sinsp_decoder_db::on_reset(sinsp_evt* evt)
+{
+	m_valid = false;
+}
+
+void sinsp_decoder_db::set_transaction_callback(transaction_cb cb)
+{
+	m_transaction_cb = cb;
+}
+
+bool sinsp_decoder_db::get_info_line(char** res)
+{
+	if(!m_valid)
+	{
+		return false;
+	}
+
+	m_infostr = m_name + " " + m_transaction.m_op +
+		(m_transaction.m_is_error ? " error" : "") +
+		" latency=" + to_string(m_transaction.m_latency_ns / 1000) + "us";
+
+	*res = (char*)m_infostr.c_str();
+	return true;
+}
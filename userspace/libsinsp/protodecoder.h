@@ -17,6 +17,10 @@ limitations under the License.
 
 #pragma once
 
+#include <functional>
+#include "http_transaction.h"
+#include "db_transaction.h"
+
 ///////////////////////////////////////////////////////////////////////////////
 // The protocol decoder interface
 ///////////////////////////////////////////////////////////////////////////////
@@ -84,6 +88,14 @@ protected:
 	void unregister_read_callback(sinsp_fdinfo_t* fdinfo);
 	void unregister_write_callback(sinsp_fdinfo_t* fdinfo);
 
+	//
+	// Per-connection state of this decoder, stored in the fd so that it
+	// goes away with it. set_fd_state() takes ownership of state and
+	// deletes the previous one; pass NULL to just drop it.
+	//
+	sinsp_protodecoder_state* get_fd_state(sinsp_fdinfo_t* fdinfo);
+	void set_fd_state(sinsp_fdinfo_t* fdinfo, sinsp_protodecoder_state* state);
+
 	string m_name;
 	sinsp* m_inspector;
 
@@ -111,8 +123,8 @@ private:
 
 ///////////////////////////////////////////////////////////////////////////////
 // Decoder classes
-// NOTE: these should be moved to a separate file but, since we have only one
-//       for the moment, we keep it here
+// NOTE: the protocol parsing logic lives in separate files (e.g.
+//       http_transaction.h), only the glue with the engine is here
 ///////////////////////////////////////////////////////////////////////////////
 class sinsp_decoder_syslog : public sinsp_protodecoder
 {
@@ -140,3 +152,105 @@ private:
 	void decode_message(char *data, uint32_t len, char* pristr, uint32_t pristrlen);
 	string m_infostr;
 };
+
+//
+// Pairs HTTP/1.x requests and responses on TCP and unix sockets. The
+// transaction is available, through the http.* fields or the transaction
+// callback, on the read or write that completes the response headers.
+//
+class sinsp_decoder_http : public sinsp_protodecoder
+{
+public:
+	typedef std::function<void(sinsp_evt* evt, const sinsp_http_transaction& tr)> transaction_cb;
+
+	sinsp_decoder_http();
+	sinsp_protodecoder* allocate_new();
+	void init();
+	void on_fd_from_proc(sinsp_fdinfo_t* fdinfo);
+	void on_event(sinsp_evt* evt, sinsp_pd_callback_type etype);
+	void on_read(sinsp_evt* evt, char *data, uint32_t len);
+	void on_write(sinsp_evt* evt, char *data, uint32_t len);
+	void on_reset(sinsp_evt* evt);
+	bool get_info_line(char** res);
+
+	void set_transaction_callback(transaction_cb cb);
+
+	inline bool is_data_valid() const
+	{
+		return m_valid;
+	}
+
+	sinsp_http_transaction m_transaction;
+
+private:
+	struct conn_state : public sinsp_protodecoder_state
+	{
+		sinsp_http_conn m_conn;
+	};
+
+	void track(sinsp_fdinfo_t* fdinfo);
+	void on_data(sinsp_evt* evt, bool is_read, char *data, uint32_t len);
+
+	bool m_valid;
+	transaction_cb m_transaction_cb;
+	// fds found not to be HTTP, their callbacks are removed by on_reset()
+	std::vector<sinsp_fdinfo_t*> m_untrack_list;
+	string m_infostr;
+};
+
+//
+// Pairs requests and responses of one of the sinsp_db_protocol protocols
+// on the TCP connections to its well known server port. One instance is
+// registered per protocol, named after it (mysql, pgsql, redis, kafka).
+//
+class sinsp_decoder_db : public sinsp_protodecoder
+{
+public:
+	typedef std::function<void(sinsp_evt* evt, const sinsp_db_transaction& tr)> transaction_cb;
+
+	sinsp_decoder_db(sinsp_db_protocol protocol);
+	sinsp_protodecoder* allocate_new();
+	void init();
+	void on_fd_from_proc(sinsp_fdinfo_t* fdinfo);
+	void on_event(sinsp_evt* evt, sinsp_pd_callback_type etype);
+	void on_read(sinsp_evt* evt, char *data, uint32_t len);
+	void on_write(sinsp_evt* evt, char *data, uint32_t len);
+	void on_reset(sinsp_evt* evt);
+	bool get_info_line(char** res);
+
+	void set_transaction_callback(transaction_cb cb);
+
+	inline bool is_data_valid() const
+	{
+		return m_valid;
+	}
+
+	inline sinsp_db_protocol get_protocol() const
+	{
+		return m_protocol;
+	}
+
+	static uint16_t default_port(sinsp_db_protocol protocol);
+
+	sinsp_db_transaction m_transaction;
+
+private:
+	struct conn_state : public sinsp_protodecoder_state
+	{
+		conn_state(sinsp_db_protocol protocol, bool is_server):
+			m_conn(protocol, is_server)
+		{
+		}
+
+		sinsp_db_conn m_conn;
+	};
+
+	void track(sinsp_fdinfo_t* fdinfo);
+	void on_data(sinsp_evt* evt, bool is_read, char *data, uint32_t len);
+
+	sinsp_db_protocol m_protocol;
+	uint16_t m_port;
+	bool m_valid;
+	transaction_cb m_transaction_cb;
+	string m_infostr;
+};
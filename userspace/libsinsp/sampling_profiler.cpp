@@ -0,0 +1,386 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <unistd.h>
+#include <unwind.h>
+#include <sys/syscall.h>
+#endif
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "sampling_profiler.h"
+
+#ifdef __linux__
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// the profiler that owns the SIGPROF handler, if any
+static std::atomic<sinsp_sampling_profiler*> s_active_profiler(NULL);
+// number of signal handlers that may be using s_active_profiler
+static std::atomic<uint32_t> s_running_handlers(0);
+static std::once_flag s_handler_installed;
+
+struct unwind_state
+{
+	void** m_pcs;
+	uint32_t m_depth;
+	uint32_t m_skip;
+};
+
+static _Unwind_Reason_Code unwind_cb(struct _Unwind_Context* ctx, void* arg)
+{
+	unwind_state* state = (unwind_state*)arg;
+	uintptr_t pc = _Unwind_GetIP(ctx);
+
+	if(pc == 0)
+	{
+		return _URC_END_OF_STACK;
+	}
+
+	if(state->m_skip > 0)
+	{
+		state->m_skip--;
+		return _URC_NO_REASON;
+	}
+
+	state->m_pcs[state->m_depth++] = (void*)pc;
+	return state->m_depth < sinsp_sampling_profiler::MAX_DEPTH ? _URC_NO_REASON : _URC_END_OF_STACK;
+}
+#endif
+
+sinsp_sampling_profiler::sinsp_sampling_profiler():
+	m_enabled(false),
+	m_evt(NULL),
+	m_head(0),
+	m_tail(0),
+	m_n_drops(0),
+	m_n_samples(0)
+{
+}
+
+sinsp_sampling_profiler::~sinsp_sampling_profiler()
+{
+	stop();
+}
+
+size_t sinsp_sampling_profiler::stack_key_hash::operator()(const std::vector<uintptr_t>& key) const
+{
+	size_t hash = 0;
+	for(uintptr_t pc : key)
+	{
+		hash = hash * 1099511628211ULL ^ pc;
+	}
+	return hash;
+}
+
+#ifdef __linux__
+void sinsp_sampling_profiler::start(uint32_t frequency_hz, const sinsp_evt* evt)
+{
+	if(m_enabled)
+	{
+		return;
+	}
+
+	if(frequency_hz == 0 || frequency_hz > 10000)
+	{
+		throw sinsp_exception("invalid sampling profiler frequency " + std::to_string(frequency_hz));
+	}
+
+	sinsp_sampling_profiler* expected = NULL;
+	if(!s_active_profiler.compare_exchange_strong(expected, this))
+	{
+		throw sinsp_exception("another sampling profiler is already running");
+	}
+
+	if(m_ring.empty())
+	{
+		m_ring.resize(RING_SIZE);
+	}
+	m_evt = evt;
+
+	//
+	// The first unwind loads libgcc_s and allocates, which must not happen
+	// inside the signal handler
+	//
+	void* pcs[MAX_DEPTH];
+	unwind_state state = {pcs, 0, 0};
+	_Unwind_Backtrace(unwind_cb, &state);
+
+	//
+	// The handler stays installed for the life of the process: a signal
+	// can still be pending when the timer is deleted, and the default
+	// SIGPROF action kills the process
+	//
+	std::call_once(s_handler_installed, []()
+	{
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_sigaction = signal_handler;
+		sa.sa_flags = SA_SIGINFO | SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGPROF, &sa, NULL);
+	});
+
+	struct sigevent sev;
+	memset(&sev, 0, sizeof(sev));
+	sev.sigev_notify = SIGEV_THREAD_ID;
+	sev.sigev_signo = SIGPROF;
+	sev.sigev_notify_thread_id = syscall(SYS_gettid);
+
+	if(timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &m_timer) != 0)
+	{
+		s_active_profiler.store(NULL);
+		throw sinsp_exception(std::string("cannot create the profiler timer: ") + strerror(errno));
+	}
+
+	struct itimerspec its;
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = ONE_SECOND_IN_NS / frequency_hz;
+	its.it_value = its.it_interval;
+
+	if(timer_settime(m_timer, 0, &its, NULL) != 0)
+	{
+		timer_delete(m_timer);
+		s_active_profiler.store(NULL);
+		throw sinsp_exception(std::string("cannot start the profiler timer: ") + strerror(errno));
+	}
+
+	m_enabled = true;
+}
+
+void sinsp_sampling_profiler::stop()
+{
+	if(!m_enabled)
+	{
+		return;
+	}
+
+	timer_delete(m_timer);
+	s_active_profiler.store(NULL);
+
+	//
+	// A handler that loaded the profiler before it was cleared may still
+	// be taking a sample on the sampled thread
+	//
+	while(s_running_handlers.load() != 0)
+	{
+		std::this_thread::yield();
+	}
+
+	m_enabled = false;
+}
+
+void sinsp_sampling_profiler::signal_handler(int sig, siginfo_t* info, void* ctx)
+{
+	int saved_errno = errno;
+
+	// counted before the load, so that stop() can't miss this handler
+	s_running_handlers.fetch_add(1);
+	sinsp_sampling_profiler* profiler = s_active_profiler.load();
+	if(profiler != NULL)
+	{
+		profiler->take_sample();
+	}
+	s_running_handlers.fetch_sub(1);
+
+	errno = saved_errno;
+}
+
+//
+// Runs in the signal handler: no locks, no allocations
+//
+void sinsp_sampling_profiler::take_sample()
+{
+	uint64_t head = m_head.load(std::memory_order_relaxed);
+	if(head - m_tail.load(std::memory_order_acquire) >= RING_SIZE)
+	{
+		m_n_drops.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	sample& s = m_ring[head % RING_SIZE];
+
+	// skip take_sample(), signal_handler() and the signal trampoline
+	unwind_state state = {s.m_pcs, 0, 3};
+	_Unwind_Backtrace(unwind_cb, &state);
+	s.m_depth = state.m_depth;
+
+	const scap_evt* pevt = m_evt ? m_evt->m_pevt : NULL;
+	s.m_evt_type = pevt ? pevt->type : PPM_EVENT_MAX;
+
+	m_head.store(head + 1, std::memory_order_release);
+}
+
+std::string sinsp_sampling_profiler::symbolize(uintptr_t pc)
+{
+	auto it = m_symbols.find(pc);
+	if(it != m_symbols.end())
+	{
+		return it->second;
+	}
+
+	std::string res;
+	Dl_info info;
+
+	// pc is a return address, look up the call instruction instead
+	if(dladdr((void*)(pc - 1), &info) != 0 && info.dli_sname != NULL)
+	{
+		int status;
+		char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+		res = (status == 0 && demangled != NULL) ? demangled : info.dli_sname;
+		free(demangled);
+	}
+	else
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "0x%" PRIxPTR, pc);
+		res = buf;
+	}
+
+	// ';' separates the frames in the collapsed format
+	std::replace(res.begin(), res.end(), ';', ':');
+
+	m_symbols[pc] = res;
+	return res;
+}
+#else // __linux__
+void sinsp_sampling_profiler::start(uint32_t frequency_hz, const sinsp_evt* evt)
+{
+	throw sinsp_exception("the sampling profiler is not supported on this platform");
+}
+
+void sinsp_sampling_profiler::stop()
+{
+}
+
+std::string sinsp_sampling_profiler::symbolize(uintptr_t pc)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "0x%" PRIxPTR, pc);
+	return buf;
+}
+#endif // __linux__
+
+void sinsp_sampling_profiler::drain()
+{
+	std::lock_guard<std::mutex> lock(m_drain_mtx);
+
+	uint64_t tail = m_tail.load(std::memory_order_relaxed);
+	uint64_t head = m_head.load(std::memory_order_acquire);
+	std::vector<uintptr_t> key;
+
+	for(; tail != head; tail++)
+	{
+		const sample& s = m_ring[tail % RING_SIZE];
+
+		key.assign(1, s.m_evt_type);
+		for(uint32_t j = 0; j < s.m_depth; j++)
+		{
+			key.push_back((uintptr_t)s.m_pcs[j]);
+		}
+
+		auto it = m_stack_ids.find(key);
+		if(it == m_stack_ids.end())
+		{
+			it = m_stack_ids.insert(std::make_pair(key, (uint32_t)m_stacks.size())).first;
+			m_stacks.push_back(&it->first);
+			m_stack_counts.push_back(0);
+		}
+
+		m_stack_counts[it->second]++;
+		m_n_samples++;
+	}
+
+	m_tail.store(tail, std::memory_order_release);
+}
+
+std::string sinsp_sampling_profiler::to_collapsed()
+{
+	drain();
+
+	std::lock_guard<std::mutex> lock(m_drain_mtx);
+
+	//
+	// Stacks that differ only by the position inside the same functions
+	// become the same line once symbolized
+	//
+	const struct ppm_event_info* etable = g_infotables.m_event_info;
+	std::unordered_map<std::string, uint64_t> lines;
+	std::string line;
+
+	for(uint32_t id = 0; id < m_stacks.size(); id++)
+	{
+		const std::vector<uintptr_t>& stack = *m_stacks[id];
+		uint16_t etype = (uint16_t)stack[0];
+
+		if(etype < PPM_EVENT_MAX)
+		{
+			line = PPME_IS_ENTER(etype) ? ">" : "<";
+			line += etable[etype].name;
+		}
+		else
+		{
+			line = "[no event]";
+		}
+
+		for(size_t j = stack.size() - 1; j >= 1; j--)
+		{
+			line += ';';
+			line += symbolize(stack[j]);
+		}
+
+		lines[line] += m_stack_counts[id];
+	}
+
+	std::vector<std::pair<uint64_t, const std::string*>> sorted;
+	for(const auto& it : lines)
+	{
+		sorted.push_back(std::make_pair(it.second, &it.first));
+	}
+	std::sort(sorted.rbegin(), sorted.rend());
+
+	std::string res;
+	for(const auto& it : sorted)
+	{
+		res += *it.second;
+		res += ' ';
+		res += std::to_string(it.first);
+		res += '\n';
+	}
+
+	return res;
+}
+
+void sinsp_sampling_profiler::reset()
+{
+	std::lock_guard<std::mutex> lock(m_drain_mtx);
+
+	m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+	m_stack_ids.clear();
+	m_stacks.clear();
+	m_stack_counts.clear();
+	m_n_samples = 0;
+	m_n_drops.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,162 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <signal.h>
+#include <time.h>
+#endif
+
+#include "sinsp_public.h"
+
+class sinsp_evt;
+
+/*!
+  \brief In-process sampling profiler for the capture thread.
+
+  A per-thread CPU time timer delivers SIGPROF to the thread that called
+  start(). The signal handler unwinds the stack and stores the return
+  addresses, together with the type of the event being processed, in a
+  single producer ring; drain() moves the samples from the ring into a
+  table of unique stacks, and to_collapsed() renders that table in the
+  collapsed format used by flame graph tools.
+
+  When the profiler is stopped nothing is installed, so the only cost left
+  in the event loop is a check of enabled().
+
+  Only one profiler can run at a time in a process, since the SIGPROF
+  handler is process wide. Only available on Linux.
+*/
+class SINSP_PUBLIC sinsp_sampling_profiler
+{
+public:
+	static const uint32_t MAX_DEPTH = 48;
+	static const uint32_t RING_SIZE = 4096;
+
+	sinsp_sampling_profiler();
+	~sinsp_sampling_profiler();
+
+	/*!
+	  \brief Start sampling the calling thread frequency_hz times per
+	  second of CPU time. evt is the event whose type is attached to the
+	  samples, it can be NULL.
+
+	  \note throws a sinsp_exception if the timer can't be created or if
+	  another profiler is running.
+	*/
+	void start(uint32_t frequency_hz, const sinsp_evt* evt);
+
+	/*!
+	  \brief Stop sampling. Can be called from any thread: it waits for a
+	  sample that is being taken on the sampled thread, so the profiler can
+	  be destroyed as soon as it returns. It must not be called from a
+	  signal handler.
+	*/
+	void stop();
+
+	inline bool enabled() const
+	{
+		return m_enabled;
+	}
+
+	/*!
+	  \brief True when the ring is filling up and should be drained
+	*/
+	inline bool needs_drain() const
+	{
+		return m_head.load(std::memory_order_relaxed) -
+			m_tail.load(std::memory_order_relaxed) >= RING_SIZE / 2;
+	}
+
+	/*!
+	  \brief Move the samples collected so far into the stack table.
+	  Can be called from any thread.
+	*/
+	void drain();
+
+	/*!
+	  \brief Render the samples collected since the last reset() as one
+	  "frame;frame;...;frame count" line per unique stack, outermost frame
+	  first. The first frame is the type of the event being processed.
+	*/
+	std::string to_collapsed();
+
+	void reset();
+
+	/*!
+	  \brief Number of samples lost because the ring was full
+	*/
+	inline uint64_t get_dropped_samples() const
+	{
+		return m_n_drops.load(std::memory_order_relaxed);
+	}
+
+	inline uint64_t get_samples() const
+	{
+		return m_n_samples;
+	}
+
+private:
+	struct sample
+	{
+		uint16_t m_evt_type;
+		uint16_t m_depth;
+		void* m_pcs[MAX_DEPTH];
+	};
+
+	struct stack_key_hash
+	{
+		size_t operator()(const std::vector<uintptr_t>& key) const;
+	};
+
+#ifdef __linux__
+	static void signal_handler(int sig, siginfo_t* info, void* ctx);
+	void take_sample();
+	timer_t m_timer;
+	struct sigaction m_old_action;
+#endif
+	std::string symbolize(uintptr_t pc);
+
+	bool m_enabled;
+	const sinsp_evt* m_evt;
+
+	//
+	// The ring is written by the signal handler only, and read under
+	// m_drain_mtx
+	//
+	std::vector<sample> m_ring;
+	std::atomic<uint64_t> m_head;
+	std::atomic<uint64_t> m_tail;
+	std::atomic<uint64_t> m_n_drops;
+
+	std::mutex m_drain_mtx;
+	// stack (event type first, then the pcs) -> stack id
+	std::unordered_map<std::vector<uintptr_t>, uint32_t, stack_key_hash> m_stack_ids;
+	// stack id -> number of samples
+	std::vector<uint64_t> m_stack_counts;
+	std::vector<const std::vector<uintptr_t>*> m_stacks;
+	std::unordered_map<uintptr_t, std::string> m_symbols;
+	uint64_t m_n_samples;
+};
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <random>
 #ifndef _WIN32
 #include <unistd.h>
 #include <sys/stat.h>
@@ -32,9 +33,12 @@ limitations under the License.
 #include "sinsp_auth.h"
 #include "filter.h"
 #include "filterchecks.h"
+#include "value_parser.h"
 #include "cyclewriter.h"
+#include "dump_rotator.h"
 #include "protodecoder.h"
 #include "dns_manager.h"
+#include "proc_async_source.h"
 
 #ifndef CYGWING_AGENT
 #ifndef MINIMAL_BUILD
@@ -87,10 +91,26 @@ sinsp::sinsp(bool static_container, const std::string static_id, const std::stri
 	m_inactive_container_scan_time_ns = DEFAULT_INACTIVE_CONTAINER_SCAN_TIME_S * ONE_SECOND_IN_NS;
 	m_cycle_writer = NULL;
 	m_write_cycling = false;
+	m_background_rotation = false;
+	m_dump_rotator = NULL;
+	m_delta_rotation_files = 0;
+	m_delta_rotation_count = 0;
+	m_dump_base_id = 0;
+	m_flight_recorder = NULL;
+	m_tcp_stats = NULL;
+	m_suppress_tcp_events = false;
+	m_cpu_analysis = NULL;
+#ifdef HAS_FILTERING
+	m_flight_recorder_trigger = NULL;
+	m_flight_recorder_compress = false;
+	m_flight_recorder_last_snapshot = 0;
+#endif
 
 #ifdef HAS_FILTERING
 	m_filter = NULL;
 	m_evttype_filter = NULL;
+	m_metric_filter_evaluated = &sinsp_metrics_registry::get().counter("sinsp_filter_evaluated_events", "Events evaluated by the filters");
+	m_metric_filter_rejected = &sinsp_metrics_registry::get().counter("sinsp_filter_rejected_events", "Events rejected by the filters");
 #endif
 
 	m_fds_to_remove = new vector<int64_t>;
@@ -132,6 +152,8 @@ sinsp::sinsp(bool static_container, const std::string static_id, const std::stri
 
 	m_proc_scan_timeout_ms = SCAP_PROC_SCAN_TIMEOUT_NONE;
 	m_proc_scan_log_interval_ms = SCAP_PROC_SCAN_LOG_NONE;
+	m_fast_fd_scan = false;
+	m_tcp_srtt_agg_interval_ms = 0;
 
 	uint32_t evlen = sizeof(scap_evt) + 2 * sizeof(uint16_t) + 2 * sizeof(uint64_t);
 	m_meinfo.m_piscapevt = (scap_evt*)new char[evlen];
@@ -195,6 +217,18 @@ sinsp::~sinsp()
 		m_cycle_writer = NULL;
 	}
 
+	stop_flight_recorder();
+	stop_tcp_stats();
+	stop_cpu_analysis();
+
+#ifdef HAS_FILTERING
+	if(m_flight_recorder_trigger)
+	{
+		delete m_flight_recorder_trigger;
+		m_flight_recorder_trigger = NULL;
+	}
+#endif
+
 	if(m_meinfo.m_piscapevt)
 	{
 		delete[] m_meinfo.m_piscapevt;
@@ -473,6 +507,8 @@ void sinsp::open_live_common(uint32_t timeout_ms, scap_mode_t mode)
 	oargs.debug_log_fn = &sinsp_scap_debug_log_fn;
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
+	oargs.fast_fd_scan = m_fast_fd_scan;
+	oargs.tcp_srtt_agg_interval_ms = m_tcp_srtt_agg_interval_ms;
 
 	if(!m_filter_proc_table_when_saving)
 	{
@@ -547,6 +583,8 @@ void sinsp::open_nodriver()
 	oargs.debug_log_fn = &sinsp_scap_debug_log_fn;
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
+	oargs.fast_fd_scan = m_fast_fd_scan;
+	oargs.tcp_srtt_agg_interval_ms = m_tcp_srtt_agg_interval_ms;
 
 	int32_t scap_rc;
 	m_h = scap_open(oargs, error, &scap_rc);
@@ -692,6 +730,8 @@ void sinsp::open_int()
 	oargs.debug_log_fn = &sinsp_scap_debug_log_fn;
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
+	oargs.fast_fd_scan = m_fast_fd_scan;
+	oargs.tcp_srtt_agg_interval_ms = m_tcp_srtt_agg_interval_ms;
 
 	int32_t scap_rc;
 	m_h = scap_open(oargs, error, &scap_rc);
@@ -745,6 +785,36 @@ void sinsp::fdopen(int fd)
 
 void sinsp::close()
 {
+	//
+	// The background /proc reader borrows the capture devices
+	//
+	if(m_thread_manager)
+	{
+		m_thread_manager->stop_async_proc_lookups();
+	}
+
+	//
+	// Finish a rotation in progress before closing the dumper, so that
+	// the events kept in memory meanwhile get to the new file
+	//
+	if(m_dump_rotator)
+	{
+		while(m_dump_rotator->in_progress())
+		{
+			try
+			{
+				autodump_finish_rotation(true);
+			}
+			catch(const sinsp_exception& e)
+			{
+				g_logger.format(sinsp_logger::SEV_ERROR, "%s", e.what());
+			}
+		}
+
+		delete m_dump_rotator;
+		m_dump_rotator = NULL;
+	}
+
 	if(m_h)
 	{
 		scap_close(m_h);
@@ -781,37 +851,363 @@ void sinsp::close()
 }
 
 void sinsp::autodump_start(const string& dump_filename, bool compress)
+{
+	// the first file of a dump is always a base
+	m_dump_base_file.clear();
+	autodump_open(dump_filename, compress);
+}
+
+void sinsp::autodump_open(const string& dump_filename, bool compress)
 {
 	if(NULL == m_h)
 	{
 		throw sinsp_exception("inspector not opened yet");
 	}
 
+	//
+	// Base files are full captures, and refresh the tables from /proc
+	// like them. The tables of delta captures come from sinsp, which
+	// knows what changed.
+	//
+	bool delta = m_delta_rotation_files != 0 && !autodump_base_due(dump_filename);
+
+	if(delta)
+	{
+		autodump_set_state_base(dump_filename);
+	}
+
 	if(compress)
 	{
-		m_dumper = scap_dump_open(m_h, dump_filename.c_str(), SCAP_COMPRESSION_GZIP, false);
+		m_dumper = scap_dump_open(m_h, dump_filename.c_str(), SCAP_COMPRESSION_GZIP, delta);
 	}
 	else
 	{
-		m_dumper = scap_dump_open(m_h, dump_filename.c_str(), SCAP_COMPRESSION_NONE, false);
+		m_dumper = scap_dump_open(m_h, dump_filename.c_str(), SCAP_COMPRESSION_NONE, delta);
 	}
 
+	scap_set_dump_state_base(m_h, NULL, 0);
 	m_is_dumping = true;
 
 	if(NULL == m_dumper)
 	{
+		// the next file can't refer to this one
+		m_dump_base_file.clear();
 		throw sinsp_exception(scap_getlasterr(m_h));
 	}
 
+	if(delta)
+	{
+		m_thread_manager->dump_thread_deltas_to_file(m_dumper);
+	}
+	else if(m_delta_rotation_files != 0)
+	{
+		autodump_state_id(m_dumper);
+		m_thread_manager->keep_dump_base();
+	}
+
 	m_container_manager.dump_containers(m_dumper);
 }
 
+//
+// Whether dump_filename is the base of the next delta captures
+//
+bool sinsp::autodump_base_due(const string& dump_filename)
+{
+	if(m_dump_base_file.empty() || ++m_delta_rotation_count >= m_delta_rotation_files)
+	{
+		m_dump_base_file = dump_filename;
+		m_delta_rotation_count = 0;
+
+		// 0 is the id of a file without one
+		std::random_device rd;
+		do
+		{
+			m_dump_base_id = ((uint64_t)rd() << 32) | rd();
+		}
+		while(m_dump_base_id == 0);
+
+		return true;
+	}
+
+	return false;
+}
+
+void sinsp::autodump_set_state_base(const string& dump_filename)
+{
+	//
+	// The readers look for relative names in the directory of the delta
+	//
+	string base = m_dump_base_file;
+	size_t pos = dump_filename.rfind('/');
+	if(pos != string::npos && base.compare(0, pos + 1, dump_filename, 0, pos + 1) == 0)
+	{
+		base = base.substr(pos + 1);
+	}
+
+	if(scap_set_dump_state_base(m_h, base.c_str(), m_dump_base_id) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
+void sinsp::autodump_state_id(scap_dumper_t* dumper)
+{
+	if(scap_write_state_id(m_h, dumper, m_dump_base_id) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
 void sinsp::autodump_next_file()
 {
-	autodump_stop();
-	autodump_start(m_cycle_writer->get_current_file_name(), m_compress);
+	if(!m_background_rotation || m_dumper == NULL)
+	{
+		autodump_stop();
+		autodump_open(m_cycle_writer->get_current_file_name(), m_compress);
+		return;
+	}
+
+	if(m_dump_rotator == NULL)
+	{
+		m_dump_rotator = new sinsp_dump_rotator();
+	}
+
+	//
+	// The cycle writer moved on again before the previous file was ready.
+	// Only one rotation is queued: if there's already one, wait for the
+	// rotation in progress, which starts the queued one.
+	//
+	if(m_dump_rotator->in_progress())
+	{
+		if(!m_pending_rotation_file.empty())
+		{
+			autodump_finish_rotation(true);
+		}
+
+		m_pending_rotation_file = m_cycle_writer->get_current_file_name();
+		return;
+	}
+
+	autodump_start_rotation(m_cycle_writer->get_current_file_name());
+}
+
+void sinsp::autodump_start_rotation(const string& dump_filename)
+{
+	//
+	// Serialize the section header and the tables for the next file now,
+	// so that the helper thread doesn't need the capture handle. Like the
+	// rest of the rotation, this doesn't go back to /proc.
+	//
+	bool delta = m_delta_rotation_files != 0 && !autodump_base_due(dump_filename);
+
+	if(delta)
+	{
+		autodump_set_state_base(dump_filename);
+	}
+
+	scap_dumper_t* header = scap_managedbuf_dump_create(m_h, 0, true, true);
+	scap_set_dump_state_base(m_h, NULL, 0);
+	scap_dumper_t* pending = scap_managedbuf_dump_create(m_h, 0, false, false);
+	if(header == NULL || pending == NULL)
+	{
+		if(header != NULL)
+		{
+			scap_dump_close(header);
+		}
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+
+	try
+	{
+		if(delta)
+		{
+			m_thread_manager->dump_thread_deltas_to_file(header);
+		}
+		else
+		{
+			if(m_delta_rotation_files != 0)
+			{
+				autodump_state_id(header);
+			}
+			m_thread_manager->dump_threads_to_file(header, m_delta_rotation_files != 0);
+		}
+		m_container_manager.dump_containers(header);
+	}
+	catch(...)
+	{
+		scap_dump_close(header);
+		scap_dump_close(pending);
+		throw;
+	}
+
+	m_dump_rotator->start(m_dumper, dump_filename, m_compress, header);
+
+	// the events go to memory until the next file is ready
+	m_dumper = pending;
+}
+
+void sinsp::autodump_finish_rotation(bool wait)
+{
+	scap_dumper_t* next;
+
+	try
+	{
+		next = wait ? m_dump_rotator->finish() : m_dump_rotator->try_finish();
+	}
+	catch(...)
+	{
+		scap_dump_close(m_dumper);
+		m_dumper = NULL;
+		m_is_dumping = false;
+		m_pending_rotation_file.clear();
+		throw;
+	}
+
+	if(next == NULL)
+	{
+		return;
+	}
+
+	char error[SCAP_LASTERR_SIZE];
+	int32_t res = scap_dump_append_buf(next, m_dumper, error);
+	scap_dump_close(m_dumper);
+	m_dumper = next;
+
+	if(res != SCAP_SUCCESS)
+	{
+		m_pending_rotation_file.clear();
+		throw sinsp_exception(error);
+	}
+
+	if(!m_pending_rotation_file.empty())
+	{
+		string fname = m_pending_rotation_file;
+		m_pending_rotation_file.clear();
+		autodump_start_rotation(fname);
+	}
+}
+
+void sinsp::set_background_rotation(bool enable)
+{
+	m_background_rotation = enable;
+}
+
+void sinsp::set_delta_rotation(uint32_t files_per_base)
+{
+	m_delta_rotation_files = files_per_base;
 }
 
+void sinsp::start_flight_recorder(uint64_t max_bytes, uint64_t max_duration_ns)
+{
+	stop_flight_recorder();
+	m_flight_recorder = new sinsp_flight_recorder(max_bytes, max_duration_ns);
+}
+
+void sinsp::stop_flight_recorder()
+{
+	if(m_flight_recorder != NULL)
+	{
+		delete m_flight_recorder;
+		m_flight_recorder = NULL;
+	}
+}
+
+void sinsp::start_tcp_stats(bool suppress_events)
+{
+	stop_tcp_stats();
+	m_tcp_stats = new sinsp_tcp_stats_table();
+	m_suppress_tcp_events = suppress_events;
+}
+
+void sinsp::stop_tcp_stats()
+{
+	if(m_tcp_stats != NULL)
+	{
+		delete m_tcp_stats;
+		m_tcp_stats = NULL;
+	}
+	m_suppress_tcp_events = false;
+}
+
+void sinsp::start_cpu_analysis()
+{
+	stop_cpu_analysis();
+	m_cpu_analysis = new sinsp_cpu_analysis_table();
+}
+
+void sinsp::stop_cpu_analysis()
+{
+	if(m_cpu_analysis != NULL)
+	{
+		delete m_cpu_analysis;
+		m_cpu_analysis = NULL;
+	}
+}
+
+void sinsp::flight_recorder_snapshot(const string& filename, bool compress)
+{
+	if(NULL == m_h)
+	{
+		throw sinsp_exception("inspector not opened yet");
+	}
+
+	if(m_flight_recorder == NULL)
+	{
+		throw sinsp_exception("flight recorder not started");
+	}
+
+	scap_dumper_t* dumper = scap_dump_open(m_h, filename.c_str(),
+		compress ? SCAP_COMPRESSION_GZIP : SCAP_COMPRESSION_NONE, true);
+	if(dumper == NULL)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+
+	int32_t res = SCAP_SUCCESS;
+	try
+	{
+		m_thread_manager->dump_threads_to_file(dumper);
+		m_container_manager.dump_containers(dumper);
+	}
+	catch(...)
+	{
+		scap_dump_close(dumper);
+		throw;
+	}
+
+	m_flight_recorder->loop([&](const scap_evt* e, uint16_t cpuid, uint32_t flags)
+	{
+		if(res == SCAP_SUCCESS)
+		{
+			res = scap_dump(m_h, dumper, (scap_evt*)e, cpuid, flags);
+		}
+	});
+
+	scap_dump_close(dumper);
+
+	if(res != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_h));
+	}
+}
+
+#ifdef HAS_FILTERING
+void sinsp::set_flight_recorder_trigger(const string& filter, const string& file_prefix, bool compress)
+{
+	sinsp_filter_compiler compiler(this, filter);
+	sinsp_filter* trigger = compiler.compile();
+
+	if(m_flight_recorder_trigger != NULL)
+	{
+		delete m_flight_recorder_trigger;
+	}
+
+	m_flight_recorder_trigger = trigger;
+	m_flight_recorder_prefix = file_prefix;
+	m_flight_recorder_compress = compress;
+}
+#endif
+
 void sinsp::autodump_stop()
 {
 	if(NULL == m_h)
@@ -819,6 +1215,12 @@ void sinsp::autodump_stop()
 		throw sinsp_exception("inspector not opened yet");
 	}
 
+	// a queued rotation starts when the one in progress is done
+	while(m_dump_rotator != NULL && m_dump_rotator->in_progress())
+	{
+		autodump_finish_rotation(true);
+	}
+
 	if(m_dumper != NULL)
 	{
 		scap_dump_close(m_dumper);
@@ -944,6 +1346,27 @@ sinsp_network_interfaces* sinsp::get_ifaddr_list()
 	return m_network_interfaces;
 }
 
+void sinsp::add_net_tag(const std::string& net, const std::string& tag)
+{
+	uint8_t storage[sizeof(ipv6net)];
+
+	size_t len = sinsp_filter_value_parser::string_to_rawval(net.c_str(), net.size(), storage, sizeof(storage), PT_IPNET);
+
+	if(len == sizeof(ipv4net))
+	{
+		m_net_tags.add_ipv4_net(*(ipv4net*)storage, tag);
+	}
+	else
+	{
+		m_net_tags.add_ipv6_net(*(ipv6net*)storage, tag);
+	}
+}
+
+void sinsp::clear_net_tags()
+{
+	m_net_tags.clear();
+}
+
 void sinsp::import_user_list()
 {
 	uint32_t j;
@@ -1129,6 +1552,14 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	sinsp_evt* evt;
 	int32_t res;
 
+	//
+	// Empty the profiler ring before it overflows
+	//
+	if(m_sampling_profiler.enabled() && m_sampling_profiler.needs_drain())
+	{
+		m_sampling_profiler.drain();
+	}
+
 	//
 	// Check if there are fake cpu events to  events
 	//
@@ -1171,7 +1602,16 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		//
 		// Get the event from libscap
 		//
-		res = scap_next(m_h, &(evt->m_pevt), &(evt->m_cpuid));
+		if(m_perf_monitor.enabled())
+		{
+			uint64_t start = sinsp_perf_monitor::ticks();
+			res = scap_next(m_h, &(evt->m_pevt), &(evt->m_cpuid));
+			m_perf_monitor.add(SINSP_PERF_SCAP_NEXT, sinsp_perf_monitor::ticks() - start);
+		}
+		else
+		{
+			res = scap_next(m_h, &(evt->m_pevt), &(evt->m_cpuid));
+		}
 
 		if(res != SCAP_SUCCESS)
 		{
@@ -1231,15 +1671,7 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 
 	if (m_automatic_threadtable_purging)
 	{
-		//
-		// Delayed removal of threads from the thread table, so that
-		// things like exit() or close() can be parsed.
-		//
-		if(m_tid_to_remove != -1)
-		{
-			remove_thread(m_tid_to_remove, false);
-			m_tid_to_remove = -1;
-		}
+		remove_delayed_thread();
 
 		if(!is_capture())
 		{
@@ -1247,6 +1679,11 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		}
 	}
 
+	if(m_thread_manager->has_proc_lookup_results())
+	{
+		m_thread_manager->merge_proc_lookups();
+	}
+
 #ifndef HAS_ANALYZER
 
 	if(is_debug_enabled() && is_live())
@@ -1293,27 +1730,9 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	}
 #endif // HAS_ANALYZER
 
-	//
-	// Delayed removal of the fd, so that
-	// things like exit() or close() can be parsed.
-	//
-	uint32_t nfdr = (uint32_t)m_fds_to_remove->size();
-
-	if(nfdr != 0)
+	if(!remove_delayed_fds())
 	{
-		sinsp_threadinfo* ptinfo = &*get_thread_ref(m_tid_of_fd_to_remove, true, true);
-		if(!ptinfo)
-		{
-			ASSERT(false);
-			return res;
-		}
-
-		for(uint32_t j = 0; j < nfdr; j++)
-		{
-			ptinfo->remove_fd(m_fds_to_remove->at(j));
-		}
-
-		m_fds_to_remove->clear();
+		return res;
 	}
 
 #ifdef SIMULATE_DROP_MODE
@@ -1343,7 +1762,16 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		return SCAP_TIMEOUT;
 	}
 #else
-	m_parser->process_event(evt);
+	if(m_perf_monitor.enabled())
+	{
+		uint64_t start = sinsp_perf_monitor::ticks();
+		m_parser->process_event(evt);
+		m_perf_monitor.add_parser(evt->get_type(), sinsp_perf_monitor::ticks() - start);
+	}
+	else
+	{
+		m_parser->process_event(evt);
+	}
 #endif
 
 	//
@@ -1364,6 +1792,21 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		}
 #endif
 
+		uint64_t dump_start = m_perf_monitor.enabled() ? sinsp_perf_monitor::ticks() : 0;
+
+		if(m_dump_rotator != NULL && m_dump_rotator->in_progress())
+		{
+			//
+			// The cycle writer already moved to the next file, just
+			// check if it's ready
+			//
+			autodump_finish_rotation(scap_dump_get_offset(m_dumper) > (int64_t)m_max_rotation_buffer_bytes);
+		}
+
+		//
+		// The events written during a rotation count for the next
+		// file, a NEWFILE that comes meanwhile is queued
+		//
 		if(m_write_cycling)
 		{
 			switch(m_cycle_writer->consider(evt))
@@ -1391,6 +1834,38 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		{
 			throw sinsp_exception(scap_getlasterr(m_h));
 		}
+
+		if(m_perf_monitor.enabled())
+		{
+			m_perf_monitor.add(SINSP_PERF_DUMPER, sinsp_perf_monitor::ticks() - dump_start);
+		}
+	}
+
+	if(m_tcp_stats != NULL)
+	{
+		m_tcp_stats->on_ts(evt->get_ts());
+	}
+
+	if(m_cpu_analysis != NULL)
+	{
+		m_cpu_analysis->on_ts(evt->get_ts());
+	}
+
+	if(m_flight_recorder != NULL)
+	{
+		scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
+		m_flight_recorder->add(pdevt, evt->m_cpuid, evt->get_dump_flags());
+
+#ifdef HAS_FILTERING
+		if(m_flight_recorder_trigger != NULL &&
+		   m_flight_recorder->get_added() - m_flight_recorder_last_snapshot >= m_flight_recorder->get_nevts() &&
+		   m_flight_recorder_trigger->run(evt))
+		{
+			m_flight_recorder_last_snapshot = m_flight_recorder->get_added();
+			flight_recorder_snapshot(m_flight_recorder_prefix + to_string(evt->get_num()) + ".scap",
+						 m_flight_recorder_compress);
+		}
+#endif
 	}
 
 #if defined(HAS_FILTERING) && defined(HAS_CAPTURE_FILTERING)
@@ -1413,7 +1888,16 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	//
 	if (m_external_event_processor)
 	{
-		m_external_event_processor->process_event(evt, libsinsp::EVENT_RETURN_NONE);
+		if(m_perf_monitor.enabled())
+		{
+			uint64_t start = sinsp_perf_monitor::ticks();
+			m_external_event_processor->process_event(evt, libsinsp::EVENT_RETURN_NONE);
+			m_perf_monitor.add(SINSP_PERF_EXTERNAL_PROCESSOR, sinsp_perf_monitor::ticks() - start);
+		}
+		else
+		{
+			m_external_event_processor->process_event(evt, libsinsp::EVENT_RETURN_NONE);
+		}
 	}
 
 	// Clean parse related event data after analyzer did its parsing too
@@ -1714,6 +2198,30 @@ void sinsp::add_evttype_filter(string &name,
 }
 
 bool sinsp::run_filters_on_evt(sinsp_evt *evt)
+{
+	bool res;
+
+	if(m_perf_monitor.enabled())
+	{
+		uint64_t start = sinsp_perf_monitor::ticks();
+		res = run_filters(evt);
+		m_perf_monitor.add_filter(evt->get_type(), sinsp_perf_monitor::ticks() - start);
+	}
+	else
+	{
+		res = run_filters(evt);
+	}
+
+	m_metric_filter_evaluated->add();
+	if(!res)
+	{
+		m_metric_filter_rejected->add();
+	}
+
+	return res;
+}
+
+bool sinsp::run_filters(sinsp_evt *evt)
 {
 	//
 	// First run the global filter, if there is one.
@@ -1835,6 +2343,41 @@ sinsp_stats sinsp::get_stats()
 }
 #endif // GATHER_INTERNAL_STATS
 
+void sinsp::set_perf_instrumentation(bool enable)
+{
+	m_perf_monitor.set_enabled(enable);
+}
+
+sinsp_perf_report sinsp::get_perf_report() const
+{
+	return m_perf_monitor.get_report();
+}
+
+void sinsp::reset_perf_report()
+{
+	m_perf_monitor.reset();
+}
+
+void sinsp::start_sampling_profiler(uint32_t frequency_hz)
+{
+	m_sampling_profiler.start(frequency_hz, &m_evt);
+}
+
+void sinsp::stop_sampling_profiler()
+{
+	m_sampling_profiler.stop();
+}
+
+std::string sinsp::get_sampling_profile()
+{
+	return m_sampling_profiler.to_collapsed();
+}
+
+void sinsp::reset_sampling_profile()
+{
+	m_sampling_profiler.reset();
+}
+
 void sinsp::set_log_callback(sinsp_logger_callback cb)
 {
 	if(cb)
@@ -2003,6 +2546,47 @@ void sinsp::set_metadata_download_params(uint32_t data_max_b,
 	m_metadata_download_params.m_data_watch_freq_sec = data_watch_freq_sec;
 }
 
+void sinsp::remove_delayed_thread()
+{
+	//
+	// Delayed removal of threads from the thread table, so that
+	// things like exit() or close() can be parsed.
+	//
+	if(m_tid_to_remove != -1)
+	{
+		remove_thread(m_tid_to_remove, false);
+		m_tid_to_remove = -1;
+	}
+}
+
+bool sinsp::remove_delayed_fds()
+{
+	//
+	// Delayed removal of the fd, so that
+	// things like exit() or close() can be parsed.
+	//
+	uint32_t nfdr = (uint32_t)m_fds_to_remove->size();
+
+	if(nfdr != 0)
+	{
+		sinsp_threadinfo* ptinfo = &*get_thread_ref(m_tid_of_fd_to_remove, true, true);
+		if(!ptinfo)
+		{
+			ASSERT(false);
+			return false;
+		}
+
+		for(uint32_t j = 0; j < nfdr; j++)
+		{
+			ptinfo->remove_fd(m_fds_to_remove->at(j));
+		}
+
+		m_fds_to_remove->clear();
+	}
+
+	return true;
+}
+
 bool sinsp::remove_inactive_threads()
 {
 	return m_thread_manager->remove_inactive_threads();
@@ -2418,6 +3002,11 @@ void sinsp::set_thread_timeout_s(uint32_t val)
 	m_thread_timeout_ns = (uint64_t)val * ONE_SECOND_IN_NS;
 }
 
+void sinsp::set_thread_purge_batch_size(uint32_t val)
+{
+	m_thread_purge_batch_size = val;
+}
+
 void sinsp::set_proc_scan_timeout_ms(uint64_t val)
 {
 	m_proc_scan_timeout_ms = val;
@@ -2428,77 +3017,130 @@ void sinsp::set_proc_scan_log_interval_ms(uint64_t val)
 	m_proc_scan_log_interval_ms = val;
 }
 
+void sinsp::set_fast_fd_scan(bool enable)
+{
+	m_fast_fd_scan = enable;
+}
+
+void sinsp::set_tcp_srtt_agg_interval_ms(uint32_t interval_ms)
+{
+	m_tcp_srtt_agg_interval_ms = interval_ms;
+}
+
+void sinsp::set_async_proc_lookups(bool enable)
+{
+	m_thread_manager->set_async_proc_lookups(enable);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
-// Note: this is defined here so we can inline it in sinso::next
+// Note: these are defined here so we can inline them in sinso::next
 ///////////////////////////////////////////////////////////////////////////////
+bool sinsp_thread_manager::has_proc_lookup_results() const
+{
+	return m_proc_async_source && m_proc_async_source->has_results();
+}
+
 bool sinsp_thread_manager::remove_inactive_threads()
 {
 	bool res = false;
+	uint64_t now = m_inspector->m_lastevent_ts;
 
 	if(m_last_flush_time_ns == 0)
 	{
-		//
-		// Set the first table scan for 30 seconds in, so that we can spot bugs in the logic without having
-		// to wait for tens of minutes
-		//
-		if(m_inspector->m_inactive_thread_scan_time_ns > 30 * ONE_SECOND_IN_NS)
-		{
-			m_last_flush_time_ns =
-				(m_inspector->m_lastevent_ts - m_inspector->m_inactive_thread_scan_time_ns + 30 * ONE_SECOND_IN_NS);
-		}
-		else
+		m_last_flush_time_ns = now;
+	}
+
+	if(!m_unscheduled_threads.empty() && now != 0)
+	{
+		for(const auto& it : m_unscheduled_threads)
 		{
-			m_last_flush_time_ns =
-				(m_inspector->m_lastevent_ts - m_inspector->m_inactive_thread_scan_time_ns);
+			m_expiry_wheel.schedule(it, now + m_inspector->m_thread_timeout_ns);
 		}
+		m_unscheduled_threads.clear();
 	}
 
-	if(m_inspector->m_lastevent_ts >
-		m_last_flush_time_ns + m_inspector->m_inactive_thread_scan_time_ns)
+	//
+	// Only look at the threads whose deadline expired, and at most
+	// m_thread_purge_batch_size of them, so that the cost of purging is spread
+	// across events instead of stalling the capture every scan interval.
+	// The expiry wheel keeps track of where we stopped.
+	//
+	m_expired_threads.clear();
+	if(m_expiry_wheel.pop_expired(now, m_inspector->m_thread_purge_batch_size, m_expired_threads) != 0)
 	{
-		std::unordered_map<uint64_t, bool> to_delete;
-
 		res = true;
 
-		m_last_flush_time_ns = m_inspector->m_lastevent_ts;
+		for(const auto& it : m_expired_threads)
+		{
+			sinsp_threadinfo* tinfo = m_threadtable.get(it.m_tid);
 
-		g_logger.format(sinsp_logger::SEV_INFO, "Flushing thread table");
+			//
+			// The thread is already gone, or the tid was reused by a
+			// thread that has its own entry in the wheel
+			//
+			if(tinfo == nullptr || tinfo->m_clone_ts != it.m_clone_ts)
+			{
+				continue;
+			}
 
-		//
-		// Go through the table and remove dead entries.
-		//
-		m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
-			bool closed = (tinfo.m_flags & PPM_CL_CLOSED) != 0;
+			bool closed = (tinfo->m_flags & PPM_CL_CLOSED) != 0;
+			uint64_t deadline = tinfo->m_lastaccess_ts + m_inspector->m_thread_timeout_ns;
+
+			if(!closed && now <= deadline)
+			{
+				// still in use, check again when it can expire
+				schedule_thread_expiry(tinfo, deadline);
+				continue;
+			}
 
 			if(closed ||
-				((m_inspector->m_lastevent_ts > tinfo.m_lastaccess_ts + m_inspector->m_thread_timeout_ns) &&
-					!scap_is_thread_alive(m_inspector->m_h, tinfo.m_pid, tinfo.m_tid, tinfo.m_comm.c_str()))
-					)
+				!scap_is_thread_alive(m_inspector->m_h, tinfo->m_pid, tinfo->m_tid, tinfo->m_comm.c_str()))
 			{
 				//
-				// Reset the cache
+				// Not forced: a forced removal of a main thread that still
+				// has children would rebuild the child counts of the whole
+				// table. remove_thread() leaves those in the table, they go
+				// with their last child below or are checked again later.
 				//
-				m_last_tid = 0;
-				m_last_tinfo.reset();
+				bool clone_thread = (tinfo->m_flags & PPM_CL_CLONE_THREAD) != 0;
+				int64_t pid = tinfo->m_pid;
 
-#ifdef GATHER_INTERNAL_STATS
-				m_removed_threads->increment();
-#endif
-				to_delete[tinfo.m_tid] = closed;
+				remove_thread(it.m_tid, false);
+
+				tinfo = m_threadtable.get(it.m_tid);
+				if(tinfo == nullptr)
+				{
+					m_n_purged_threads++;
+
+					//
+					// remove_thread() decremented the child count of the
+					// main thread, which can go now if it's closed
+					//
+					sinsp_threadinfo* main_thread = clone_thread ? m_threadtable.get(pid) : nullptr;
+					if(main_thread != nullptr && main_thread->m_nchilds == 0 &&
+					   (main_thread->m_flags & PPM_CL_CLOSED) != 0)
+					{
+						remove_thread(pid, false);
+						m_n_purged_threads++;
+					}
+					continue;
+				}
 			}
-			return true;
-		});
 
-		for (auto& it : to_delete)
-		{
-			remove_thread(it.first, it.second);
+			schedule_thread_expiry(tinfo, now + m_inspector->m_thread_timeout_ns);
 		}
+	}
 
-		//
-		// Rebalance the thread table dependency tree, so we free up threads that
-		// exited but that are stuck because of reference counting.
-		//
-		recreate_child_dependencies();
+	if(now > m_last_flush_time_ns + m_inspector->m_inactive_thread_scan_time_ns)
+	{
+		m_last_flush_time_ns = now;
+
+		if(m_n_purged_threads != 0)
+		{
+			g_logger.format(sinsp_logger::SEV_INFO, "Purged %u inactive threads from the thread table", m_n_purged_threads);
+			m_n_purged_threads = 0;
+			res = true;
+		}
 	}
 
 	return res;
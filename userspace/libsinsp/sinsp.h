@@ -74,7 +74,13 @@ using namespace std;
 #include "filter.h"
 #include "dumper.h"
 #include "stats.h"
+#include "perf_monitor.h"
+#include "sampling_profiler.h"
+#include "flight_recorder.h"
+#include "tcp_stats.h"
+#include "cpu_analysis.h"
 #include "ifinfo.h"
+#include "ip_prefix_search.h"
 #include "container.h"
 #include "viewinfo.h"
 #include "utils.h"
@@ -102,6 +108,7 @@ class sinsp_parser;
 class sinsp_analyzer;
 class sinsp_filter;
 class cycle_writer;
+class sinsp_dump_rotator;
 class sinsp_protodecoder;
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 class k8s;
@@ -405,19 +412,26 @@ public:
 	void disable_automatic_threadtable_purging();
 
 	/*!
-	 * \brief sets the interval at which the thread purge code runs. This does
-	 *        not run every event as it's mildly expensive if there are lots of threads
+	 * \brief sets the interval at which the number of purged threads is
+	 *        logged. Expired threads themselves are purged incrementally,
+	 *        see set_thread_purge_batch_size()
 	 */
 	void set_thread_purge_interval_s(uint32_t val);
 
 	/*!
 	 * \brief sets the amount of time after which a thread which has seen no events
-	 *        can be purged. As the purging happens only every m_thread_purge_interval_s,
-	 *        the max time a thread may linger is actually m_thread_purge_interval +
-	 *        m_thread_timeout_s
+	 *        can be purged. Threads are checked shortly after their timeout
+	 *        expires, as long as the purge batches keep up with the expiries
 	 */
 	void set_thread_timeout_s(uint32_t val);
 
+	/*!
+	 * \brief sets the max number of expired threads that are checked each time
+	 *        the thread purge code runs. Purging is incremental, so expired
+	 *        threads are removed over several events instead of in one pass.
+	 */
+	void set_thread_purge_batch_size(uint32_t val);
+
 	/*!
 	 * \brief sets the max amount of time that the initial scan of /proc should execute,
 	 *        after which a so-far-successful scan should be stopped and success returned.
@@ -431,6 +445,34 @@ public:
 	 */
 	void set_proc_scan_log_interval_ms(uint64_t val);
 
+	/*!
+	 * \brief enables the fast fd scan of /proc: fewer syscalls per fd, and the
+	 *        open flags and device of files are read from /proc only when the
+	 *        fd is first looked up. Must be called before open().
+	 */
+	void set_fast_fd_scan(bool enable);
+
+	/*!
+	 * \brief with the BPF probe, aggregate the srtt of tcp_rcv_established
+	 *        in the kernel and receive one tcp_rtt_summary event per socket
+	 *        and CPU every interval_ms, and on tcp_close. 0, the default,
+	 *        keeps the sampled tcp_rcv_established events. Must be called
+	 *        before open(), which throws if the live capture doesn't use
+	 *        the BPF probe.
+	 *
+	 * \note a summary is sent by the first segment after the end of the
+	 *       interval, so a socket that goes idle only reports on tcp_close.
+	 */
+	void set_tcp_srtt_agg_interval_ms(uint32_t interval_ms);
+
+	/*!
+	 * \brief when enabled, threads missing from the table are created right
+	 *        away with placeholder values, and their /proc information
+	 *        (fds, env, cgroups) is read by a background thread and merged
+	 *        in a later call to next(). Live captures only.
+	 */
+	void set_async_proc_lookups(bool enable);
+
 
 	/*!
 	  \brief Start writing the captured events to file.
@@ -464,6 +506,103 @@ public:
 	*/
 	void autodump_stop();
 
+	/*!
+	  \brief When the cycle writer asks for a new file, close the current
+	   one and write the header of the next one in a helper thread instead
+	   of blocking the event loop. The thread table for the new file is
+	   taken from sinsp instead of being read again from /proc, and the
+	   events that arrive meanwhile are kept in memory.
+	*/
+	void set_background_rotation(bool enable);
+
+	/*!
+	  \brief Make the files written by the cycle writer delta captures:
+	   only one every files_per_base has the whole thread and fd tables,
+	   the others name it and only store the threads and fds that were
+	   added, changed or removed since. The readers load the base first.
+	   0, the default, writes the full tables in every file.
+
+	  \note a delta can't be read without its base. A cycle writer that
+	   deletes the oldest files can leave up to files_per_base - 1
+	   deltas without it, and one that reuses the file names can give
+	   them a newer file with the name of their base. The readers check
+	   the state id the base was written with and refuse to open such
+	   deltas, instead of rebuilding wrong tables. Readers without delta
+	   support refuse them too, by the major version of the file.
+	*/
+	void set_delta_rotation(uint32_t files_per_base);
+
+	/*!
+	  \brief Start keeping the most recent events in memory, up to max_bytes
+	   and, if max_duration_ns is not 0, up to max_duration_ns before the
+	   last event. The events are recorded after parsing, whether they
+	   pass the filter or not.
+	*/
+	void start_flight_recorder(uint64_t max_bytes, uint64_t max_duration_ns = 0);
+
+	void stop_flight_recorder();
+
+	sinsp_flight_recorder* get_flight_recorder()
+	{
+		return m_flight_recorder;
+	}
+
+	/*!
+	  \brief Write the events kept by the flight recorder to a capture
+	   file, after the current thread, fd and container tables. The
+	   recorder keeps going and its content is left untouched.
+
+	  @throws a sinsp_exception containing the error string is thrown in case
+	   of failure.
+	*/
+	void flight_recorder_snapshot(const string& filename, bool compress);
+
+#ifdef HAS_FILTERING
+	/*!
+	  \brief Take a flight recorder snapshot, to
+	   <file_prefix><event number>.scap, when an event matches filter. After
+	   a snapshot the filter is ignored until all the events in the
+	   recorder are new, so that consecutive snapshots don't overlap.
+	*/
+	void set_flight_recorder_trigger(const string& filter, const string& file_prefix, bool compress);
+#endif
+
+	/*!
+	  \brief Start folding the tcp_* kernel events into per connection
+	   stats, available through the fd.tcp.* fields and the table
+	   returned by get_tcp_stats().
+
+	  \param suppress_events if true, the tcp_* events are not returned by
+	   next() anymore, for consumers that only need the aggregates.
+	*/
+	void start_tcp_stats(bool suppress_events);
+
+	void stop_tcp_stats();
+
+	sinsp_tcp_stats_table* get_tcp_stats()
+	{
+		return m_tcp_stats;
+	}
+
+	/*!
+	  \brief Start decoding the cpu_analysis events into per thread and
+	   per container on-CPU/off-CPU time breakdowns, available through the
+	   thread.cpu.*_ns fields and the table returned by get_cpu_analysis().
+	*/
+	void start_cpu_analysis();
+
+	void stop_cpu_analysis();
+
+	sinsp_cpu_analysis_table* get_cpu_analysis()
+	{
+		return m_cpu_analysis;
+	}
+
+	inline bool suppress_tcp_events() const
+	{
+		return m_suppress_tcp_events;
+	}
+
 	/*!
 	  \brief Populate the given vector with the full list of filter check fields
 	   that this version of the library supports.
@@ -550,6 +689,48 @@ public:
 	sinsp_stats get_stats();
 #endif
 
+	/*!
+	  \brief Enable or disable the timing of the event loop stages (scap_next,
+	   parsing, filtering, formatting, dumping, external processing).
+	   Unlike GATHER_INTERNAL_STATS this can be switched on in production
+	   builds; when it's off each stage only pays for a branch.
+
+	  \note Enabling the instrumentation resets the collected timings.
+	*/
+	void set_perf_instrumentation(bool enable);
+
+	/*!
+	  \brief Return the latency histograms of the event loop stages and the
+	   per event type parser and filter costs collected so far.
+	*/
+	sinsp_perf_report get_perf_report() const;
+
+	/*!
+	  \brief Clear the timings collected so far.
+	*/
+	void reset_perf_report();
+
+	/*!
+	  \brief Start sampling the stack of the capture thread frequency_hz
+	   times per second of CPU time. Each sample is tagged with the type of
+	   the event being processed.
+
+	  \note This must be called from the thread that calls next().
+	   Linux only, throws a sinsp_exception elsewhere.
+	*/
+	void start_sampling_profiler(uint32_t frequency_hz = 99);
+
+	void stop_sampling_profiler();
+
+	/*!
+	  \brief Return the stacks sampled so far in collapsed format, one
+	   "event;frame;...;frame count" line per unique stack, ready to be
+	   fed to flame graph tools.
+	*/
+	std::string get_sampling_profile();
+
+	void reset_sampling_profile();
+
 	libsinsp::event_processor* m_external_event_processor;
 
 	sinsp_threadinfo* build_threadinfo()
@@ -596,6 +777,27 @@ public:
 	*/
 	sinsp_network_interfaces* get_ifaddr_list();
 
+	/*!
+	  \brief Tag a network, for the fd.net.tag, fd.cnet.tag and
+	   fd.snet.tag fields. When an address is in more than one tagged
+	   network, the tag of the most specific one is used.
+
+	  \param net the network in CIDR notation, e.g. 10.0.0.0/8 or
+	   2001:db8::/32.
+	  \param tag the tag. Replaces the previous one if the network is
+	   already tagged.
+
+	  \note throws a sinsp_exception if the network can't be parsed.
+	*/
+	void add_net_tag(const std::string& net, const std::string& tag);
+
+	void clear_net_tags();
+
+	inline const ip_prefix_map<std::string>& get_net_tags() const
+	{
+		return m_net_tags;
+	}
+
 	/*!
 	  \brief Set the format used to render event data
 	   buffer arguments.
@@ -985,7 +1187,17 @@ private:
 
 	void remove_thread(int64_t tid, bool force);
 
+	//
+	// The removals that the parsers leave for the next event, so that
+	// things like exit() or close() can be parsed.
+	// remove_delayed_fds() returns false if the thread of the fds is gone.
+	//
+	void remove_delayed_thread();
+	bool remove_delayed_fds();
 
+#ifdef HAS_FILTERING
+	bool run_filters(sinsp_evt *evt);
+#endif
 
 	//
 	// Note: lookup_only should be used when the query for the thread is made
@@ -1128,6 +1340,8 @@ public:
 	sinsp_filter* m_filter;
 	sinsp_evttype_filter *m_evttype_filter;
 	std::string m_filterstring;
+	sinsp_metric_counter* m_metric_filter_evaluated;
+	sinsp_metric_counter* m_metric_filter_rejected;
 
 #endif
 
@@ -1137,6 +1351,8 @@ public:
 #ifdef GATHER_INTERNAL_STATS
 	sinsp_stats m_stats;
 #endif
+	sinsp_perf_monitor m_perf_monitor;
+	sinsp_sampling_profiler m_sampling_profiler;
 #ifdef HAS_ANALYZER
 	std::vector<uint64_t> m_tid_collisions;
 #endif
@@ -1164,6 +1380,7 @@ public:
 	bool m_automatic_threadtable_purging = true;
 	uint64_t m_thread_timeout_ns = (uint64_t)1800 * ONE_SECOND_IN_NS;
 	uint64_t m_inactive_thread_scan_time_ns = (uint64_t)1200 * ONE_SECOND_IN_NS;
+	uint32_t m_thread_purge_batch_size = 64;
 
 	//
 	// Container limits
@@ -1187,6 +1404,48 @@ public:
 	//
 	cycle_writer* m_cycle_writer;
 	bool m_write_cycling;
+	bool m_background_rotation;
+	sinsp_dump_rotator* m_dump_rotator;
+	// past this, wait for the next file instead of buffering more events
+	const uint64_t m_max_rotation_buffer_bytes = 64 * 1024 * 1024;
+
+	// file of the next rotation, when the cycle writer asked for it
+	// before the previous one was done
+	std::string m_pending_rotation_file;
+
+	void autodump_start_rotation(const string& dump_filename);
+	void autodump_finish_rotation(bool wait);
+
+	// every m_delta_rotation_files-th file has the full tables, the
+	// others only the changes since m_dump_base_file
+	uint32_t m_delta_rotation_files;
+	uint32_t m_delta_rotation_count;
+	std::string m_dump_base_file;
+	// state id written in m_dump_base_file, checked by the readers of
+	// its deltas
+	uint64_t m_dump_base_id;
+
+	void autodump_open(const string& dump_filename, bool compress);
+	bool autodump_base_due(const string& dump_filename);
+	void autodump_set_state_base(const string& dump_filename);
+	void autodump_state_id(scap_dumper_t* dumper);
+
+	sinsp_flight_recorder* m_flight_recorder;
+
+	ip_prefix_map<std::string> m_net_tags;
+
+	sinsp_tcp_stats_table* m_tcp_stats;
+	bool m_suppress_tcp_events;
+
+	sinsp_cpu_analysis_table* m_cpu_analysis;
+
+#ifdef HAS_FILTERING
+	sinsp_filter* m_flight_recorder_trigger;
+	std::string m_flight_recorder_prefix;
+	bool m_flight_recorder_compress;
+	// recorder event count at the last triggered snapshot
+	uint64_t m_flight_recorder_last_snapshot;
+#endif
 
 #ifdef SIMULATE_DROP_MODE
 	//
@@ -1243,6 +1502,8 @@ public:
 	//
 	uint64_t m_proc_scan_timeout_ms;
 	uint64_t m_proc_scan_log_interval_ms;
+	bool m_fast_fd_scan;
+	uint32_t m_tcp_srtt_agg_interval_ms;
 
 	// Any thread with a comm in this set will not have its events
 	// returned in sinsp::next()
@@ -1257,6 +1518,8 @@ public:
 	friend class sinsp_thread_manager;
 	friend class sinsp_container_manager;
 	friend class sinsp_dumper;
+	friend class sinsp_parallel_replay;
+	friend class sinsp_evt_formatter;
 	friend class sinsp_analyzer_fd_listener;
 	friend class sinsp_chisel;
 	friend class sinsp_tracerparser;
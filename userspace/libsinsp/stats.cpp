@@ -39,6 +39,13 @@ void sinsp_stats::clear()
 	m_n_store_drops = 0;
 	m_n_retrieved_evts = 0;
 	m_n_retrieve_drops = 0;
+	m_n_interned_blocks = 0;
+	m_interned_bytes = 0;
+	m_n_interned_hits = 0;
+	m_fd_table_bytes = 0;
+	m_n_fd_names = 0;
+	m_fd_names_bytes = 0;
+	m_n_fd_names_hits = 0;
 	m_metrics_registry.clear_all_metrics();
 }
 
@@ -62,6 +69,17 @@ void sinsp_stats::emit(FILE* f)
 	fprintf(f, "store drops: %" PRIu64 "\n", m_n_store_drops);
 	fprintf(f, "retrieved evts: %" PRIu64 "\n", m_n_retrieved_evts);
 	fprintf(f, "retrieve drops: %" PRIu64 "\n", m_n_retrieve_drops);
+	fprintf(f, "interned thread blocks: %" PRIu64 " (%" PRIu64 " bytes, %" PRIu64 " shared)\n",
+		m_n_interned_blocks,
+		m_interned_bytes,
+		m_n_interned_hits);
+	fprintf(f, "fd tables: %" PRIu64 " bytes (%zu bytes per fd)\n",
+		m_fd_table_bytes,
+		sizeof(sinsp_fdinfo_t));
+	fprintf(f, "interned fd names: %" PRIu64 " (%" PRIu64 " bytes, %" PRIu64 " shared)\n",
+		m_n_fd_names,
+		m_fd_names_bytes,
+		m_n_fd_names_hits);
 
 	for(internal_metrics::registry::metric_map_iterator_t it = m_metrics_registry.get_metrics().begin(); it != m_metrics_registry.get_metrics().end(); it++)
 	{
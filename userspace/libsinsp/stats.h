@@ -51,6 +51,13 @@ public:
 	uint64_t m_n_store_drops;
 	uint64_t m_n_retrieved_evts;
 	uint64_t m_n_retrieve_drops;
+	uint64_t m_n_interned_blocks;
+	uint64_t m_interned_bytes;
+	uint64_t m_n_interned_hits;
+	uint64_t m_fd_table_bytes;
+	uint64_t m_n_fd_names;
+	uint64_t m_fd_names_bytes;
+	uint64_t m_n_fd_names_hits;
 
 private:
 	internal_metrics::registry m_metrics_registry;
@@ -27,6 +27,154 @@ limitations under the License.
 extern sinsp_filter_check_list g_filterlist;
 extern sinsp_evttables g_infotables;
 
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table_key_index implementation
+///////////////////////////////////////////////////////////////////////////////
+#define TABLE_KEY_INDEX_INITIAL_SLOTS 1024
+
+sinsp_table_key_index::sinsp_table_key_index()
+{
+	slot empty = {0, EMPTY_SLOT};
+	m_slots.assign(TABLE_KEY_INDEX_INITIAL_SLOTS, empty);
+	m_mask = TABLE_KEY_INDEX_INITIAL_SLOTS - 1;
+}
+
+//
+// FNV-1a
+//
+uint64_t sinsp_table_key_index::hash(const uint8_t* val, uint32_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	for(uint32_t j = 0; j < len; j++)
+	{
+		h ^= val[j];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+uint32_t sinsp_table_key_index::intern(uint8_t* val, uint32_t len, sinsp_table_buffer* buffer, OUT bool* is_new)
+{
+	//
+	// Keep the load factor under 3/4
+	//
+	if((m_keys.size() + 1) * 4 > m_slots.size() * 3)
+	{
+		grow();
+	}
+
+	uint64_t h = hash(val, len);
+	uint64_t pos = h & m_mask;
+
+	while(true)
+	{
+		slot* s = &m_slots[pos];
+
+		if(s->m_id == EMPTY_SLOT)
+		{
+			s->m_hash = h;
+			s->m_id = (uint32_t)m_keys.size();
+			m_keys.push_back(sinsp_table_field(buffer->copy(val, len), len, 1));
+			*is_new = true;
+			return s->m_id;
+		}
+
+		if(s->m_hash == h)
+		{
+			sinsp_table_field* key = &m_keys[s->m_id];
+			if(key->m_len == len && memcmp(key->m_val, val, len) == 0)
+			{
+				*is_new = false;
+				return s->m_id;
+			}
+		}
+
+		pos = (pos + 1) & m_mask;
+	}
+}
+
+void sinsp_table_key_index::grow()
+{
+	slot empty = {0, EMPTY_SLOT};
+	vector<slot> old_slots(m_slots.size() * 2, empty);
+	m_slots.swap(old_slots);
+	m_mask = m_slots.size() - 1;
+
+	for(const slot& s : old_slots)
+	{
+		if(s.m_id == EMPTY_SLOT)
+		{
+			continue;
+		}
+
+		uint64_t pos = s.m_hash & m_mask;
+		while(m_slots[pos].m_id != EMPTY_SLOT)
+		{
+			pos = (pos + 1) & m_mask;
+		}
+
+		m_slots[pos] = s;
+	}
+}
+
+void sinsp_table_key_index::clear()
+{
+	//
+	// The slots are kept, the next sample will likely have as many keys
+	//
+	if(m_keys.size() != 0)
+	{
+		slot empty = {0, EMPTY_SLOT};
+		std::fill(m_slots.begin(), m_slots.end(), empty);
+		m_keys.clear();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table_column and sinsp_table_columns implementation
+///////////////////////////////////////////////////////////////////////////////
+void sinsp_table_column::append(sinsp_table_field* fld, sinsp_table_buffer* buffer)
+{
+	m_cnts.push_back(fld->m_cnt);
+
+	if(m_width != 0)
+	{
+		ASSERT(fld->m_len == m_width);
+		m_data.insert(m_data.end(), fld->m_val, fld->m_val + m_width);
+	}
+	else
+	{
+		m_vars.push_back(sinsp_table_field(buffer->copy(fld->m_val, fld->m_len),
+			fld->m_len,
+			fld->m_cnt));
+	}
+}
+
+void sinsp_table_columns::init(vector<ppm_param_type>* types)
+{
+	m_columns.resize(types->size() - 1);
+
+	for(uint32_t j = 1; j < types->size(); j++)
+	{
+		m_columns[j - 1].m_width = sinsp_table::get_fixed_field_len(types->at(j));
+	}
+}
+
+void sinsp_table_columns::clear()
+{
+	m_keys.clear();
+	m_buffer.clear();
+
+	for(auto& column : m_columns)
+	{
+		column.m_data.clear();
+		column.m_vars.clear();
+		column.m_cnts.clear();
+	}
+}
+
 //
 //
 // Table sorter functor
@@ -105,6 +253,9 @@ sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_inte
 	m_sample_data = NULL;
 	m_json_first_row = json_first_row;
 	m_json_last_row = json_last_row;
+	m_sample_limit = 0;
+	m_columnar = false;
+	m_cur_columns = &m_columns[0];
 }
 
 sinsp_table::~sinsp_table()
@@ -248,6 +399,12 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 	m_premerge_vals_array_sz = (m_n_fields - 1) * sizeof(sinsp_table_field);
 	m_vals_array_sz = m_premerge_vals_array_sz;
 
+	if(m_columnar)
+	{
+		m_columns[0].init(&m_premerge_types);
+		m_columns[1].init(&m_premerge_types);
+	}
+
 	//////////////////////////////////////////////////////////////////////////////////////
 	// If a merge has been specified, configure it 
 	//////////////////////////////////////////////////////////////////////////////////////
@@ -339,6 +496,26 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 	}
 
 	m_postmerge_vals_array_sz = (m_n_postmerge_fields - 1) * sizeof(sinsp_table_field);
+
+	if(m_columnar)
+	{
+		m_merge_columns.init(&m_postmerge_types);
+	}
+}
+
+void sinsp_table::set_columnar(bool columnar)
+{
+	if(columnar && m_type != sinsp_table::TT_TABLE)
+	{
+		throw sinsp_exception("columnar aggregation is only supported for tables");
+	}
+
+	if(m_n_premerge_fields != 0)
+	{
+		throw sinsp_exception("columnar aggregation must be selected before configuring the table");
+	}
+
+	m_columnar = columnar;
 }
 
 void sinsp_table::add_row(bool merging)
@@ -386,11 +563,11 @@ void sinsp_table::add_row(bool merging)
 			{
 				if(merging)
 				{
-					add_fields(j, &m_fld_pointers[j], m_postmerge_extractors[j]->m_merge_aggregation);
+					add_fields((*m_types)[j], &m_vals[j - 1], &m_fld_pointers[j], m_postmerge_extractors[j]->m_merge_aggregation, m_buffer);
 				}
 				else
 				{
-					add_fields(j, &m_fld_pointers[j], m_premerge_extractors[j]->m_aggregation);
+					add_fields((*m_types)[j], &m_vals[j - 1], &m_fld_pointers[j], m_premerge_extractors[j]->m_aggregation, m_buffer);
 				}
 			}
 		}
@@ -429,6 +606,37 @@ void sinsp_table::add_row(bool merging)
 	}
 }
 
+void sinsp_table::add_row_columnar(sinsp_table_columns* columns, bool merging)
+{
+	uint32_t j;
+	bool is_new;
+
+	uint32_t id = columns->m_keys.intern(m_fld_pointers[0].m_val,
+		m_fld_pointers[0].m_len,
+		&columns->m_buffer,
+		&is_new);
+
+	for(j = 1; j < m_n_fields; j++)
+	{
+		sinsp_table_column* column = &columns->m_columns[j - 1];
+
+		if(is_new)
+		{
+			column->append(&m_fld_pointers[j], &columns->m_buffer);
+		}
+		else
+		{
+			sinsp_table_field dst = column->get(id);
+			uint32_t aggr = merging ?
+				m_postmerge_extractors[j]->m_merge_aggregation :
+				m_premerge_extractors[j]->m_aggregation;
+
+			add_fields((*m_types)[j], &dst, &m_fld_pointers[j], aggr, &columns->m_buffer);
+			column->set(id, &dst);
+		}
+	}
+}
+
 void sinsp_table::process_event(sinsp_evt* evt)
 {
 	uint32_t j;
@@ -470,7 +678,10 @@ void sinsp_table::process_event(sinsp_evt* evt)
 				}
 
 				pfld->m_len = get_field_len(j);
-				pfld->m_val = m_buffer->copy(pfld->m_val, pfld->m_len);
+				if(!m_columnar)
+				{
+					pfld->m_val = m_buffer->copy(pfld->m_val, pfld->m_len);
+				}
 				pfld->m_cnt = 0;
 			}
 			else
@@ -482,15 +693,26 @@ void sinsp_table::process_event(sinsp_evt* evt)
 		{
 			pfld->m_val = val;
 			pfld->m_len = get_field_len(j);
-			pfld->m_val = m_buffer->copy(val, pfld->m_len);
+			if(!m_columnar)
+			{
+				pfld->m_val = m_buffer->copy(val, pfld->m_len);
+			}
 			pfld->m_cnt = 1;
 		}
 	}
 
 	//
-	// Add the row
+	// Add the row. In columnar mode the values are only copied, in the
+	// columns, when the key is new.
 	//
-	add_row(false);
+	if(m_columnar)
+	{
+		add_row_columnar(m_cur_columns, false);
+	}
+	else
+	{
+		add_row(false);
+	}
 
 	return;
 }
@@ -568,9 +790,22 @@ void sinsp_table::flush(sinsp_evt* evt)
 			//
 			// Emit the sample
 			//
-			create_sample();
+			if(m_columnar)
+			{
+				create_sample_columnar();
 
-			if(m_type == sinsp_table::TT_TABLE)
+				//
+				// Same as switch_buffers() below for the columns
+				//
+				m_cur_columns = (m_cur_columns == &m_columns[0]) ? &m_columns[1] : &m_columns[0];
+				m_cur_columns->clear();
+			}
+			else
+			{
+				create_sample();
+			}
+
+			if(m_type == sinsp_table::TT_TABLE && !m_columnar)
 			{
 				//
 				// Switch the data storage so that the current one is still usable by the 
@@ -830,9 +1065,42 @@ void sinsp_table::sort_sample()
 		uint32_t tyid = m_do_merging? m_sorting_col + 2 : m_sorting_col + 1;
 		cc.m_type = m_premerge_types[tyid];
 
-		sort(m_sample_data->begin(),
-			m_sample_data->end(),
-			cc);
+		//
+		// When only the top of the sample is going to be used, sort just
+		// that part
+		//
+		size_t nrows = m_sample_data->size();
+
+		if(m_type == sinsp_table::TT_TABLE)
+		{
+			if(m_sample_limit != 0)
+			{
+				nrows = m_sample_limit;
+			}
+			else if(m_output_type == sinsp_table::OT_JSON && m_json_last_row != 0)
+			{
+				nrows = (size_t)m_json_last_row + 1;
+			}
+		}
+
+		if(nrows < m_sample_data->size())
+		{
+			partial_sort(m_sample_data->begin(),
+				m_sample_data->begin() + nrows,
+				m_sample_data->end(),
+				cc);
+
+			if(m_sample_limit != 0)
+			{
+				m_sample_data->resize(nrows);
+			}
+		}
+		else
+		{
+			sort(m_sample_data->begin(),
+				m_sample_data->end(),
+				cc);
+		}
 	}
 }
 
@@ -1042,6 +1310,64 @@ void sinsp_table::create_sample()
 	}
 }
 
+void sinsp_table::create_sample_columnar()
+{
+	uint32_t j;
+	uint32_t id;
+	sinsp_table_columns* columns = m_cur_columns;
+
+	ASSERT(m_type == sinsp_table::TT_TABLE);
+
+	//
+	// Merging is done the same way as collecting the events, with the
+	// postmerge fields taken from the columns
+	//
+	if(m_do_merging)
+	{
+		m_merge_columns.clear();
+
+		for(id = 0; id < columns->m_keys.size(); id++)
+		{
+			for(j = 0; j < m_n_postmerge_fields; j++)
+			{
+				uint32_t col = m_groupby_columns[j];
+				if(col == 0)
+				{
+					m_postmerge_fld_pointers[j] = *columns->m_keys.get_key(id);
+				}
+				else
+				{
+					m_postmerge_fld_pointers[j] = columns->m_columns[col - 1].get(id);
+				}
+			}
+
+			add_row_columnar(&m_merge_columns, true);
+		}
+
+		columns = &m_merge_columns;
+	}
+
+	//
+	// Emit the table. The rows are reused across samples to avoid
+	// reallocating their values.
+	//
+	uint32_t nrows = columns->m_keys.size();
+	m_full_sample_data.resize(nrows);
+
+	for(id = 0; id < nrows; id++)
+	{
+		sinsp_sample_row& row = m_full_sample_data[id];
+
+		row.m_key = *columns->m_keys.get_key(id);
+		row.m_values.resize(m_n_fields - 1);
+
+		for(j = 0; j < m_n_fields - 1; j++)
+		{
+			row.m_values[j] = columns->m_columns[j].get(id);
+		}
+	}
+}
+
 void sinsp_table::add_fields_sum(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
 {
 	uint8_t* operand1 = dst->m_val;
@@ -1176,7 +1502,7 @@ void sinsp_table::add_fields_sum_of_avg(ppm_param_type type, sinsp_table_field *
 	dst->m_cnt = 1;
 }
 
-void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
+void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src, sinsp_table_buffer* buffer)
 {
 	uint8_t* operand1 = dst->m_val;
 	uint8_t* operand2 = src->m_val;
@@ -1248,7 +1574,7 @@ void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, si
 		}
 		else
 		{
-			dst->m_val = m_buffer->copy(src->m_val, src->m_len);
+			dst->m_val = buffer->copy(src->m_val, src->m_len);
 		}
 
 		dst->m_len = src->m_len;
@@ -1257,7 +1583,7 @@ void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, si
 	}
 }
 
-void sinsp_table::add_fields_min(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
+void sinsp_table::add_fields_min(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src, sinsp_table_buffer* buffer)
 {
 	uint8_t* operand1 = dst->m_val;
 	uint8_t* operand2 = src->m_val;
@@ -1330,7 +1656,7 @@ void sinsp_table::add_fields_min(ppm_param_type type, sinsp_table_field *dst, si
 		}
 		else
 		{
-			dst->m_val = m_buffer->copy(src->m_val, src->m_len);
+			dst->m_val = buffer->copy(src->m_val, src->m_len);
 		}
 
 		dst->m_len = src->m_len;
@@ -1339,11 +1665,8 @@ void sinsp_table::add_fields_min(ppm_param_type type, sinsp_table_field *dst, si
 	}
 }
 
-void sinsp_table::add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t aggr)
+void sinsp_table::add_fields(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src, uint32_t aggr, sinsp_table_buffer* buffer)
 {
-	ppm_param_type type = (*m_types)[dst_id];
-	sinsp_table_field* dst = &(m_vals[dst_id - 1]);
-
 	switch(aggr)
 	{
 	case A_NONE:
@@ -1365,7 +1688,7 @@ void sinsp_table::add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t a
 		add_fields_sum(type, dst, src);		
 		return;
 	case A_MAX:
-		add_fields_max(type, dst, src);		
+		add_fields_max(type, dst, src, buffer);
 		return;
 	case A_MIN:
 		if(src->m_cnt != 0)
@@ -1377,7 +1700,7 @@ void sinsp_table::add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t a
 			}
 			else
 			{
-				add_fields_min(type, dst, src);
+				add_fields_min(type, dst, src, buffer);
 			}
 		}
 		return;
@@ -1395,6 +1718,33 @@ uint32_t sinsp_table::get_field_len(uint32_t id)
 	type = (*m_types)[id];
 	fld = &(m_fld_pointers[id]);
 
+	switch(type)
+	{
+	case PT_CHARBUF:
+		return (uint32_t)(strlen((char*)fld->m_val) + 1);
+	case PT_BYTEBUF:
+		return fld->m_len;
+	case PT_IPADDR:
+	case PT_IPNET:
+		if(fld->m_len == sizeof(struct in_addr))
+		{
+			return 4;
+		}
+		else
+		{
+			return sizeof(ipv6addr);
+		}
+	default:
+	{
+		uint32_t len = get_fixed_field_len(type);
+		ASSERT(len != 0);
+		return len;
+	}
+	}
+}
+
+uint32_t sinsp_table::get_fixed_field_len(ppm_param_type type)
+{
 	switch(type)
 	{
 	case PT_INT8:
@@ -1428,32 +1778,12 @@ uint32_t sinsp_table::get_field_len(uint32_t id)
 	case PT_RELTIME:
 	case PT_ABSTIME:
 		return 8;
-	case PT_CHARBUF:
-		return (uint32_t)(strlen((char*)fld->m_val) + 1);
-	case PT_BYTEBUF:
-		return fld->m_len;
 	case PT_DOUBLE:
 		return sizeof(double);
 	case PT_IPV6ADDR:
 		return sizeof(ipv6addr);
-	case PT_IPADDR:
-	case PT_IPNET:
-		if(fld->m_len == sizeof(struct in_addr))
-		{
-			return 4;
-		}
-		else
-		{
-			return sizeof(ipv6addr);
-		}
-	case PT_SOCKADDR:
-	case PT_SOCKTUPLE:
-	case PT_FDLIST:
-	case PT_FSPATH:
-	case PT_FSRELPATH:
 	default:
-		ASSERT(false);
-		return false;
+		return 0;
 	}
 }
 
@@ -210,6 +210,103 @@ public:
 	uint32_t m_pos;
 };
 
+//
+// Open addressing index that interns the keys of a columnar table and gives
+// each of them a dense id, which is the position of the row in the columns.
+// The hash of each key is kept in its slot, so the key bytes are only
+// compared on a probable match and never rehashed when the index grows.
+//
+class sinsp_table_key_index
+{
+public:
+	sinsp_table_key_index();
+
+	//
+	// Returns the id of the key, adding it if it's not there. New keys are
+	// copied in buffer.
+	//
+	uint32_t intern(uint8_t* val, uint32_t len, sinsp_table_buffer* buffer, OUT bool* is_new);
+
+	inline sinsp_table_field* get_key(uint32_t id)
+	{
+		return &m_keys[id];
+	}
+
+	inline uint32_t size() const
+	{
+		return (uint32_t)m_keys.size();
+	}
+
+	void clear();
+
+private:
+	static const uint32_t EMPTY_SLOT = 0xffffffff;
+
+	struct slot
+	{
+		uint64_t m_hash;
+		uint32_t m_id;
+	};
+
+	static uint64_t hash(const uint8_t* val, uint32_t len);
+	void grow();
+
+	vector<slot> m_slots;
+	vector<sinsp_table_field> m_keys;
+	uint64_t m_mask;
+};
+
+//
+// Accumulators of one value column, one entry per key id. Fixed size
+// values are stored back to back in m_data, the others as fields pointing
+// to the table buffer.
+//
+class sinsp_table_column
+{
+public:
+	void append(sinsp_table_field* fld, sinsp_table_buffer* buffer);
+
+	inline sinsp_table_field get(uint32_t id)
+	{
+		if(m_width != 0)
+		{
+			return sinsp_table_field(&m_data[(size_t)id * m_width], m_width, m_cnts[id]);
+		}
+		else
+		{
+			sinsp_table_field res = m_vars[id];
+			res.m_cnt = m_cnts[id];
+			return res;
+		}
+	}
+
+	inline void set(uint32_t id, sinsp_table_field* fld)
+	{
+		m_cnts[id] = fld->m_cnt;
+
+		if(m_width == 0)
+		{
+			m_vars[id] = *fld;
+		}
+	}
+
+	uint32_t m_width; ///< Size of the values, 0 if it's not fixed
+	vector<uint8_t> m_data;
+	vector<sinsp_table_field> m_vars;
+	vector<uint32_t> m_cnts;
+};
+
+class sinsp_table_columns
+{
+public:
+	void init(vector<ppm_param_type>* types);
+	void clear();
+
+	sinsp_table_key_index m_keys;
+	vector<sinsp_table_column> m_columns; ///< One per value, the key is not here
+	sinsp_table_buffer m_buffer; ///< Keys and variable size values
+};
+
 class sinsp_sample_row
 {
 public:
@@ -291,6 +388,33 @@ public:
 		m_is_sorting_ascending = is_sorting_ascending;
 	}
 
+	/*!
+	  \brief Aggregate the rows of a TT_TABLE table in columns of fixed
+	  size accumulators indexed by interned key ids, instead of a map of
+	  rows copied in the table buffer. Must be called before configure().
+	  The samples are the same in both modes.
+	*/
+	void set_columnar(bool columnar);
+	bool is_columnar()
+	{
+		return m_columnar;
+	}
+
+	/*!
+	  \brief Only keep the first max_rows rows of the sorted samples of
+	  TT_TABLE tables, so that a partial sort is enough. 0, the default,
+	  keeps all of them.
+	*/
+	void set_sample_limit(uint32_t max_rows)
+	{
+		m_sample_limit = max_rows;
+	}
+
+	//
+	// Size of the values of the given type, 0 if it depends on the value
+	//
+	static uint32_t get_fixed_field_len(ppm_param_type type);
+
 	uint64_t m_next_flush_time_ns;
 	uint64_t m_prev_flush_time_ns;
 	uint64_t m_refresh_interval_ns;
@@ -301,13 +425,15 @@ private:
 	inline void add_row(bool merging);
 	inline void add_fields_sum(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
 	inline void add_fields_sum_of_avg(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
-	inline void add_fields_max(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
-	inline void add_fields_min(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
-	inline void add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t aggr);
+	inline void add_fields_max(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src, sinsp_table_buffer* buffer);
+	inline void add_fields_min(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src, sinsp_table_buffer* buffer);
+	inline void add_fields(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src, uint32_t aggr, sinsp_table_buffer* buffer);
+	inline void add_row_columnar(sinsp_table_columns* columns, bool merging);
 	void process_proctable(sinsp_evt* evt);
 	inline uint32_t get_field_len(uint32_t id);
 	inline uint8_t* get_default_val(filtercheck_field_info* fld);
 	void create_sample();
+	void create_sample_columnar();
 	void switch_buffers();
 	void print_raw(vector<sinsp_sample_row>* sample_data, uint64_t time_delta);
 	void print_json(vector<sinsp_sample_row>* sample_data, uint64_t time_delta);
@@ -359,6 +485,16 @@ private:
 	uint32_t m_view_depth;
 	uint32_t m_json_first_row;
 	uint32_t m_json_last_row;
+	uint32_t m_sample_limit;
+	bool m_columnar;
+	//
+	// Columnar mode storage. There are two sets for the events, like the
+	// two buffers in row mode, so that the last sample stays valid while
+	// the next one is collected.
+	//
+	sinsp_table_columns m_columns[2];
+	sinsp_table_columns* m_cur_columns;
+	sinsp_table_columns m_merge_columns;
 
 	friend class curses_table;	
 	friend class sinsp_cursesui;
@@ -0,0 +1,260 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "tcp_stats.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+// From include/net/tcp_states.h
+#define SINSP_TCP_CLOSE 7
+
+sinsp_tcp_conn_key::sinsp_tcp_conn_key(uint32_t sip, uint16_t sport, uint32_t dip, uint16_t dport)
+{
+	if(sip < dip || (sip == dip && sport <= dport))
+	{
+		m_ip_a = sip;
+		m_port_a = sport;
+		m_ip_b = dip;
+		m_port_b = dport;
+	}
+	else
+	{
+		m_ip_a = dip;
+		m_port_a = dport;
+		m_ip_b = sip;
+		m_port_b = sport;
+	}
+}
+
+sinsp_tcp_stats_table::sinsp_tcp_stats_table(uint64_t max_connections,
+	uint64_t interval_ns,
+	uint64_t idle_timeout_ns):
+	m_max_connections(max_connections),
+	m_interval_ns(interval_ns),
+	m_idle_timeout_ns(idle_timeout_ns),
+	m_next_snapshot_ts(0),
+	m_n_untracked(0)
+{
+}
+
+void sinsp_tcp_stats_table::set_snapshot_callback(uint64_t interval_ns, const snapshot_callback_t& cb)
+{
+	m_interval_ns = interval_ns;
+	m_snapshot_cb = cb;
+	m_next_snapshot_ts = 0;
+}
+
+sinsp_tcp_stats* sinsp_tcp_stats_table::get(const sinsp_tcp_conn_key& key, uint64_t ts)
+{
+	auto it = m_conns.find(key);
+
+	if(it == m_conns.end())
+	{
+		if(m_conns.size() >= m_max_connections)
+		{
+			m_n_untracked++;
+			return NULL;
+		}
+
+		sinsp_tcp_stats& st = m_conns[key];
+		memset(&st, 0, sizeof(st));
+		st.m_srtt_min = UINT32_MAX;
+		st.m_state = -1;
+		st.m_first_ts = ts;
+		st.m_last_ts = ts;
+		return &st;
+	}
+
+	it->second.m_last_ts = ts;
+	return &it->second;
+}
+
+bool sinsp_tcp_stats_table::process_event(sinsp_evt* evt)
+{
+	uint16_t etype = evt->get_type();
+
+	switch(etype)
+	{
+	case PPME_TCP_RCV_ESTABLISHED_E:
+	case PPME_TCP_CLOSE_E:
+	case PPME_TCP_RTT_SUMMARY_E:
+	case PPME_TCP_DROP_E:
+	case PPME_TCP_RETRANCESMIT_SKB_E:
+	case PPME_TCP_SET_STATE_E:
+	case PPME_TCP_SEND_RESET_E:
+	case PPME_TCP_RECEIVE_RESET_E:
+		break;
+	default:
+		return false;
+	}
+
+	//
+	// The tuple is family, source address, source port, destination
+	// address and destination port. Only IPv4 is sent by the driver.
+	//
+	sinsp_evt_param* parinfo = evt->get_param(0);
+	if(parinfo->m_len != 13 || parinfo->m_val[0] != PPM_AF_INET)
+	{
+		return true;
+	}
+
+	const char* packed = parinfo->m_val;
+	sinsp_tcp_conn_key key(*(uint32_t*)(packed + 1),
+		*(uint16_t*)(packed + 5),
+		*(uint32_t*)(packed + 7),
+		*(uint16_t*)(packed + 11));
+
+	sinsp_tcp_stats* st = get(key, evt->get_ts());
+	if(st == NULL)
+	{
+		return true;
+	}
+
+	switch(etype)
+	{
+	case PPME_TCP_RCV_ESTABLISHED_E:
+	case PPME_TCP_CLOSE_E:
+	{
+		uint32_t srtt = *(uint32_t*)evt->get_param(1)->m_val;
+
+		if(srtt < st->m_srtt_min)
+		{
+			st->m_srtt_min = srtt;
+		}
+		if(srtt > st->m_srtt_max)
+		{
+			st->m_srtt_max = srtt;
+		}
+		st->m_srtt_sum += srtt;
+		st->m_srtt_samples++;
+
+		if(etype == PPME_TCP_CLOSE_E)
+		{
+			st->m_state = SINSP_TCP_CLOSE;
+		}
+		break;
+	}
+	case PPME_TCP_RTT_SUMMARY_E:
+	{
+		//
+		// Aggregated by the BPF probe: samples, min, max and sum
+		//
+		uint32_t samples = *(uint32_t*)evt->get_param(1)->m_val;
+		uint32_t srtt_min = *(uint32_t*)evt->get_param(2)->m_val;
+		uint32_t srtt_max = *(uint32_t*)evt->get_param(3)->m_val;
+
+		if(samples == 0)
+		{
+			break;
+		}
+		if(srtt_min < st->m_srtt_min)
+		{
+			st->m_srtt_min = srtt_min;
+		}
+		if(srtt_max > st->m_srtt_max)
+		{
+			st->m_srtt_max = srtt_max;
+		}
+		st->m_srtt_sum += *(uint64_t*)evt->get_param(4)->m_val;
+		st->m_srtt_samples += samples;
+		break;
+	}
+	case PPME_TCP_DROP_E:
+		st->m_drops++;
+		break;
+	case PPME_TCP_RETRANCESMIT_SKB_E:
+	{
+		int32_t segs = *(int32_t*)evt->get_param(1)->m_val;
+		st->m_retransmits += segs > 0 ? segs : 1;
+		break;
+	}
+	case PPME_TCP_SET_STATE_E:
+		st->m_state = *(int32_t*)evt->get_param(2)->m_val;
+		break;
+	case PPME_TCP_SEND_RESET_E:
+		st->m_resets_sent++;
+		st->m_reset_state = *(uint32_t*)evt->get_param(1)->m_val;
+		break;
+	case PPME_TCP_RECEIVE_RESET_E:
+		st->m_resets_received++;
+		st->m_reset_state = *(uint32_t*)evt->get_param(1)->m_val;
+		break;
+	}
+
+	return true;
+}
+
+const sinsp_tcp_stats* sinsp_tcp_stats_table::find(const sinsp_tcp_conn_key& key) const
+{
+	auto it = m_conns.find(key);
+
+	if(it == m_conns.end())
+	{
+		return NULL;
+	}
+
+	return &it->second;
+}
+
+const sinsp_tcp_stats* sinsp_tcp_stats_table::find(const sinsp_fdinfo_t* fdinfo) const
+{
+	if(fdinfo->m_type != SCAP_FD_IPV4_SOCK ||
+	   fdinfo->m_sockinfo.m_ipv4info.m_fields.m_l4proto != SCAP_L4_TCP)
+	{
+		return NULL;
+	}
+
+	const ipv4tuple& t = fdinfo->m_sockinfo.m_ipv4info;
+	return find(sinsp_tcp_conn_key(t.m_fields.m_sip, t.m_fields.m_sport, t.m_fields.m_dip, t.m_fields.m_dport));
+}
+
+void sinsp_tcp_stats_table::loop(const loop_callback_t& cb) const
+{
+	for(auto& it : m_conns)
+	{
+		cb(it.first, it.second);
+	}
+}
+
+void sinsp_tcp_stats_table::snapshot(uint64_t ts)
+{
+	if(m_next_snapshot_ts == 0)
+	{
+		m_next_snapshot_ts = ts + m_interval_ns;
+		return;
+	}
+
+	m_next_snapshot_ts = ts + m_interval_ns;
+
+	if(m_snapshot_cb)
+	{
+		m_snapshot_cb(ts, *this);
+	}
+
+	for(auto it = m_conns.begin(); it != m_conns.end();)
+	{
+		if(it->second.m_state == SINSP_TCP_CLOSE ||
+		   it->second.m_last_ts + m_idle_timeout_ns < ts)
+		{
+			it = m_conns.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
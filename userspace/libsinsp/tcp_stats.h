@@ -0,0 +1,164 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <unordered_map>
+
+#include "sinsp_public.h"
+#include "settings.h"
+
+class sinsp_evt;
+
+/*!
+  \brief An IPv4 TCP connection, with the endpoints sorted so that both
+  sides of the connection, and the fd table tuple, give the same key.
+  Addresses are in network byte order, ports in host byte order.
+*/
+struct sinsp_tcp_conn_key
+{
+	sinsp_tcp_conn_key():
+		m_ip_a(0), m_ip_b(0), m_port_a(0), m_port_b(0)
+	{
+	}
+
+	sinsp_tcp_conn_key(uint32_t sip, uint16_t sport, uint32_t dip, uint16_t dport);
+
+	bool operator==(const sinsp_tcp_conn_key& other) const
+	{
+		return m_ip_a == other.m_ip_a && m_ip_b == other.m_ip_b &&
+			m_port_a == other.m_port_a && m_port_b == other.m_port_b;
+	}
+
+	uint32_t m_ip_a;
+	uint32_t m_ip_b;
+	uint16_t m_port_a;
+	uint16_t m_port_b;
+};
+
+namespace std
+{
+template<> struct hash<sinsp_tcp_conn_key> {
+	std::size_t operator()(const sinsp_tcp_conn_key& k) const
+	{
+		uint64_t h = ((uint64_t)k.m_ip_a << 32 | k.m_ip_b) * 0x9e3779b97f4a7c15ULL;
+		return h ^ ((uint64_t)k.m_port_a << 16 | k.m_port_b);
+	}
+};
+}
+
+/*!
+  \brief Health of a TCP connection, from the tcp_* kernel events
+*/
+struct sinsp_tcp_stats
+{
+	uint32_t m_srtt_min; ///< Smoothed RTT, microseconds
+	uint32_t m_srtt_max;
+	uint64_t m_srtt_sum;
+	uint64_t m_srtt_samples;
+	uint64_t m_retransmits; ///< Retransmitted segments
+	uint64_t m_drops;
+	uint64_t m_resets_sent;
+	uint64_t m_resets_received;
+	uint32_t m_reset_state; ///< TCP state at the last reset
+	int32_t m_state; ///< Last TCP state seen, -1 if unknown
+	uint64_t m_first_ts;
+	uint64_t m_last_ts;
+
+	inline uint32_t srtt_avg() const
+	{
+		return m_srtt_samples ? (uint32_t)(m_srtt_sum / m_srtt_samples) : 0;
+	}
+};
+
+/*!
+  \brief Folds the tcp_* kernel events into per connection stats.
+
+  The events come from the kernel network stack, not from the process
+  owning the socket, so connections are identified by their tuple only.
+  fd filter fields look their fdinfo up by tuple.
+
+  Every interval of event time, the snapshot callback, if any, gets the
+  whole table. Then connections that went to TCP_CLOSE, or that had no
+  events for the idle timeout, are removed.
+*/
+class SINSP_PUBLIC sinsp_tcp_stats_table
+{
+public:
+	typedef std::function<void(uint64_t ts, const sinsp_tcp_stats_table& table)> snapshot_callback_t;
+	typedef std::function<void(const sinsp_tcp_conn_key& key, const sinsp_tcp_stats& stats)> loop_callback_t;
+
+	/*!
+	  \param max_connections beyond this, new connections aren't tracked
+	  until the next purge.
+	*/
+	sinsp_tcp_stats_table(uint64_t max_connections = 256 * 1024,
+		uint64_t interval_ns = 10ULL * 1000000000,
+		uint64_t idle_timeout_ns = 300ULL * 1000000000);
+
+	/*!
+	  \return false if evt isn't a tcp_* event.
+	*/
+	bool process_event(sinsp_evt* evt);
+
+	/*!
+	  \brief Call with the time of every event, runs the snapshot
+	  callback and the purge when the interval is over.
+	*/
+	inline void on_ts(uint64_t ts)
+	{
+		if(ts >= m_next_snapshot_ts)
+		{
+			snapshot(ts);
+		}
+	}
+
+	void set_snapshot_callback(uint64_t interval_ns, const snapshot_callback_t& cb);
+
+	const sinsp_tcp_stats* find(const sinsp_tcp_conn_key& key) const;
+	const sinsp_tcp_stats* find(const sinsp_fdinfo_t* fdinfo) const;
+
+	void loop(const loop_callback_t& cb) const;
+
+	inline uint64_t size() const
+	{
+		return m_conns.size();
+	}
+
+	/*!
+	  \brief Events for connections that couldn't be tracked because the
+	  table was full
+	*/
+	inline uint64_t get_n_untracked() const
+	{
+		return m_n_untracked;
+	}
+
+private:
+	sinsp_tcp_stats* get(const sinsp_tcp_conn_key& key, uint64_t ts);
+	void snapshot(uint64_t ts);
+
+	std::unordered_map<sinsp_tcp_conn_key, sinsp_tcp_stats> m_conns;
+	uint64_t m_max_connections;
+	uint64_t m_interval_ns;
+	uint64_t m_idle_timeout_ns;
+	uint64_t m_next_snapshot_ts;
+	uint64_t m_n_untracked;
+	snapshot_callback_t m_snapshot_cb;
+};
@@ -0,0 +1,221 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <string.h>
+#include <vector>
+
+#include <sinsp.h>
+#include <cpu_analysis.h>
+
+//
+// Build a cpu_analysis event the way the BPF probe sends struct info_t:
+// 16 durations, 8 run queue latencies in us, 16 types
+//
+class cpu_analysis_event
+{
+public:
+	struct interval
+	{
+		uint8_t type;
+		uint64_t duration_ns;
+		uint64_t runq_us;
+	};
+
+	cpu_analysis_event(int64_t tid, uint64_t ts, const std::vector<interval>& intervals, uint32_t time_specs_len = 128)
+	{
+		uint64_t time_specs[16] = {0};
+		uint64_t runq[8] = {0};
+		uint8_t types[16] = {0};
+
+		for(uint32_t j = 0; j < intervals.size(); j++)
+		{
+			time_specs[j] = intervals[j].duration_ns;
+			types[j] = intervals[j].type;
+			if(intervals[j].type != CPU_TIME_ON)
+			{
+				runq[j / 2] = intervals[j].runq_us;
+			}
+		}
+
+		uint16_t lens[] = {8, 8, 4, (uint16_t)time_specs_len, sizeof(runq), sizeof(types)};
+		uint32_t len = sizeof(scap_evt) + sizeof(lens);
+		for(uint16_t l : lens)
+		{
+			len += l;
+		}
+
+		m_buf.resize(len);
+		scap_evt* e = (scap_evt*)m_buf.data();
+		e->ts = ts;
+		e->tid = tid;
+		e->len = len;
+		e->type = PPME_CPU_ANALYSIS_E;
+		e->nparams = 6;
+
+		uint8_t* p = (uint8_t*)(e + 1);
+		memcpy(p, lens, sizeof(lens));
+		p += sizeof(lens);
+
+		uint64_t start_ts = ts - 1000;
+		uint32_t cnt = intervals.size();
+		memcpy(p, &start_ts, 8);
+		memcpy(p + 8, &ts, 8);
+		memcpy(p + 16, &cnt, 4);
+		p += 20;
+		memcpy(p, time_specs, time_specs_len);
+		p += time_specs_len;
+		memcpy(p, runq, sizeof(runq));
+		p += sizeof(runq);
+		memcpy(p, types, sizeof(types));
+
+		m_evt.init(m_buf.data(), 0);
+	}
+
+	sinsp_evt* get()
+	{
+		return &m_evt;
+	}
+
+private:
+	std::vector<uint8_t> m_buf;
+	sinsp_evt m_evt;
+};
+
+TEST(cpu_analysis_test, decode)
+{
+	cpu_analysis_event evt(42, 5000, {
+		{CPU_TIME_ON, 1000, 0},
+		{CPU_TIME_NET, 20000, 3},
+		{CPU_TIME_ON, 500, 0},
+		{CPU_TIME_DISK, 2000, 5},
+		{42, 100, 0},
+	});
+
+	sinsp_cpu_analysis_record record;
+	ASSERT_TRUE(record.init(evt.get()));
+	ASSERT_EQ(4000u, record.get_start_ts());
+	ASSERT_EQ(5000u, record.get_end_ts());
+	ASSERT_EQ(5u, record.size());
+
+	sinsp_cpu_interval i = record.get(0);
+	ASSERT_EQ(CPU_TIME_ON, i.m_type);
+	ASSERT_EQ(1000u, i.m_duration_ns);
+	ASSERT_EQ(0u, i.m_runq_ns);
+
+	i = record.get(1);
+	ASSERT_EQ(CPU_TIME_NET, i.m_type);
+	ASSERT_EQ(20000u, i.m_duration_ns);
+	ASSERT_EQ(3000u, i.m_runq_ns);
+
+	// the run queue latency can't be longer than the interval
+	i = record.get(3);
+	ASSERT_EQ(CPU_TIME_DISK, i.m_type);
+	ASSERT_EQ(2000u, i.m_runq_ns);
+
+	// unknown types are accounted as other
+	ASSERT_EQ(CPU_TIME_OTHER, record.get(4).m_type);
+
+	// too short for its count
+	cpu_analysis_event truncated(42, 5000, {{CPU_TIME_ON, 1000, 0}, {CPU_TIME_NET, 1000, 0}}, 8);
+	ASSERT_FALSE(record.init(truncated.get()));
+
+	std::vector<uint8_t> buf(sizeof(scap_evt), 0);
+	((scap_evt*)buf.data())->type = PPME_SYSCALL_CLOSE_E;
+	((scap_evt*)buf.data())->len = buf.size();
+	sinsp_evt other;
+	other.init(buf.data(), 0);
+	ASSERT_FALSE(record.init(&other));
+}
+
+TEST(cpu_analysis_test, breakdown)
+{
+	sinsp_cpu_analysis_table table;
+
+	ASSERT_TRUE(table.process_event(cpu_analysis_event(1, 100, {
+		{CPU_TIME_ON, 1000, 0},
+		{CPU_TIME_NET, 10000, 2},
+		{CPU_TIME_ON, 3000, 0},
+		{CPU_TIME_LOCK, 5000, 0},
+	}).get(), "c1"));
+	ASSERT_TRUE(table.process_event(cpu_analysis_event(1, 200, {
+		{CPU_TIME_IDLE, 7000, 1},
+		{CPU_TIME_ON, 2000, 0},
+	}).get(), "c1"));
+	ASSERT_TRUE(table.process_event(cpu_analysis_event(2, 300, {
+		{CPU_TIME_ON, 4000, 0},
+		{CPU_TIME_DISK, 6000, 0},
+	}).get(), "c1"));
+	ASSERT_TRUE(table.process_event(cpu_analysis_event(3, 400, {
+		{CPU_TIME_ON, 9000, 0},
+	}).get(), ""));
+
+	const sinsp_cpu_time_breakdown* t1 = table.find_thread(1);
+	ASSERT_NE(nullptr, t1);
+	ASSERT_EQ(6000u, t1->oncpu_ns());
+	ASSERT_EQ(8000u, t1->m_time_ns[CPU_TIME_NET]);
+	ASSERT_EQ(5000u, t1->m_time_ns[CPU_TIME_LOCK]);
+	ASSERT_EQ(6000u, t1->m_time_ns[CPU_TIME_IDLE]);
+	ASSERT_EQ(3000u, t1->m_time_ns[CPU_TIME_RUNQ]);
+	ASSERT_EQ(22000u, t1->offcpu_ns());
+	ASSERT_EQ(6u, t1->m_nintervals);
+	ASSERT_EQ(200u, t1->m_last_ts);
+
+	const sinsp_cpu_time_breakdown* c1 = table.find_container("c1");
+	ASSERT_NE(nullptr, c1);
+	ASSERT_EQ(10000u, c1->oncpu_ns());
+	ASSERT_EQ(6000u, c1->m_time_ns[CPU_TIME_DISK]);
+	ASSERT_EQ(28000u, c1->offcpu_ns());
+
+	const sinsp_cpu_time_breakdown* host = table.find_container("");
+	ASSERT_NE(nullptr, host);
+	ASSERT_EQ(9000u, host->oncpu_ns());
+	ASSERT_EQ(0u, host->offcpu_ns());
+
+	ASSERT_EQ(3u, table.get_threads().size());
+	ASSERT_EQ(2u, table.get_containers().size());
+	ASSERT_EQ(nullptr, table.find_thread(4));
+}
+
+TEST(cpu_analysis_test, purge_and_limit)
+{
+	sinsp_cpu_analysis_table table(2, 1000);
+
+	table.on_ts(1);
+	for(int64_t tid = 1; tid <= 3; tid++)
+	{
+		table.process_event(cpu_analysis_event(tid, 10 * tid, {{CPU_TIME_ON, 100, 0}}).get(), "");
+	}
+
+	// the third thread isn't tracked, but counts in its container
+	ASSERT_EQ(2u, table.get_threads().size());
+	ASSERT_EQ(300u, table.find_container("")->oncpu_ns());
+
+	// only the thread with recent events is kept
+	table.process_event(cpu_analysis_event(2, 1500, {{CPU_TIME_ON, 100, 0}}).get(), "");
+	table.on_ts(1050);
+	ASSERT_EQ(1u, table.get_threads().size());
+	ASSERT_NE(nullptr, table.find_thread(2));
+
+	// no purge before the timeout is over again
+	table.on_ts(2020);
+	ASSERT_EQ(1u, table.get_threads().size());
+
+	table.on_ts(2600);
+	ASSERT_EQ(0u, table.get_threads().size());
+	ASSERT_EQ(1u, table.get_containers().size());
+}
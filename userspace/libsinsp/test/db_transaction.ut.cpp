@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <db_transaction.h>
+#include <string>
+
+static bool feed(sinsp_db_conn& conn, bool is_read, uint64_t ts, const std::string& data, sinsp_db_transaction* tr)
+{
+	return conn.on_data(is_read, ts, data.data(), data.size(), data.size(), tr);
+}
+
+TEST(db_transaction_test, mysql)
+{
+	sinsp_db_conn conn(SINSP_DB_MYSQL, false);
+	sinsp_db_transaction tr;
+
+	// server greeting, no request pending
+	ASSERT_FALSE(feed(conn, true, 100, std::string("\x0a\x00\x00\x00\x0a" "8.0.26", 11), &tr));
+
+	ASSERT_FALSE(feed(conn, false, 1000, std::string("\x09\x00\x00\x00\x03SELECT 1", 13), &tr));
+	ASSERT_TRUE(feed(conn, true, 4000, std::string("\x01\x00\x00\x01\x01", 5), &tr));
+	EXPECT_STREQ("COM_QUERY", tr.m_op);
+	EXPECT_EQ(3000u, tr.m_latency_ns);
+	EXPECT_EQ(13u, tr.m_req_size);
+	EXPECT_FALSE(tr.m_is_error);
+
+	ASSERT_FALSE(feed(conn, false, 5000, std::string("\x0c\x00\x00\x00\x03SELECT * x", 16), &tr));
+	ASSERT_TRUE(feed(conn, true, 5500, std::string("\x17\x00\x00\x01\xff\x28\x04#42000You have an error", 29), &tr));
+	EXPECT_TRUE(tr.m_is_error);
+	EXPECT_EQ(1064, tr.m_error_code);
+}
+
+TEST(db_transaction_test, pgsql_extended_query)
+{
+	sinsp_db_conn conn(SINSP_DB_PGSQL, true);
+	sinsp_db_transaction tr;
+
+	// Parse and Bind/Execute/Sync read separately by the server
+	ASSERT_FALSE(feed(conn, true, 1000, std::string("P\x00\x00\x00\x08\x00\x00\x00", 8), &tr));
+	ASSERT_FALSE(feed(conn, true, 1100, std::string("B\x00\x00\x00\x04" "E\x00\x00\x00\x04" "S\x00\x00\x00\x04", 15), &tr));
+
+	// ParseComplete, then an ErrorResponse
+	ASSERT_TRUE(feed(conn, false, 2000, std::string("1\x00\x00\x00\x04" "E\x00\x00\x00\x08SERR" "Z\x00\x00\x00\x05I", 20), &tr));
+	EXPECT_STREQ("Parse", tr.m_op);
+	EXPECT_EQ(1000u, tr.m_latency_ns);
+	EXPECT_EQ(23u, tr.m_req_size);
+	EXPECT_TRUE(tr.m_is_error);
+	EXPECT_TRUE(tr.m_is_server);
+
+	// a notice is not a response
+	ASSERT_FALSE(feed(conn, true, 3000, std::string("Q\x00\x00\x00\x0dSELECT 1\x00", 14), &tr));
+	ASSERT_FALSE(feed(conn, false, 3500, std::string("N\x00\x00\x00\x04", 5), &tr));
+	ASSERT_TRUE(feed(conn, false, 4000, std::string("T\x00\x00\x00\x06\x00\x01", 7), &tr));
+	EXPECT_STREQ("Query", tr.m_op);
+	EXPECT_FALSE(tr.m_is_error);
+}
+
+TEST(db_transaction_test, pgsql_bad_message_lengths)
+{
+	sinsp_db_conn conn(SINSP_DB_PGSQL, false);
+	sinsp_db_transaction tr;
+
+	// the second message claims more bytes than the buffer holds
+	ASSERT_FALSE(feed(conn, false, 1000, std::string("Q\x00\x00\x00\x0dSELECT 1\x00", 14), &tr));
+	ASSERT_TRUE(feed(conn, true, 2000, std::string("1\x00\x00\x00\x04" "C\x00\x00\x01\x00" "SEL", 13), &tr));
+	EXPECT_STREQ("Query", tr.m_op);
+	EXPECT_FALSE(tr.m_is_error);
+
+	// lengths that would wrap the offset around or never move it
+	ASSERT_FALSE(feed(conn, false, 3000, std::string("Q\x00\x00\x00\x0dSELECT 1\x00", 14), &tr));
+	ASSERT_TRUE(feed(conn, true, 4000, std::string("1\x00\x00\x00\x04" "C\xff\xff\xff\xfe" "SEL", 13), &tr));
+	EXPECT_FALSE(tr.m_is_error);
+
+	ASSERT_FALSE(feed(conn, false, 5000, std::string("Q\x00\x00\x00\x0dSELECT 1\x00", 14), &tr));
+	ASSERT_TRUE(feed(conn, true, 6000, std::string("1\x00\x00\x00\x04" "C\xff\xff\xff\xff" "SEL", 13), &tr));
+	EXPECT_FALSE(tr.m_is_error);
+
+	// a first message longer than the buffer
+	ASSERT_FALSE(feed(conn, false, 7000, std::string("Q\x00\x00\x00\x0dSELECT 1\x00", 14), &tr));
+	ASSERT_TRUE(feed(conn, true, 8000, std::string("T\xff\xff\xff\xff\x00\x01", 7), &tr));
+	EXPECT_FALSE(tr.m_is_error);
+}
+
+TEST(db_transaction_test, redis_pipelined)
+{
+	sinsp_db_conn conn(SINSP_DB_REDIS, false);
+	sinsp_db_transaction tr;
+
+	ASSERT_FALSE(feed(conn, false, 1000, "*2\r\n$3\r\nget\r\n$3\r\nfoo\r\n", &tr));
+	ASSERT_FALSE(feed(conn, false, 1100, "*3\r\n$4\r\nHSET\r\n$1\r\nh\r\n$1\r\nv\r\n", &tr));
+	ASSERT_FALSE(feed(conn, false, 1200, "PING\r\n", &tr));
+
+	ASSERT_TRUE(feed(conn, true, 2000, "$3\r\nbar\r\n", &tr));
+	EXPECT_STREQ("GET", tr.m_op);
+	EXPECT_EQ(1000u, tr.m_latency_ns);
+	ASSERT_TRUE(feed(conn, true, 2100, "-WRONGTYPE Operation\r\n", &tr));
+	EXPECT_STREQ("HSET", tr.m_op);
+	EXPECT_TRUE(tr.m_is_error);
+	ASSERT_TRUE(feed(conn, true, 2200, "+PONG\r\n", &tr));
+	EXPECT_STREQ("PING", tr.m_op);
+	ASSERT_FALSE(feed(conn, true, 2300, "+PONG\r\n", &tr));
+}
+
+TEST(db_transaction_test, kafka_correlation_ids)
+{
+	sinsp_db_conn conn(SINSP_DB_KAFKA, false);
+	sinsp_db_transaction tr;
+
+	// Produce v7 id 5, then Metadata v9 id 6
+	ASSERT_FALSE(feed(conn, false, 1000, std::string("\x00\x00\x00\x20\x00\x00\x00\x07\x00\x00\x00\x05", 12), &tr));
+	ASSERT_FALSE(feed(conn, false, 1500, std::string("\x00\x00\x00\x20\x00\x03\x00\x09\x00\x00\x00\x06", 12), &tr));
+
+	// the produce had acks=0, only the metadata gets an answer
+	ASSERT_TRUE(feed(conn, true, 3500, std::string("\x00\x00\x00\x30\x00\x00\x00\x06", 8), &tr));
+	EXPECT_STREQ("Metadata", tr.m_op);
+	EXPECT_EQ(2000u, tr.m_latency_ns);
+
+	ASSERT_FALSE(feed(conn, true, 4000, std::string("\x00\x00\x00\x30\x00\x00\x00\x05", 8), &tr));
+}
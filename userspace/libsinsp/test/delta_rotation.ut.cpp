@@ -0,0 +1,198 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// to write the files one by one, without the cycle writer
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include <sinsp.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int64_t fake_tid = 900000001;
+
+static void add_file_fd(sinsp_threadinfo* tinfo, int64_t fd, const char* name)
+{
+	sinsp_fdinfo_t fdi;
+	fdi.m_type = SCAP_FD_FILE_V2;
+	fdi.m_openflags = PPM_O_RDONLY;
+	fdi.set_name(name);
+	tinfo->add_fd(fd, &fdi);
+}
+
+// the readers want at least one event in a capture
+static void dump_evt(sinsp& inspector)
+{
+	scap_evt evt = {};
+	evt.ts = 1;
+	evt.tid = getpid();
+	evt.len = sizeof(scap_evt);
+	evt.type = PPME_SYSDIGEVENT_E;
+	ASSERT_EQ(SCAP_SUCCESS, scap_dump(inspector.m_h, inspector.m_dumper, &evt, 0, 0));
+}
+
+// major version in the section header of an uncompressed capture
+static uint16_t major_version(const std::string& fname)
+{
+	uint8_t buf[14] = {};
+	FILE* f = fopen(fname.c_str(), "rb");
+	EXPECT_NE(nullptr, f);
+	if(f != NULL)
+	{
+		EXPECT_EQ(sizeof(buf), fread(buf, 1, sizeof(buf), f));
+		fclose(f);
+	}
+	// after the block header and the byte order magic
+	uint16_t major;
+	memcpy(&major, buf + 12, sizeof(major));
+	return major;
+}
+
+// a full capture, which could be a base too
+static void write_base(const std::string& fname)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+	inspector.set_delta_rotation(3);
+	inspector.autodump_start(fname, false);
+	dump_evt(inspector);
+	inspector.autodump_stop();
+	inspector.close();
+}
+
+TEST(delta_rotation_test, base_and_delta_round_trip)
+{
+	char dir[] = "/tmp/sinsp_delta_XXXXXX";
+	ASSERT_NE(nullptr, mkdtemp(dir));
+	std::string base = std::string(dir) + "/base.scap";
+	std::string delta = std::string(dir) + "/delta.scap";
+
+	// without a driver, /proc is only scanned for sockets
+	sockaddr_in addr = {};
+	socklen_t addrlen = sizeof(addr);
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int held_fd = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_LE(0, held_fd);
+	ASSERT_EQ(0, bind(held_fd, (sockaddr*)&addr, sizeof(addr)));
+	ASSERT_EQ(0, listen(held_fd, 1));
+	ASSERT_EQ(0, getsockname(held_fd, (sockaddr*)&addr, &addrlen));
+	int64_t pid = getpid();
+	int64_t removed_tid = -1;
+
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+		inspector.set_delta_rotation(3);
+
+		// the base is a full capture, from a new scan of /proc
+		inspector.autodump_start(base, false);
+		dump_evt(inspector);
+		inspector.autodump_stop();
+
+		inspector.m_thread_manager->get_threads()->loop([&] (sinsp_threadinfo& tinfo) {
+			if(tinfo.m_tid != pid && tinfo.is_main_thread())
+			{
+				removed_tid = tinfo.m_tid;
+				return false;
+			}
+			return true;
+		});
+		ASSERT_NE(-1, removed_tid);
+		inspector.m_thread_manager->remove_thread(removed_tid, true);
+
+		sinsp_threadinfo* tinfo = new sinsp_threadinfo(&inspector);
+		tinfo->m_tid = fake_tid;
+		tinfo->m_pid = fake_tid;
+		tinfo->m_ptid = 1;
+		tinfo->m_comm = "fake";
+		tinfo->m_exe = "fake";
+		ASSERT_TRUE(inspector.add_thread(tinfo));
+		add_file_fd(inspector.get_thread_ref(fake_tid).get(), 3, "/tmp/fake_file");
+
+		sinsp_threadinfo* self = inspector.get_thread_ref(pid).get();
+		ASSERT_NE(nullptr, self);
+		add_file_fd(self, 1000, "/tmp/self_file");
+
+		// only the changes since the base
+		inspector.autodump_open(delta, false);
+		dump_evt(inspector);
+		inspector.autodump_stop();
+		inspector.close();
+	}
+
+	{
+		sinsp inspector;
+		inspector.open(delta);
+
+		sinsp_threadinfo* tinfo = inspector.get_thread_ref(fake_tid).get();
+		ASSERT_NE(nullptr, tinfo);
+		EXPECT_EQ("fake", tinfo->m_comm);
+		sinsp_fdinfo_t* fdi = tinfo->get_fd(3);
+		ASSERT_NE(nullptr, fdi);
+		EXPECT_EQ("/tmp/fake_file", fdi->m_name);
+
+		// the threads of the base are still there, with their fds
+		sinsp_threadinfo* self = inspector.get_thread_ref(pid).get();
+		ASSERT_NE(nullptr, self);
+		fdi = self->get_fd(1000);
+		ASSERT_NE(nullptr, fdi);
+		EXPECT_EQ("/tmp/self_file", fdi->m_name);
+		fdi = self->get_fd(held_fd);
+		ASSERT_NE(nullptr, fdi);
+		EXPECT_EQ(SCAP_FD_IPV4_SERVSOCK, fdi->m_type);
+		EXPECT_EQ(ntohs(addr.sin_port), fdi->m_sockinfo.m_ipv4serverinfo.m_port);
+
+		EXPECT_EQ(nullptr, inspector.get_thread_ref(removed_tid).get());
+		inspector.close();
+	}
+
+	// the readers that don't know delta captures refuse them
+	EXPECT_EQ(1u, major_version(base));
+	EXPECT_EQ(2u, major_version(delta));
+
+	// the others refuse another capture in place of its base
+	write_base(base);
+	{
+		sinsp inspector;
+		try
+		{
+			inspector.open(delta);
+			ADD_FAILURE() << "opened with another base";
+		}
+		catch(const sinsp_exception& e)
+		{
+			EXPECT_NE(std::string::npos, std::string(e.what()).find("is not the state base")) << e.what();
+		}
+	}
+
+	// a delta can't be read without its base
+	ASSERT_EQ(0, unlink(base.c_str()));
+	{
+		sinsp inspector;
+		EXPECT_THROW(inspector.open(delta), sinsp_exception);
+	}
+
+	close(held_fd);
+	unlink(delta.c_str());
+	rmdir(dir);
+}
@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// to rotate to a given file, without the cycle writer
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include <sinsp.h>
+#include <dump_rotator.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+static void dump_evt(sinsp& inspector, uint64_t ts)
+{
+	scap_evt evt = {};
+	evt.ts = ts;
+	evt.tid = getpid();
+	evt.len = sizeof(scap_evt);
+	evt.type = PPME_SYSDIGEVENT_E;
+	ASSERT_EQ(SCAP_SUCCESS, scap_dump(inspector.m_h, inspector.m_dumper, &evt, 0, 0));
+}
+
+static std::vector<uint64_t> read_ts(sinsp& inspector)
+{
+	std::vector<uint64_t> res;
+	sinsp_evt* evt;
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		res.push_back(evt->get_ts());
+	}
+	return res;
+}
+
+TEST(dump_rotator_test, background_rotation_round_trip)
+{
+	char dir[] = "/tmp/sinsp_rotation_XXXXXX";
+	ASSERT_NE(nullptr, mkdtemp(dir));
+	std::string first = std::string(dir) + "/first.scap";
+	std::string second = std::string(dir) + "/second.scap";
+
+	// without a driver, /proc is only scanned for sockets
+	sockaddr_in addr = {};
+	socklen_t addrlen = sizeof(addr);
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int held_fd = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_LE(0, held_fd);
+	ASSERT_EQ(0, bind(held_fd, (sockaddr*)&addr, sizeof(addr)));
+	ASSERT_EQ(0, listen(held_fd, 1));
+	ASSERT_EQ(0, getsockname(held_fd, (sockaddr*)&addr, &addrlen));
+
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+		inspector.set_background_rotation(true);
+
+		inspector.autodump_start(first, false);
+		dump_evt(inspector, 1);
+
+		// what autodump_next_file() does when the cycle writer moves on
+		inspector.m_dump_rotator = new sinsp_dump_rotator();
+		inspector.autodump_start_rotation(second);
+		ASSERT_TRUE(inspector.m_dump_rotator->in_progress());
+
+		// kept in memory until the second file is ready
+		dump_evt(inspector, 2);
+		dump_evt(inspector, 3);
+
+		inspector.autodump_stop();
+		EXPECT_FALSE(inspector.m_dump_rotator->in_progress());
+		EXPECT_EQ(1u, inspector.m_dump_rotator->get_rotations());
+		inspector.close();
+	}
+
+	{
+		sinsp inspector;
+		inspector.open(first);
+		EXPECT_EQ(std::vector<uint64_t>({1}), read_ts(inspector));
+		inspector.close();
+	}
+
+	{
+		sinsp inspector;
+		inspector.open(second);
+
+		// the tables of the second file come from sinsp
+		sinsp_threadinfo* self = inspector.get_thread_ref(getpid()).get();
+		ASSERT_NE(nullptr, self);
+		sinsp_fdinfo_t* fdi = self->get_fd(held_fd);
+		ASSERT_NE(nullptr, fdi);
+		EXPECT_EQ(SCAP_FD_IPV4_SERVSOCK, fdi->m_type);
+		EXPECT_EQ(ntohs(addr.sin_port), fdi->m_sockinfo.m_ipv4serverinfo.m_port);
+
+		EXPECT_EQ(std::vector<uint64_t>({2, 3}), read_ts(inspector));
+		inspector.close();
+	}
+
+	close(held_fd);
+	unlink(first.c_str());
+	unlink(second.c_str());
+	rmdir(dir);
+}
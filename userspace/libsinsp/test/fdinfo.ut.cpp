@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+
+#include <sinsp.h>
+
+TEST(fdinfo_test, set_name)
+{
+	sinsp_fdinfo_t fdi;
+	ASSERT_EQ(0u, fdi.m_name.id());
+	ASSERT_EQ(libsinsp::interned_string::NO_SLASH, fdi.m_name.last_slash());
+
+	fdi.set_name("/etc/passwd");
+	uint64_t id = fdi.m_name.id();
+	ASSERT_NE(0u, id);
+	ASSERT_EQ("/etc/passwd", fdi.m_name);
+	ASSERT_EQ(4u, fdi.m_name.last_slash());
+
+	// fds with the same name share it, with its id
+	sinsp_fdinfo_t other;
+	other.set_name(std::string("/etc/passwd"));
+	ASSERT_EQ(id, other.m_name.id());
+	ASSERT_EQ(fdi.m_name.c_str(), other.m_name.c_str());
+
+	fdi.set_name("passwd");
+	ASSERT_NE(id, fdi.m_name.id());
+	ASSERT_EQ(libsinsp::interned_string::NO_SLASH, fdi.m_name.last_slash());
+
+	fdi.set_name("/tmp/dir/");
+	ASSERT_EQ(8u, fdi.m_name.last_slash());
+
+	other.copy(fdi, true);
+	ASSERT_EQ(fdi.m_name.id(), other.m_name.id());
+	ASSERT_EQ(8u, other.m_name.last_slash());
+}
+
+TEST(fdinfo_test, layout)
+{
+	// the fds are the bulk of the state, see the notes on the fields
+	ASSERT_LE(sizeof(sinsp_fdinfo_t), 80u);
+}
+
+TEST(fdinfo_test, state_hash)
+{
+	sinsp_fdinfo_t fdi;
+	fdi.m_type = SCAP_FD_FILE_V2;
+	fdi.set_name("/var/log/syslog");
+	fdi.m_openflags = PPM_O_WRONLY;
+	size_t h = fdi.state_hash();
+
+	// what delta captures compare to tell what changed
+	sinsp_fdinfo_t other;
+	other.copy(fdi, true);
+	ASSERT_EQ(h, other.state_hash());
+
+	other.m_openflags |= PPM_O_APPEND;
+	ASSERT_NE(h, other.state_hash());
+
+	other.copy(fdi, true);
+	other.set_name("/var/log/messages");
+	ASSERT_NE(h, other.state_hash());
+
+	sinsp_fdinfo_t sock;
+	sock.m_type = SCAP_FD_IPV4_SOCK;
+	sock.m_sockinfo.m_ipv4info.m_fields.m_sport = 80;
+	h = sock.state_hash();
+	sock.m_sockinfo.m_ipv4info.m_fields.m_dport = 4242;
+	ASSERT_NE(h, sock.state_hash());
+}
@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <flight_recorder.h>
+#include <vector>
+
+//
+// Event of the given total length whose tid is used as an id
+//
+static std::vector<uint8_t> make_evt(uint64_t id, uint64_t ts, uint32_t len)
+{
+	std::vector<uint8_t> buf(len, 0xab);
+	scap_evt* e = (scap_evt*)buf.data();
+	e->ts = ts;
+	e->tid = id;
+	e->len = len;
+	e->type = PPME_SYSCALL_READ_E;
+	e->nparams = 0;
+	return buf;
+}
+
+static std::vector<uint64_t> ids(const sinsp_flight_recorder& fr)
+{
+	std::vector<uint64_t> res;
+	fr.loop([&](const scap_evt* e, uint16_t cpuid, uint32_t flags)
+	{
+		EXPECT_EQ(0xab, ((const uint8_t*)e)[e->len - 1]);
+		res.push_back(e->tid);
+	});
+	return res;
+}
+
+TEST(flight_recorder_test, keeps_the_most_recent_events)
+{
+	sinsp_flight_recorder fr(4096, 0);
+
+	// 200 byte records, 20 of them fit
+	for(uint64_t j = 0; j < 100; j++)
+	{
+		auto e = make_evt(j, j, 200 - 16);
+		ASSERT_TRUE(fr.add((scap_evt*)e.data(), 0, 0));
+	}
+
+	std::vector<uint64_t> res = ids(fr);
+	ASSERT_EQ(fr.get_nevts(), res.size());
+	ASSERT_EQ(100u, fr.get_added());
+	ASSERT_EQ(100u - res.size(), fr.get_evicted());
+	ASSERT_LE(fr.get_used_bytes(), 4096u);
+
+	for(size_t j = 0; j < res.size(); j++)
+	{
+		ASSERT_EQ(100 - res.size() + j, res[j]);
+	}
+	ASSERT_EQ(99u, res.back());
+}
+
+TEST(flight_recorder_test, variable_sizes_wrap)
+{
+	sinsp_flight_recorder fr(4096, 0);
+
+	for(uint64_t j = 0; j < 1000; j++)
+	{
+		auto e = make_evt(j, j, 32 + (j * 37) % 900);
+		ASSERT_TRUE(fr.add((scap_evt*)e.data(), (uint16_t)j, 0));
+
+		std::vector<uint64_t> res = ids(fr);
+		ASSERT_EQ(fr.get_nevts(), res.size());
+		ASSERT_EQ(j, res.back());
+		for(size_t k = 1; k < res.size(); k++)
+		{
+			ASSERT_EQ(res[k - 1] + 1, res[k]);
+		}
+	}
+}
+
+TEST(flight_recorder_test, max_duration)
+{
+	sinsp_flight_recorder fr(1024 * 1024, 100);
+
+	for(uint64_t j = 0; j < 1000; j++)
+	{
+		auto e = make_evt(j, j * 10, 64);
+		fr.add((scap_evt*)e.data(), 0, 0);
+	}
+
+	// events from ts 9890 to 9990
+	std::vector<uint64_t> res = ids(fr);
+	ASSERT_EQ(11u, res.size());
+	ASSERT_EQ(989u, res.front());
+}
+
+TEST(flight_recorder_test, too_large)
+{
+	sinsp_flight_recorder fr(4096, 0);
+
+	auto small = make_evt(1, 1, 64);
+	auto large = make_evt(2, 2, 8192);
+	ASSERT_TRUE(fr.add((scap_evt*)small.data(), 0, 0));
+	ASSERT_FALSE(fr.add((scap_evt*)large.data(), 0, 0));
+	ASSERT_EQ(1u, fr.get_nevts());
+
+	fr.clear();
+	ASSERT_EQ(0u, fr.get_nevts());
+	ASSERT_TRUE(ids(fr).empty());
+}
@@ -0,0 +1,93 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <http_transaction.h>
+#include <string.h>
+
+static bool feed(sinsp_http_conn& conn, bool is_read, uint64_t ts, const std::string& data, sinsp_http_transaction* tr, uint32_t snaplen = 0)
+{
+	uint32_t datalen = (snaplen != 0 && snaplen < data.size()) ? snaplen : data.size();
+	return conn.on_data(is_read, ts, data.c_str(), datalen, data.size(), tr);
+}
+
+TEST(http_transaction_test, client_transaction)
+{
+	sinsp_http_conn conn;
+	sinsp_http_transaction tr;
+
+	ASSERT_FALSE(feed(conn, false, 1000, "POST /api/v1/items?id=3 HTTP/1.1\r\nHost: x\r\nContent-Length: 4\r\n\r\nabcd", &tr));
+	ASSERT_TRUE(feed(conn, true, 6000, "HTTP/1.1 201 Created\r\nContent-Length: 10\r\n\r\n0123456789", &tr));
+
+	EXPECT_EQ("POST", tr.m_method);
+	EXPECT_EQ("/api/v1/items?id=3", tr.m_url);
+	EXPECT_EQ(201u, tr.m_status);
+	EXPECT_EQ(5000u, tr.m_latency_ns);
+	EXPECT_EQ(68, tr.m_req_size);
+	EXPECT_EQ(54, tr.m_resp_size);
+	EXPECT_FALSE(tr.m_is_server);
+
+	// the body of the response doesn't start a new transaction
+	ASSERT_FALSE(feed(conn, true, 7000, "more body", &tr));
+}
+
+TEST(http_transaction_test, server_pipelined_and_split)
+{
+	sinsp_http_conn conn;
+	sinsp_http_transaction tr;
+
+	ASSERT_FALSE(feed(conn, true, 1000, "GET /a HTTP/1.1\r\nHost: x\r\n\r\n", &tr));
+	ASSERT_FALSE(feed(conn, true, 2000, "GET /b HTTP/1.1\r\nHo", &tr));
+	ASSERT_FALSE(feed(conn, true, 2500, "st: x\r\n\r\n", &tr));
+
+	// headers of the first response split across two writes
+	ASSERT_FALSE(feed(conn, false, 3000, "HTTP/1.1 200 OK\r\n", &tr));
+	ASSERT_TRUE(feed(conn, false, 3100, "Content-Length: 0\r\n\r\n", &tr));
+	EXPECT_EQ("/a", tr.m_url);
+	EXPECT_EQ(200u, tr.m_status);
+	EXPECT_EQ(2000u, tr.m_latency_ns);
+	EXPECT_TRUE(tr.m_is_server);
+
+	ASSERT_TRUE(feed(conn, false, 4000, "HTTP/1.1 404 Not Found\r\nTransfer-Encoding: chunked\r\n\r\n", &tr));
+	EXPECT_EQ("GET", tr.m_method);
+	EXPECT_EQ("/b", tr.m_url);
+	EXPECT_EQ(404u, tr.m_status);
+	EXPECT_EQ(2000u, tr.m_latency_ns);
+	EXPECT_EQ(-1, tr.m_resp_size);
+}
+
+TEST(http_transaction_test, truncated_buffers)
+{
+	sinsp_http_conn conn;
+	sinsp_http_transaction tr;
+
+	ASSERT_FALSE(feed(conn, false, 1000, "GET /index.html HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\n\r\n", &tr, 30));
+	ASSERT_TRUE(feed(conn, true, 3000, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n", &tr, 20));
+	EXPECT_EQ("/index.html", tr.m_url);
+	EXPECT_EQ(500u, tr.m_status);
+	EXPECT_EQ(60, tr.m_req_size);
+	EXPECT_EQ(-1, tr.m_resp_size);
+}
+
+TEST(http_transaction_test, not_http)
+{
+	sinsp_http_conn conn;
+	sinsp_http_transaction tr;
+
+	ASSERT_FALSE(feed(conn, false, 1000, "\x16\x03\x01\x02\x00\x01\x00\x01\xfc\x03\x03", &tr));
+	ASSERT_TRUE(conn.is_not_http());
+}
@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <interned_string.h>
+
+using namespace libsinsp;
+
+TEST(interned_string_test, share)
+{
+	shared_block_pool_stats before = interned_string::pool().get_stats();
+
+	{
+		interned_string a(std::string("/usr/lib/x86_64-linux-gnu/libc.so.6"));
+		interned_string b;
+		ASSERT_TRUE(b.empty());
+		ASSERT_EQ("", b.str());
+
+		ASSERT_TRUE(b.assign("/usr/lib/x86_64-linux-gnu/libc.so.6"));
+		ASSERT_FALSE(b.assign("/usr/lib/x86_64-linux-gnu/libc.so.6"));
+		ASSERT_TRUE(a == b);
+		ASSERT_EQ(a.c_str(), b.c_str());
+		ASSERT_EQ(25u, a.last_slash());
+		ASSERT_EQ(a.find("libc"), a.str().find("libc"));
+
+		interned_string c = b;
+		b = "pipe:[1234]";
+		ASSERT_TRUE(a == c);
+		ASSERT_TRUE(a != b);
+		ASSERT_NE(a.id(), b.id());
+		ASSERT_EQ(interned_string::NO_SLASH, b.last_slash());
+
+		shared_block_pool_stats during = interned_string::pool().get_stats();
+		ASSERT_EQ(before.m_n_blocks + 2, during.m_n_blocks);
+		ASSERT_GT(during.m_bytes, before.m_bytes);
+
+		// the empty string isn't stored
+		b = "";
+		ASSERT_TRUE(b.empty());
+		ASSERT_EQ(0u, b.id());
+	}
+
+	shared_block_pool_stats after = interned_string::pool().get_stats();
+	ASSERT_EQ(before.m_n_blocks, after.m_n_blocks);
+	ASSERT_EQ(before.m_bytes, after.m_bytes);
+}
+
+TEST(interned_string_test, threads)
+{
+	shared_block_pool_stats before = interned_string::pool().get_stats();
+	std::vector<std::thread> threads;
+
+	for(int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([]()
+		{
+			std::vector<interned_string> names(16);
+			for(int j = 0; j < 20000; j++)
+			{
+				interned_string& n = names[j % names.size()];
+				n = "/proc/" + std::to_string(j % 37) + "/stat";
+				interned_string copy = n;
+				ASSERT_EQ(n.str(), copy.str());
+			}
+		});
+	}
+
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	ASSERT_EQ(before.m_n_blocks, interned_string::pool().get_stats().m_n_blocks);
+}
@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <interned_vector.h>
+
+using namespace libsinsp;
+
+TEST(interned_vector_test, identical_blocks_are_shared)
+{
+	auto before = interned_vector<std::string>::pool().get_stats();
+
+	interned_vector<std::string> a(std::vector<std::string>{"PATH=/bin", "HOME=/root"});
+	interned_vector<std::string> b(std::vector<std::string>{"PATH=/bin", "HOME=/root"});
+	interned_vector<std::string> c(std::vector<std::string>{"PATH=/usr/bin"});
+
+	ASSERT_EQ(a, b);
+	ASSERT_NE(a, c);
+	ASSERT_EQ(&a.get(), &b.get());
+	ASSERT_EQ(2u, a.size());
+	ASSERT_EQ("HOME=/root", a[1]);
+
+	auto after = interned_vector<std::string>::pool().get_stats();
+	ASSERT_EQ(before.m_n_blocks + 2, after.m_n_blocks);
+	ASSERT_EQ(before.m_n_hits + 1, after.m_n_hits);
+}
+
+TEST(interned_vector_test, blocks_released_with_last_reference)
+{
+	auto before = interned_vector<std::string>::pool().get_stats();
+	{
+		interned_vector<std::string> a(std::vector<std::string>{"-d1"});
+		interned_vector<std::string> b = a;
+		a.clear();
+		ASSERT_EQ(before.m_n_blocks + 1, interned_vector<std::string>::pool().get_stats().m_n_blocks);
+		ASSERT_EQ("-d1", b[0]);
+	}
+	auto after = interned_vector<std::string>::pool().get_stats();
+	ASSERT_EQ(before.m_n_blocks, after.m_n_blocks);
+	ASSERT_EQ(before.m_bytes, after.m_bytes);
+}
+
+TEST(interned_vector_test, empty)
+{
+	interned_vector<std::pair<std::string, std::string>> cgroups;
+	ASSERT_TRUE(cgroups.empty());
+	ASSERT_EQ(cgroups.begin(), cgroups.end());
+
+	cgroups.assign({{"cpu", "/docker/abc"}});
+	ASSERT_EQ("/docker/abc", cgroups[0].second);
+
+	cgroups.assign({});
+	ASSERT_TRUE(cgroups.empty());
+}
@@ -0,0 +1,172 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <arpa/inet.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <ip_prefix_search.h>
+
+static ipv4net make_ipv4net(const char* ip, uint32_t len)
+{
+	ipv4net net;
+	inet_pton(AF_INET, ip, &net.m_ip);
+	net.m_netmask = len == 0 ? 0 : htonl(~0U << (32 - len));
+	return net;
+}
+
+static uint32_t ipv4(const char* ip)
+{
+	uint32_t res;
+	inet_pton(AF_INET, ip, &res);
+	return res;
+}
+
+static ipv6net make_ipv6net(const char* ip, uint32_t len)
+{
+	ipv6net net;
+	inet_pton(AF_INET6, ip, net.m_ip.m_b);
+	net.m_prefix_len = len;
+	return net;
+}
+
+static ipv6addr ipv6(const char* ip)
+{
+	ipv6addr res;
+	inet_pton(AF_INET6, ip, res.m_b);
+	return res;
+}
+
+TEST(ip_prefix_search_test, longest_match_ipv4)
+{
+	ip_prefix_map<std::string> map;
+
+	map.add_ipv4_net(make_ipv4net("10.0.0.0", 8), "ten");
+	map.add_ipv4_net(make_ipv4net("10.1.0.0", 16), "ten-one");
+	map.add_ipv4_net(make_ipv4net("10.1.2.0", 24), "ten-one-two");
+	map.add_ipv4_net(make_ipv4net("192.168.1.7", 32), "host");
+	map.add_ipv4_net(make_ipv4net("172.16.0.0", 12), "private");
+	ASSERT_EQ(5u, map.size());
+
+	ASSERT_EQ("ten", *map.match_ipv4(ipv4("10.200.1.1")));
+	ASSERT_EQ("ten-one", *map.match_ipv4(ipv4("10.1.3.4")));
+	ASSERT_EQ("ten-one-two", *map.match_ipv4(ipv4("10.1.2.255")));
+	ASSERT_EQ("host", *map.match_ipv4(ipv4("192.168.1.7")));
+	ASSERT_EQ("private", *map.match_ipv4(ipv4("172.31.255.255")));
+	ASSERT_EQ(NULL, map.match_ipv4(ipv4("172.32.0.0")));
+	ASSERT_EQ(NULL, map.match_ipv4(ipv4("192.168.1.8")));
+	ASSERT_EQ(NULL, map.match_ipv4(ipv4("11.0.0.1")));
+
+	// replace, then add a default route
+	map.add_ipv4_net(make_ipv4net("10.0.0.0", 8), "net10");
+	map.add_ipv4_net(make_ipv4net("0.0.0.0", 0), "any");
+	ASSERT_EQ(6u, map.size());
+	ASSERT_EQ("net10", *map.match_ipv4(ipv4("10.200.1.1")));
+	ASSERT_EQ("any", *map.match_ipv4(ipv4("11.0.0.1")));
+
+	map.clear();
+	ASSERT_TRUE(map.empty());
+	ASSERT_EQ(NULL, map.match_ipv4(ipv4("10.1.2.3")));
+}
+
+TEST(ip_prefix_search_test, longest_match_ipv6)
+{
+	ip_prefix_map<std::string> map;
+
+	map.add_ipv6_net(make_ipv6net("2001:db8::", 32), "doc");
+	map.add_ipv6_net(make_ipv6net("2001:db8:aaaa::", 48), "doc-a");
+	map.add_ipv6_net(make_ipv6net("fe80::", 10), "link-local");
+
+	ASSERT_EQ("doc", *map.match_ipv6(ipv6("2001:db8:1::1")));
+	ASSERT_EQ("doc-a", *map.match_ipv6(ipv6("2001:db8:aaaa:1::1")));
+	ASSERT_EQ("link-local", *map.match_ipv6(ipv6("febf::1")));
+	ASSERT_EQ(NULL, map.match_ipv6(ipv6("fec0::1")));
+	ASSERT_EQ(NULL, map.match_ipv6(ipv6("2001:db9::1")));
+
+	// the IPv4 and IPv6 networks are separate
+	ASSERT_EQ(NULL, map.match_ipv4(0));
+}
+
+TEST(ip_prefix_search_test, many_networks)
+{
+	std::mt19937 rng(42);
+	std::vector<std::pair<uint32_t, uint32_t>> nets;
+	ip_prefix_map<uint32_t> map;
+
+	for(uint32_t j = 0; j < 100000; j++)
+	{
+		uint32_t len = 8 + rng() % 25;
+		uint32_t mask = htonl(~0U << (32 - len));
+		ipv4net net = {(uint32_t)rng() & mask, mask};
+		nets.push_back({net.m_ip, mask});
+		map.add_ipv4_net(net, j);
+	}
+
+	//
+	// Compare with a linear scan, half of the addresses are taken
+	// from the networks
+	//
+	for(uint32_t j = 0; j < 500; j++)
+	{
+		uint32_t addr = rng();
+		if(j % 2 == 0)
+		{
+			auto& net = nets[rng() % nets.size()];
+			addr = net.first | (addr & ~net.second);
+		}
+
+		int64_t best = -1;
+		uint32_t best_len = 0;
+		for(uint32_t k = 0; k < nets.size(); k++)
+		{
+			uint32_t len = __builtin_popcount(nets[k].second);
+			if((addr & nets[k].second) == nets[k].first && (best == -1 || len >= best_len))
+			{
+				// the last network added with the same prefix wins
+				best = k;
+				best_len = len;
+			}
+		}
+
+		const uint32_t* res = map.match_ipv4(addr);
+		if(best == -1)
+		{
+			ASSERT_EQ(NULL, res);
+		}
+		else
+		{
+			ASSERT_NE(nullptr, res);
+			ASSERT_EQ(best_len, __builtin_popcount(nets[*res].second));
+			ASSERT_EQ(nets[best].first, nets[*res].first);
+		}
+	}
+}
+
+TEST(ip_prefix_search_test, search)
+{
+	ip_prefix_search search;
+
+	search.add_ipv4_net(make_ipv4net("10.0.0.0", 8), true);
+	search.add_ipv6_net(make_ipv6net("2001:db8::", 32), true);
+
+	ASSERT_TRUE(search.match_ipv4(ipv4("10.2.3.4")));
+	ASSERT_FALSE(search.match_ipv4(ipv4("11.2.3.4")));
+	ASSERT_TRUE(search.match_ipv6(ipv6("2001:db8::1")));
+	ASSERT_FALSE(search.match_ipv6(ipv6("2001:db9::1")));
+}
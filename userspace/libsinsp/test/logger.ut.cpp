@@ -0,0 +1,169 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <logger.h>
+
+namespace
+{
+
+std::mutex s_mtx;
+std::vector<std::string> s_lines;
+std::thread::id s_callback_thread;
+
+void callback(std::string&& str, sinsp_logger::severity sev)
+{
+	std::lock_guard<std::mutex> lock(s_mtx);
+	s_lines.push_back(std::move(str));
+	s_callback_thread = std::this_thread::get_id();
+}
+
+std::vector<std::string> lines()
+{
+	std::lock_guard<std::mutex> lock(s_mtx);
+	std::vector<std::string> res;
+	res.swap(s_lines);
+	return res;
+}
+
+}
+
+TEST(logger_test, sync)
+{
+	sinsp_logger logger;
+	lines();
+	logger.add_callback_log(callback);
+	logger.disable_timestamps();
+	logger.add_encoded_severity();
+
+	logger.format(sinsp_logger::SEV_ERROR, "hello %d", 42);
+	logger.format(sinsp_logger::SEV_DEBUG, "filtered");
+
+	std::vector<std::string> res = lines();
+	ASSERT_EQ(1u, res.size());
+	ASSERT_EQ("SEV_ERR hello 42", res[0]);
+	ASSERT_EQ(std::this_thread::get_id(), s_callback_thread);
+}
+
+TEST(logger_test, async)
+{
+	sinsp_logger logger;
+	lines();
+	logger.add_callback_log(callback);
+	logger.enable_async(16, 10000);
+	ASSERT_TRUE(logger.is_async());
+
+	for(int j = 0; j < 20; j++)
+	{
+		logger.format(sinsp_logger::SEV_INFO, "msg %d", j);
+	}
+
+	// what didn't fit is counted, and reported once it's written
+	ASSERT_EQ(4u, logger.get_n_dropped());
+
+	logger.disable_async();
+	ASSERT_FALSE(logger.is_async());
+
+	std::vector<std::string> res = lines();
+	ASSERT_EQ(17u, res.size());
+	ASSERT_NE(std::this_thread::get_id(), s_callback_thread);
+	for(int j = 0; j < 16; j++)
+	{
+		// the timestamp is the one of the log() call
+		ASSERT_EQ(" msg " + std::to_string(j), res[j].substr(res[j].find(' ', 6)));
+	}
+	ASSERT_NE(std::string::npos, res[16].find("4 log messages dropped"));
+}
+
+TEST(logger_test, toggle_async_while_logging)
+{
+	sinsp_logger logger;
+	lines();
+	logger.add_callback_log(callback);
+	logger.disable_timestamps();
+
+	std::atomic<bool> stop(false);
+	std::atomic<uint64_t> n_logged(0);
+	std::vector<std::thread> producers;
+	for(int j = 0; j < 4; j++)
+	{
+		producers.emplace_back([&]()
+		{
+			while(!stop)
+			{
+				logger.format(sinsp_logger::SEV_INFO, "msg");
+				n_logged++;
+			}
+		});
+	}
+
+	for(int j = 0; j < 200; j++)
+	{
+		logger.enable_async(64, 1);
+		std::this_thread::yield();
+		logger.disable_async();
+	}
+
+	stop = true;
+	for(auto& t : producers)
+	{
+		t.join();
+	}
+
+	// every message is either written or counted as dropped
+	uint64_t n_written = 0;
+	for(const auto& line : lines())
+	{
+		if(line == "msg")
+		{
+			n_written++;
+		}
+	}
+	ASSERT_EQ(n_logged.load(), n_written + logger.get_n_dropped());
+}
+
+TEST(logger_test, rate_limit)
+{
+	sinsp_logger logger;
+	lines();
+	logger.add_callback_log(callback);
+	logger.disable_timestamps();
+	logger.set_rate_limit(0.001, 3);
+
+	for(int j = 0; j < 10; j++)
+	{
+		logger.format(sinsp_logger::SEV_INFO, "first %d", j);
+		logger.format(sinsp_logger::SEV_INFO, "second %d", j);
+	}
+
+	// every call site has its own budget
+	std::vector<std::string> res = lines();
+	ASSERT_EQ(6u, res.size());
+	ASSERT_EQ("first 2", res[4]);
+	ASSERT_EQ("second 2", res[5]);
+	ASSERT_EQ(14u, logger.get_n_dropped());
+
+	logger.set_rate_limit(0, 0);
+	logger.format(sinsp_logger::SEV_INFO, "first %d", 10);
+	ASSERT_EQ(1u, lines().size());
+}
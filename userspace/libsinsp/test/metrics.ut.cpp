@@ -0,0 +1,131 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <thread>
+#include <vector>
+
+#include <metrics.h>
+#include <sinsp_exception.h>
+
+TEST(metrics_test, counter_shards)
+{
+	sinsp_metric_counter& c = sinsp_metrics_registry::get().counter("test_counter", "A counter");
+	std::vector<std::thread> threads;
+
+	// more threads than shards, some have to share
+	for(uint32_t t = 0; t < 2 * SINSP_METRIC_SHARDS; t++)
+	{
+		threads.emplace_back([&c]()
+		{
+			for(int j = 0; j < 10000; j++)
+			{
+				c.add();
+			}
+		});
+	}
+
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	c.add(5);
+	ASSERT_EQ(2 * SINSP_METRIC_SHARDS * 10000 + 5, c.get());
+
+	// same name, same metric
+	ASSERT_EQ(&c, &sinsp_metrics_registry::get().counter("test_counter", ""));
+	ASSERT_THROW(sinsp_metrics_registry::get().gauge("test_counter", ""), sinsp_exception);
+}
+
+TEST(metrics_test, histogram_buckets)
+{
+	// every value falls in a bucket whose bounds contain it
+	std::vector<uint64_t> values = {0, 1, 15, 16, 31, 32, 33, 1000, 123456789, 1ULL << 63, UINT64_MAX};
+	for(uint64_t v : values)
+	{
+		uint32_t b = sinsp_metric_histogram::bucket(v);
+		ASSERT_LT(b, sinsp_metric_histogram::NBUCKETS);
+		ASSERT_LE(sinsp_metric_histogram::bucket_lowest(b), v);
+		ASSERT_GE(sinsp_metric_histogram::bucket_highest(b), v);
+	}
+
+	// and the buckets follow each other
+	for(uint32_t b = 1; b < sinsp_metric_histogram::NBUCKETS; b++)
+	{
+		ASSERT_EQ(sinsp_metric_histogram::bucket_highest(b - 1) + 1, sinsp_metric_histogram::bucket_lowest(b));
+	}
+	ASSERT_EQ(UINT64_MAX, sinsp_metric_histogram::bucket_highest(sinsp_metric_histogram::NBUCKETS - 1));
+}
+
+TEST(metrics_test, histogram_percentiles)
+{
+	sinsp_metric_histogram& h = sinsp_metrics_registry::get().histogram("test_histogram", "A histogram");
+
+	std::thread t([&h]()
+	{
+		for(uint64_t v = 1; v <= 500; v++)
+		{
+			h.record(v * 1000);
+		}
+	});
+	for(uint64_t v = 501; v <= 1000; v++)
+	{
+		h.record(v * 1000);
+	}
+	t.join();
+
+	sinsp_metric_histogram_snapshot s = h.get();
+	ASSERT_EQ(1000u, s.m_count);
+	ASSERT_EQ(500500000u, s.m_sum);
+	ASSERT_EQ(1000u, s.m_min);
+	ASSERT_EQ(1000000u, s.m_max);
+
+	uint64_t p50 = s.percentile(50);
+	ASSERT_GE(p50, 500000u);
+	ASSERT_LE(p50, 500000u * 17 / 16);
+	uint64_t p99 = s.percentile(99);
+	ASSERT_GE(p99, 990000u);
+	ASSERT_LE(p99, 1000000u);
+	ASSERT_EQ(1000000u, s.percentile(100));
+}
+
+TEST(metrics_test, export)
+{
+	sinsp_metrics_registry& metrics = sinsp_metrics_registry::get();
+	metrics.gauge("test_gauge", "A gauge").set(-3);
+	metrics.histogram("test_empty_histogram", "Nothing recorded");
+
+	std::string text = metrics.to_text();
+	ASSERT_NE(std::string::npos, text.find("# HELP test_gauge A gauge\n# TYPE test_gauge gauge\ntest_gauge -3\n"));
+	ASSERT_NE(std::string::npos, text.find("test_empty_histogram{quantile=\"0.99\"} 0\n"));
+	ASSERT_NE(std::string::npos, text.find("test_empty_histogram_count 0\n"));
+
+	// the summary lines are not cut, whatever the length of the name
+	std::string long_name = "test_" + std::string(200, 'x');
+	metrics.histogram(long_name, "A long name").record(7);
+	metrics.histogram("sinsp_container_resolve_ns", "").record(5);
+	text = metrics.to_text();
+	ASSERT_NE(std::string::npos, text.find(long_name + "{quantile=\"0.999\"} 7\n"));
+	ASSERT_NE(std::string::npos, text.find(long_name + "_sum 7\n"));
+	ASSERT_NE(std::string::npos, text.find(long_name + "_count 1\n"));
+	ASSERT_NE(std::string::npos, text.find("\nsinsp_container_resolve_ns_sum "));
+	ASSERT_NE(std::string::npos, text.find("\nsinsp_container_resolve_ns_count "));
+
+	std::string json = metrics.to_json();
+	ASSERT_NE(std::string::npos, json.find("\"test_gauge\":{\"description\":\"A gauge\",\"type\":\"gauge\",\"value\":-3}"));
+}
@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mpsc_ring.h>
+
+using libsinsp::mpsc_ring;
+
+TEST(mpsc_ring_test, full_and_wrap)
+{
+	mpsc_ring<std::string> ring(3);
+	std::string s;
+
+	ASSERT_EQ(4u, ring.capacity());
+	ASSERT_FALSE(ring.pop(s));
+
+	for(int lap = 0; lap < 3; lap++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			ASSERT_TRUE(ring.push(std::to_string(lap * 10 + j)));
+		}
+
+		std::string extra = "extra";
+		ASSERT_FALSE(ring.push(std::move(extra)));
+		ASSERT_EQ("extra", extra);
+
+		for(int j = 0; j < 4; j++)
+		{
+			ASSERT_TRUE(ring.pop(s));
+			ASSERT_EQ(std::to_string(lap * 10 + j), s);
+		}
+		ASSERT_FALSE(ring.pop(s));
+	}
+}
+
+TEST(mpsc_ring_test, producers)
+{
+	const uint64_t nproducers = 4;
+	const uint64_t nitems = 100000;
+	mpsc_ring<uint64_t> ring(64);
+	std::vector<std::thread> producers;
+
+	for(uint64_t p = 0; p < nproducers; p++)
+	{
+		producers.emplace_back([&ring, p, nitems]()
+		{
+			for(uint64_t j = 0; j < nitems; j++)
+			{
+				while(!ring.push(p * nitems + j))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	// every producer's items come out in its order
+	std::vector<uint64_t> next(nproducers, 0);
+	for(uint64_t n = 0; n < nproducers * nitems;)
+	{
+		uint64_t v;
+		if(!ring.pop(v))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		uint64_t p = v / nitems;
+		ASSERT_EQ(next[p], v % nitems);
+		next[p]++;
+		n++;
+	}
+
+	for(auto& t : producers)
+	{
+		t.join();
+	}
+}
@@ -0,0 +1,173 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// for the dumper of the inspector
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include <sinsp.h>
+#include <parallel_replay.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef HAS_FILTERING
+static const int64_t replay_fd = 500;
+static const char* replay_file = "/tmp/replay_file";
+
+//
+// Writes events with the parameters given as raw buffers
+//
+class evt_writer
+{
+public:
+	evt_writer(sinsp& inspector):
+		m_inspector(inspector),
+		m_ts(1000)
+	{
+	}
+
+	void add(uint16_t type, const std::vector<std::string>& params)
+	{
+		std::string buf(sizeof(scap_evt), '\0');
+		for(const auto& p : params)
+		{
+			uint16_t len = (uint16_t)p.size();
+			buf.append((const char*)&len, sizeof(len));
+		}
+		for(const auto& p : params)
+		{
+			buf.append(p);
+		}
+
+		scap_evt* evt = (scap_evt*)&buf[0];
+		evt->ts = m_ts++;
+		evt->tid = getpid();
+		evt->len = (uint32_t)buf.size();
+		evt->type = type;
+		evt->nparams = (uint32_t)params.size();
+		ASSERT_EQ(SCAP_SUCCESS, scap_dump(m_inspector.m_h, m_inspector.m_dumper, evt, 0, 0));
+	}
+
+	template<typename T> static std::string val(T v)
+	{
+		return std::string((const char*)&v, sizeof(v));
+	}
+
+	static std::string str(const char* s)
+	{
+		return std::string(s, strlen(s) + 1);
+	}
+
+private:
+	sinsp& m_inspector;
+	uint64_t m_ts;
+};
+
+static std::vector<sinsp_replay_match> sequential_read(const std::string& file, const std::string& filter, const std::string& format)
+{
+	std::vector<sinsp_replay_match> res;
+	sinsp inspector;
+	sinsp_evt* evt;
+
+	inspector.open(file);
+	sinsp_filter_compiler compiler(&inspector, filter);
+	std::unique_ptr<sinsp_filter> flt(compiler.compile());
+	sinsp_evt_formatter formatter(&inspector, format);
+
+	while(inspector.next(&evt) != SCAP_EOF)
+	{
+		if(flt->run(evt))
+		{
+			sinsp_replay_match m;
+			m.m_shard = 0;
+			m.m_ts = evt->get_ts();
+			formatter.tostring(evt, &m.m_output);
+			res.push_back(m);
+		}
+	}
+
+	inspector.close();
+	return res;
+}
+
+TEST(parallel_replay_test, matches_sequential_read)
+{
+	char dir[] = "/tmp/sinsp_replay_XXXXXX";
+	ASSERT_NE(nullptr, mkdtemp(dir));
+	std::string capture = std::string(dir) + "/capture.scap";
+
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+		inspector.autodump_start(capture, false);
+		evt_writer w(inspector);
+
+		// the fd is opened in the first shard, read in the next ones,
+		// then closed: only the fd table says what its name is
+		w.add(PPME_SYSCALL_OPEN_E, {});
+		w.add(PPME_SYSCALL_OPEN_X, {w.val(replay_fd), w.str(replay_file), w.val<uint32_t>(PPM_O_RDONLY), w.val<uint32_t>(0), w.val<uint32_t>(0)});
+		for(uint32_t j = 0; j < 10; j++)
+		{
+			w.add(PPME_SYSCALL_READ_E, {w.val(replay_fd), w.val<uint32_t>(4)});
+			w.add(PPME_SYSCALL_READ_X, {w.val<int64_t>(4), "abcd"});
+		}
+		w.add(PPME_SYSCALL_CLOSE_E, {w.val(replay_fd)});
+		w.add(PPME_SYSCALL_CLOSE_X, {w.val<int64_t>(0)});
+		// after the close the fd has no name anymore
+		w.add(PPME_SYSCALL_READ_E, {w.val(replay_fd), w.val<uint32_t>(4)});
+		w.add(PPME_SYSCALL_READ_X, {w.val<int64_t>(-9), ""});
+
+		inspector.autodump_stop();
+		inspector.close();
+	}
+
+	std::string filter = std::string("fd.name=") + replay_file;
+	std::string format = "%evt.dir %evt.type %fd.name";
+	std::vector<sinsp_replay_match> expected = sequential_read(capture, filter, format);
+	// open exit, the reads, the close
+	ASSERT_EQ(23u, expected.size());
+
+	// shards of two events keep every enter event with its exit
+	std::vector<sinsp_replay_shard> shards = sinsp_parallel_replay::split(capture, std::string(dir) + "/shard", 2, false);
+	ASSERT_EQ(13u, shards.size());
+
+	sinsp_parallel_replay replay(shards);
+	std::vector<sinsp_replay_match> matches = replay.run(filter, format, 4);
+
+	ASSERT_EQ(expected.size(), matches.size());
+	EXPECT_EQ(expected.front().m_ts, matches.front().m_ts);
+	EXPECT_EQ(expected.back().m_ts, matches.back().m_ts);
+	for(size_t j = 0; j < expected.size(); j++)
+	{
+		EXPECT_EQ(expected[j].m_ts, matches[j].m_ts);
+		EXPECT_EQ(expected[j].m_output, matches[j].m_output);
+	}
+	EXPECT_EQ(0u, matches.front().m_shard);
+	EXPECT_EQ(11u, matches.back().m_shard);
+
+	for(const auto& shard : shards)
+	{
+		unlink(shard.m_filename.c_str());
+	}
+	unlink(capture.c_str());
+	rmdir(dir);
+}
+#endif
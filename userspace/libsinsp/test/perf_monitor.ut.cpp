@@ -0,0 +1,117 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <sinsp.h>
+#include <perf_monitor.h>
+
+TEST(perf_monitor_test, histogram_buckets)
+{
+	sinsp_perf_histogram h;
+	for(uint64_t ticks : {0, 1, 2, 3, 4, 1000})
+	{
+		h.add(ticks);
+	}
+
+	EXPECT_EQ(6u, h.m_count);
+	EXPECT_EQ(1010u, h.m_sum);
+	EXPECT_EQ(1000u, h.m_max);
+	EXPECT_EQ(1u, h.m_buckets[0]);
+	EXPECT_EQ(1u, h.m_buckets[1]);
+	// [2, 4)
+	EXPECT_EQ(2u, h.m_buckets[2]);
+	EXPECT_EQ(1u, h.m_buckets[3]);
+	// [512, 1024)
+	EXPECT_EQ(1u, h.m_buckets[10]);
+
+	EXPECT_EQ(3u, h.percentile(50));
+	EXPECT_EQ(1000u, h.percentile(99));
+	EXPECT_EQ(1000u, h.percentile(100));
+
+	h.clear();
+	EXPECT_EQ(0u, h.m_count);
+	EXPECT_EQ(0u, h.percentile(50));
+}
+
+TEST(perf_monitor_test, stages)
+{
+	sinsp_perf_monitor monitor;
+	monitor.set_enabled(true);
+
+	// the filters of an event don't count in its parser time
+	monitor.add_filter(PPME_SYSCALL_OPEN_X, 30);
+	monitor.add_filter(PPME_SYSCALL_OPEN_X, 20);
+	monitor.add_parser(PPME_SYSCALL_OPEN_X, 100);
+	monitor.add_parser(PPME_SYSCALL_OPEN_X, 10);
+	monitor.add(SINSP_PERF_SCAP_NEXT, 7);
+	monitor.add(SINSP_PERF_DUMPER, 9);
+
+	sinsp_perf_report report = monitor.get_report();
+	EXPECT_LT(0, report.m_ns_per_tick);
+
+	EXPECT_EQ(2u, report.m_stages[SINSP_PERF_FILTER].m_count);
+	EXPECT_EQ(50u, report.m_stages[SINSP_PERF_FILTER].m_sum);
+	EXPECT_EQ(2u, report.m_stages[SINSP_PERF_PARSER].m_count);
+	EXPECT_EQ(60u, report.m_stages[SINSP_PERF_PARSER].m_sum);
+	EXPECT_EQ(50u, report.m_stages[SINSP_PERF_PARSER].m_max);
+	EXPECT_EQ(1u, report.m_stages[SINSP_PERF_SCAP_NEXT].m_count);
+	EXPECT_EQ(1u, report.m_stages[SINSP_PERF_DUMPER].m_count);
+	EXPECT_EQ(0u, report.m_stages[SINSP_PERF_FORMATTER].m_count);
+
+	const sinsp_perf_evt_stats& parser = report.m_parser_by_evt[PPME_SYSCALL_OPEN_X];
+	EXPECT_EQ(2u, parser.m_count);
+	EXPECT_EQ(60u, parser.m_sum);
+	const sinsp_perf_evt_stats& filter = report.m_filter_by_evt[PPME_SYSCALL_OPEN_X];
+	EXPECT_EQ(2u, filter.m_count);
+	EXPECT_EQ(30u, filter.m_max);
+	EXPECT_EQ(0u, report.m_parser_by_evt[PPME_SYSCALL_CLOSE_X].m_count);
+
+	EXPECT_NE(std::string::npos, report.to_string().find("open"));
+
+	monitor.reset();
+	report = monitor.get_report();
+	EXPECT_EQ(0u, report.m_stages[SINSP_PERF_PARSER].m_count);
+	EXPECT_EQ(0u, report.m_parser_by_evt[PPME_SYSCALL_OPEN_X].m_count);
+}
+
+TEST(perf_monitor_test, disabled_records_nothing)
+{
+	sinsp inspector;
+	scap_evt scapevt = {};
+	scapevt.type = PPME_SYSCALL_OPEN_X;
+	scapevt.len = sizeof(scapevt);
+	sinsp_evt evt(&inspector);
+	evt.init((uint8_t*)&scapevt, 0);
+
+	inspector.run_filters_on_evt(&evt);
+	sinsp_perf_report report = inspector.get_perf_report();
+	EXPECT_EQ(0u, report.m_stages[SINSP_PERF_FILTER].m_count);
+	EXPECT_TRUE(report.m_filter_by_evt.empty());
+
+	inspector.set_perf_instrumentation(true);
+	inspector.run_filters_on_evt(&evt);
+	report = inspector.get_perf_report();
+	EXPECT_EQ(1u, report.m_stages[SINSP_PERF_FILTER].m_count);
+	EXPECT_EQ(1u, report.m_filter_by_evt[PPME_SYSCALL_OPEN_X].m_count);
+
+	// turning it off keeps what was recorded, and records nothing more
+	inspector.set_perf_instrumentation(false);
+	inspector.run_filters_on_evt(&evt);
+	report = inspector.get_perf_report();
+	EXPECT_EQ(1u, report.m_stages[SINSP_PERF_FILTER].m_count);
+	EXPECT_EQ(1u, report.m_filter_by_evt[PPME_SYSCALL_OPEN_X].m_count);
+}
@@ -0,0 +1,61 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <sinsp.h>
+#include <sampling_profiler.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+TEST(sampling_profiler_test, stop_from_another_thread)
+{
+	for(int j = 0; j < 20; j++)
+	{
+		sinsp_sampling_profiler* profiler = new sinsp_sampling_profiler();
+		std::atomic<bool> started(false);
+		std::atomic<bool> done(false);
+
+		// the sampled thread keeps running while the profiler goes away
+		std::thread sampled([&]()
+		{
+			profiler->start(10000, NULL);
+			started = true;
+			volatile uint64_t n = 0;
+			while(!done)
+			{
+				n++;
+			}
+		});
+
+		while(!started)
+		{
+			std::this_thread::yield();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+		profiler->stop();
+		EXPECT_FALSE(profiler->enabled());
+		delete profiler;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		done = true;
+		sampled.join();
+	}
+}
+#endif
@@ -0,0 +1,219 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// for the scap handle of the inspector
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include <sinsp.h>
+#include <scap-int.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#if defined(HAS_CAPTURE) && defined(__linux__)
+static scap_fdinfo* find_ino(scap_fdinfo* table, uint64_t ino)
+{
+	for(scap_fdinfo* fdi = table; fdi != NULL; fdi = (scap_fdinfo*)fdi->hh.next)
+	{
+		if(fdi->ino == ino)
+		{
+			return fdi;
+		}
+	}
+	return NULL;
+}
+
+static int loopback_socket(int type, sockaddr_in* addr)
+{
+	socklen_t addrlen = sizeof(*addr);
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	int fd = socket(AF_INET, type, 0);
+	EXPECT_LE(0, fd);
+	EXPECT_EQ(0, bind(fd, (sockaddr*)addr, sizeof(*addr)));
+	EXPECT_EQ(0, getsockname(fd, (sockaddr*)addr, &addrlen));
+	return fd;
+}
+
+TEST(scap_fds_test, sock_diag_matches_proc_net)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+	scap_t* handle = inspector.m_h;
+
+	// a listening socket, both ends of a connection, a udp socket
+	sockaddr_in addr;
+	int listener = loopback_socket(SOCK_STREAM, &addr);
+	ASSERT_EQ(0, listen(listener, 1));
+	int client = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_EQ(0, connect(client, (sockaddr*)&addr, sizeof(addr)));
+	int server = accept(listener, NULL, NULL);
+	ASSERT_LE(0, server);
+	sockaddr_in udp_addr;
+	int udp = loopback_socket(SOCK_DGRAM, &udp_addr);
+
+	scap_ns_socket_list netlink = {};
+	ASSERT_EQ(SCAP_SUCCESS, scap_fd_read_inet_sockets_from_netlink(handle, (char*)"/proc/self/", &netlink)) << scap_getlasterr(handle);
+
+	scap_fdinfo* proc = NULL;
+	ASSERT_EQ(SCAP_SUCCESS, scap_fd_read_ipv4_sockets_from_proc_fs(handle, "/proc/net/tcp", SCAP_L4_TCP, &proc));
+	ASSERT_EQ(SCAP_SUCCESS, scap_fd_read_ipv4_sockets_from_proc_fs(handle, "/proc/net/udp", SCAP_L4_UDP, &proc));
+
+	for(int fd : {listener, client, server, udp})
+	{
+		struct stat st;
+		ASSERT_EQ(0, fstat(fd, &st));
+
+		scap_fdinfo* a = find_ino(netlink.sockets, st.st_ino);
+		scap_fdinfo* b = find_ino(proc, st.st_ino);
+		ASSERT_NE(nullptr, a) << "fd " << fd;
+		ASSERT_NE(nullptr, b) << "fd " << fd;
+		ASSERT_EQ(b->type, a->type) << "fd " << fd;
+
+		if(a->type == SCAP_FD_IPV4_SERVSOCK)
+		{
+			EXPECT_EQ(b->info.ipv4serverinfo.ip, a->info.ipv4serverinfo.ip);
+			EXPECT_EQ(b->info.ipv4serverinfo.port, a->info.ipv4serverinfo.port);
+			EXPECT_EQ(b->info.ipv4serverinfo.l4proto, a->info.ipv4serverinfo.l4proto);
+		}
+		else
+		{
+			ASSERT_EQ(SCAP_FD_IPV4_SOCK, a->type);
+			EXPECT_EQ(b->info.ipv4info.sip, a->info.ipv4info.sip);
+			EXPECT_EQ(b->info.ipv4info.dip, a->info.ipv4info.dip);
+			EXPECT_EQ(b->info.ipv4info.sport, a->info.ipv4info.sport);
+			EXPECT_EQ(b->info.ipv4info.dport, a->info.ipv4info.dport);
+			EXPECT_EQ(b->info.ipv4info.l4proto, a->info.ipv4info.l4proto);
+		}
+	}
+
+	struct stat st;
+	ASSERT_EQ(0, fstat(listener, &st));
+	scap_fdinfo* fdi = find_ino(netlink.sockets, st.st_ino);
+	ASSERT_EQ(SCAP_FD_IPV4_SERVSOCK, fdi->type);
+	EXPECT_EQ(ntohs(addr.sin_port), fdi->info.ipv4serverinfo.port);
+
+	scap_fd_free_table(handle, &netlink.sockets);
+	scap_fd_free_table(handle, &proc);
+	close(udp);
+	close(server);
+	close(client);
+	close(listener);
+}
+
+static scap_fdinfo* find_fd(scap_threadinfo* tinfo, int64_t fd)
+{
+	scap_fdinfo* fdi;
+	HASH_FIND_INT64(tinfo->fdlist, &fd, fdi);
+	return fdi;
+}
+
+TEST(scap_fds_test, fast_scan_matches_regular_scan)
+{
+	sinsp inspector;
+	inspector.set_fast_fd_scan(true);
+	inspector.open_nodriver();
+	scap_t* handle = inspector.m_h;
+	// without a driver only the sockets are read, scan like a live capture,
+	// and keep the fds in the tables instead of passing them to sinsp
+	handle->m_mode = SCAP_MODE_LIVE;
+	proc_entry_callback callback = handle->m_proc_callback;
+	handle->m_proc_callback = NULL;
+
+	char file_name[] = "/tmp/scap_fds_XXXXXX";
+	int file = mkstemp(file_name);
+	ASSERT_LE(0, file);
+	int append = open(file_name, O_WRONLY | O_APPEND);
+	ASSERT_LE(0, append);
+	int pipes[2];
+	ASSERT_EQ(0, pipe(pipes));
+	sockaddr_in addr;
+	int sock = loopback_socket(SOCK_DGRAM, &addr);
+
+	char err[SCAP_LASTERR_SIZE];
+	scap_ns_socket_list* sockets_by_ns = NULL;
+	scap_threadinfo regular = {};
+	scap_threadinfo fast = {};
+	handle->m_fast_fd_scan = false;
+	ASSERT_EQ(SCAP_SUCCESS, scap_fd_scan_fd_dir(handle, (char*)"/proc/self/", &regular, &sockets_by_ns, NULL, err)) << err;
+	handle->m_fast_fd_scan = true;
+	ASSERT_EQ(SCAP_SUCCESS, scap_fd_scan_fd_dir(handle, (char*)"/proc/self/", &fast, &sockets_by_ns, NULL, err)) << err;
+	handle->m_proc_callback = callback;
+	handle->m_mode = SCAP_MODE_NODRIVER;
+
+	for(int fd : {file, append, pipes[0], pipes[1], sock})
+	{
+		scap_fdinfo* a = find_fd(&regular, fd);
+		scap_fdinfo* b = find_fd(&fast, fd);
+		ASSERT_NE(nullptr, a) << "fd " << fd;
+		ASSERT_NE(nullptr, b) << "fd " << fd;
+		EXPECT_EQ(a->type, b->type) << "fd " << fd;
+		EXPECT_EQ(a->ino, b->ino) << "fd " << fd;
+		if(a->type == SCAP_FD_FILE_V2)
+		{
+			EXPECT_STREQ(file_name, b->info.regularinfo.fname);
+			EXPECT_STREQ(a->info.regularinfo.fname, b->info.regularinfo.fname);
+			EXPECT_EQ(PPM_O_NONE, b->info.regularinfo.open_flags);
+		}
+		else if(a->type == SCAP_FD_IPV4_SOCK || a->type == SCAP_FD_IPV4_SERVSOCK)
+		{
+			EXPECT_EQ(0, memcmp(&a->info, &b->info, sizeof(a->info))) << "fd " << fd;
+		}
+		else
+		{
+			EXPECT_STREQ(a->info.fname, b->info.fname) << "fd " << fd;
+		}
+	}
+	scap_fdinfo* regular_append = find_fd(&regular, append);
+	ASSERT_EQ(SCAP_FD_FILE_V2, regular_append->type);
+	EXPECT_EQ(PPM_O_WRONLY | PPM_O_APPEND, regular_append->info.regularinfo.open_flags & (PPM_O_WRONLY | PPM_O_APPEND));
+	EXPECT_NE(0u, regular_append->info.regularinfo.mount_id);
+
+	// sinsp reads the flags the fast scan left out on the first lookup
+	sinsp_threadinfo tinfo(&inspector);
+	tinfo.m_tid = getpid();
+	tinfo.m_pid = getpid();
+	tinfo.m_fdtable.m_tid = getpid();
+	sinsp_fdinfo_t res;
+	tinfo.add_fd_from_scap(find_fd(&fast, append), &res);
+	ASSERT_EQ(1u, tinfo.m_fdtable.m_table.count(append));
+	EXPECT_TRUE(tinfo.m_fdtable.m_table[append].m_flags & sinsp_fdinfo_t::FLAGS_FILE_FLAGS_PENDING);
+
+	sinsp_fdinfo_t* fdi = tinfo.get_fd(append);
+	ASSERT_NE(nullptr, fdi);
+	EXPECT_FALSE(fdi->m_flags & sinsp_fdinfo_t::FLAGS_FILE_FLAGS_PENDING);
+	EXPECT_EQ(regular_append->info.regularinfo.open_flags, fdi->m_openflags);
+	EXPECT_EQ(std::string(file_name), fdi->m_name);
+
+	scap_fd_free_proc_fd_table(handle, &regular);
+	scap_fd_free_proc_fd_table(handle, &fast);
+	scap_fd_free_ns_sockets_list(handle, &sockets_by_ns);
+	close(sock);
+	close(pipes[0]);
+	close(pipes[1]);
+	close(append);
+	close(file);
+	unlink(file_name);
+}
+#endif
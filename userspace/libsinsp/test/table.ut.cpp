@@ -0,0 +1,97 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <sinsp.h>
+#include <table.h>
+#include <map>
+#include <tuple>
+
+typedef std::map<std::string, std::tuple<uint64_t, uint64_t, uint32_t>> grouped_rows;
+
+//
+// Group the processes by name, with the sum of the virtual memory, the
+// largest resident memory and the number of processes of each group
+//
+static grouped_rows run_table(sinsp* inspector, bool columnar)
+{
+	sinsp_table table(inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, sinsp_table::OT_CURSES, 0, 0);
+	table.set_columnar(columnar);
+
+	std::vector<sinsp_view_column_info> entries;
+	entries.push_back(sinsp_view_column_info("thread.tid", "TID", "", 8, TEF_IS_KEY, A_NONE, A_NONE, {}, ""));
+	entries.push_back(sinsp_view_column_info("proc.name", "NAME", "", 8, TEF_IS_GROUPBY_KEY, A_NONE, A_NONE, {}, ""));
+	entries.push_back(sinsp_view_column_info("thread.vmsize", "VIRT", "", 8, TEF_NONE, A_SUM, A_SUM, {}, ""));
+	entries.push_back(sinsp_view_column_info("thread.vmrss", "RES", "", 8, TEF_NONE, A_MAX, A_MAX, {}, ""));
+	entries.push_back(sinsp_view_column_info("evt.count", "COUNT", "", 8, TEF_NONE, A_SUM, A_SUM, {}, ""));
+	table.configure(&entries, "", false, 0);
+	table.set_sorting_col(1);
+
+	scap_evt scapevt = {};
+	scapevt.type = PPME_SYSDIGEVENT_X;
+	sinsp_evt evt(inspector);
+	evt.init((uint8_t*)&scapevt, 0);
+
+	// the first flush only sets the time of the next one
+	scapevt.ts = 10 * ONE_SECOND_IN_NS;
+	table.flush(&evt);
+	scapevt.ts = 11 * ONE_SECOND_IN_NS;
+	table.flush(&evt);
+
+	grouped_rows res;
+	std::vector<sinsp_sample_row>* sample = table.get_sample(ONE_SECOND_IN_NS);
+	for(auto& row : *sample)
+	{
+		EXPECT_EQ(3u, row.m_values.size());
+		std::string name((char*)row.m_key.m_val);
+		EXPECT_EQ(0u, res.count(name));
+		res[name] = std::make_tuple(*(uint64_t*)row.m_values[0].m_val,
+			*(uint64_t*)row.m_values[1].m_val,
+			*(uint32_t*)row.m_values[2].m_val);
+	}
+
+	return res;
+}
+
+TEST(table_test, columnar_matches_rows)
+{
+	sinsp inspector;
+	const char* names[] = {"nginx", "bash", "nginx", "redis", "bash", "nginx"};
+
+	for(uint32_t j = 0; j < sizeof(names) / sizeof(names[0]); j++)
+	{
+		// the thread table takes ownership
+		sinsp_threadinfo* tinfo = new sinsp_threadinfo(&inspector);
+		tinfo->m_tid = 100 + j;
+		tinfo->m_pid = tinfo->m_tid;
+		tinfo->m_ptid = 1;
+		tinfo->m_comm = names[j];
+		tinfo->m_exe = names[j];
+		tinfo->m_vmsize_kb = 1000 * (j + 1);
+		tinfo->m_vmrss_kb = 10 * (j + 1);
+		ASSERT_TRUE(inspector.add_thread(tinfo));
+	}
+
+	grouped_rows rows = run_table(&inspector, false);
+	grouped_rows columns = run_table(&inspector, true);
+
+	ASSERT_EQ(3u, rows.size());
+	EXPECT_EQ(std::make_tuple(1000ul + 3000 + 6000, 60ul, 3u), rows["nginx"]);
+	EXPECT_EQ(std::make_tuple(2000ul + 5000, 50ul, 2u), rows["bash"]);
+	EXPECT_EQ(std::make_tuple(4000ul, 40ul, 1u), rows["redis"]);
+	EXPECT_EQ(rows, columns);
+}
@@ -0,0 +1,223 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <sinsp.h>
+#include <tcp_stats.h>
+
+//
+// Build a tcp_* event: the tuple followed by 32 bit, then 64 bit parameters
+//
+class tcp_event
+{
+public:
+	tcp_event(uint16_t type, uint64_t ts, const char* sip, uint16_t sport, const char* dip, uint16_t dport,
+		  const std::vector<uint32_t>& args, const std::vector<uint64_t>& args64 = {})
+	{
+		uint32_t nparams = 1 + args.size() + args64.size();
+		uint32_t len = sizeof(scap_evt) + nparams * sizeof(uint16_t) + 13 +
+			args.size() * sizeof(uint32_t) + args64.size() * sizeof(uint64_t);
+
+		m_buf.resize(len);
+		scap_evt* e = (scap_evt*)m_buf.data();
+		e->ts = ts;
+		e->tid = 0;
+		e->len = len;
+		e->type = type;
+		e->nparams = nparams;
+
+		uint16_t* lens = (uint16_t*)(e + 1);
+		uint8_t* p = (uint8_t*)(lens + nparams);
+
+		lens[0] = 13;
+		p[0] = PPM_AF_INET;
+		inet_pton(AF_INET, sip, p + 1);
+		memcpy(p + 5, &sport, 2);
+		inet_pton(AF_INET, dip, p + 7);
+		memcpy(p + 11, &dport, 2);
+		p += 13;
+
+		for(uint32_t j = 0; j < args.size(); j++)
+		{
+			lens[j + 1] = sizeof(uint32_t);
+			memcpy(p, &args[j], sizeof(uint32_t));
+			p += sizeof(uint32_t);
+		}
+
+		for(uint32_t j = 0; j < args64.size(); j++)
+		{
+			lens[j + 1 + args.size()] = sizeof(uint64_t);
+			memcpy(p, &args64[j], sizeof(uint64_t));
+			p += sizeof(uint64_t);
+		}
+
+		m_evt.init(m_buf.data(), 0);
+	}
+
+	sinsp_evt* get()
+	{
+		return &m_evt;
+	}
+
+private:
+	std::vector<uint8_t> m_buf;
+	sinsp_evt m_evt;
+};
+
+static sinsp_tcp_conn_key key(const char* sip, uint16_t sport, const char* dip, uint16_t dport)
+{
+	uint32_t s, d;
+	inet_pton(AF_INET, sip, &s);
+	inet_pton(AF_INET, dip, &d);
+	return sinsp_tcp_conn_key(s, sport, d, dport);
+}
+
+TEST(tcp_stats_test, aggregate)
+{
+	sinsp_tcp_stats_table table;
+
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RCV_ESTABLISHED_E, 10, "10.0.0.1", 40000, "10.0.0.2", 80, {100}).get()));
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RCV_ESTABLISHED_E, 20, "10.0.0.1", 40000, "10.0.0.2", 80, {300}).get()));
+	// the other side of the same connection
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RCV_ESTABLISHED_E, 30, "10.0.0.2", 80, "10.0.0.1", 40000, {200}).get()));
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RETRANCESMIT_SKB_E, 40, "10.0.0.1", 40000, "10.0.0.2", 80, {3}).get()));
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_DROP_E, 50, "10.0.0.1", 40000, "10.0.0.2", 80, {}).get()));
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RECEIVE_RESET_E, 60, "10.0.0.1", 40000, "10.0.0.2", 80, {1}).get()));
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RCV_ESTABLISHED_E, 70, "10.0.0.3", 40000, "10.0.0.2", 80, {50}).get()));
+
+	ASSERT_EQ(2u, table.size());
+
+	const sinsp_tcp_stats* st = table.find(key("10.0.0.2", 80, "10.0.0.1", 40000));
+	ASSERT_NE(nullptr, st);
+	ASSERT_EQ(100u, st->m_srtt_min);
+	ASSERT_EQ(200u, st->srtt_avg());
+	ASSERT_EQ(300u, st->m_srtt_max);
+	ASSERT_EQ(3u, st->m_retransmits);
+	ASSERT_EQ(1u, st->m_drops);
+	ASSERT_EQ(1u, st->m_resets_received);
+	ASSERT_EQ(0u, st->m_resets_sent);
+	ASSERT_EQ(1u, st->m_reset_state);
+	ASSERT_EQ(10u, st->m_first_ts);
+	ASSERT_EQ(60u, st->m_last_ts);
+
+	// not a tcp event
+	std::vector<uint8_t> buf(sizeof(scap_evt), 0);
+	((scap_evt*)buf.data())->type = PPME_SYSCALL_CLOSE_E;
+	((scap_evt*)buf.data())->len = buf.size();
+	sinsp_evt evt;
+	evt.init(buf.data(), 0);
+	ASSERT_FALSE(table.process_event(&evt));
+}
+
+TEST(tcp_stats_test, kernel_summary)
+{
+	sinsp_tcp_stats_table table;
+
+	// samples, min, max, sum
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RTT_SUMMARY_E, 10, "10.0.0.1", 40000, "10.0.0.2", 80, {4, 100, 400}, {1000}).get()));
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RTT_SUMMARY_E, 20, "10.0.0.1", 40000, "10.0.0.2", 80, {6, 50, 300}, {1000}).get()));
+	// nothing aggregated since the last one
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RTT_SUMMARY_E, 30, "10.0.0.1", 40000, "10.0.0.2", 80, {0, 0, 0}, {0}).get()));
+	// mixed with a sampled event
+	ASSERT_TRUE(table.process_event(tcp_event(PPME_TCP_RCV_ESTABLISHED_E, 40, "10.0.0.1", 40000, "10.0.0.2", 80, {200}).get()));
+
+	const sinsp_tcp_stats* st = table.find(key("10.0.0.1", 40000, "10.0.0.2", 80));
+	ASSERT_NE(nullptr, st);
+	ASSERT_EQ(11u, st->m_srtt_samples);
+	ASSERT_EQ(50u, st->m_srtt_min);
+	ASSERT_EQ(400u, st->m_srtt_max);
+	ASSERT_EQ(2200u, st->m_srtt_sum);
+	ASSERT_EQ(200u, st->srtt_avg());
+}
+
+TEST(tcp_stats_test, snapshot_and_purge)
+{
+	sinsp_tcp_stats_table table(1024, 100, 1000);
+	std::vector<uint64_t> snapshots;
+	uint64_t nconns = 0;
+
+	table.set_snapshot_callback(100, [&](uint64_t ts, const sinsp_tcp_stats_table& t)
+	{
+		snapshots.push_back(ts);
+		nconns = t.size();
+	});
+
+	table.on_ts(1);
+	table.process_event(tcp_event(PPME_TCP_RCV_ESTABLISHED_E, 10, "10.0.0.1", 1, "10.0.0.2", 80, {100}).get());
+	table.process_event(tcp_event(PPME_TCP_RCV_ESTABLISHED_E, 10, "10.0.0.1", 2, "10.0.0.2", 80, {100}).get());
+	// TCP_CLOSE
+	table.process_event(tcp_event(PPME_TCP_SET_STATE_E, 20, "10.0.0.1", 2, "10.0.0.2", 80, {1, 7}).get());
+	table.on_ts(50);
+	ASSERT_TRUE(snapshots.empty());
+
+	// the closed connection is reported once, then removed
+	table.on_ts(101);
+	ASSERT_EQ(1u, snapshots.size());
+	ASSERT_EQ(2u, nconns);
+	ASSERT_EQ(1u, table.size());
+
+	// the idle one goes after the timeout
+	table.on_ts(1200);
+	ASSERT_EQ(2u, snapshots.size());
+	ASSERT_EQ(0u, table.size());
+}
+
+TEST(tcp_stats_test, full_table)
+{
+	sinsp_tcp_stats_table table(2);
+
+	for(uint16_t port = 1; port <= 4; port++)
+	{
+		table.process_event(tcp_event(PPME_TCP_DROP_E, 10, "10.0.0.1", port, "10.0.0.2", 80, {}).get());
+	}
+
+	ASSERT_EQ(2u, table.size());
+	ASSERT_EQ(2u, table.get_n_untracked());
+}
+
+#ifdef HAS_CAPTURE
+TEST(tcp_stats_test, kernel_summary_needs_bpf)
+{
+	// the kernel module
+	const char* probe = getenv("SYSDIG_BPF_PROBE");
+	bool had_probe = probe != NULL;
+	std::string saved_probe = had_probe ? probe : "";
+	unsetenv("SYSDIG_BPF_PROBE");
+
+	sinsp inspector;
+	inspector.set_tcp_srtt_agg_interval_ms(100);
+	try
+	{
+		inspector.open();
+		ADD_FAILURE() << "opened without the BPF probe";
+	}
+	catch(const sinsp_exception& e)
+	{
+		EXPECT_NE(std::string::npos, std::string(e.what()).find("needs the BPF probe")) << e.what();
+	}
+
+	if(had_probe)
+	{
+		setenv("SYSDIG_BPF_PROBE", saved_probe.c_str(), 1);
+	}
+}
+#endif
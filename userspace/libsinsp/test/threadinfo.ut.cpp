@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// to merge a lookup without the background thread
+#define VISIBILITY_PRIVATE
+
+#include <gtest.h>
+#include <sinsp.h>
+#include <string.h>
+
+TEST(thread_manager_test, merge_proc_lookup_container_refs)
+{
+	// every thread resolves to the static container
+	sinsp inspector(true, "static_id", "static_name", "static_image");
+	sinsp_thread_manager* manager = inspector.m_thread_manager;
+
+	// what find_thread() creates while /proc is read in the background
+	sinsp_threadinfo* placeholder = new sinsp_threadinfo(&inspector);
+	placeholder->m_tid = 4242;
+	placeholder->m_pid = 4242;
+	placeholder->m_ptid = -1;
+	placeholder->m_comm = "<NA>";
+	placeholder->m_exe = "<NA>";
+	ASSERT_TRUE(manager->add_thread(placeholder, false));
+	ASSERT_EQ(0u, inspector.m_container_manager.get_thread_refs("static_id"));
+
+	scap_threadinfo* pi = new scap_threadinfo();
+	memset(pi, 0, sizeof(*pi));
+	pi->tid = 4242;
+	pi->pid = 4242;
+	pi->ptid = 1;
+	strcpy(pi->comm, "worker");
+	strcpy(pi->exe, "worker");
+
+	sinsp_threadinfo* tinfo = manager->get_threads()->get(4242);
+	ASSERT_EQ(placeholder, tinfo);
+	manager->merge_proc_lookup(tinfo, pi);
+	delete pi;
+
+	EXPECT_EQ("worker", tinfo->m_comm);
+	EXPECT_EQ("static_id", tinfo->m_container_id);
+	EXPECT_EQ(1u, inspector.m_container_manager.get_thread_refs("static_id"));
+
+	manager->remove_thread(4242, true);
+	EXPECT_EQ(0u, inspector.m_container_manager.get_thread_refs("static_id"));
+}
+
+static sinsp_threadinfo* add_thread(sinsp& inspector, int64_t tid, int64_t pid, bool closed)
+{
+	sinsp_threadinfo* tinfo = new sinsp_threadinfo(&inspector);
+	tinfo->m_tid = tid;
+	tinfo->m_pid = pid;
+	tinfo->m_ptid = 1;
+	tinfo->m_comm = "test";
+	tinfo->m_exe = "test";
+	if(tid != pid)
+	{
+		tinfo->m_flags |= PPM_CL_CLONE_THREAD;
+	}
+	if(closed)
+	{
+		tinfo->m_flags |= PPM_CL_CLOSED;
+	}
+	EXPECT_TRUE(inspector.m_thread_manager->add_thread(tinfo, false));
+	return tinfo;
+}
+
+TEST(thread_manager_test, purge_fixes_child_counts)
+{
+	sinsp inspector;
+	sinsp_thread_manager* manager = inspector.m_thread_manager;
+	inspector.set_thread_timeout_s(1);
+	inspector.m_lastevent_ts = ONE_SECOND_IN_NS;
+
+	// a process that lost one of its two threads
+	add_thread(inspector, 100, 100, false);
+	add_thread(inspector, 101, 100, true);
+	add_thread(inspector, 102, 100, false);
+	// a process that is gone, with its thread
+	add_thread(inspector, 200, 200, true);
+	add_thread(inspector, 201, 200, true);
+	ASSERT_EQ(2u, manager->get_threads()->get(100)->m_nchilds);
+	ASSERT_EQ(1u, manager->get_threads()->get(200)->m_nchilds);
+
+	// the threads that are still running were used recently
+	inspector.m_lastevent_ts = 10 * ONE_SECOND_IN_NS;
+	manager->get_threads()->get(100)->m_lastaccess_ts = inspector.m_lastevent_ts;
+	manager->get_threads()->get(102)->m_lastaccess_ts = inspector.m_lastevent_ts;
+	ASSERT_TRUE(inspector.remove_inactive_threads());
+
+	EXPECT_EQ(nullptr, manager->get_threads()->get(101));
+	EXPECT_EQ(nullptr, manager->get_threads()->get(200));
+	EXPECT_EQ(nullptr, manager->get_threads()->get(201));
+	ASSERT_NE(nullptr, manager->get_threads()->get(100));
+	ASSERT_NE(nullptr, manager->get_threads()->get(102));
+	EXPECT_EQ(1u, manager->get_threads()->get(100)->m_nchilds);
+	EXPECT_EQ(2u, manager->get_thread_count());
+}
@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <timing_wheel.h>
+#include <algorithm>
+
+using namespace libsinsp;
+
+static const uint64_t TICK = 1000;
+
+TEST(timing_wheel_test, expires_in_order_of_ticks)
+{
+	timing_wheel<int> wheel(TICK);
+	std::vector<int> out;
+
+	wheel.schedule(1, 100 * TICK);
+	wheel.schedule(2, 150 * TICK);
+	wheel.schedule(3, 5000 * TICK);
+	wheel.schedule(4, 300000 * TICK);
+	ASSERT_EQ(4u, wheel.size());
+
+	ASSERT_EQ(0u, wheel.pop_expired(100 * TICK, 100, out));
+	ASSERT_EQ(1u, wheel.pop_expired(101 * TICK, 100, out));
+	ASSERT_EQ(1, out[0]);
+
+	ASSERT_EQ(0u, wheel.pop_expired(150 * TICK, 100, out));
+	ASSERT_EQ(1u, wheel.pop_expired(4999 * TICK, 100, out));
+	ASSERT_EQ(2, out[1]);
+
+	ASSERT_EQ(0u, wheel.pop_expired(5000 * TICK, 100, out));
+	ASSERT_EQ(1u, wheel.pop_expired(5001 * TICK, 100, out));
+	ASSERT_EQ(3, out[2]);
+
+	ASSERT_EQ(0u, wheel.pop_expired(300000 * TICK, 100, out));
+	ASSERT_EQ(1u, wheel.pop_expired(300001 * TICK, 100, out));
+	ASSERT_EQ(4, out[3]);
+	ASSERT_EQ(0u, wheel.size());
+}
+
+TEST(timing_wheel_test, bounded_pops_resume)
+{
+	timing_wheel<int> wheel(TICK);
+	std::vector<int> out;
+
+	for(int j = 0; j < 10; j++)
+	{
+		wheel.schedule(j, 10 * TICK);
+	}
+
+	ASSERT_EQ(4u, wheel.pop_expired(20 * TICK, 4, out));
+	ASSERT_EQ(4u, wheel.pop_expired(20 * TICK, 4, out));
+	ASSERT_EQ(2u, wheel.pop_expired(20 * TICK, 4, out));
+	ASSERT_EQ(0u, wheel.pop_expired(20 * TICK, 4, out));
+
+	std::sort(out.begin(), out.end());
+	for(int j = 0; j < 10; j++)
+	{
+		ASSERT_EQ(j, out[j]);
+	}
+}
+
+TEST(timing_wheel_test, past_and_far_deadlines)
+{
+	timing_wheel<int> wheel(TICK);
+	std::vector<int> out;
+
+	wheel.schedule(1, 1000 * TICK);
+	// already expired
+	wheel.schedule(2, 10 * TICK);
+	// beyond the span of the wheel
+	uint64_t far = 1000 + (1ULL << 26);
+	wheel.schedule(3, far * TICK);
+
+	ASSERT_EQ(1u, wheel.pop_expired(1000 * TICK + 1, 100, out));
+	ASSERT_EQ(2, out[0]);
+	ASSERT_EQ(1u, wheel.pop_expired(1001 * TICK, 100, out));
+	ASSERT_EQ(1, out[1]);
+
+	ASSERT_EQ(0u, wheel.pop_expired((far - 1) * TICK, 100, out));
+	ASSERT_EQ(1u, wheel.pop_expired((far + 1) * TICK, 100, out));
+	ASSERT_EQ(3, out[2]);
+}
+
+TEST(timing_wheel_test, random_deadlines)
+{
+	timing_wheel<uint64_t> wheel(TICK);
+	std::vector<uint64_t> out;
+	uint64_t base = 1000000;
+	uint64_t seed = 42;
+
+	for(uint32_t j = 0; j < 10000; j++)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		wheel.schedule(base + (seed >> 40) % 200000, (base + (seed >> 40) % 200000) * TICK);
+	}
+
+	for(uint64_t now = base; now < base + 200010; now += 7)
+	{
+		size_t first = out.size();
+		wheel.pop_expired(now * TICK, 1000000, out);
+		for(size_t k = first; k < out.size(); k++)
+		{
+			ASSERT_LT(out[k], now);
+			ASSERT_GE(out[k] + 7, now);
+		}
+	}
+
+	ASSERT_EQ(10000u, out.size());
+	ASSERT_EQ(0u, wheel.size());
+}
@@ -26,6 +26,7 @@ limitations under the License.
 #include "sinsp_int.h"
 #include "protodecoder.h"
 #include "tracers.h"
+#include "proc_async_source.h"
 
 #ifdef HAS_ANALYZER
 #include "tracer_emitter.h"
@@ -134,7 +135,7 @@ void sinsp_threadinfo::fix_sockets_coming_from_proc()
 				it->second.m_sockinfo.m_ipv4info.m_fields.m_sport = it->second.m_sockinfo.m_ipv4info.m_fields.m_dport;
 				it->second.m_sockinfo.m_ipv4info.m_fields.m_dport = tport;
 
-				it->second.m_name = ipv4tuple_to_string(&it->second.m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled);
+				it->second.set_name(ipv4tuple_to_string(&it->second.m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled));
 
 				it->second.set_role_server();
 			}
@@ -232,13 +233,13 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 		{
 			m_inspector->m_network_interfaces->update_fd(newfdi);
 		}
-		newfdi->m_name = ipv4tuple_to_string(&newfdi->m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled);
+		newfdi->set_name(ipv4tuple_to_string(&newfdi->m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled));
 		break;
 	case SCAP_FD_IPV4_SERVSOCK:
 		newfdi->m_sockinfo.m_ipv4serverinfo.m_ip = fdi->info.ipv4serverinfo.ip;
 		newfdi->m_sockinfo.m_ipv4serverinfo.m_port = fdi->info.ipv4serverinfo.port;
 		newfdi->m_sockinfo.m_ipv4serverinfo.m_l4proto = fdi->info.ipv4serverinfo.l4proto;
-		newfdi->m_name = ipv4serveraddr_to_string(&newfdi->m_sockinfo.m_ipv4serverinfo, m_inspector->m_hostname_and_port_resolution_enabled);
+		newfdi->set_name(ipv4serveraddr_to_string(&newfdi->m_sockinfo.m_ipv4serverinfo, m_inspector->m_hostname_and_port_resolution_enabled));
 
 		//
 		// We keep note of all the host bound server ports.
@@ -269,7 +270,7 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 			{
 				m_inspector->m_network_interfaces->update_fd(newfdi);
 			}
-			newfdi->m_name = ipv4tuple_to_string(&newfdi->m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled);
+			newfdi->set_name(ipv4tuple_to_string(&newfdi->m_sockinfo.m_ipv4info, m_inspector->m_hostname_and_port_resolution_enabled));
 		}
 		else
 		{
@@ -282,14 +283,14 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 			{
 				newfdi->m_flags |= sinsp_fdinfo_t::FLAGS_SOCKET_CONNECTED;
 			}
-			newfdi->m_name = ipv6tuple_to_string(&newfdi->m_sockinfo.m_ipv6info, m_inspector->m_hostname_and_port_resolution_enabled);
+			newfdi->set_name(ipv6tuple_to_string(&newfdi->m_sockinfo.m_ipv6info, m_inspector->m_hostname_and_port_resolution_enabled));
 		}
 		break;
 	case SCAP_FD_IPV6_SERVSOCK:
 		copy_ipv6_address(newfdi->m_sockinfo.m_ipv6serverinfo.m_ip.m_b, fdi->info.ipv6serverinfo.ip);
 		newfdi->m_sockinfo.m_ipv6serverinfo.m_port = fdi->info.ipv6serverinfo.port;
 		newfdi->m_sockinfo.m_ipv6serverinfo.m_l4proto = fdi->info.ipv6serverinfo.l4proto;
-		newfdi->m_name = ipv6serveraddr_to_string(&newfdi->m_sockinfo.m_ipv6serverinfo, m_inspector->m_hostname_and_port_resolution_enabled);
+		newfdi->set_name(ipv6serveraddr_to_string(&newfdi->m_sockinfo.m_ipv6serverinfo, m_inspector->m_hostname_and_port_resolution_enabled));
 
 		//
 		// We keep note of all the host bound server ports.
@@ -301,7 +302,7 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 	case SCAP_FD_UNIX_SOCK:
 		newfdi->m_sockinfo.m_unixinfo.m_fields.m_source = fdi->info.unix_socket_info.source;
 		newfdi->m_sockinfo.m_unixinfo.m_fields.m_dest = fdi->info.unix_socket_info.destination;
-		newfdi->m_name = fdi->info.unix_socket_info.fname;
+		newfdi->set_name(fdi->info.unix_socket_info.fname);
 		if(newfdi->m_name.empty())
 		{
 			newfdi->set_role_client();
@@ -313,10 +314,16 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 		break;
 	case SCAP_FD_FILE_V2:
 		newfdi->m_openflags = fdi->info.regularinfo.open_flags;
-		newfdi->m_name = fdi->info.regularinfo.fname;
+		newfdi->set_name(fdi->info.regularinfo.fname);
 		newfdi->m_dev = fdi->info.regularinfo.dev;
 		newfdi->m_mount_id = fdi->info.regularinfo.mount_id;
 
+		if(m_inspector->m_fast_fd_scan && !m_inspector->is_capture())
+		{
+			// the fast scan doesn't read fdinfo, see sinsp_fdtable::lookup_device()
+			newfdi->m_flags |= sinsp_fdinfo_t::FLAGS_FILE_FLAGS_PENDING;
+		}
+
 		if(newfdi->m_name == USER_EVT_DEVICE_NAME)
 		{
 			newfdi->m_flags |= sinsp_fdinfo_t::FLAGS_IS_TRACER_FILE;
@@ -337,7 +344,7 @@ void sinsp_threadinfo::add_fd_from_scap(scap_fdinfo *fdi, OUT sinsp_fdinfo_t *re
 	case SCAP_FD_INOTIFY:
 	case SCAP_FD_TIMERFD:
 	case SCAP_FD_NETLINK:
-		newfdi->m_name = fdi->info.fname;
+		newfdi->set_name(fdi->info.fname);
 
 		if(newfdi->m_name == USER_EVT_DEVICE_NAME)
 		{
@@ -501,14 +508,16 @@ std::string sinsp_threadinfo::get_exepath() const
 
 void sinsp_threadinfo::set_args(const char* args, size_t len)
 {
-	m_args.clear();
+	vector<string> block;
 
 	size_t offset = 0;
 	while(offset < len)
 	{
-		m_args.push_back(args + offset);
-		offset += m_args.back().length() + 1;
+		block.push_back(args + offset);
+		offset += block.back().length() + 1;
 	}
+
+	m_args.assign(std::move(block));
 }
 
 void sinsp_threadinfo::set_env(const char* env, size_t len)
@@ -526,7 +535,7 @@ void sinsp_threadinfo::set_env(const char* env, size_t len)
 		}
 	}
 
-	m_env.clear();
+	vector<string> block;
 	size_t offset = 0;
 	while(offset < len)
 	{
@@ -540,14 +549,16 @@ void sinsp_threadinfo::set_env(const char* env, size_t len)
 			if(!memcmp(left, zero, sz))
 			{
 				free(zero);
-				return;
+				break;
 			}
 			free(zero);
 		}
-		m_env.push_back(left);
+		block.push_back(left);
 
-		offset += m_env.back().length() + 1;
+		offset += block.back().length() + 1;
 	}
+
+	m_env.assign(std::move(block));
 }
 
 bool sinsp_threadinfo::set_env_from_proc() {
@@ -560,15 +571,16 @@ bool sinsp_threadinfo::set_env_from_proc() {
 		return false;
 	}
 
-	m_env.clear();
+	vector<string> block;
 	while (environment) {
 		string env;
 		getline(environment, env, '\0');
 		if (!env.empty())
 		{
-			m_env.emplace_back(env);
+			block.emplace_back(env);
 		}
 	}
+	m_env.assign(std::move(block));
 
 	return true;
 }
@@ -620,7 +632,7 @@ string sinsp_threadinfo::get_env(const string& name)
 
 void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 {
-	m_cgroups.clear();
+	vector<pair<string, string>> block;
 
 	size_t offset = 0;
 	while(offset < len)
@@ -630,7 +642,7 @@ void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 		if(sep == NULL)
 		{
 			ASSERT(false);
-			return;
+			break;
 		}
 
 		string subsys(str, sep - str);
@@ -659,9 +671,11 @@ void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 			subsys = "blkio";
 		}
 
-		m_cgroups.push_back(std::make_pair(subsys, cgroup));
+		block.push_back(std::make_pair(subsys, cgroup));
 		offset += subsys_length + 1 + cgroup.length() + 1;
 	}
+
+	m_cgroups.assign(std::move(block));
 }
 
 sinsp_threadinfo* sinsp_threadinfo::get_parent_thread()
@@ -1211,8 +1225,15 @@ void sinsp_threadinfo::fd_to_scap(scap_fdinfo *dst, sinsp_fdinfo_t* src)
 // sinsp_thread_manager implementation
 ///////////////////////////////////////////////////////////////////////////////
 sinsp_thread_manager::sinsp_thread_manager(sinsp* inspector)
-	: m_max_thread_table_size(m_thread_table_absolute_max_size)
+	: m_expiry_wheel(ONE_SECOND_IN_NS),
+	  m_max_thread_table_size(m_thread_table_absolute_max_size)
 {
+	sinsp_metrics_registry& metrics = sinsp_metrics_registry::get();
+	m_metric_added = &metrics.counter("sinsp_threads_added", "Threads added to the thread table");
+	m_metric_removed = &metrics.counter("sinsp_threads_removed", "Threads removed from the thread table");
+	m_metric_dropped = &metrics.counter("sinsp_threads_dropped", "Threads not added because the thread table was full");
+	m_metric_threads = &metrics.gauge("sinsp_threads", "Threads in the thread table");
+
 	m_inspector = inspector;
 	clear();
 }
@@ -1220,10 +1241,16 @@ sinsp_thread_manager::sinsp_thread_manager(sinsp* inspector)
 void sinsp_thread_manager::clear()
 {
 	m_threadtable.clear();
+	m_metric_threads->set(0);
+	m_inspector->m_container_manager.clear_thread_refs();
 	m_last_tid = 0;
 	m_last_tinfo.reset();
 	m_last_flush_time_ns = 0;
+	m_expiry_wheel.clear();
+	m_unscheduled_threads.clear();
+	m_n_purged_threads = 0;
 	m_n_drops = 0;
+	m_pending_proc_lookups.clear();
 
 #ifdef GATHER_INTERNAL_STATS
 	m_failed_lookups = &m_inspector->m_stats.get_metrics_registry().register_counter(internal_metrics::metric_name("thread_failed_lookups","Failed thread lookups"));
@@ -1277,6 +1304,7 @@ bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_sc
 				threadinfo->m_tid, threadinfo->m_pid, threadinfo->m_comm.c_str());
 		}
 		m_n_drops++;
+		m_metric_dropped->add();
 		return false;
 	}
 
@@ -1285,13 +1313,52 @@ bool sinsp_thread_manager::add_thread(sinsp_threadinfo *threadinfo, bool from_sc
 		increment_mainthread_childcount(threadinfo);
 	}
 
+	// a new thread with the same tid replaces the placeholder
+	if(!m_pending_proc_lookups.empty())
+	{
+		m_pending_proc_lookups.erase(threadinfo->m_tid);
+	}
+
 	threadinfo->compute_program_hash();
 	threadinfo->allocate_private_state();
+
+	sinsp_threadinfo* old_tinfo = m_threadtable.get(threadinfo->m_tid);
+	if(old_tinfo != nullptr)
+	{
+		m_inspector->m_container_manager.remove_thread_ref(old_tinfo->m_container_id);
+	}
 	m_threadtable.put(threadinfo);
+	m_inspector->m_container_manager.add_thread_ref(threadinfo->m_container_id);
+	m_metric_added->add();
+	m_metric_threads->set(m_threadtable.size());
+
+	schedule_thread_expiry(threadinfo);
 
 	return true;
 }
 
+void sinsp_thread_manager::schedule_thread_expiry(sinsp_threadinfo* tinfo)
+{
+	//
+	// The initial /proc scan and the proclist of a capture file are loaded
+	// before any event is received. Their deadline is computed on the
+	// timestamp of the first event, so that it's in the same time base as
+	// the events (this matters when reading a capture file).
+	//
+	if(m_inspector->m_lastevent_ts == 0)
+	{
+		m_unscheduled_threads.push_back({tinfo->m_tid, tinfo->m_clone_ts});
+		return;
+	}
+
+	schedule_thread_expiry(tinfo, m_inspector->m_lastevent_ts + m_inspector->m_thread_timeout_ns);
+}
+
+void sinsp_thread_manager::schedule_thread_expiry(sinsp_threadinfo* tinfo, uint64_t deadline_ns)
+{
+	m_expiry_wheel.schedule({tinfo->m_tid, tinfo->m_clone_ts}, deadline_ns);
+}
+
 void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 {
 	uint64_t nchilds;
@@ -1375,7 +1442,11 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 		m_removed_threads->increment();
 #endif
 
+		m_inspector->m_container_manager.remove_thread_ref(tinfo->m_container_id);
+		m_pending_proc_lookups.erase(tid);
 		m_threadtable.erase(tid);
+		m_metric_removed->add();
+		m_metric_threads->set(m_threadtable.size());
 
 		//
 		// If the thread has a nonzero refcount, it means that we are forcing the removal
@@ -1451,10 +1522,32 @@ void sinsp_thread_manager::update_statistics()
 	m_inspector->m_stats.m_n_threads = get_thread_count();
 
 	m_inspector->m_stats.m_n_fds = 0;
-	for(threadinfo_map_iterator_t it = m_threadtable.begin(); it != m_threadtable.end(); it++)
-	{
-		m_inspector->m_stats.m_n_fds += it->second.get_fd_table()->size();
-	}
+	m_inspector->m_stats.m_fd_table_bytes = 0;
+	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
+		m_inspector->m_stats.m_n_fds += tinfo.get_fd_table()->size();
+		// the threads that share the table of their process don't use theirs
+		if(!(tinfo.m_flags & PPM_CL_CLONE_FILES))
+		{
+			m_inspector->m_stats.m_fd_table_bytes += tinfo.m_fdtable.memory_usage();
+		}
+		return true;
+	});
+
+	//
+	// args, env and cgroups blocks are shared between threads, report
+	// the memory of the unique blocks
+	//
+	libsinsp::shared_block_pool_stats strvec_stats = libsinsp::interned_vector<string>::pool().get_stats();
+	libsinsp::shared_block_pool_stats cgroups_stats = libsinsp::interned_vector<pair<string, string>>::pool().get_stats();
+	m_inspector->m_stats.m_n_interned_blocks = strvec_stats.m_n_blocks + cgroups_stats.m_n_blocks;
+	m_inspector->m_stats.m_interned_bytes = strvec_stats.m_bytes + cgroups_stats.m_bytes;
+	m_inspector->m_stats.m_n_interned_hits = strvec_stats.m_n_hits + cgroups_stats.m_n_hits;
+
+	// the fd names, shared by all the fds with the same name
+	libsinsp::shared_block_pool_stats names_stats = libsinsp::interned_string::pool().get_stats();
+	m_inspector->m_stats.m_n_fd_names = names_stats.m_n_blocks;
+	m_inspector->m_stats.m_fd_names_bytes = names_stats.m_bytes;
+	m_inspector->m_stats.m_n_fd_names_hits = names_stats.m_n_hits;
 #endif
 }
 
@@ -1501,7 +1594,184 @@ void sinsp_thread_manager::thread_to_scap(sinsp_threadinfo& tinfo, 	scap_threadi
 	sctinfo->filtered_out = false;
 }
 
-void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
+void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper, bool keep_base)
+{
+	vector<sinsp_threadinfo*> threads;
+
+	threads.reserve(m_threadtable.size());
+	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
+		threads.push_back(&tinfo);
+		return true;
+	});
+
+	write_proclist(dumper, threads);
+
+	for(sinsp_threadinfo* tinfo : threads)
+	{
+		write_fds(dumper, *tinfo, NULL);
+	}
+
+	if(keep_base)
+	{
+		keep_dump_base();
+	}
+}
+
+void sinsp_thread_manager::keep_dump_base()
+{
+	unordered_map<const void*, size_t> block_hashes;
+
+	m_dump_base.clear();
+	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
+		dumped_thread& dt = m_dump_base[tinfo.m_tid];
+
+		dt.m_hash = thread_state_hash(tinfo, block_hashes);
+		if(tinfo.is_main_thread())
+		{
+			// with the devices that write_fds() looks up
+			sinsp_fdtable* fdtable = tinfo.get_fd_table();
+			for(auto& it : fdtable->m_table)
+			{
+				fdtable->lookup_device(&it.second, it.first);
+				dt.m_fds[it.first] = it.second.state_hash();
+			}
+		}
+		return true;
+	});
+}
+
+void sinsp_thread_manager::dump_thread_deltas_to_file(scap_dumper_t* dumper)
+{
+	unordered_map<const void*, size_t> block_hashes;
+	vector<sinsp_threadinfo*> threads;
+	vector<pair<sinsp_threadinfo*, vector<int64_t>>> fds;
+	vector<scap_removed_state> removed;
+
+	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
+		auto bit = m_dump_base.find(tinfo.m_tid);
+		const dumped_thread* dt = bit != m_dump_base.end() ? &bit->second : NULL;
+
+		if(dt == NULL || dt->m_hash != thread_state_hash(tinfo, block_hashes))
+		{
+			threads.push_back(&tinfo);
+		}
+
+		vector<int64_t> changed;
+		sinsp_fdtable* fdtable = tinfo.get_fd_table();
+		bool main_thread = tinfo.is_main_thread();
+
+		if(main_thread)
+		{
+			for(auto& it : fdtable->m_table)
+			{
+				fdtable->lookup_device(&it.second, it.first);
+
+				unordered_map<int64_t, size_t>::const_iterator fit;
+				if(dt == NULL ||
+				   (fit = dt->m_fds.find(it.first)) == dt->m_fds.end() ||
+				   fit->second != it.second.state_hash())
+				{
+					changed.push_back(it.first);
+				}
+			}
+
+			if(!changed.empty())
+			{
+				fds.emplace_back(&tinfo, std::move(changed));
+			}
+		}
+
+		if(dt != NULL)
+		{
+			for(auto& it : dt->m_fds)
+			{
+				if(!main_thread || fdtable->m_table.find(it.first) == fdtable->m_table.end())
+				{
+					removed.push_back({(uint64_t)tinfo.m_tid, it.first});
+				}
+			}
+		}
+
+		return true;
+	});
+
+	for(auto& it : m_dump_base)
+	{
+		if(m_threadtable.get(it.first) == NULL)
+		{
+			removed.push_back({(uint64_t)it.first, -1});
+		}
+	}
+
+	//
+	// The removals go first, so that the threads that reuse a tid
+	// aren't dropped with the old ones
+	//
+	if(!removed.empty() &&
+	   scap_write_removed_state(m_inspector->m_h, dumper, removed.data(), (uint32_t)removed.size()) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+	}
+
+	write_proclist(dumper, threads);
+
+	for(auto& it : fds)
+	{
+		write_fds(dumper, *it.first, &it.second);
+	}
+}
+
+//
+// The memory counters don't make a thread dirty, they change all the
+// time. The interned args, env and cgroups are hashed once per block.
+//
+template<typename T>
+static size_t block_state_hash(const vector<T>& block, unordered_map<const void*, size_t>& block_hashes)
+{
+	auto it = block_hashes.find(&block);
+	if(it != block_hashes.end())
+	{
+		return it->second;
+	}
+
+	size_t h = block.size();
+	for(const T& val : block)
+	{
+		hash_combine(h, libsinsp::shared_block_hash(val));
+	}
+
+	block_hashes[&block] = h;
+	return h;
+}
+
+size_t sinsp_thread_manager::thread_state_hash(sinsp_threadinfo& tinfo, unordered_map<const void*, size_t>& block_hashes)
+{
+	size_t h = std::hash<int64_t>()(tinfo.m_tid);
+
+	hash_combine(h, tinfo.m_pid);
+	hash_combine(h, tinfo.m_ptid);
+	hash_combine(h, tinfo.m_sid);
+	hash_combine(h, tinfo.m_vpgid);
+	hash_combine(h, tinfo.m_flags);
+	hash_combine(h, tinfo.m_fdlimit);
+	hash_combine(h, tinfo.m_uid);
+	hash_combine(h, tinfo.m_gid);
+	hash_combine(h, tinfo.m_vtid);
+	hash_combine(h, tinfo.m_vpid);
+	hash_combine(h, tinfo.m_loginuid);
+	hash_combine(h, tinfo.m_comm);
+	hash_combine(h, tinfo.m_exe);
+	hash_combine(h, tinfo.m_exepath);
+	hash_combine(h, tinfo.m_cwd);
+	hash_combine(h, tinfo.m_root);
+	hash_combine(h, block_state_hash(tinfo.m_args.get(), block_hashes));
+	hash_combine(h, block_state_hash(tinfo.m_env.get(), block_hashes));
+	hash_combine(h, block_state_hash(tinfo.m_cgroups.get(), block_hashes));
+
+	return h;
+}
+
+void sinsp_thread_manager::write_proclist(scap_dumper_t* dumper, const vector<sinsp_threadinfo*>& threads)
 {
 	//
 	// First pass of the table to calculate the lengths
@@ -1510,7 +1780,8 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 
 	vector<uint32_t> lengths;
 
-	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
+	for(sinsp_threadinfo* tinfo : threads)
+	{
 		uint32_t il = (uint32_t)
 			(sizeof(uint32_t) +     // len
 			sizeof(uint64_t) +	// tid
@@ -1518,12 +1789,12 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 			sizeof(uint64_t) +	// ptid
 			sizeof(uint64_t) +	// sid
 			sizeof(uint64_t) +  // pgid
-			2 + MIN(tinfo.m_comm.size(), SCAP_MAX_PATH_SIZE) +
-			2 + MIN(tinfo.m_exe.size(), SCAP_MAX_PATH_SIZE) +
-			2 + MIN(tinfo.m_exepath.size(), SCAP_MAX_PATH_SIZE) +
-                        2 + MIN(tinfo.args_len(), SCAP_MAX_ARGS_SIZE) +
+			2 + MIN(tinfo->m_comm.size(), SCAP_MAX_PATH_SIZE) +
+			2 + MIN(tinfo->m_exe.size(), SCAP_MAX_PATH_SIZE) +
+			2 + MIN(tinfo->m_exepath.size(), SCAP_MAX_PATH_SIZE) +
+                        2 + MIN(tinfo->args_len(), SCAP_MAX_ARGS_SIZE) +
                         // 1 is sizeof("/")
-                        2 + MIN((tinfo.m_cwd == "")? 1 : tinfo.m_cwd.size(), SCAP_MAX_PATH_SIZE) +
+                        2 + MIN((tinfo->m_cwd == "")? 1 : tinfo->m_cwd.size(), SCAP_MAX_PATH_SIZE) +
 			sizeof(uint64_t) +	// fdlimit
 			sizeof(uint32_t) +	// flags
 			sizeof(uint32_t) +	// uid
@@ -1533,17 +1804,16 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 			sizeof(uint32_t) +  // vmswap_kb
 			sizeof(uint64_t) +  // pfmajor
 			sizeof(uint64_t) +  // pfminor
-                        2 + MIN(tinfo.env_len(), SCAP_MAX_ENV_SIZE) +
+                        2 + MIN(tinfo->env_len(), SCAP_MAX_ENV_SIZE) +
 			sizeof(int64_t) +  // vtid
 			sizeof(int64_t) +  // vpid
-                        2 + MIN(tinfo.cgroups_len(), SCAP_MAX_CGROUPS_SIZE) +
-			2 + MIN(tinfo.m_root.size(), SCAP_MAX_PATH_SIZE)) +
+                        2 + MIN(tinfo->cgroups_len(), SCAP_MAX_CGROUPS_SIZE) +
+			2 + MIN(tinfo->m_root.size(), SCAP_MAX_PATH_SIZE)) +
 			sizeof(uint32_t);  // loginuid
 
 		lengths.push_back(il);
 		totlen += il;
-		return true;
-	});
+	}
 
 	//
 	// Second pass of the table to dump the Threads
@@ -1554,7 +1824,8 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 	}
 
 	uint32_t idx = 0;
-	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
+	for(sinsp_threadinfo* tinfo : threads)
+	{
 		scap_threadinfo *sctinfo;
 		struct iovec *args_iov, *envs_iov, *cgroups_iov;
 		int argscnt, envscnt, cgroupscnt;
@@ -1565,20 +1836,20 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 			throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
 		}
 
-		thread_to_scap(tinfo, sctinfo);
-		tinfo.args_to_iovec(&args_iov, &argscnt, argsrem);
-		tinfo.env_to_iovec(&envs_iov, &envscnt, envsrem);
-		tinfo.cgroups_to_iovec(&cgroups_iov, &cgroupscnt, cgroupsrem);
+		thread_to_scap(*tinfo, sctinfo);
+		tinfo->args_to_iovec(&args_iov, &argscnt, argsrem);
+		tinfo->env_to_iovec(&envs_iov, &envscnt, envsrem);
+		tinfo->cgroups_to_iovec(&cgroups_iov, &cgroupscnt, cgroupsrem);
 
 		if(scap_write_proclist_entry_bufs(m_inspector->m_h, dumper, sctinfo, lengths[idx++],
-						  tinfo.m_comm.c_str(),
-						  tinfo.m_exe.c_str(),
-						  tinfo.m_exepath.c_str(),
+						  tinfo->m_comm.c_str(),
+						  tinfo->m_exe.c_str(),
+						  tinfo->m_exepath.c_str(),
 						  args_iov, argscnt,
 						  envs_iov, envscnt,
-						  (tinfo.m_cwd == "" ? "/" : tinfo.m_cwd.c_str()),
+						  (tinfo->m_cwd == "" ? "/" : tinfo->m_cwd.c_str()),
 						  cgroups_iov, cgroupscnt,
-						  tinfo.m_root.c_str()) != SCAP_SUCCESS)
+						  tinfo->m_root.c_str()) != SCAP_SUCCESS)
 		{
 			throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
 		}
@@ -1588,78 +1859,92 @@ void sinsp_thread_manager::dump_threads_to_file(scap_dumper_t* dumper)
 		free(cgroups_iov);
 
 		scap_proc_free(m_inspector->m_h, sctinfo);
-		return true;
-	});
+	}
 
 	if(scap_write_proclist_trailer(m_inspector->m_h, dumper, totlen) != SCAP_SUCCESS)
 	{
 		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
 	}
+}
 
-	//
-	// Third pass of the table to dump the FDs
-	//
-
-	m_threadtable.loop([&] (sinsp_threadinfo& tinfo) {
-		scap_threadinfo *sctinfo;
+void sinsp_thread_manager::write_fds(scap_dumper_t* dumper, sinsp_threadinfo& tinfo, const vector<int64_t>* fds)
+{
+	scap_threadinfo *sctinfo;
 
-		if((sctinfo = scap_proc_alloc(m_inspector->m_h)) == NULL)
-		{
-			throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
-		}
+	if((sctinfo = scap_proc_alloc(m_inspector->m_h)) == NULL)
+	{
+		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+	}
 
-		// Note: as scap_fd_add/scap_write_proc_fds do not use
-		// any of the array-based fields like comm, etc. a
-		// shallow copy is safe
-		thread_to_scap(tinfo, sctinfo);
+	// Note: as scap_fd_add/scap_write_proc_fds do not use
+	// any of the array-based fields like comm, etc. a
+	// shallow copy is safe
+	thread_to_scap(tinfo, sctinfo);
 
-		if(tinfo.is_main_thread())
-		{
+	if(tinfo.is_main_thread())
+	{
+		//
+		// Add the FDs, all of them or the listed ones
+		//
+		sinsp_fdtable* fdtable = tinfo.get_fd_table();
+		auto add_fd = [&](int64_t fd, sinsp_fdinfo_t& fdinfo) {
 			//
-			// Add the FDs
+			// Allocate the scap fd info
 			//
-			unordered_map<int64_t, sinsp_fdinfo_t>& fdtable = tinfo.get_fd_table()->m_table;
-			for(auto it = fdtable.begin(); it != fdtable.end(); ++it)
+			scap_fdinfo* scfdinfo = (scap_fdinfo*)malloc(sizeof(scap_fdinfo));
+			if(scfdinfo == NULL)
 			{
-				//
-				// Allocate the scap fd info
-				//
-				scap_fdinfo* scfdinfo = (scap_fdinfo*)malloc(sizeof(scap_fdinfo));
-				if(scfdinfo == NULL)
-				{
-					scap_proc_free(m_inspector->m_h, sctinfo);
-					throw sinsp_exception("thread memory allocation error in sinsp_thread_manager::to_scap");
-				}
+				scap_proc_free(m_inspector->m_h, sctinfo);
+				throw sinsp_exception("thread memory allocation error in sinsp_thread_manager::to_scap");
+			}
 
-				//
-				// Populate the fd info
-				//
-				scfdinfo->fd = it->first;
-				tinfo.fd_to_scap(scfdinfo, &it->second);
+			//
+			// Populate the fd info
+			//
+			scfdinfo->fd = fd;
+			fdtable->lookup_device(&fdinfo, fd);
+			tinfo.fd_to_scap(scfdinfo, &fdinfo);
 
-				//
-				// Add the new fd to the scap table.
-				//
-				if(scap_fd_add(m_inspector->m_h, sctinfo, it->first, scfdinfo) != SCAP_SUCCESS)
-				{
-					scap_proc_free(m_inspector->m_h, sctinfo);
-					throw sinsp_exception("error calling scap_fd_add in sinsp_thread_manager::to_scap (" + string(scap_getlasterr(m_inspector->m_h)) + ")");
-				}
+			//
+			// Add the new fd to the scap table.
+			//
+			if(scap_fd_add(m_inspector->m_h, sctinfo, fd, scfdinfo) != SCAP_SUCCESS)
+			{
+				scap_proc_free(m_inspector->m_h, sctinfo);
+				throw sinsp_exception("error calling scap_fd_add in sinsp_thread_manager::to_scap (" + string(scap_getlasterr(m_inspector->m_h)) + ")");
 			}
-		}
+		};
 
-		//
-		// Dump the thread to disk
-		//
-		if(scap_write_proc_fds(m_inspector->m_h, sctinfo, dumper) != SCAP_SUCCESS)
+		if(fds == NULL)
+		{
+			for(auto it = fdtable->m_table.begin(); it != fdtable->m_table.end(); ++it)
+			{
+				add_fd(it->first, it->second);
+			}
+		}
+		else
 		{
-			scap_proc_free(m_inspector->m_h, sctinfo);
-			throw sinsp_exception("error calling scap_proc_add in sinsp_thread_manager::to_scap (" + string(scap_getlasterr(m_inspector->m_h)) + ")");
+			for(int64_t fd : *fds)
+			{
+				auto it = fdtable->m_table.find(fd);
+				if(it != fdtable->m_table.end())
+				{
+					add_fd(fd, it->second);
+				}
+			}
 		}
+	}
 
+	//
+	// Dump the thread to disk
+	//
+	if(scap_write_proc_fds(m_inspector->m_h, sctinfo, dumper) != SCAP_SUCCESS)
+	{
 		scap_proc_free(m_inspector->m_h, sctinfo);
-		return true;
-	});
+		throw sinsp_exception("error calling scap_proc_add in sinsp_thread_manager::to_scap (" + string(scap_getlasterr(m_inspector->m_h)) + ")");
+	}
+
+	scap_proc_free(m_inspector->m_h, sctinfo);
 }
 
 threadinfo_map_t::ptr_t sinsp_thread_manager::get_thread_ref(int64_t tid, bool query_os_if_not_found, bool lookup_only, bool main_thread)
@@ -1684,6 +1969,7 @@ threadinfo_map_t::ptr_t sinsp_thread_manager::get_thread_ref(int64_t tid, bool q
         }
 
         scap_threadinfo* scap_proc = NULL;
+        bool proc_lookup_queued = false;
 
 		// unfortunately, sinsp owns the threade factory
         sinsp_threadinfo* newti = m_inspector->build_threadinfo();
@@ -1721,13 +2007,25 @@ threadinfo_map_t::ptr_t sinsp_thread_manager::get_thread_ref(int64_t tid, bool q
                 }
             }
 
+            if(m_async_proc_lookups
+#if defined(HAS_CAPTURE)
+               && tid != m_inspector->m_sysdig_pid
+#endif
+              )
+            {
+                proc_lookup_queued = queue_proc_lookup(tid, scan_sockets);
+            }
+
+            if(!proc_lookup_queued)
+            {
 #ifdef HAS_ANALYZER
-            uint64_t ts = sinsp_utils::get_current_time_ns();
+                uint64_t ts = sinsp_utils::get_current_time_ns();
 #endif
-            scap_proc = scap_proc_get(m_inspector->m_h, tid, scan_sockets);
+                scap_proc = scap_proc_get(m_inspector->m_h, tid, scan_sockets);
 #ifdef HAS_ANALYZER
-            m_n_proc_lookups_duration_ns += sinsp_utils::get_current_time_ns() - ts;
+                m_n_proc_lookups_duration_ns += sinsp_utils::get_current_time_ns() - ts;
 #endif
+            }
         }
 
         if(scap_proc)
@@ -1768,6 +2066,11 @@ threadinfo_map_t::ptr_t sinsp_thread_manager::get_thread_ref(int64_t tid, bool q
         //
         add_thread(newti, false);
         sinsp_proc = find_thread(tid, lookup_only);
+
+        if(sinsp_proc && proc_lookup_queued)
+        {
+            m_pending_proc_lookups.insert(tid);
+        }
     }
 
     return sinsp_proc;
@@ -1823,3 +2126,136 @@ void sinsp_thread_manager::set_max_thread_table_size(uint32_t value)
 {
     m_max_thread_table_size = std::min(value, m_thread_table_absolute_max_size);
 }
+
+void sinsp_thread_manager::set_async_proc_lookups(bool enabled)
+{
+	m_async_proc_lookups = enabled;
+
+	if(!enabled)
+	{
+		stop_async_proc_lookups();
+	}
+}
+
+void sinsp_thread_manager::stop_async_proc_lookups()
+{
+	if(m_proc_async_source)
+	{
+		m_proc_async_source->quiesce();
+		m_proc_async_source.reset();
+	}
+
+	//
+	// The placeholders stay as they are
+	//
+	m_pending_proc_lookups.clear();
+}
+
+bool sinsp_thread_manager::queue_proc_lookup(int64_t tid, bool scan_sockets)
+{
+	if(!m_proc_async_source)
+	{
+		if(m_inspector->is_capture())
+		{
+			return false;
+		}
+
+		char error[SCAP_LASTERR_SIZE];
+		scap_t* reader = scap_proc_reader_open(m_inspector->m_h, error);
+		if(reader == NULL)
+		{
+			g_logger.format(sinsp_logger::SEV_WARNING,
+				"Cannot read /proc in the background, falling back to synchronous lookups: %s", error);
+			m_async_proc_lookups = false;
+			return false;
+		}
+
+		m_proc_async_source = std::make_shared<sinsp_proc_async_source>(reader, m_proc_lookup_ttl_ms);
+	}
+
+	m_proc_async_source->queue(tid, scan_sockets);
+	return true;
+}
+
+void sinsp_thread_manager::merge_proc_lookups()
+{
+	sinsp_proc_async_source::results_t results = m_proc_async_source->get_results();
+
+	for(const auto& it : results)
+	{
+		int64_t tid = it.first.m_tid;
+
+		//
+		// The thread is gone, or an event already replaced the placeholder
+		//
+		if(m_pending_proc_lookups.erase(tid) == 0)
+		{
+			continue;
+		}
+
+		sinsp_threadinfo* tinfo = m_threadtable.get(tid);
+		if(tinfo == nullptr || !it.second)
+		{
+			continue;
+		}
+
+		merge_proc_lookup(tinfo, it.second.get());
+	}
+}
+
+void sinsp_thread_manager::merge_proc_lookup(sinsp_threadinfo* tinfo, scap_threadinfo* pi)
+{
+	//
+	// init() resets the whole thread, save what was built from the events
+	// seen since the placeholder was created: the syscall that may be
+	// waiting for its exit event, and the fds that were opened. Those fds
+	// are more recent than /proc, so they win.
+	//
+	uint8_t* lastevent_data = tinfo->m_lastevent_data;
+	uint16_t lastevent_type = tinfo->m_lastevent_type;
+	uint16_t lastevent_cpuid = tinfo->m_lastevent_cpuid;
+	sinsp_evt::category lastevent_category = tinfo->m_lastevent_category;
+	int64_t lastevent_fd = tinfo->m_lastevent_fd;
+	uint64_t lastevent_ts = tinfo->m_lastevent_ts;
+	uint64_t prevevent_ts = tinfo->m_prevevent_ts;
+	uint64_t lastaccess_ts = tinfo->m_lastaccess_ts;
+	uint64_t nchilds = tinfo->m_nchilds;
+	uint32_t closed = tinfo->m_flags & PPM_CL_CLOSED;
+	std::unordered_map<int64_t, sinsp_fdinfo_t> event_fds;
+	event_fds.swap(tinfo->m_fdtable.m_table);
+
+	tinfo->init(pi);
+
+	tinfo->m_lastevent_data = lastevent_data;
+	tinfo->m_lastevent_type = lastevent_type;
+	tinfo->m_lastevent_cpuid = lastevent_cpuid;
+	tinfo->m_lastevent_category = lastevent_category;
+	tinfo->m_lastevent_fd = lastevent_fd;
+	tinfo->m_lastevent_ts = lastevent_ts;
+	tinfo->m_prevevent_ts = prevevent_ts;
+	tinfo->m_lastaccess_ts = lastaccess_ts;
+	tinfo->m_nchilds = nchilds;
+	tinfo->m_flags |= closed;
+
+	//
+	// The placeholder was a main thread. init() resolved the container,
+	// and moved the thread ref of the table to it.
+	//
+	increment_mainthread_childcount(tinfo);
+	tinfo->compute_program_hash();
+
+	sinsp_fdtable* fdtable = tinfo->get_fd_table();
+	if(fdtable != NULL)
+	{
+		fdtable->reset_cache();
+		for(auto& fdit : event_fds)
+		{
+			fdtable->add(fdit.first, &fdit.second);
+		}
+	}
+
+	m_last_tinfo.reset();
+
+	// the expiry wheel entry is keyed on the clone timestamp, which changed
+	schedule_thread_expiry(tinfo);
+}
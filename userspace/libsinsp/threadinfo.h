@@ -33,12 +33,17 @@ struct iovec {
 #include <functional>
 #include <memory>
 #include <set>
+#include <unordered_set>
 #include "fdinfo.h"
 #include "internal_metrics.h"
+#include "interned_vector.h"
+#include "metrics.h"
+#include "timing_wheel.h"
 
 class sinsp_delays_info;
 class sinsp_tracerparser;
 class blprogram;
+class sinsp_proc_async_source;
 
 typedef struct erase_fd_params
 {
@@ -177,10 +182,9 @@ public:
 			sinsp_fdinfo_t *fdinfo = fdt->find(fd);
 			if(fdinfo)
 			{
-				// Its current name is now its old
-				// name. The name might change as a
-				// result of parsing.
-				fdinfo->m_oldname = fdinfo->m_name;
+				// The name might change as a result
+				// of parsing, start tracking it.
+				fdinfo->reset_name_changed();
 				return fdinfo;
 			}
 		}
@@ -252,9 +256,9 @@ public:
 	std::string m_comm; ///< Command name (e.g. "top")
 	std::string m_exe; ///< argv[0] (e.g. "sshd: user@pts/4")
 	std::string m_exepath; ///< full executable path
-	std::vector<std::string> m_args; ///< Command line arguments (e.g. "-d1")
-	std::vector<std::string> m_env; ///< Environment variables
-	std::vector<std::pair<std::string, std::string>> m_cgroups; ///< subsystem-cgroup pairs
+	libsinsp::interned_vector<std::string> m_args; ///< Command line arguments (e.g. "-d1"), shared with the threads that have the same ones
+	libsinsp::interned_vector<std::string> m_env; ///< Environment variables, shared with the threads that have the same ones
+	libsinsp::interned_vector<std::pair<std::string, std::string>> m_cgroups; ///< subsystem-cgroup pairs, shared with the threads that have the same ones
 	std::string m_container_id; ///< heuristic-based container id
 	uint32_t m_flags; ///< The thread flags. See the PPM_CL_* declarations in ppm_events_public.h.
 	int64_t m_fdlimit;  ///< The maximum number of FDs this thread can open
@@ -557,6 +561,16 @@ private:
 	friend class sinsp_threadinfo;
 };
 
+//
+// Entry of the thread table expiry wheel. The clone timestamp tells apart
+// threads that reuse the same tid.
+//
+struct sinsp_thread_expiry_entry
+{
+	int64_t m_tid;
+	uint64_t m_clone_ts;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // This class manages the thread table
 ///////////////////////////////////////////////////////////////////////////////
@@ -607,7 +621,27 @@ public:
     threadinfo_map_t::ptr_t find_thread(int64_t tid, bool lookup_only);
 
 
-	void dump_threads_to_file(scap_dumper_t* dumper);
+	/*!
+	  \brief Write the thread and fd tables to a capture file.
+
+	  \param keep_base remember what was written, as the base of the
+	   following calls to dump_thread_deltas_to_file()
+	*/
+	void dump_threads_to_file(scap_dumper_t* dumper, bool keep_base = false);
+
+	/*!
+	  \brief Remember the current tables as the base of the following
+	   calls to dump_thread_deltas_to_file(), when another writer (like
+	   the /proc scan of scap) filled the base capture.
+	*/
+	void keep_dump_base();
+
+	/*!
+	  \brief Write only the threads and fds that were added, changed or
+	   removed since the last dump_threads_to_file() with keep_base, after
+	   the state base block that names the file it wrote to.
+	*/
+	void dump_thread_deltas_to_file(scap_dumper_t* dumper);
 
 	uint32_t get_thread_count()
 	{
@@ -632,17 +666,53 @@ public:
 
 	void set_m_max_n_proc_lookups(int32_t val) { m_max_n_proc_lookups = val; }
 	void set_m_max_n_proc_socket_lookups(int32_t val) { m_max_n_proc_socket_lookups = val; }
-private:
+
+	/*!
+	  \brief When enabled, threads that are not in the table are created
+	  right away from the event with placeholder values, and /proc is read
+	  in the background. The results are merged by merge_proc_lookups().
+	  Only applies to live captures.
+	*/
+	void set_async_proc_lookups(bool enabled);
+
+	inline bool has_proc_lookup_results() const;
+
+	/*!
+	  \brief Replace the placeholders with what was read from /proc,
+	  keeping the fds that were created by the events seen in the meantime.
+	*/
+	void merge_proc_lookups();
+
+	void stop_async_proc_lookups();
+
+	uint32_t get_pending_proc_lookups() const
+	{
+		return (uint32_t)m_pending_proc_lookups.size();
+	}
+
+VISIBILITY_PRIVATE
+	bool queue_proc_lookup(int64_t tid, bool scan_sockets);
+	void merge_proc_lookup(sinsp_threadinfo* tinfo, scap_threadinfo* pi);
 	void increment_mainthread_childcount(sinsp_threadinfo* threadinfo);
 	inline void clear_thread_pointers(sinsp_threadinfo& threadinfo);
 	void free_dump_fdinfos(std::vector<scap_fdinfo*>* fdinfos_to_free);
 	void thread_to_scap(sinsp_threadinfo& tinfo, scap_threadinfo* sctinfo);
+	void write_proclist(scap_dumper_t* dumper, const std::vector<sinsp_threadinfo*>& threads);
+	void write_fds(scap_dumper_t* dumper, sinsp_threadinfo& tinfo, const std::vector<int64_t>* fds);
+	size_t thread_state_hash(sinsp_threadinfo& tinfo, std::unordered_map<const void*, size_t>& block_hashes);
+	void schedule_thread_expiry(sinsp_threadinfo* tinfo);
+	void schedule_thread_expiry(sinsp_threadinfo* tinfo, uint64_t deadline_ns);
 
 	sinsp* m_inspector;
 	threadinfo_map_t m_threadtable;
 	int64_t m_last_tid;
 	std::weak_ptr<sinsp_threadinfo> m_last_tinfo;
 	uint64_t m_last_flush_time_ns;
+	libsinsp::timing_wheel<sinsp_thread_expiry_entry> m_expiry_wheel;
+	std::vector<sinsp_thread_expiry_entry> m_expired_threads;
+	// threads added before the first event, waiting for its timestamp
+	std::vector<sinsp_thread_expiry_entry> m_unscheduled_threads;
+	uint32_t m_n_purged_threads;
 	uint32_t m_n_drops;
 	const uint32_t m_thread_table_absolute_max_size = 131072;
 	uint32_t m_max_thread_table_size;
@@ -651,6 +721,25 @@ private:
 	int32_t m_n_main_thread_lookups = 0;
 	int32_t m_max_n_proc_lookups = -1;
 	int32_t m_max_n_proc_socket_lookups = -1;
+	bool m_async_proc_lookups = false;
+	const uint64_t m_proc_lookup_ttl_ms = 30000;
+	std::shared_ptr<sinsp_proc_async_source> m_proc_async_source;
+	// threads still holding placeholder values
+	std::unordered_set<int64_t> m_pending_proc_lookups;
+
+	// What the base of the delta captures holds: the hash of each thread,
+	// and of each fd of the main threads
+	struct dumped_thread
+	{
+		size_t m_hash;
+		std::unordered_map<int64_t, size_t> m_fds;
+	};
+	std::unordered_map<int64_t, dumped_thread> m_dump_base;
+
+	sinsp_metric_counter* m_metric_added;
+	sinsp_metric_counter* m_metric_removed;
+	sinsp_metric_counter* m_metric_dropped;
+	sinsp_metric_gauge* m_metric_threads;
 
 	INTERNAL_COUNTER(m_failed_lookups);
 	INTERNAL_COUNTER(m_cached_lookups);
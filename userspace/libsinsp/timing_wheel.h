@@ -0,0 +1,308 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace libsinsp
+{
+
+/**
+ * Hierarchical timing wheel used to expire the entries of the inspector
+ * tables (threads, containers, DNS names...).
+ *
+ * Items are scheduled with a deadline and handed back by pop_expired()
+ * once the deadline has passed, so the cost of expiring things is
+ * proportional to what expires and not to the size of the tables.
+ * Schedule and expiry are O(1); an item is moved to a lower level at most
+ * LEVELS - 1 times during its life, and those moves are spread over the
+ * pop_expired() calls like the expiries.
+ *
+ * There's no cancellation: owners are expected to check, when an item
+ * expires, whether the object it refers to is still there and still due,
+ * and schedule it again if it isn't. This keeps the hot paths (e.g. thread
+ * lookups) free from any bookkeeping.
+ *
+ * Not thread-safe.
+ */
+template<typename T>
+class timing_wheel
+{
+public:
+	static const uint32_t SLOT_BITS = 6;
+	static const uint32_t SLOTS = 1 << SLOT_BITS;
+	static const uint32_t LEVELS = 4;
+
+	explicit timing_wheel(uint64_t tick_ns):
+		m_tick_ns(tick_ns),
+		m_started(false),
+		m_now(0),
+		m_cursor(0),
+		m_cascade_cursor(0),
+		m_size(0)
+	{
+		for(uint32_t l = 0; l < LEVELS; l++)
+		{
+			m_level_size[l] = 0;
+			m_levels[l].resize(SLOTS);
+		}
+	}
+
+	/**
+	 * Schedule item to expire at deadline_ns. Deadlines that already
+	 * passed expire with the next pop_expired() call.
+	 */
+	void schedule(T item, uint64_t deadline_ns)
+	{
+		entry e{std::move(item), deadline_ns / m_tick_ns};
+
+		//
+		// The clock starts with the first pop_expired(), until then
+		// items are kept aside
+		//
+		if(!m_started)
+		{
+			m_pending.push_back(std::move(e));
+		}
+		else
+		{
+			insert(std::move(e));
+		}
+		m_size++;
+	}
+
+	/**
+	 * Move expired items into out, resuming from where the previous call
+	 * stopped. At most max_items items are expired or moved between
+	 * levels, so the cost of a call is bounded even when a lot of items
+	 * expire together. Returns the number of items moved into out.
+	 */
+	uint32_t pop_expired(uint64_t now_ns, uint32_t max_items, std::vector<T>& out)
+	{
+		uint64_t now_tick = now_ns / m_tick_ns;
+		uint32_t npopped = 0;
+		uint32_t nwork = 0;
+
+		if(!m_started)
+		{
+			m_started = true;
+			m_now = now_tick;
+			for(const auto& e : m_pending)
+			{
+				if(e.m_tick < m_now)
+				{
+					m_now = e.m_tick;
+				}
+			}
+
+			for(auto& e : m_pending)
+			{
+				insert(std::move(e));
+			}
+			m_pending.clear();
+		}
+
+		while(nwork < max_items)
+		{
+			//
+			// Finish moving down the upper level slots that became
+			// current, they may contain items for the current tick
+			//
+			if(m_cascade_cursor < m_cascade.size())
+			{
+				insert(std::move(m_cascade[m_cascade_cursor++]));
+				nwork++;
+				continue;
+			}
+			else if(!m_cascade.empty())
+			{
+				m_cascade.clear();
+				m_cascade_cursor = 0;
+			}
+
+			//
+			// A tick expires when it's fully in the past
+			//
+			if(m_now >= now_tick)
+			{
+				break;
+			}
+
+			std::deque<entry>& slot = m_levels[0][m_now & (SLOTS - 1)];
+			if(m_cursor < slot.size())
+			{
+				entry& e = slot[m_cursor++];
+				m_level_size[0]--;
+				nwork++;
+
+				//
+				// Items with a deadline beyond the wheel span were
+				// parked early, put them back in
+				//
+				if(e.m_tick > m_now)
+				{
+					insert(std::move(e));
+					continue;
+				}
+
+				out.push_back(std::move(e.m_item));
+				npopped++;
+				continue;
+			}
+
+			slot.clear();
+			m_cursor = 0;
+			advance(now_tick);
+		}
+
+		m_size -= npopped;
+		return npopped;
+	}
+
+	void clear()
+	{
+		for(uint32_t l = 0; l < LEVELS; l++)
+		{
+			for(auto& slot : m_levels[l])
+			{
+				slot.clear();
+			}
+			m_level_size[l] = 0;
+		}
+		m_pending.clear();
+		m_cascade.clear();
+		m_cascade_cursor = 0;
+		m_started = false;
+		m_now = 0;
+		m_cursor = 0;
+		m_size = 0;
+	}
+
+	inline size_t size() const
+	{
+		return m_size;
+	}
+
+private:
+	struct entry
+	{
+		T m_item;
+		uint64_t m_tick;
+	};
+
+	void insert(entry&& e)
+	{
+		uint64_t tick = e.m_tick < m_now ? m_now : e.m_tick;
+		uint64_t delta = tick - m_now;
+		uint32_t level = 0;
+
+		while(level < LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1))))
+		{
+			level++;
+		}
+
+		// park the items that are farther than the span of the top level
+		if(delta >= (1ULL << (SLOT_BITS * LEVELS)))
+		{
+			tick = m_now + (1ULL << (SLOT_BITS * LEVELS)) - 1;
+		}
+
+		m_levels[level][(tick >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(std::move(e));
+		m_level_size[level]++;
+	}
+
+	//
+	// Move the clock one tick forward, or more if the lower levels are
+	// empty. The upper level slots that become current are queued to be
+	// moved down by pop_expired().
+	//
+	void advance(uint64_t now_tick)
+	{
+		uint32_t empty_levels = 0;
+		while(empty_levels < LEVELS && m_level_size[empty_levels] == 0)
+		{
+			empty_levels++;
+		}
+
+		if(empty_levels == LEVELS)
+		{
+			m_now = now_tick;
+			return;
+		}
+
+		//
+		// With the first n levels empty nothing can expire before the
+		// next slot of level n becomes current
+		//
+		uint64_t next = m_now + 1;
+		if(empty_levels > 0)
+		{
+			uint64_t span = 1ULL << (SLOT_BITS * empty_levels);
+			next = (m_now | (span - 1)) + 1;
+			if(next > now_tick)
+			{
+				next = now_tick;
+			}
+		}
+		m_now = next;
+
+		for(uint32_t l = 1; l < LEVELS; l++)
+		{
+			if((m_now & ((1ULL << (SLOT_BITS * l)) - 1)) != 0)
+			{
+				break;
+			}
+
+			std::deque<entry>& slot = m_levels[l][(m_now >> (SLOT_BITS * l)) & (SLOTS - 1)];
+			m_level_size[l] -= slot.size();
+
+			if(m_cascade.empty())
+			{
+				m_cascade.swap(slot);
+			}
+			else
+			{
+				for(auto& e : slot)
+				{
+					m_cascade.push_back(std::move(e));
+				}
+				slot.clear();
+			}
+		}
+	}
+
+	uint64_t m_tick_ns;
+	bool m_started;
+	// current tick, the slots of older ticks are empty
+	uint64_t m_now;
+	// position inside the current level 0 slot, so a slot can be drained over several calls
+	size_t m_cursor;
+	// items of the upper level slots that became current, being moved down
+	std::deque<entry> m_cascade;
+	size_t m_cascade_cursor;
+	size_t m_size;
+	// items scheduled before the clock started
+	std::deque<entry> m_pending;
+	std::vector<std::deque<entry>> m_levels[LEVELS];
+	size_t m_level_size[LEVELS];
+};
+
+}
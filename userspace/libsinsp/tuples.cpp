@@ -15,6 +15,7 @@ limitations under the License.
 
 */
 
+#include <string.h>
 #include <tuples.h>
 
 ipv6addr ipv6addr::empty_address = {0x00000000, 0x00000000, 0x00000000, 0x00000000};
@@ -50,3 +51,23 @@ bool ipv6addr::in_subnet(const ipv6addr &other) const
 	return (m_b[0] == other.m_b[0] &&
 		m_b[1] == other.m_b[1]);
 }
+
+bool ipv6addr::in_subnet(const ipv6addr &other, uint32_t prefix_len) const
+{
+	const uint8_t* a = (const uint8_t*)m_b;
+	const uint8_t* b = (const uint8_t*)other.m_b;
+	uint32_t nbytes = prefix_len / 8;
+
+	if(memcmp(a, b, nbytes) != 0)
+	{
+		return false;
+	}
+
+	if(prefix_len % 8 == 0)
+	{
+		return true;
+	}
+
+	uint8_t mask = (uint8_t)(0xff << (8 - prefix_len % 8));
+	return (a[nbytes] & mask) == (b[nbytes] & mask);
+}
@@ -56,10 +56,20 @@ typedef struct _ipv6addr
 	bool operator!=(const _ipv6addr &other) const;
 	bool operator<(const _ipv6addr &other) const;
 	bool in_subnet(const _ipv6addr &other) const;
+	bool in_subnet(const _ipv6addr &other, uint32_t prefix_len) const;
 
 	static struct _ipv6addr empty_address;
 }ipv6addr;
 
+/*!
+	\brief An IPv6 network.
+*/
+typedef struct ipv6net
+{
+	ipv6addr m_ip; ///< IP addr
+	uint32_t m_prefix_len; ///< Number of leading bits of m_ip that identify the network
+}ipv6net;
+
 
 /*!
 	\brief An IPv6 tuple. 
@@ -158,7 +158,6 @@ size_t sinsp_filter_value_parser::string_to_rawval(const char* str, uint32_t len
 			parsed_len = sizeof(struct in_addr);
 			break;
 	        case PT_IPV6ADDR:
-	        case PT_IPV6NET:
 		{
 			ipv6addr *addr = (ipv6addr*) storage;
 			if(inet_pton(AF_INET6, str, addr->m_b) != 1)
@@ -168,6 +167,36 @@ size_t sinsp_filter_value_parser::string_to_rawval(const char* str, uint32_t len
 			parsed_len = sizeof(ipv6addr);
 			break;
 		}
+	        case PT_IPV6NET:
+		{
+			stringstream ss(str);
+			string ip, prefix;
+			ipv6net* net = (ipv6net*)storage;
+
+			getline(ss, ip, '/');
+
+			if(inet_pton(AF_INET6, ip.c_str(), net->m_ip.m_b) != 1)
+			{
+				throw sinsp_exception("unrecognized IPv6 address " + string(str));
+			}
+
+			//
+			// Without a prefix length, the network is the first 64 bits
+			//
+			net->m_prefix_len = 64;
+			if(getline(ss, prefix))
+			{
+				net->m_prefix_len = sinsp_numparser::parseu32(prefix);
+
+				if(net->m_prefix_len > 128)
+				{
+					throw sinsp_exception("invalid prefix length " + prefix);
+				}
+			}
+
+			parsed_len = sizeof(ipv6net);
+			break;
+		}
 		case PT_IPNET:
 			if(memchr(str, '.', len) != NULL)
 			{